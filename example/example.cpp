@@ -1,505 +1,1034 @@
-
-
-#include <string>
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <cassert>
-
-#include "../luaaa.hpp"
-
-#define LOG printf
-
-
-void bindToLUA(lua_State *);
-
-void runLuaExample(lua_State * ls)
-{
-    bindToLUA(ls);
-    
-    do {
-        LOG("------------------------------------------\n");
-        std::stringstream buffer;
-        std::ifstream file("example.lua");
-        if (file)
-        {
-            buffer << file.rdbuf();
-            file.close();
-        }
-
-
-        int err = luaL_loadbuffer(ls, buffer.str().c_str(), buffer.str().length(), "console");
-        if (err == 0)
-        {
-            err = lua_pcall(ls, 0, 0, 0);
-        }
-
-        if (err)
-        {
-            LOG("lua err: %s", lua_tostring(ls, -1));
-            lua_pop(ls, 1);
-        }
-        
-    } while (std::cin.get() != 27);
-    
-}
-
-
-int main()
-{
-    auto ls = luaL_newstate();
-    luaL_openlibs(ls);
-
-    if (ls != NULL)
-    {
-        runLuaExample(ls);
-
-        lua_close(ls);
-    }
-    return 0;
-}
-
-
-
-//===============================================================================
-// example c++ class 
-//===============================================================================
-
-
-class Cat
-{
-public:
-    Cat()
-        : m_age(1), m_weight(1.0f)
-    {
-        LOG("Cat: a cat spawn at %p.\n", this);
-    }
-
-    Cat(const std::string& name)
-        : m_name(name), m_age(1), m_weight(1.0f)
-    {
-        LOG("Cat: %s spawn at %p\n", m_name.c_str(), this);
-    }
-
-    ~Cat()
-    {
-        LOG("Cat: cat[%p] %s is free.\n", this, m_name.c_str());
-    }
-
-    const std::string& getName() const {
-        LOG("Cat:get name\n");
-        return m_name; 
-    }
-
-
-    const std::string& setName(const std::string& name)
-    {
-        LOG("Cat:set name to %s\n", name.c_str());
-        m_name = name; 
-        return m_name;
-    }
-
-    int setAge(const int age)
-    { 
-        LOG("Cat:set age to %d\n", age);
-        m_age = age; 
-        return m_age;
-    }
-
-    int getAge() const
-    {
-        LOG("Cat:get age\n");
-        return m_age; 
-    }
-
-    float setWeight(float w)
-    {
-        LOG("Cat:set weight to %f\n", w);
-        m_weight = w;
-        return m_weight;
-    }
-
-    float getWeight() const
-    {
-        LOG("Cat:get weight\n");
-        return m_weight;
-    }
-
-    void eat(const std::list<std::string>& foods)
-    {
-        for (auto & it : foods)
-        {
-            LOG("%s eat %s.\n", m_name.c_str(), it.c_str());
-            m_weight += 0.1f;
-        }
-        LOG("%s is getting fatter.\n", m_name.c_str());
-    }
-
-    void test(int a, const std::string& b, float c, const std::string& d, const std::string& e)
-    {
-        LOG("cat test: got params from lua: [0: %d, 1:%s, 2:%f, 3:%s, 4:%s]\n", a, b.c_str(), c, d.c_str(), e.c_str());
-    }
-
-    std::string toString() const
-    { 
-        std::stringstream result;
-        result << m_name << " is a cat, he is " << m_age <<" years old, has a weight of " << m_weight << " kg.";
-        return result.str();
-    }
-
-    static void speak(const std::string& w)
-    {
-        LOG("%s, miaow~~\n", w.c_str());
-    }
-
-    void testfunctor(std::function<int(int param)> callback)
-    {
-	    int result = callback(42);
-	    LOG("Callback with argument 42 leads to %d.\n", result);
-    }
-
-public:
-    std::string prop1;
-    std::set<std::string> prop3;
-private:
-    std::string m_name;
-    int m_age;
-    float m_weight;
-};
-
-
-std::string getProp1(const Cat& cat) {
-    printf("*** READ prop1 ***\n");
-    return cat.prop1;
-}
-
-void setProp1(Cat& cat, const std::string& val) {
-    printf("*** WRITE prop1 ***\n");
-    cat.prop1 = val;
-}
-
-
-class SingletonWorld 
-{
-public:
-    static SingletonWorld * getInstance() {
-        static SingletonWorld instance("singleton");
-        return &instance;
-    }
-
-    static SingletonWorld * newInstance(const std::string tagName) {
-        return new SingletonWorld(tagName);
-    }
-
-    static void delInstance(SingletonWorld * instance) {
-        delete instance;
-    }
-public:
-    const std::string getTag() const {
-        return mTag;
-    }
-
-    SingletonWorld() {
-        mTag = "default";
-        LOG("SingletonWorld[%s] constructed.\n", mTag.c_str());
-    }
-
-    SingletonWorld(const std::string& tagName) : mTag(tagName) {
-        LOG("SingletonWorld[%s] constructed.\n", mTag.c_str());
-    }
-
-    ~SingletonWorld() {
-        LOG("SingletonWorld[%s] destructed.\n", mTag.c_str());
-    }
-private:
-    std::string mTag;
-};
-
-class Position {
-public:
-    float x;
-    float y;
-    float z;
-
-    Position():x(0), y(0), z(0) {}
-    Position(float fx, float fy, float fz):x(fx), y(fy), z(fz) {}
-};
-
-
-
-//===============================================================================
-// example c functions
-//===============================================================================
-void testSet(const std::set<int>& s1, const std::set<int>& s2)
-{
-    LOG("testSet: set<int> size: s1:%lu s2:%lu\n", s1.size(), s2.size());
-    LOG("--------------------------\n");
-    LOG("s1:");
-    for (auto it = s1.begin(); it != s1.end(); ++it)
-    {
-        LOG("%d ", *it);
-    }
-    LOG("\ns2:");
-    for (auto it = s2.begin(); it != s2.end(); ++it)
-    {
-        LOG("%d ", *it);
-    }
-    LOG("\n--------------------------\n");
-}
-
-void testSetSet(const std::multiset<std::set<std::string>>& s)
-{
-    LOG("testSetSet: multiset<set<str>> size: %lu\n", s.size());
-    LOG("--------------------------\n");
-    for (auto it = s.begin(); it != s.end(); ++it)
-    {
-        LOG("=>set<str> size: %lu\n", it->size());
-        for (auto nit = it->begin(); nit != it->end(); ++nit)
-        {
-            LOG("'%s', ", nit->c_str());
-        }
-        LOG("\n");
-    }
-    LOG("\n--------------------------\n");
-}
-
-
-void testMapMap(const std::map<std::string, std::map<std::string, std::string>>& s)
-{
-    LOG("testMapMap: map<str, map<str, str>> size: %lu\n", s.size());
-    LOG("--------------------------\n");
-    for (auto it = s.begin(); it != s.end(); ++it)
-    {
-        LOG("'%s' => map<str, str> size: %lu\n", it->first.c_str(), it->second.size());
-        for (auto nit = it->second.begin(); nit != it->second.end(); ++nit)
-        {
-            LOG("%s = %s, ", nit->first.c_str(),  nit->second.c_str());
-        }
-        LOG("\n");
-    }
-    LOG("\n--------------------------\n");
-}
-
-
-const std::tuple<int, std::string, std::string, float> testTuple(std::tuple<std::string, int, float> info) {
-    LOG("c++ load lua list to tuple:\n");
-    LOG("\t0: '%s'\n", std::get<0>(info).c_str());
-    LOG("\t1: %d\n", std::get<1>(info));
-    LOG("\t2: %g\n", std::get<2>(info));
-    LOG("c++ returns tuple to lua:\n");
-    return std::tuple<int, std::string, std::string, float>(123, "string A", "string B", 0.123f);
-}
-
-const std::tuple<> testTuple2(std::tuple<> info) {
-    LOG("c++ load lua list to empty tuple.\n");
-    LOG("c++ returns empty tuple to lua:\n");
-    return std::tuple<>();
-}
-
-void testMultipleParams(int a, int b, const std::string& c, float d, double e)
-{
-    LOG("c++ testCallback: got params from lua: [0: %d, 1: %d, 2: %s, 3: %f, 4: %g]\n", a, b, c.c_str(), d, e);
-}
-
-
-void testCallback(int (*f)(const std::string&, int, float), int val, const std::string& str)
-{
-    auto result = f("a string from c++:" + str, val, 1.2345678f);
-    LOG("c++ testCallback: got result from lua callback: %d\n", result);
-}
-
-void testCallbackFunctor(std::function<int(const std::string&, int, float)> f, int val, const std::string& str)
-{
-    auto result = f("a string from c++:" + str, val, 8.7654321f);
-    LOG("c++ testCallbackFunctor: got result from lua callback: %d\n", result);
-}
-
-
-//===============================================
-// declare custom LuaStack operators
-//===============================================
-// for GCC, it must be delcared in namespace luaaa.
-namespace luaaa {
-    template<> struct LuaStack<Position>
-    {
-        inline static Position get(lua_State * L, int idx)
-        {
-            auto dict = LuaStack<std::map<std::string, float>>::get(L, idx);
-            return Position(dict.find("x")->second, dict.find("y")->second, dict.find("z")->second);
-        }
-
-        inline static void put(lua_State * L, const Position & v)
-        {
-            std::map<std::string, float> dict;
-            dict["x"] = v.x;
-            dict["y"] = v.y;
-            dict["z"] = v.z;
-            LuaStack<decltype(dict)>::put(L, dict);
-        }
-    };
-}
-//*/
-
-Position testPosition(const Position& a, const Position& b)
-{
-    return Position(a.x + b.x, a.y + b.y, a.z + b.z);
-}
-
-
-//===============================================
-// below shows ho to bind c++ with lua
-//===============================================
-using namespace luaaa;
-
-
-int module__index(lua_State* state) {
-    LOG("~~~~~~~~~~~~~~~~~~module__index:~~~~~~~~~~~~~~~~~~~");
-    lua_pushinteger(state, 999);
-    return 1;
-}
-
-int module__newindex(lua_State* state) {
-    LOG("~~~~~~~~~~~~~~~~~~module__newindex:~~~~~~~~~~~~~~~~~~~");
-    lua_rawset(state, -3);
-    return 0;
-}
-
-void moduleSetProp1(const std::string& val) {
-    LOG("moduleSetProp1:%s", val.c_str());
-    return;
-}
-
-
-const char* moduleGetProp1() {
-    LOG("moduleGetProp1");
-    return "string as prop1 value";
-}
-
-int moduleSetProp2(int val) {
-    LOG("moduleSetProp2:%d", val);
-    return val;
-}
-
-const char* moduleGetProp2() {
-    LOG("moduleGetProp2");
-    return "string as prop2 value";
-}
-
-
-
-void bindToLUA(lua_State * L)
-{
-    // bind class to lua
-    LuaClass<Cat> luaCat(L, "AwesomeCat");
-    luaCat.ctor<std::string>();
-    luaCat.fun("setName", &Cat::setName);
-    luaCat.fun("getName", &Cat::getName);
-    luaCat.fun("setAge", &Cat::setAge);
-    luaCat.fun("getAge", &Cat::getAge);
-    luaCat.fun("eat", &Cat::eat);
-    luaCat.fun("speak", &Cat::speak);
-    luaCat.fun("test", &Cat::test);
-    luaCat.fun("testfunctor", &Cat::testfunctor);
-    luaCat.fun(std::string("testFunctor1"), [](int n1, int n2) -> int {
-        LOG("testFunctor1:%d, %d\n", n1, n2);
-        return n1 * n2;
-    });
-    luaCat.fun("testFunctor2", std::function<void(int, int)>([](int n1, int n2) {
-        LOG("testFunctor2:%d, %d\n", n1, n2);
-    }));
-    luaCat.fun("__tostring", &Cat::toString);
-    luaCat.def("tag", "Animal");
-
-    luaCat.set("say", &Cat::speak);
-    luaCat.set("name", &Cat::setName);
-    luaCat.get("name", &Cat::getName);
-    luaCat.set("age", &Cat::setAge);
-    luaCat.get("age", &Cat::getAge);
-
-    luaCat.set("prop1", setProp1);
-    luaCat.get("prop1", getProp1);
-    luaCat.set("prop2", [](const Cat& cat, float val) -> void { printf("set prop2=%f\n", val); /*cat.setWeight(val)*/; });
-    luaCat.get("prop2", [](Cat& cat) -> float { printf("get prop2\n");  return cat.getWeight(); });
-    luaCat.set(std::string("prop3"), [](Cat& cat, const std::set<std::string>& val) { printf("set prop3\n");  cat.prop3 = val; });
-    luaCat.get(std::string("prop3"), [](const Cat& cat) -> std::set<std::string> { printf("get prop3\n");  return cat.prop3; });
-    luaCat.set(std::string("prop4"), [](float val) { printf("set prop4=%f\n", val); });
-    luaCat.get(std::string("prop4"), []() -> float { printf("get prop4\n");  return 0.123f; });
-
-    // rise compile error
-    //luaCat.set(std::string("prop5"), [](float val, int v2) { printf("set prop5=%f\n", val); });
-    //luaCat.get(std::string("prop5"), [](int) -> float { printf("get prop5\n");  return 0.123f; });
-
-
-    // bind singleton class to lua
-    LuaClass<SingletonWorld> luaWorld(L, "SingletonWorld");
-    /// use class default constructor as instance spawner, default destructor will be called from gc.
-    luaWorld.ctor();
-    /// use class constructor as instance spawner, default destructor will be called from gc.
-    luaWorld.ctor<const std::string&>("createWithName");
-    /// use static function as instance spawner, default destructor will be called from gc.
-    luaWorld.ctor("newInstance", &SingletonWorld::newInstance);
-    /// use static function as instance spawner and static function as delete function which be called from gc.
-    luaWorld.ctor("managedInstance", &SingletonWorld::newInstance , &SingletonWorld::delInstance);
-    /// for singleton pattern, set deleter(gc) to nullptr to avoid singleton instance be destroyed.
-    luaWorld.ctor("getInstance", &SingletonWorld::getInstance, nullptr);
-    luaWorld.fun("getTag", &SingletonWorld::getTag);
-
-
-    // define a module with name "AwesomeMod"
-    LuaModule awesomeMod(L, "AwesomeMod");
-    awesomeMod.def("cint", 20190101);
-    awesomeMod.def("cstr", "this is c string");
-    awesomeMod.def("acat", luaCat);
-
-    std::list<std::string> dict {
-        "AMICUS", "AMOS", "AMTRAK", "ANGELICA", "ANNIE OAKLEY", 
-        "BEETHOVEN", "BERTHA", "BESSEYA", "BILLIE JEAN", "BIMBO", 
-        "BISS", "DECATHLON", "DELIRIUM", "DELIUS", "DEMPSEY" 
-    };
-
-    awesomeMod.def("dict", dict);
-
-    // c++11 standard conatiners(array, vector, deque, list, forward_list, set/multiset, map/multimap, unordered_set/unordered_multiset, unordered_map/unordered_multimap)
-    awesomeMod.fun("testSet", testSet);
-    awesomeMod.fun("testSetSet", testSetSet);
-    awesomeMod.fun("testMapMap", testMapMap);
-    awesomeMod.fun("testMultipleParams", testMultipleParams);
-    awesomeMod.fun("testTuple", testTuple);
-    awesomeMod.fun("testTuple2", testTuple2);
-    awesomeMod.fun("testCallback", testCallback);
-    awesomeMod.fun("testCallbackFunctor", testCallbackFunctor);
-    awesomeMod.fun("testPosition", testPosition);
-    awesomeMod.fun("testFunctor1", [](int a, float b) {
-        LOG("awesomeMod call testFunctor1: %d, %f", a, b);
-    });
-    awesomeMod.fun("testFunctor2", [](int a, float b) -> float {
-        LOG("awesomeMod call testFunctor2(%d * %f = %f):", a, b, a*b);
-        return a * b;
-    });
-
-    awesomeMod.set("prop1", moduleSetProp1);
-    awesomeMod.get("prop1", moduleGetProp1);
-    awesomeMod.set("prop2", moduleSetProp2);
-    awesomeMod.get("prop2", moduleGetProp2);
-    awesomeMod.set(std::string("prop3"), [](const std::string& val) { printf("set prop3=%s\n", val.c_str()); });
-    awesomeMod.get(std::string("prop3"), []() -> std::string { printf("get prop3\n");  return "string as prop3"; });
-    awesomeMod.set(std::string("prop4"), [](float val) { printf("set prop4=%f\n", val); });
-    awesomeMod.get(std::string("prop4"), [](){ printf("get prop4\n"); return 0.123f; });
-
-    awesomeMod.fun("__index", module__index);
-    awesomeMod.fun("__newindex", module__newindex);
-
-    // put something to global, just emit the module name
-    LuaModule(L).def("pi", 3.1415926535897932);
-
-    LuaModule(L).def("WITHOUT_CPP_STDLIB", !!LUAAA_WITHOUT_CPP_STDLIB);
-
-    // operations can be chained.
-    LuaClass<int*>(L, "int")
-    .ctor<int*>("new")
-    .def("type", std::string("[c int *]"))
-    .def("max", INT_MAX)
-    .def("min", INT_MIN);
-
-}
-
+
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cassert>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "../luaaa.hpp"
+#include "../luaaa_json.hpp"
+#include "../luaaa_math.hpp"
+#include "../luaaa_msgpack.hpp"
+#include "../luaaa_thread.hpp"
+
+#define LOG printf
+
+// counts global operator new, to compare bound functions taking std::pmr args with std ones.
+static std::atomic<long> allocations(0);
+void * operator new(size_t size)
+{
+    ++allocations;
+    void * p = malloc(size ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void * p) noexcept { free(p); }
+void operator delete(void * p, size_t) noexcept { free(p); }
+
+
+void bindToLUA(lua_State *);
+
+void runLuaExample(lua_State * ls)
+{
+    bindToLUA(ls);
+    
+    do {
+        LOG("------------------------------------------\n");
+        std::stringstream buffer;
+        std::ifstream file("example.lua");
+        if (file)
+        {
+            buffer << file.rdbuf();
+            file.close();
+        }
+
+
+        int err = luaL_loadbuffer(ls, buffer.str().c_str(), buffer.str().length(), "console");
+        if (err == 0)
+        {
+            err = lua_pcall(ls, 0, 0, 0);
+        }
+
+        if (err)
+        {
+            LOG("lua err: %s", lua_tostring(ls, -1));
+            lua_pop(ls, 1);
+        }
+        
+    } while (std::cin.get() != 27);
+    
+}
+
+
+int main()
+{
+    auto ls = luaL_newstate();
+    luaL_openlibs(ls);
+
+    if (ls != NULL)
+    {
+        runLuaExample(ls);
+
+        lua_close(ls);
+    }
+    return 0;
+}
+
+
+
+//===============================================================================
+// example c++ class 
+//===============================================================================
+
+
+class Cat
+{
+public:
+    Cat()
+        : m_age(1), m_weight(1.0f)
+    {
+        LOG("Cat: a cat spawn at %p.\n", this);
+    }
+
+    Cat(const std::string& name)
+        : m_name(name), m_age(1), m_weight(1.0f)
+    {
+        LOG("Cat: %s spawn at %p\n", m_name.c_str(), this);
+    }
+
+    ~Cat()
+    {
+        LOG("Cat: cat[%p] %s is free.\n", this, m_name.c_str());
+    }
+
+    const std::string& getName() const {
+        LOG("Cat:get name\n");
+        return m_name; 
+    }
+
+
+    const std::string& setName(const std::string& name)
+    {
+        LOG("Cat:set name to %s\n", name.c_str());
+        m_name = name; 
+        return m_name;
+    }
+
+    int setAge(const int age)
+    { 
+        LOG("Cat:set age to %d\n", age);
+        m_age = age; 
+        return m_age;
+    }
+
+    int getAge() const
+    {
+        LOG("Cat:get age\n");
+        return m_age; 
+    }
+
+    float setWeight(float w)
+    {
+        LOG("Cat:set weight to %f\n", w);
+        m_weight = w;
+        return m_weight;
+    }
+
+    float getWeight() const
+    {
+        LOG("Cat:get weight\n");
+        return m_weight;
+    }
+
+    void eat(const std::list<std::string>& foods)
+    {
+        for (auto & it : foods)
+        {
+            LOG("%s eat %s.\n", m_name.c_str(), it.c_str());
+            m_weight += 0.1f;
+        }
+        LOG("%s is getting fatter.\n", m_name.c_str());
+    }
+
+    void test(int a, const std::string& b, float c, const std::string& d, const std::string& e)
+    {
+        LOG("cat test: got params from lua: [0: %d, 1:%s, 2:%f, 3:%s, 4:%s]\n", a, b.c_str(), c, d.c_str(), e.c_str());
+    }
+
+    std::string toString() const
+    { 
+        std::stringstream result;
+        result << m_name << " is a cat, he is " << m_age <<" years old, has a weight of " << m_weight << " kg.";
+        return result.str();
+    }
+
+    static void speak(const std::string& w)
+    {
+        LOG("%s, miaow~~\n", w.c_str());
+    }
+
+    void testfunctor(std::function<int(int param)> callback)
+    {
+	    int result = callback(42);
+	    LOG("Callback with argument 42 leads to %d.\n", result);
+    }
+
+public:
+    std::string prop1;
+    std::set<std::string> prop3;
+private:
+    std::string m_name;
+    int m_age;
+    float m_weight;
+};
+
+
+std::string getProp1(const Cat& cat) {
+    printf("*** READ prop1 ***\n");
+    return cat.prop1;
+}
+
+void setProp1(Cat& cat, const std::string& val) {
+    printf("*** WRITE prop1 ***\n");
+    cat.prop1 = val;
+}
+
+
+class SingletonWorld 
+{
+public:
+    static SingletonWorld * getInstance() {
+        static SingletonWorld instance("singleton");
+        return &instance;
+    }
+
+    static SingletonWorld * newInstance(const std::string tagName) {
+        return new SingletonWorld(tagName);
+    }
+
+    static void delInstance(SingletonWorld * instance) {
+        delete instance;
+    }
+public:
+    const std::string getTag() const {
+        return mTag;
+    }
+
+    SingletonWorld() {
+        mTag = "default";
+        LOG("SingletonWorld[%s] constructed.\n", mTag.c_str());
+    }
+
+    SingletonWorld(const std::string& tagName) : mTag(tagName) {
+        LOG("SingletonWorld[%s] constructed.\n", mTag.c_str());
+    }
+
+    ~SingletonWorld() {
+        LOG("SingletonWorld[%s] destructed.\n", mTag.c_str());
+    }
+private:
+    std::string mTag;
+};
+
+class Position {
+public:
+    float x;
+    float y;
+    float z;
+
+    Position():x(0), y(0), z(0) {}
+    Position(float fx, float fy, float fz):x(fx), y(fy), z(fz) {}
+};
+
+struct Route {
+    std::string name;
+    Position start;
+    std::vector<Position> path;
+};
+
+struct Telemetry {
+    std::string source;
+    int frame;
+    std::vector<float> samples;
+};
+
+// class hierarchy bound by LuaClass::base, Entity is not the first base of Unit.
+class Named
+{
+public:
+    const std::string& getName() const { return m_name; }
+    void setName(const std::string& name) { m_name = name; }
+private:
+    std::string m_name;
+};
+
+class Entity
+{
+public:
+    Entity() : m_hp(100) {}
+    int getHp() const { return m_hp; }
+    void damage(int amount) { m_hp -= amount; }
+private:
+    int m_hp;
+};
+
+class Unit : public Named, public Entity
+{
+public:
+    Unit() : m_speed(1.5f) {}
+    float getSpeed() const { return m_speed; }
+private:
+    float m_speed;
+};
+
+
+// C++ class with virtuals, LuaBehavior forwards them to overrides of lua subclasses.
+class Behavior
+{
+public:
+    virtual ~Behavior() {}
+    virtual int tick(int dt) { return dt; }
+    virtual std::string name() const = 0;
+};
+
+class LuaBehavior : public luaaa::LuaOverridable<Behavior>
+{
+public:
+    int tick(int dt) override { LUAAA_OVERRIDE(Behavior, tick, (dt)); }
+    std::string name() const override { LUAAA_OVERRIDE_PURE(std::string, Behavior, name, ()); }
+};
+
+
+//===============================================================================
+// example c functions
+//===============================================================================
+void testSet(const std::set<int>& s1, const std::set<int>& s2)
+{
+    LOG("testSet: set<int> size: s1:%lu s2:%lu\n", s1.size(), s2.size());
+    LOG("--------------------------\n");
+    LOG("s1:");
+    for (auto it = s1.begin(); it != s1.end(); ++it)
+    {
+        LOG("%d ", *it);
+    }
+    LOG("\ns2:");
+    for (auto it = s2.begin(); it != s2.end(); ++it)
+    {
+        LOG("%d ", *it);
+    }
+    LOG("\n--------------------------\n");
+}
+
+void testSetSet(const std::multiset<std::set<std::string>>& s)
+{
+    LOG("testSetSet: multiset<set<str>> size: %lu\n", s.size());
+    LOG("--------------------------\n");
+    for (auto it = s.begin(); it != s.end(); ++it)
+    {
+        LOG("=>set<str> size: %lu\n", it->size());
+        for (auto nit = it->begin(); nit != it->end(); ++nit)
+        {
+            LOG("'%s', ", nit->c_str());
+        }
+        LOG("\n");
+    }
+    LOG("\n--------------------------\n");
+}
+
+
+void testMapMap(const std::map<std::string, std::map<std::string, std::string>>& s)
+{
+    LOG("testMapMap: map<str, map<str, str>> size: %lu\n", s.size());
+    LOG("--------------------------\n");
+    for (auto it = s.begin(); it != s.end(); ++it)
+    {
+        LOG("'%s' => map<str, str> size: %lu\n", it->first.c_str(), it->second.size());
+        for (auto nit = it->second.begin(); nit != it->second.end(); ++nit)
+        {
+            LOG("%s = %s, ", nit->first.c_str(),  nit->second.c_str());
+        }
+        LOG("\n");
+    }
+    LOG("\n--------------------------\n");
+}
+
+
+const std::tuple<int, std::string, std::string, float> testTuple(std::tuple<std::string, int, float> info) {
+    LOG("c++ load lua list to tuple:\n");
+    LOG("\t0: '%s'\n", std::get<0>(info).c_str());
+    LOG("\t1: %d\n", std::get<1>(info));
+    LOG("\t2: %g\n", std::get<2>(info));
+    LOG("c++ returns tuple to lua:\n");
+    return std::tuple<int, std::string, std::string, float>(123, "string A", "string B", 0.123f);
+}
+
+const std::tuple<> testTuple2(std::tuple<> info) {
+    LOG("c++ load lua list to empty tuple.\n");
+    LOG("c++ returns empty tuple to lua:\n");
+    return std::tuple<>();
+}
+
+void testMultipleParams(int a, int b, const std::string& c, float d, double e)
+{
+    LOG("c++ testCallback: got params from lua: [0: %d, 1: %d, 2: %s, 3: %f, 4: %g]\n", a, b, c.c_str(), d, e);
+}
+
+
+void testCallback(int (*f)(const std::string&, int, float), int val, const std::string& str)
+{
+    auto result = f("a string from c++:" + str, val, 1.2345678f);
+    LOG("c++ testCallback: got result from lua callback: %d\n", result);
+}
+
+void testCallbackFunctor(std::function<int(const std::string&, int, float)> f, int val, const std::string& str)
+{
+    auto result = f("a string from c++:" + str, val, 8.7654321f);
+    LOG("c++ testCallbackFunctor: got result from lua callback: %d\n", result);
+}
+
+
+//===============================================
+// declare custom LuaStack operators
+//===============================================
+// LUAAA_STRUCT generates LuaStack for struct <-> lua table, it must be used at global scope.
+LUAAA_STRUCT(Position, x, y, z)
+LUAAA_STRUCT(Route, name, start, path)
+LUAAA_STRUCT(Telemetry, source, frame, samples)
+
+// hand written LuaStack, rgb color as lua integer, white when omitted.
+struct Color {
+    unsigned rgb;
+};
+
+namespace luaaa
+{
+    template<> struct LuaStack<Color>
+    {
+        inline static Color get(lua_State * L, int idx)
+        {
+            Color c = { (unsigned)luaL_optinteger(L, idx, 0xffffff) };
+            return c;
+        }
+        inline static void put(lua_State * L, const Color& c)
+        {
+            lua_pushinteger(L, c.rgb);
+        }
+    };
+}
+
+// amount in cents, arithmetic and comparison bound as lua operators.
+class Money
+{
+public:
+    Money(int cents = 0) : m_cents(cents) {}
+    int cents() const { return m_cents; }
+    Money operator+(const Money& o) const { return Money(m_cents + o.m_cents); }
+    Money operator-(const Money& o) const { return Money(m_cents - o.m_cents); }
+    Money operator*(int n) const { return Money(m_cents * n); }
+    Money operator-() const { return Money(-m_cents); }
+    bool operator==(const Money& o) const { return m_cents == o.m_cents; }
+    bool operator<(const Money& o) const { return m_cents < o.m_cents; }
+private:
+    int m_cents;
+};
+
+Position testPosition(const Position& a, const Position& b)
+{
+    return Position(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+Route testRoute(const Route& route)
+{
+    Route reversed;
+    reversed.name = route.name + " reversed";
+    reversed.start = route.path.empty() ? route.start : route.path.back();
+    reversed.path.assign(route.path.rbegin(), route.path.rend());
+    return reversed;
+}
+
+// packs telemetry frame into msgpack straight from C++ members, samples become a packed float array.
+std::string testTelemetry(int frame, int count)
+{
+    Telemetry t;
+    t.source = "sensor";
+    t.frame = frame;
+    for (int i = 0; i < count; ++i)
+    {
+        t.samples.push_back(i * 0.5f);
+    }
+    luaaa::msgpack::Writer w;
+    luaaa::msgpack::pack(nullptr, t, w);
+    return std::string(w.data(), w.size());
+}
+
+
+//===============================================
+// below shows ho to bind c++ with lua
+//===============================================
+using namespace luaaa;
+
+
+// runs chunk `code` with arg in a new worker state, arg and result are copied between states by luaaa::transfer.
+int testTransfer(lua_State * L)
+{
+    size_t len = 0;
+    const char * code = luaL_checklstring(L, 1, &len);
+    lua_settop(L, 2);
+
+    lua_State * worker = luaL_newstate();
+    luaL_openlibs(worker);
+    bindToLUA(worker);
+    bool ok = luaL_loadbuffer(worker, code, len, "worker") == 0 && transfer(L, 2, worker) && lua_pcall(worker, 1, 1, 0) == 0;
+    if (ok)
+    {
+        ok = transfer(worker, -1, L);
+    }
+    else
+    {
+        lua_pushstring(L, lua_tostring(worker, -1));
+    }
+    lua_close(worker);
+    return ok ? 1 : lua_error(L);
+}
+
+// `producers` worker threads, each with own state, send `count` records into one channel, this state receives them.
+// returns milliseconds and sum of ids.
+int testChannel(lua_State * L)
+{
+    const int producers = (int)luaL_checkinteger(L, 1);
+    const int count = (int)luaL_checkinteger(L, 2);
+    Channel channel(1024);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < producers; ++i)
+    {
+        workers.emplace_back([channel, count]() {
+            lua_State * worker = luaL_newstate();
+            luaL_openlibs(worker);
+            Channel::bind(worker);
+            luaL_loadstring(worker, "local channel, n = ... for i = 1, n do channel:send({ id = i, name = 'item' .. i, tags = { 'a', 'b' } }) end");
+            LuaStack<Channel>::put(worker, channel);
+            lua_pushinteger(worker, count);
+            if (lua_pcall(worker, 2, 0, 0))
+            {
+                LOG("worker err: %s\n", lua_tostring(worker, -1));
+            }
+            lua_close(worker);
+        });
+    }
+
+    lua_Number sum = 0;
+    for (int i = 0; i < producers * count && channel.recv(L); ++i)
+    {
+        lua_getfield(L, -1, "id");
+        sum += lua_tonumber(L, -1);
+        lua_pop(L, 2);
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    lua_pushnumber(L, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    lua_pushnumber(L, sum);
+    return 2;
+}
+
+int testStateHandle(lua_State * L)
+{
+    const int threads = (int)luaL_checkinteger(L, 1);
+    const int count = (int)luaL_checkinteger(L, 2);
+    luaL_checktype(L, 3, LUA_TFUNCTION);
+    LuaFunctionRef fn(L, 3);
+    StateHandle handle(L);
+    std::atomic<int> done(0);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([&handle, &fn, &done, count]() {
+            for (int k = 1; k < count; ++k)
+            {
+                handle.notify(fn, k);
+            }
+            // last value waits for its result.
+            handle.call<lua_Number>(fn, count).get();
+            done++;
+        });
+    }
+    while (done.load() < threads)
+    {
+        if (handle.drain(256) == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    lua_pushnumber(L, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    return 1;
+}
+
+int testSharedView(lua_State * L)
+{
+    const int threads = (int)luaL_checkinteger(L, 1);
+    const int count = (int)luaL_checkinteger(L, 2);
+    std::vector<Route> routes(count);
+    for (int i = 0; i < count; ++i)
+    {
+        routes[i].name = "route" + std::to_string(i);
+        routes[i].start = Position(float(i), 0, 0);
+        for (int k = 1; k <= 8; ++k)
+        {
+            routes[i].path.push_back(Position(float(i), float(k), 0));
+        }
+    }
+    // read-only from here on, every worker state views the same routes.
+    SharedView<std::vector<Route>> shared(std::move(routes));
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<double> memory(threads);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([shared, count, &memory, i]() {
+            lua_State * worker = luaL_newstate();
+            luaL_openlibs(worker);
+            LuaStack<SharedView<std::vector<Route>>>::put(worker, shared);
+            lua_setglobal(worker, "routes");
+            if (luaL_dostring(worker, "local s = 0 for i = 1, #routes do local path = routes[i].path s = s + path[#path].y end return s")
+                || lua_tointeger(worker, -1) != lua_Integer(count) * 8)
+            {
+                LOG("worker err: %s\n", lua_tostring(worker, -1));
+            }
+            lua_settop(worker, 0);
+            lua_gc(worker, LUA_GCCOLLECT, 0);
+            memory[i] = lua_gc(worker, LUA_GCCOUNT, 0);
+            lua_close(worker);
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // what every worker would hold with routes converted to tables.
+    lua_State * copy = luaL_newstate();
+    LuaStack<std::vector<Route>>::put(copy, *shared);
+    lua_gc(copy, LUA_GCCOLLECT, 0);
+    const double copyKB = lua_gc(copy, LUA_GCCOUNT, 0);
+    lua_close(copy);
+
+    lua_pushnumber(L, ms);
+    lua_pushnumber(L, memory[0]);
+    lua_pushnumber(L, copyKB);
+    LuaStack<SharedView<std::vector<Route>>>::put(L, shared);
+    return 4;
+}
+
+
+// C++ code driving behaviors, calls go to lua overrides.
+int runBehavior(LuaBehavior& b, int dt)
+{
+    Behavior& behavior = b;
+    return behavior.tick(dt);
+}
+
+std::string behaviorName(const LuaBehavior& b)
+{
+    return static_cast<const Behavior&>(b).name();
+}
+
+// overrides called by C++ while no lua code runs, lua errors arrive as LuaOverrideError.
+int testOverride(lua_State * L)
+{
+    lua_State * s = luaL_newstate();
+    luaL_openlibs(s);
+    LuaClass<LuaBehavior>(s, "Behavior").ctor().fun("tick", &LuaBehavior::tick);
+    luaL_dostring(s,
+        "Orc = Behavior.extend()\n"
+        "function Orc:tick(dt) return 100 + Orc.super.tick(self, dt) end\n"
+        "function Orc:name() return 'orc' end\n"
+        "Broken = Behavior.extend()\n"
+        "function Broken:tick(dt) error('broken tick') end\n"
+        "function Broken:name() return {} end\n"
+        "orc, broken = Orc.new(), Broken.new()\n");
+    lua_getglobal(s, "orc");
+    lua_getglobal(s, "broken");
+    Behavior& orc = LuaStack<LuaBehavior&>::get(s, -2);
+    Behavior& broken = LuaStack<LuaBehavior&>::get(s, -1);
+    lua_pop(s, 2);
+
+    const int ticked = orc.tick(3);
+    const std::string name = orc.name();
+    std::string error;
+    try
+    {
+        broken.tick(1);
+    }
+    catch (const LuaOverrideError& e)
+    {
+        error = e.what();
+    }
+    // return value of wrong type is reported the same way.
+    std::string typeError;
+    try
+    {
+        broken.name();
+    }
+    catch (const LuaOverrideError& e)
+    {
+        typeError = e.what();
+    }
+    lua_close(s);
+
+    lua_pushinteger(L, ticked);
+    lua_pushstring(L, name.c_str());
+    lua_pushstring(L, error.c_str());
+    lua_pushstring(L, typeError.c_str());
+    return 4;
+}
+
+// lua function kept by C++ between calls, it may come from a coroutine which is gone when it is called.
+static LuaFunctionRef rememberedFn;
+
+int rememberFunction(lua_State * L)
+{
+    rememberedFn = LuaFunctionRef(L, 1);
+    return 0;
+}
+
+int recallFunction(lua_State * L)
+{
+    const std::vector<int> values { (int)luaL_checkinteger(L, 1) };
+    const int status = for_each(L, values, rememberedFn);
+    rememberedFn.reset();
+    return status == 0 ? 0 : lua_error(L);
+}
+
+
+int module__index(lua_State* state) {
+    LOG("~~~~~~~~~~~~~~~~~~module__index:~~~~~~~~~~~~~~~~~~~");
+    lua_pushinteger(state, 999);
+    return 1;
+}
+
+int module__newindex(lua_State* state) {
+    LOG("~~~~~~~~~~~~~~~~~~module__newindex:~~~~~~~~~~~~~~~~~~~");
+    lua_rawset(state, -3);
+    return 0;
+}
+
+void moduleSetProp1(const std::string& val) {
+    LOG("moduleSetProp1:%s", val.c_str());
+    return;
+}
+
+
+const char* moduleGetProp1() {
+    LOG("moduleGetProp1");
+    return "string as prop1 value";
+}
+
+int moduleSetProp2(int val) {
+    LOG("moduleSetProp2:%d", val);
+    return val;
+}
+
+const char* moduleGetProp2() {
+    LOG("moduleGetProp2");
+    return "string as prop2 value";
+}
+
+
+
+void bindToLUA(lua_State * L)
+{
+    // bind class to lua
+    LuaClass<Cat> luaCat(L, "AwesomeCat");
+    luaCat.ctor<std::string>();
+    luaCat.fun("setName", &Cat::setName);
+    luaCat.fun("getName", &Cat::getName);
+    luaCat.fun("setAge", &Cat::setAge);
+    luaCat.fun("getAge", &Cat::getAge);
+    luaCat.fun("eat", &Cat::eat);
+    luaCat.fun("speak", &Cat::speak);
+    luaCat.fun("test", &Cat::test);
+    luaCat.fun("testfunctor", &Cat::testfunctor);
+    luaCat.fun(std::string("testFunctor1"), [](int n1, int n2) -> int {
+        LOG("testFunctor1:%d, %d\n", n1, n2);
+        return n1 * n2;
+    });
+    luaCat.fun("testFunctor2", std::function<void(int, int)>([](int n1, int n2) {
+        LOG("testFunctor2:%d, %d\n", n1, n2);
+    }));
+    luaCat.fun("__tostring", &Cat::toString);
+    // overloads share one name, target is selected by lua arg types.
+    luaCat.fun("update", &Cat::setAge, &Cat::setName);
+    luaCat.def("tag", "Animal");
+    // cats can be copied into other states by luaaa::transfer.
+    luaCat.clone();
+
+    luaCat.set("say", &Cat::speak);
+    luaCat.set("name", &Cat::setName);
+    luaCat.get("name", &Cat::getName);
+    luaCat.set("age", &Cat::setAge);
+    luaCat.get("age", &Cat::getAge);
+
+    luaCat.set("prop1", setProp1);
+    luaCat.get("prop1", getProp1);
+    luaCat.set("prop2", [](const Cat& cat, float val) -> void { printf("set prop2=%f\n", val); /*cat.setWeight(val)*/; });
+    luaCat.get("prop2", [](Cat& cat) -> float { printf("get prop2\n");  return cat.getWeight(); });
+    luaCat.set(std::string("prop3"), [](Cat& cat, const std::set<std::string>& val) { printf("set prop3\n");  cat.prop3 = val; });
+    luaCat.get(std::string("prop3"), [](const Cat& cat) -> std::set<std::string> { printf("get prop3\n");  return cat.prop3; });
+    luaCat.set(std::string("prop4"), [](float val) { printf("set prop4=%f\n", val); });
+    luaCat.get(std::string("prop4"), []() -> float { printf("get prop4\n");  return 0.123f; });
+
+    // rise compile error
+    //luaCat.set(std::string("prop5"), [](float val, int v2) { printf("set prop5=%f\n", val); });
+    //luaCat.get(std::string("prop5"), [](int) -> float { printf("get prop5\n");  return 0.123f; });
+
+
+    // bind singleton class to lua
+    LuaClass<SingletonWorld> luaWorld(L, "SingletonWorld");
+    /// use class default constructor as instance spawner, default destructor will be called from gc.
+    luaWorld.ctor();
+    /// use class constructor as instance spawner, default destructor will be called from gc.
+    luaWorld.ctor<const std::string&>("createWithName");
+    /// use static function as instance spawner, default destructor will be called from gc.
+    luaWorld.ctor("newInstance", &SingletonWorld::newInstance);
+    /// use static function as instance spawner and static function as delete function which be called from gc.
+    luaWorld.ctor("managedInstance", &SingletonWorld::newInstance , &SingletonWorld::delInstance);
+    /// for singleton pattern, set deleter(gc) to nullptr to avoid singleton instance be destroyed.
+    luaWorld.ctor("getInstance", &SingletonWorld::getInstance, nullptr);
+    luaWorld.fun("getTag", &SingletonWorld::getTag);
+
+
+    // bind class hierarchy, base classes first. Unit objects are accepted where Named or Entity is expected,
+    // unchecked methods of Entity find the Entity part of Unit too.
+    LuaClass<Named>(L, "Named").fun("getName", &Named::getName).fun("setName", &Named::setName);
+    LuaClass<Entity>(L, "Entity").ctor().fun<unchecked>("getHp", &Entity::getHp).fun<unchecked>("damage", &Entity::damage);
+    LuaClass<Unit>(L, "Unit").ctor().base<Named>().base<Entity>().fun("getSpeed", &Unit::getSpeed);
+
+    // operator tags live in luaaa::ops, so ::div from <cstdlib> stays usable under `using namespace luaaa`.
+    LuaClass<Money>(L, "Money").ctor<int>().fun("cents", &Money::cents)
+        .op<ops::add>().op<ops::sub>().op<ops::mul, Money, int>().op<ops::unm>().op<ops::eq>().op<ops::lt>();
+
+    // lua subclasses of Behavior override its virtuals.
+    LuaClass<LuaBehavior>(L, "Behavior").ctor().fun("tick", &LuaBehavior::tick);
+
+    // define a module with name "AwesomeMod"
+    LuaModule awesomeMod(L, "AwesomeMod");
+    awesomeMod.def("cint", 20190101);
+    awesomeMod.def("cstr", "this is c string");
+    awesomeMod.def("acat", luaCat);
+
+    std::list<std::string> dict {
+        "AMICUS", "AMOS", "AMTRAK", "ANGELICA", "ANNIE OAKLEY", 
+        "BEETHOVEN", "BERTHA", "BESSEYA", "BILLIE JEAN", "BIMBO", 
+        "BISS", "DECATHLON", "DELIRIUM", "DELIUS", "DEMPSEY" 
+    };
+
+    awesomeMod.def("dict", dict);
+
+    // c++11 standard conatiners(array, vector, deque, list, forward_list, set/multiset, map/multimap, unordered_set/unordered_multiset, unordered_map/unordered_multimap)
+    awesomeMod.fun("testSet", testSet);
+    awesomeMod.fun("testSetSet", testSetSet);
+    awesomeMod.fun("testMapMap", testMapMap);
+    awesomeMod.fun("testMultipleParams", testMultipleParams);
+    awesomeMod.fun("testTuple", testTuple);
+    awesomeMod.fun("testTuple2", testTuple2);
+    awesomeMod.fun("testCallback", testCallback);
+    awesomeMod.fun("testCallbackFunctor", testCallbackFunctor);
+    awesomeMod.fun("testPosition", testPosition);
+    awesomeMod.fun("testRoute", testRoute);
+    awesomeMod.fun("testTelemetry", testTelemetry);
+    awesomeMod.fun("testTransfer", testTransfer);
+    awesomeMod.fun("testChannel", testChannel);
+    awesomeMod.fun("testStateHandle", testStateHandle);
+    awesomeMod.fun("testSharedView", testSharedView);
+    awesomeMod.fun("runBehavior", runBehavior);
+    awesomeMod.fun("behaviorName", behaviorName);
+    awesomeMod.fun("testOverride", testOverride);
+    awesomeMod.fun("rememberFunction", rememberFunction);
+    awesomeMod.fun("recallFunction", recallFunction);
+    awesomeMod.fun("entityHp", [](const Entity& e) { return e.getHp(); });
+    // raw pointer goes to lua as light userdata, it is not taken as bound object.
+    awesomeMod.fun("entityPtr", [](Entity& e) { return &e; });
+    // polyline length, points are decoded into a per thread scratch vector which keeps its capacity between calls.
+    // `done` is called before the points are measured, it may call pathLength again, nested calls get their own scratch vector.
+    awesomeMod.fun("pathLength", [](reuse<std::vector<float>>& points, std::function<void()> done) -> float {
+        if (done)
+        {
+            done();
+        }
+        float length = 0;
+        for (size_t i = 2; i + 1 < points->size(); i += 2)
+        {
+            const float dx = (*points)[i] - (*points)[i - 2], dy = (*points)[i + 1] - (*points)[i - 1];
+            length += std::sqrt(dx * dx + dy * dy);
+        }
+        return length;
+    });
+    awesomeMod.fun("callDepth", []() { return LuaCallDepth(); });
+    // allocations(f) returns number of operator new while f runs.
+    awesomeMod.fun("allocations", +[](lua_State * L) -> int {
+        luaL_checktype(L, 1, LUA_TFUNCTION);
+        const long before = allocations;
+        lua_pushvalue(L, 1);
+        lua_call(L, 0, 0);
+        lua_pushinteger(L, allocations - before);
+        return 1;
+    });
+    awesomeMod.fun("tagLines", [](const std::string& tag, const std::vector<std::string>& lines) { return int(tag.size() + lines.size()); });
+#if __cplusplus >= 201703 || _MSVC_LANG >= 201703
+    // same as tagLines, args are allocated from the per thread scratch arena.
+    awesomeMod.fun("tagLinesPmr", [](const std::pmr::string& tag, const std::pmr::vector<std::pmr::string>& lines) { return int(tag.size() + lines.size()); });
+#endif
+    // numbers(n, chunk) hands 1..n to lua as a job converting chunk numbers per step.
+    awesomeMod.fun("numbers", [](int n, int chunk) {
+        std::vector<int> v;
+        for (int i = 1; i <= n; ++i)
+        {
+            v.push_back(i);
+        }
+        return streamed<std::vector<int>>(std::move(v), size_t(chunk));
+    });
+    // sumSteps(t, chunk) decodes t chunk numbers per step, returns sum and steps taken.
+    awesomeMod.fun("sumSteps", +[](lua_State * L) -> int {
+        const size_t chunk = size_t(luaL_checkinteger(L, 2));
+        LuaTableReader<std::vector<int>> reader(L, 1);
+        int steps = 1;
+        while (!reader.step(chunk))
+        {
+            ++steps;
+        }
+        int sum = 0;
+        for (int v : reader.container())
+        {
+            sum += v;
+        }
+        lua_pushinteger(L, sum);
+        lua_pushinteger(L, steps);
+        return 2;
+    });
+    // writeSquares(n, chunk) writes 1, 4, .. n*n into a table chunk numbers per step, returns table and steps taken.
+    awesomeMod.fun("writeSquares", +[](lua_State * L) -> int {
+        std::vector<int> v;
+        for (lua_Integer i = 1, n = luaL_checkinteger(L, 1); i <= n; ++i)
+        {
+            v.push_back(int(i * i));
+        }
+        const size_t chunk = size_t(luaL_checkinteger(L, 2));
+        LuaTableWriter<std::vector<int>> writer(L, v);
+        int steps = 1;
+        while (!writer.step(chunk))
+        {
+            ++steps;
+        }
+        writer.push(L);
+        lua_pushinteger(L, steps);
+        return 2;
+    });
+    awesomeMod.fun("split", [](int cents, int parts) { return div(cents, parts).quot; });
+    awesomeMod.fun("paint", [](const std::string& what, Color c) -> Color {
+        LOG("paint %s with %06x\n", what.c_str(), c.rgb);
+        return c;
+    });
+    awesomeMod.fun("testFunctor1", [](int a, float b) {
+        LOG("awesomeMod call testFunctor1: %d, %f", a, b);
+    });
+    awesomeMod.fun("testFunctor2", [](int a, float b) -> float {
+        LOG("awesomeMod call testFunctor2(%d * %f = %f):", a, b, a*b);
+        return a * b;
+    });
+
+    awesomeMod.fun("testOverload",
+        [](int a) { LOG("awesomeMod call testOverload(int): %d\n", a); },
+        [](const std::string& s) { LOG("awesomeMod call testOverload(string): %s\n", s.c_str()); },
+        [](int a, int b) -> int { LOG("awesomeMod call testOverload(int, int): %d, %d\n", a, b); return a + b; });
+
+    awesomeMod.set("prop1", moduleSetProp1);
+    awesomeMod.get("prop1", moduleGetProp1);
+    awesomeMod.set("prop2", moduleSetProp2);
+    awesomeMod.get("prop2", moduleGetProp2);
+    awesomeMod.set(std::string("prop3"), [](const std::string& val) { printf("set prop3=%s\n", val.c_str()); });
+    awesomeMod.get(std::string("prop3"), []() -> std::string { printf("get prop3\n");  return "string as prop3"; });
+    awesomeMod.set(std::string("prop4"), [](float val) { printf("set prop4=%f\n", val); });
+    awesomeMod.get(std::string("prop4"), [](){ printf("get prop4\n"); return 0.123f; });
+
+    // batched variant walks a whole lua array or array view per call.
+    awesomeMod.batch("squares", [](int v) { return v * v; });
+
+    awesomeMod.fun("__index", module__index);
+    awesomeMod.fun("__newindex", module__newindex);
+
+    // put something to global, just emit the module name
+    LuaModule(L).def("pi", 3.1415926535897932);
+
+    LuaModule(L).def("WITHOUT_CPP_STDLIB", !!LUAAA_WITHOUT_CPP_STDLIB);
+#if __cplusplus >= 201703 || _MSVC_LANG >= 201703
+    LuaModule(L).def("WITH_PMR", true);
+#else
+    LuaModule(L).def("WITH_PMR", false);
+#endif
+
+    // read-only view of C++ array, no copy, any numeric view is a source of batched functions.
+    static const long ticks[] = { 3, 5, 8, 13 };
+    LuaStack<LuaArrayView<const long>>::put(L, LuaArrayView<const long>(ticks, 4));
+    lua_setglobal(L, "ticks");
+
+    // squad of units lent to lua as lazy view, `releaseSquad` invalidates the view and every unit taken out of it.
+    static std::vector<Unit> squad(3);
+    static LuaBorrow squadBorrow;
+    awesomeMod.fun("lendSquad", []() { return LuaRangeView<std::vector<Unit>>(squad, &squadBorrow, true); });
+    awesomeMod.fun("releaseSquad", []() { squadBorrow.invalidate(); });
+
+    // track points lent as columns, `releaseTrack` invalidates the columns and every column taken out of them.
+    static std::vector<Position> track(3);
+    static LuaBorrow trackBorrow;
+    awesomeMod.fun("lendTrack", []() { return LuaColumns<Position>(track, &trackBorrow); });
+    awesomeMod.fun("releaseTrack", []() { trackBorrow.invalidate(); });
+
+    // scores by player id lent as map view, lua reads, writes and erases entries of the C++ map.
+    static std::map<int, int> scores = { { 1, 90 }, { 2, 75 }, { 7, 60 } };
+    LuaStack<LuaMapView<std::map<int, int>>>::put(L, LuaMapView<std::map<int, int>>(scores));
+    lua_setglobal(L, "scores");
+
+    // vector math classes Vec3/Vec4/Quat/Mat4, factories in module `vmath`.
+    // `points` are two packed xyz points, transformed in place from lua.
+    math::bind(L);
+    static float points[] = { 1, 0, 0, 0, 1, 0 };
+    LuaStack<LuaArrayView<float>>::put(L, LuaArrayView<float>(points, 6));
+    lua_setglobal(L, "points");
+
+    // native json codec as module `json`.
+    json::bind(L);
+
+    // MessagePack codec as module `msgpack`.
+    msgpack::bind(L);
+
+    // lock-free channel between states of different threads as class `Channel`.
+    Channel::bind(L);
+
+    // operations can be chained.
+    LuaClass<int*>(L, "int")
+    .ctor<int*>("new")
+    .def("type", std::string("[c int *]"))
+    .def("max", INT_MAX)
+    .def("min", INT_MIN);
+
+}
+
@@ -1,289 +1,930 @@
-
-
-luaaa = {}
-function luaaa:extend(base, obj)
-	derived = obj or {}
-	derived.new = function(self, ...)
-		o = base.new(...)
-		setmetatable(self, getmetatable(o))
-		self["@"] = o
-		return self
-	end
-	return derived
-end
-
-function luaaa:base(obj)
-	if (type(obj) == "table") then
-		return obj["@"]
-	end
-	return nil
-end
-
-
-function serialize(obj)
-	local str = ""
-	local t = type(obj)
-	if t == "number" then
-		str = str .. obj
-	elseif t == "boolean" then
-		str = str .. tostring(obj)
-	elseif t == "string" then
-		str = str ..  obj
-	elseif t == "table" then
-		str = str .. "{"
-		for k, v in pairs(obj) do
-			str = str .. "[" .. serialize(k) .. "]=" .. serialize(v) .. ","
-		end
-		local metatable = getmetatable(obj)
-		if metatable ~= nil and type(metatable.__index) == "table" then
-			for k, v in pairs(metatable.__index) do  
-				str = str .. "[" .. serialize(k) .. "]=" .. serialize(v) .. ","
-			end
-		end
-		str = str .. "}"
-	elseif t == "nil" then
-		str = "nil"
-	else  
-		error("can not serialize a " .. t .. " type.")
-	end  
-	return str  
-end
-
-function luaCallback(param)
-	return param + 1
-end
-
-function testAwesomeCat()
-	local a = AwesomeCat.new ("BINGO")
-	for key,value in pairs(getmetatable(a)) do
-		print(key, value)
-	end
-
-	a:setAge(2);
-	print(a)
-	a:eat({"fish", "milk", "cookie", "rice"});
-	print(a)
-	print("cat test: send params to c++: (0:0, 1:1, 2:2, 3:3, 4:4)");
-	a:test(0, 1, 2, 3, 4)
-	a:speak("Thanks!")
-	if not WITHOUT_CPP_STDLIB then
-		print(a:testFunctor1(99999, 88888))
-		print(a:testFunctor2(77777, 66666))
-		a:testfunctor(luaCallback)
-	end
-
-	a.say = "I am a cat!";
-	a.age = 12
-	print("=================== a.age:",  a.age)
-	a.name  = "HeroCat";
-	print("=================== a.name:", a.name)
-	a.prop1 = "white";
-	print("=================== a.prop1:", a.prop1)
-	if not WITHOUT_CPP_STDLIB then
-		a.prop2 = 9999123;
-		print("=================== a.prop2:", a.prop2)
-		a.prop3 = { 'aaa', 'bbb', 'ccc', 'ddd' };
-		print("=================== a.prop3:", serialize(a.prop3))
-		a.prop4 = 1.234;
-		print("=================== a.prop3:", a.prop4)
-	end
-	
-end
-
-function testAwesomeMod()
-	print("===================before assign AwesomeMod.notexists:", AwesomeMod.notexists2)
-	AwesomeMod.notexists2 = "asdadsasda";
-	print("=================== after assign AwesomeMod.notexists:", AwesomeMod.notexists2)
-	
-	AwesomeMod.prop1 = "white";
-	print("=================== AwesomeMod.prop1:", AwesomeMod.prop1)
-	if not WITHOUT_CPP_STDLIB then
-		AwesomeMod.prop2 = 9999123;
-		print("=================== AwesomeMod.prop2:", AwesomeMod.prop2)
-		AwesomeMod.prop3 = "abcdefg";
-		print("=================== AwesomeMod.prop3:", serialize(AwesomeMod.prop3))
-		AwesomeMod.prop4 = 1.234;
-		print("=================== AwesomeMod.prop4:", AwesomeMod.prop4)
-	end
-
-	print ("AwesomeMod.cint:" .. AwesomeMod.cint)
-	print ("AwesomeMod.cstr:" .. AwesomeMod.cstr)
-	print ("AwesomeMod.dict:")
-	for k,v in pairs(AwesomeMod.dict) do
-		print(tostring(k) .. "=" .. tostring(v))
-	end
-
-	print ("-------- AwesomeMod.testSet() --------")
-	AwesomeMod.testSet({11, 12, "13", 14, "15", 16, 17, 18, "2019", "2020"}, {5, 4, 3, 2, 1});
-
-
-	print ("-------- AwesomeMod.testSetSet() --------")
-	AwesomeMod.testSetSet({
-		{}, 
-		{"what", "who", "where"}, 
-		{797, 454, 828, "something"}, 
-		{"alpha, beta", "gamma"}
-	});
-
-	print ("-------- AwesomeMod.testMapMap() --------")
-	AwesomeMod.testMapMap({
-		animal = {
-			dog = "woof",
-			cat = "meow",
-			cow = "moo"
-		},
-		rank = {
-			first = "Tom",
-			second = "Lee",
-			third = "Mike"
-		}
-	});
-
-	if not WITHOUT_CPP_STDLIB then
-		print("-------- AwesomeMod.testTuple() --------")
-		local values = AwesomeMod.testTuple({"a duck", 999, 1.234})
-		print("Lua got multiple values from c++:")
-		for i = 1, #values do 
-			print("[" .. i .. "]" .. values[i]) 
-		end 
-
-		-- AwesomeMod.testTuple2() accept only empty tuple
-		local values2 = AwesomeMod.testTuple2({"a duck", 999, 1.234})
-		print("Lua got empty tuple from c++.")
-		for k,v in pairs(values2) do
-			print("[" .. tostring(k) .. "]" .. tostring(v))
-		end
-	end
-
-	print("-------- AwesomeMod.testMultipleParams() --------")
-	AwesomeMod.testMultipleParams(0,1,"two",3.3,44.44)
-
-	print("-------- AwesomeMod.testPosition() --------")
-	local positionA = { x = 100, y = 200, z = 300 }
-	local positionB = { x = 11, y = 22, z = 33 }
-	local result = AwesomeMod.testPosition(positionA, positionB)
-	print("positionA["..serialize(positionA).."] + positionB["..serialize(positionB).."] = "..serialize(result))
-
-	if not WITHOUT_CPP_STDLIB then
-		print("-------- AwesomeMod.testFunctor --------")
-		print(AwesomeMod.testFunctor1(123, 456.78))
-		print(AwesomeMod.testFunctor2(789, 111.11))
-	end
-
-end
-
-
-function testCallback ()
-	local f = function(a, b, c)
-		print ("lua testCallback:")
-		print ("    param a:" .. tostring (a))
-		print ("    param b:" .. tostring (b))
-		print ("    param c:" .. tostring (c))
-		print ("    return b * b(" .. tostring(b * b) ..") as result to c++.\n")
-		return b * b;
-	end
-
-	AwesomeMod.testCallback(f, 5555, "lua text")
-end
-
-function testCallbackFunctor ()
-	if not WITHOUT_CPP_STDLIB then
-		local f = function(a, b, c)
-			print ("lua testCallbackFunctor:")
-			print ("    param a:" .. tostring (a))
-			print ("    param b:" .. tostring (b))
-			print ("    param c:" .. tostring (c))
-			print ("    return b * b(" .. tostring(b * b) ..") as result to c++.\n")
-			return b * b;
-		end
-		AwesomeMod.testCallbackFunctor(f, 8888, "lua text from testCallbackFunctor")
-	end
-
-end
-
-function testAutoGC ()
-	local cat = AwesomeCat.new("IWILLLEAVE");
-	cat:speak("I will leave ...")
-	cat = nil;
-	collectgarbage ()
-end
-
-
-function testSingletonAndGC()
-	local world = SingletonWorld.new("chaos");
-	print("new world tag:"..world:getTag())
-	world = nil
-	collectgarbage()
-
-	local world = SingletonWorld.getInstance();
-	print("singleton world tag:"..world:getTag())
-	world = nil
-	collectgarbage()
-
-
-	local world = SingletonWorld.newInstance("new instance");
-	print("new world instance tag:"..world:getTag())
-	world = nil
-	collectgarbage()
-
-	local world=SingletonWorld.managedInstance("managed instance");
-	print("managed world instance tag:"..world:getTag())
-	world = nil
-	collectgarbage()
-end
-
-
-function testClassInheritance()
-	SpecialCat = luaaa:extend(AwesomeCat, {value = 1})
-
-	function SpecialCat:onlyInSpecial()
-		print(self:getName() .. " has a special cat function")
-		print(self:getName() .. " has value:" .. self.value)
-	end
-
-	function SpecialCat:speak(text)
-		print("Special cat[" .. self:getName() .. "] says: " .. text)
-	end
-
-	sss = SpecialCat:new("sss")
-	sss:onlyInSpecial()
-	sss:speak("I am Special Cat!")
-	print("call base class's method speak():")
-	luaaa:base(sss):speak("I am Special and Awesome Cat!")
-
-end
-
-print ("\nLUAAA_WITHOUT_CPP_STDLIB:", WITHOUT_CPP_STDLIB);
-
-print ("\n\n-- 1 --. Test auto GC\n")
-testAutoGC();
-
-print ("\n\n-- 2 --. Test AwesomeCat class\n")
-testAwesomeCat();
-
-print ("\n\n-- 3 --. Test AwesomeMod module\n")
-testAwesomeMod ();
-
-print ("\n\n-- 4 --. Test others\n")
-print ("pi = " .. pi .. "\n")
-
-print ("\n\n-- 5 --. Test Callback\n")
-testCallback();
-
-print ("\n\n-- 6 --. Test CallbackFunctor\n")
-testCallbackFunctor();
-
-print ("\n\n-- 7 --. Test Class Inheritance\n")
-testClassInheritance();
-
-print ("\n>>>>" .. collectgarbage ("count"))
-collectgarbage ()
-print ("\n<<<<" .. collectgarbage ("count"))
-
-print("\n\n-- 8 --. Test Singleton and GC\n")
-testSingletonAndGC()
-
-print("\n>>>>"..collectgarbage("count"))
-collectgarbage()
-print("\n<<<<"..collectgarbage("count"))
-
+
+
+function serialize(obj)
+	local str = ""
+	local t = type(obj)
+	if t == "number" then
+		str = str .. obj
+	elseif t == "boolean" then
+		str = str .. tostring(obj)
+	elseif t == "string" then
+		str = str ..  obj
+	elseif t == "table" then
+		str = str .. "{"
+		for k, v in pairs(obj) do
+			str = str .. "[" .. serialize(k) .. "]=" .. serialize(v) .. ","
+		end
+		local metatable = getmetatable(obj)
+		if metatable ~= nil and type(metatable.__index) == "table" then
+			for k, v in pairs(metatable.__index) do  
+				str = str .. "[" .. serialize(k) .. "]=" .. serialize(v) .. ","
+			end
+		end
+		str = str .. "}"
+	elseif t == "nil" then
+		str = "nil"
+	else  
+		error("can not serialize a " .. t .. " type.")
+	end  
+	return str  
+end
+
+function luaCallback(param)
+	return param + 1
+end
+
+function testAwesomeCat()
+	local a = AwesomeCat.new ("BINGO")
+	for key,value in pairs(getmetatable(a)) do
+		print(key, value)
+	end
+
+	a:setAge(2);
+	print(a)
+	if not WITHOUT_CPP_STDLIB then
+		a:update(3)
+		a:update("BINGO")
+	end
+	print(a)
+	a:eat({"fish", "milk", "cookie", "rice"});
+	print(a)
+	print("cat test: send params to c++: (0:0, 1:1, 2:2, 3:3, 4:4)");
+	a:test(0, 1, 2, 3, 4)
+	a:speak("Thanks!")
+	if not WITHOUT_CPP_STDLIB then
+		print(a:testFunctor1(99999, 88888))
+		print(a:testFunctor2(77777, 66666))
+		a:testfunctor(luaCallback)
+	end
+
+	a.say = "I am a cat!";
+	a.age = 12
+	print("=================== a.age:",  a.age)
+	a.name  = "HeroCat";
+	print("=================== a.name:", a.name)
+	a.prop1 = "white";
+	print("=================== a.prop1:", a.prop1)
+	if not WITHOUT_CPP_STDLIB then
+		a.prop2 = 9999123;
+		print("=================== a.prop2:", a.prop2)
+		a.prop3 = { 'aaa', 'bbb', 'ccc', 'ddd' };
+		print("=================== a.prop3:", serialize(a.prop3))
+		a.prop4 = 1.234;
+		print("=================== a.prop3:", a.prop4)
+	end
+	
+end
+
+function testAwesomeMod()
+	print("===================before assign AwesomeMod.notexists:", AwesomeMod.notexists2)
+	AwesomeMod.notexists2 = "asdadsasda";
+	print("=================== after assign AwesomeMod.notexists:", AwesomeMod.notexists2)
+	
+	AwesomeMod.prop1 = "white";
+	print("=================== AwesomeMod.prop1:", AwesomeMod.prop1)
+	if not WITHOUT_CPP_STDLIB then
+		AwesomeMod.prop2 = 9999123;
+		print("=================== AwesomeMod.prop2:", AwesomeMod.prop2)
+		AwesomeMod.prop3 = "abcdefg";
+		print("=================== AwesomeMod.prop3:", serialize(AwesomeMod.prop3))
+		AwesomeMod.prop4 = 1.234;
+		print("=================== AwesomeMod.prop4:", AwesomeMod.prop4)
+	end
+
+	print ("AwesomeMod.cint:" .. AwesomeMod.cint)
+	print ("AwesomeMod.cstr:" .. AwesomeMod.cstr)
+	print ("AwesomeMod.dict:")
+	for k,v in pairs(AwesomeMod.dict) do
+		print(tostring(k) .. "=" .. tostring(v))
+	end
+
+	print ("-------- AwesomeMod.testSet() --------")
+	AwesomeMod.testSet({11, 12, "13", 14, "15", 16, 17, 18, "2019", "2020"}, {5, 4, 3, 2, 1});
+
+
+	print ("-------- AwesomeMod.testSetSet() --------")
+	AwesomeMod.testSetSet({
+		{}, 
+		{"what", "who", "where"}, 
+		{797, 454, 828, "something"}, 
+		{"alpha, beta", "gamma"}
+	});
+
+	print ("-------- AwesomeMod.testMapMap() --------")
+	AwesomeMod.testMapMap({
+		animal = {
+			dog = "woof",
+			cat = "meow",
+			cow = "moo"
+		},
+		rank = {
+			first = "Tom",
+			second = "Lee",
+			third = "Mike"
+		}
+	});
+
+	if not WITHOUT_CPP_STDLIB then
+		print("-------- AwesomeMod.testTuple() --------")
+		local values = AwesomeMod.testTuple({"a duck", 999, 1.234})
+		print("Lua got multiple values from c++:")
+		for i = 1, #values do 
+			print("[" .. i .. "]" .. values[i]) 
+		end 
+
+		-- AwesomeMod.testTuple2() accept only empty tuple
+		local values2 = AwesomeMod.testTuple2({"a duck", 999, 1.234})
+		print("Lua got empty tuple from c++.")
+		for k,v in pairs(values2) do
+			print("[" .. tostring(k) .. "]" .. tostring(v))
+		end
+	end
+
+	print("-------- AwesomeMod.testMultipleParams() --------")
+	AwesomeMod.testMultipleParams(0,1,"two",3.3,44.44)
+
+	print("-------- AwesomeMod.testPosition() --------")
+	local positionA = { x = 100, y = 200, z = 300 }
+	local positionB = { x = 11, y = 22, z = 33 }
+	local result = AwesomeMod.testPosition(positionA, positionB)
+	print("positionA["..serialize(positionA).."] + positionB["..serialize(positionB).."] = "..serialize(result))
+
+	if not WITHOUT_CPP_STDLIB then
+		print("-------- AwesomeMod.testRoute() --------")
+		local route = AwesomeMod.testRoute({ name = "patrol", start = positionA, path = { positionA, positionB, result } })
+		print("testRoute: "..route.name.." from "..serialize(route.start)..", "..#route.path.." waypoints")
+
+		print("-------- AwesomeMod.testFunctor --------")
+		print(AwesomeMod.testFunctor1(123, 456.78))
+		print(AwesomeMod.testFunctor2(789, 111.11))
+
+		print("-------- AwesomeMod.testOverload --------")
+		AwesomeMod.testOverload(123)
+		AwesomeMod.testOverload("abc")
+		print(AwesomeMod.testOverload(123, 456))
+	end
+
+end
+
+
+function testCallback ()
+	local f = function(a, b, c)
+		print ("lua testCallback:")
+		print ("    param a:" .. tostring (a))
+		print ("    param b:" .. tostring (b))
+		print ("    param c:" .. tostring (c))
+		print ("    return b * b(" .. tostring(b * b) ..") as result to c++.\n")
+		return b * b;
+	end
+
+	AwesomeMod.testCallback(f, 5555, "lua text")
+end
+
+function testCallbackFunctor ()
+	if not WITHOUT_CPP_STDLIB then
+		local f = function(a, b, c)
+			print ("lua testCallbackFunctor:")
+			print ("    param a:" .. tostring (a))
+			print ("    param b:" .. tostring (b))
+			print ("    param c:" .. tostring (c))
+			print ("    return b * b(" .. tostring(b * b) ..") as result to c++.\n")
+			return b * b;
+		end
+		AwesomeMod.testCallbackFunctor(f, 8888, "lua text from testCallbackFunctor")
+	end
+
+end
+
+function testAutoGC ()
+	local cat = AwesomeCat.new("IWILLLEAVE");
+	cat:speak("I will leave ...")
+	cat = nil;
+	collectgarbage ()
+end
+
+
+function testSingletonAndGC()
+	local world = SingletonWorld.new("chaos");
+	print("new world tag:"..world:getTag())
+	world = nil
+	collectgarbage()
+
+	local world = SingletonWorld.getInstance();
+	print("singleton world tag:"..world:getTag())
+	world = nil
+	collectgarbage()
+
+
+	local world = SingletonWorld.newInstance("new instance");
+	print("new world instance tag:"..world:getTag())
+	world = nil
+	collectgarbage()
+
+	local world=SingletonWorld.managedInstance("managed instance");
+	print("managed world instance tag:"..world:getTag())
+	world = nil
+	collectgarbage()
+end
+
+
+function testClassInheritance()
+	SpecialCat = AwesomeCat.extend({value = 1})
+
+	function SpecialCat:onlyInSpecial()
+		print(self:getName() .. " has a special cat function")
+		print(self:getName() .. " has value:" .. self.value)
+	end
+
+	function SpecialCat:speak(text)
+		print("Special cat[" .. self:getName() .. "] says: " .. text)
+	end
+
+	sss = SpecialCat.new("sss")
+	sss:onlyInSpecial()
+	sss:speak("I am Special Cat!")
+	print("call base class's method speak():")
+	SpecialCat.super.speak(sss, "I am Special and Awesome Cat!")
+
+	-- fields of subclass object are stored with the userdata
+	sss.value = 2
+	sss:onlyInSpecial()
+
+	-- subclass can be extended again
+	SuperCat = SpecialCat.extend()
+	function SuperCat:speak(text)
+		SuperCat.super.speak(self, text .. "!!")
+	end
+	SuperCat.new("ss2"):speak("I am Super Cat")
+
+	-- the former helper, tables holding the object at "@" are still accepted by bound methods.
+	local luaaa = {}
+	function luaaa:extend(base, obj)
+		local derived = obj or {}
+		derived.new = function(self, ...)
+			local o = base.new(...)
+			setmetatable(self, getmetatable(o))
+			self["@"] = o
+			return self
+		end
+		return derived
+	end
+	local OldCat = luaaa:extend(AwesomeCat, {})
+	local old = OldCat:new("old")
+	assert(old:getName() == "old" and rawget(old, "@") ~= nil)
+
+	-- classes without ctor get no global class table.
+	assert(Named == nil)
+end
+
+
+-- pure lua json in the style of dkjson, used as baseline for the native json module.
+local luajson = {}
+
+local escapes = { ['"'] = '\\"', ['\\'] = '\\\\', ['\b'] = '\\b', ['\f'] = '\\f', ['\n'] = '\\n', ['\r'] = '\\r', ['\t'] = '\\t' }
+
+local function escapeChar(c)
+	return escapes[c] or string.format("\\u%04x", c:byte())
+end
+
+local function encodeValue(v, buffer)
+	local t = type(v)
+	if t == "string" then
+		buffer[#buffer + 1] = '"' .. v:gsub('[%c"\\]', escapeChar) .. '"'
+	elseif t == "number" then
+		buffer[#buffer + 1] = string.format("%.14g", v)
+	elseif t == "boolean" then
+		buffer[#buffer + 1] = tostring(v)
+	elseif t == "table" then
+		local n, count = #v, 0
+		for _ in pairs(v) do count = count + 1 end
+		if n > 0 and n == count then
+			buffer[#buffer + 1] = "["
+			for i = 1, n do
+				if i > 1 then buffer[#buffer + 1] = "," end
+				encodeValue(v[i], buffer)
+			end
+			buffer[#buffer + 1] = "]"
+		else
+			buffer[#buffer + 1] = "{"
+			local first = true
+			for k, e in pairs(v) do
+				if not first then buffer[#buffer + 1] = "," end
+				first = false
+				encodeValue(tostring(k), buffer)
+				buffer[#buffer + 1] = ":"
+				encodeValue(e, buffer)
+			end
+			buffer[#buffer + 1] = "}"
+		end
+	else
+		buffer[#buffer + 1] = "null"
+	end
+end
+
+function luajson.encode(v)
+	local buffer = {}
+	encodeValue(v, buffer)
+	return table.concat(buffer)
+end
+
+local unescapes = { ['"'] = '"', ['\\'] = '\\', ['/'] = '/', b = '\b', f = '\f', n = '\n', r = '\r', t = '\t' }
+
+local decodeValue
+
+local function skip(s, pos)
+	return s:find("[^ \t\r\n]", pos) or #s + 1
+end
+
+local function decodeString(s, pos)
+	local parts, i = {}, pos + 1
+	while true do
+		local a, b = s:find('["\\]', i)
+		parts[#parts + 1] = s:sub(i, a - 1)
+		if s:sub(a, a) == '"' then
+			return table.concat(parts), b + 1
+		end
+		local c = s:sub(a + 1, a + 1)
+		if c == "u" then
+			local code = tonumber(s:sub(a + 2, a + 5), 16)
+			parts[#parts + 1] = code < 128 and string.char(code) or "?"
+			i = a + 6
+		else
+			parts[#parts + 1] = unescapes[c]
+			i = a + 2
+		end
+	end
+end
+
+decodeValue = function(s, pos)
+	pos = skip(s, pos)
+	local c = s:sub(pos, pos)
+	if c == "{" then
+		local t = {}
+		pos = skip(s, pos + 1)
+		if s:sub(pos, pos) == "}" then return t, pos + 1 end
+		while true do
+			local k
+			k, pos = decodeString(s, skip(s, pos))
+			pos = skip(s, pos) + 1
+			t[k], pos = decodeValue(s, pos)
+			pos = skip(s, pos)
+			c = s:sub(pos, pos)
+			if c == "}" then return t, pos + 1 end
+			pos = pos + 1
+		end
+	elseif c == "[" then
+		local t, n = {}, 0
+		pos = skip(s, pos + 1)
+		if s:sub(pos, pos) == "]" then return t, pos + 1 end
+		while true do
+			n = n + 1
+			t[n], pos = decodeValue(s, pos)
+			pos = skip(s, pos)
+			c = s:sub(pos, pos)
+			if c == "]" then return t, pos + 1 end
+			pos = pos + 1
+		end
+	elseif c == '"' then
+		return decodeString(s, pos)
+	elseif s:sub(pos, pos + 3) == "true" then
+		return true, pos + 4
+	elseif s:sub(pos, pos + 4) == "false" then
+		return false, pos + 5
+	elseif s:sub(pos, pos + 3) == "null" then
+		return nil, pos + 4
+	end
+	local a, b = s:find("^-?%d+%.?%d*[eE]?[-+]?%d*", pos)
+	return tonumber(s:sub(a, b)), b + 1
+end
+
+function luajson.decode(s)
+	return (decodeValue(s, 1))
+end
+
+function testJson()
+	if WITHOUT_CPP_STDLIB then
+		print("json needs the C++ std lib")
+		return
+	end
+	local doc = json.decode('{"name": "luaaa", "tags": ["c++", "lua"], "version": 1.4, "nested": {"ok": true, "none": null}}')
+	print("json.decode: " .. doc.name .. ", " .. #doc.tags .. " tags, version " .. doc.version .. ", none is json.null: " .. tostring(doc.nested.none == json.null))
+	print("json.encode: " .. json.encode({ 1, 2.5, "text\n", true, json.null }))
+	print("json.encode empty array: " .. json.encode(setmetatable({}, { __jsontype = "array" })))
+	-- -0.0 keeps its sign, integers out of range are read as floats.
+	assert(json.encode(-0.0):sub(1, 2) == "-0" and 1 / json.decode("-0.0") < 0)
+	if math.type then
+		assert(math.type(json.decode("9223372036854775807")) == "integer" and json.decode("9223372036854775807") == math.maxinteger)
+		assert(json.decode("-9223372036854775808") == math.mininteger)
+		assert(math.type(json.decode("9223372036854775808")) == "float" and math.type(json.decode("-9223372036854775809")) == "float")
+	end
+
+	-- records shaped like a typical api payload.
+	local records = {}
+	for i = 1, 2000 do
+		records[i] = { id = i, name = "item" .. i, price = i * 0.25, tags = { "a", "b", "c" }, active = (i % 2 == 0), note = "line\t" .. i }
+	end
+	local text = json.encode(records)
+	assert(luajson.encode(json.decode(text)) ~= nil and #json.decode(luajson.encode(records)) == #records)
+
+	local rounds = 5
+	local function bench(f)
+		local t = os.clock()
+		for i = 1, rounds do f() end
+		return (os.clock() - t) / rounds * 1000
+	end
+	local luaEncode = bench(function() luajson.encode(records) end)
+	local nativeEncode = bench(function() json.encode(records) end)
+	local luaDecode = bench(function() luajson.decode(text) end)
+	local nativeDecode = bench(function() json.decode(text) end)
+	print(string.format("json %d bytes: encode lua %.2fms / native %.2fms (x%.1f), decode lua %.2fms / native %.2fms (x%.1f)",
+		#text, luaEncode, nativeEncode, luaEncode / nativeEncode, luaDecode, nativeDecode, luaDecode / nativeDecode))
+end
+
+function testMsgpack()
+	if WITHOUT_CPP_STDLIB then
+		print("msgpack needs the C++ std lib")
+		return
+	end
+	-- round trip
+	local values = { 0, -1, 127, -33, 300, -40000, 70000, 2^40, 0.5, 1/3, "text", "", true, false, msgpack.null, { a = 1, b = { 2, 3 } }, {} }
+	local packed = msgpack.encode(values)
+	local plain = msgpack.unpack(packed)
+	local lazy = msgpack.decode(packed)
+	for i = 1, #values do
+		if type(values[i]) ~= "table" then
+			assert(plain[i] == values[i] and lazy[i] == values[i], "msgpack round trip " .. i)
+		end
+	end
+	assert(plain[16].b[2] == 3 and lazy[16].b[2] == 3 and #lazy == #values)
+	assert(msgpack.encode(lazy) == packed and msgpack.encode(plain) == msgpack.encode(msgpack.totable(lazy)))
+	print("msgpack round trip: " .. #values .. " values in " .. #packed .. " bytes, json needs " .. #json.encode(values))
+
+	-- C++ struct packed directly, samples are viewed in place
+	local frame = msgpack.decode(AwesomeMod.testTelemetry(42, 100000))
+	assert(frame.source == "sensor" and frame.frame == 42 and #frame.samples == 100000 and frame.samples[3] == 1.0)
+	print("telemetry frame " .. frame.frame .. ": " .. #frame.samples .. " samples, samples is " .. type(frame.samples))
+
+	-- throughput
+	local records = {}
+	for i = 1, 2000 do
+		records[i] = { id = i, name = "item" .. i, price = i * 0.25, tags = { "a", "b", "c" }, active = (i % 2 == 0) }
+	end
+	local data = msgpack.encode(records)
+	local text = json.encode(records)
+	local telemetry = AwesomeMod.testTelemetry(1, 100000)
+	local rounds = 5
+	local function bench(f)
+		local t = os.clock()
+		for i = 1, rounds do f() end
+		return (os.clock() - t) / rounds * 1000
+	end
+	print(string.format("records msgpack %d bytes / json %d bytes: encode %.2fms / %.2fms, decode %.2fms / %.2fms, lazy decode one record %.2fms",
+		#data, #text,
+		bench(function() msgpack.encode(records) end), bench(function() json.encode(records) end),
+		bench(function() msgpack.unpack(data) end), bench(function() json.decode(text) end),
+		bench(function() local r = msgpack.decode(data)[1000].name end)))
+	print(string.format("telemetry %d bytes: unpack to table %.3fms, lazy view %.3fms",
+		#telemetry,
+		bench(function() local s = msgpack.unpack(telemetry).samples[100000] end),
+		bench(function() local s = msgpack.decode(telemetry).samples[100000] end)))
+end
+
+function testTransfer()
+	if WITHOUT_CPP_STDLIB then
+		print("transfer needs the C++ std lib")
+		return
+	end
+	-- tables are copied to a worker state and back, shared tables and cycles are kept, cats are cloned.
+	local shared = { "shared" }
+	local job = { id = 7, items = { 3, 1, 2 }, a = shared, b = shared, cat = AwesomeCat.new("Tom") }
+	job.self = job
+	local result = AwesomeMod.testTransfer([[
+		local job = ...
+		assert(job.a == job.b and job.self == job and job.cat:getName() == "Tom")
+		table.sort(job.items)
+		job.cat:setAge(5)
+		return { id = job.id, items = job.items, cat = job.cat, again = job.items }
+	]], job)
+	assert(result.id == 7 and result.items[1] == 1 and result.items[3] == 3 and result.again == result.items)
+	assert(result.cat:getAge() == 5 and job.cat:getAge() == 1)
+	assert(not pcall(AwesomeMod.testTransfer, "return ...", { f = print }))
+	print("transfer: job sorted in worker state " .. table.concat(result.items, ","))
+
+	-- throughput
+	local records = {}
+	for i = 1, 10000 do
+		records[i] = { id = i, name = "item" .. i, price = i * 0.25, tags = { "a", "b", "c" } }
+	end
+	local rounds = 5
+	local t = os.clock()
+	for i = 1, rounds do AwesomeMod.testTransfer("return #(...)", records) end
+	local empty = os.clock()
+	for i = 1, rounds do AwesomeMod.testTransfer("return #(...)", {}) end
+	local base = os.clock() - empty
+	print(string.format("transfer %d records to worker state: %.2fms", #records, ((empty - t) - base) / rounds * 1000))
+end
+
+function testChannel()
+	if WITHOUT_CPP_STDLIB then
+		print("Channel needs the C++ std lib")
+		return
+	end
+	local ch = Channel.new(16)
+	local shared = { 1, 2 }
+	assert(ch:try_send({ a = shared, b = shared, name = "msg" }) and ch:try_send(42))
+	local ok, msg = ch:try_recv()
+	assert(ok and msg.a == msg.b and msg.name == "msg" and select(2, ch:try_recv()) == 42 and ch:try_recv() == false)
+
+	-- send/recv yield inside coroutines when channel is full/empty.
+	if coroutine.isyieldable then
+		local received = 0
+		local producer = coroutine.wrap(function() for i = 1, 100 do ch:send(i) end ch:close() return "done" end)
+		local consumer = coroutine.wrap(function()
+			while true do
+				local ok, v = ch:recv()
+				if not ok then return "done" end
+				received = received + v
+			end
+		end)
+		local p, c
+		repeat
+			if p ~= "done" then p = producer() end
+			if c ~= "done" then c = consumer() end
+		until p == "done" and c == "done"
+		assert(received == 5050)
+		print("channel: 100 values passed between coroutines")
+	end
+
+	-- throughput, worker threads send records into this state.
+	local count = 20000
+	for _, producers in ipairs({ 1, 4 }) do
+		local n = math.floor(count / producers)
+		local ms, sum = AwesomeMod.testChannel(producers, n)
+		assert(sum == producers * n * (n + 1) / 2)
+		print(string.format("channel %d:1 %d records: %.2fms, %.0fk records/s", producers, producers * n, ms, producers * n / ms))
+	end
+end
+
+function testStateHandle()
+	if WITHOUT_CPP_STDLIB then
+		print("StateHandle needs the C++ std lib")
+		return
+	end
+	-- worker threads call into this state, calls are run in batches by the owner thread.
+	local count = 20000
+	for _, threads in ipairs({ 1, 4 }) do
+		local n = math.floor(count / threads)
+		local total = 0
+		local ms = AwesomeMod.testStateHandle(threads, n, function(v) total = total + v return total end)
+		assert(total == threads * n * (n + 1) / 2)
+		print(string.format("state handle %d threads %d calls: %.2fms, %.0fk calls/s", threads, threads * n, ms, threads * n / ms))
+	end
+end
+
+function testSharedView()
+	if WITHOUT_CPP_STDLIB then
+		print("SharedView needs the C++ std lib")
+		return
+	end
+	-- worker states read the same C++ routes, parts are looked up on access.
+	local ms, stateKB, copyKB, routes = AwesomeMod.testSharedView(4, 20000)
+	local path = routes[3].path
+	assert(#routes == 20000 and routes[3].name == "route2" and routes[3].start.x == 2 and path[#path].y == 8)
+	assert(routes[1] == routes[1] and routes[1] ~= routes[2] and routes[20001] == nil)
+	assert(not pcall(function() routes[1].name = "changed" end))
+	print(string.format("shared view 4 states x 20000 routes: %.2fms, %.0fKB per state, %.0fKB per state as tables", ms, stateKB, copyKB))
+end
+
+function testClassHierarchy()
+	if WITHOUT_CPP_STDLIB then
+		print("class hierarchy example needs the C++ std lib")
+		return
+	end
+	local u = Unit.new()
+	u:setName("scout")
+	u:damage(30)
+	assert(u:getName() == "scout" and u:getHp() == 70 and AwesomeMod.entityHp(u) == 70)
+	assert(Entity.new():getHp() == 100)
+	-- values other than objects of Entity or its derived classes are rejected.
+	for _, v in ipairs({AwesomeMod.entityPtr(u), json.null, 42, AwesomeCat.new("tom")}) do
+		assert(not pcall(AwesomeMod.entityHp, v))
+	end
+	print(string.format("unit %s: hp %d, speed %.1f", u:getName(), u:getHp(), u:getSpeed()))
+end
+
+function testArity()
+	if WITHOUT_CPP_STDLIB then
+		print("arity needs the C++ std lib")
+		return
+	end
+	-- trailing custom LuaStack arg may be omitted, Color defaults to white.
+	assert(AwesomeMod.paint("wall") == 0xffffff and AwesomeMod.paint("door", 0xff0000) == 0xff0000)
+	-- bound class arg is required.
+	local ok, err = pcall(AwesomeMod.entityHp)
+	assert(not ok)
+	print("missing arg: " .. err)
+end
+
+function testBatch()
+	if WITHOUT_CPP_STDLIB then
+		print("batch needs the C++ std lib")
+		return
+	end
+	local out = AwesomeMod.squares({1, 2, 3})
+	assert(#out == 3 and out[3] == 9)
+	-- reused result table is trimmed to the new batch.
+	AwesomeMod.squares({4}, out)
+	assert(#out == 1 and out[1] == 16 and out[2] == nil)
+	local sq = AwesomeMod.squares(ticks)
+	assert(#sq == #ticks and sq[4] == 169)
+	print("squares of ticks: " .. table.concat(sq, ", "))
+end
+
+function testOperators()
+	if WITHOUT_CPP_STDLIB then
+		print("operator needs the C++ std lib")
+		return
+	end
+	local a, b = Money.new(250), Money.new(75)
+	assert((a + b):cents() == 325 and (a - b):cents() == 175 and (b * 3):cents() == 225)
+	assert((-a):cents() == -250 and a == Money.new(250) and b < a and not (a < b))
+	assert(AwesomeMod.split(1000, 3) == 333)
+	print(string.format("money: %d + %d = %d", a:cents(), b:cents(), (a + b):cents()))
+end
+
+function testMath()
+	if WITHOUT_CPP_STDLIB then
+		print("math needs the C++ std lib")
+		return
+	end
+	local q = vmath.axisAngle(Vec3.new(0, 0, 1), math.pi / 2)
+	local m = vmath.translation(Vec3.new(1, 2, 3)) * vmath.rotation(q)
+	local p = m * Vec3.new(1, 0, 0)
+	assert(math.abs(p.x - 1) < 1e-5 and math.abs(p.y - 3) < 1e-5 and math.abs(p.z - 3) < 1e-5)
+	-- elements are (row, column), 0 based.
+	m:setAt(0, 3, 10)
+	assert(m:at(0, 3) == 10 and (m * Vec3.new(0, 0, 0)).x == 10)
+	assert(not pcall(m.at, m, 4, 0) and not pcall(m.setAt, m, 0, -1, 1))
+	vmath.translation(Vec3.new(0, 0, 5)):transformPoints(points)
+	assert(points[3] == 5 and points[6] == 5)
+	print(string.format("p = (%.1f, %.1f, %.1f)", p.x, p.y, p.z))
+end
+
+function testRangeView()
+	if WITHOUT_CPP_STDLIB then
+		print("range view needs the C++ std lib")
+		return
+	end
+	local squad = AwesomeMod.lendSquad()
+	local leader = squad[1]
+	leader:damage(40)
+	assert(#squad == 3 and squad[1] == leader and leader:getHp() == 60)
+	AwesomeMod.releaseSquad()
+	-- the view and the units taken out of it are invalid now.
+	assert(not pcall(function() return squad[1] end))
+	local ok, err = pcall(leader.getHp, leader)
+	assert(not ok)
+	print("released unit: " .. err)
+	-- lent again with a new borrow, changes were made to the C++ units.
+	assert(AwesomeMod.lendSquad()[1]:getHp() == 60)
+	-- columns of lent rows are invalidated with them.
+	local track = AwesomeMod.lendTrack()
+	local x = track.x
+	x[2] = 5
+	assert(#track == 3 and x[2] == 5)
+	AwesomeMod.releaseTrack()
+	assert(not pcall(function() return x[2] end))
+	assert(not pcall(function() return track.y end))
+	assert(AwesomeMod.lendTrack().x[2] == 5)
+end
+
+function testMapView()
+	if WITHOUT_CPP_STDLIB then
+		print("map view needs the C++ std lib")
+		return
+	end
+	assert(#scores == 3 and scores[1] == 90 and scores[2.0] == 75)
+	-- keys are not converted: no fractions, no strings for number keys.
+	assert(scores[1.5] == nil and scores["1"] == nil)
+	scores[3] = 80
+	if _VERSION ~= "Lua 5.1" then
+		-- erasing the current key while walking an ordered map is fine.
+		for id, score in pairs(scores) do
+			if score < 80 then scores[id] = nil end
+		end
+	else
+		scores[2], scores[7] = nil, nil
+	end
+	assert(#scores == 2 and scores[2] == nil and scores[3] == 80)
+	print("scores left: " .. #scores)
+end
+
+function testReuse()
+	if WITHOUT_CPP_STDLIB then
+		print("reuse needs the C++ std lib")
+		return
+	end
+	assert(AwesomeMod.pathLength({0, 0, 3, 4, 3, 0}) == 9)
+	-- nested call inside the callback does not touch points of the outer call.
+	local inner = 0
+	assert(AwesomeMod.pathLength({0, 0, 0, 2, 0, 4}, function() inner = AwesomeMod.pathLength({0, 0, 1, 0}) end) == 4)
+	assert(inner == 1)
+	-- bad args raise errors before the call is counted.
+	for i = 1, 10 do
+		assert(not pcall(AwesomeMod.pathLength, {0, {}}))
+	end
+	assert(AwesomeMod.callDepth() == 0)
+	print("path length with nested calls ok")
+end
+
+function testScratch()
+	if not WITH_PMR then
+		print("std::pmr needs C++17")
+		return
+	end
+	local tag, lines = string.rep("t", 100), {}
+	for i = 1, 16 do lines[i] = string.rep("l", 100) .. i end
+	assert(AwesomeMod.tagLinesPmr("a\0b", lines) == 19)
+	-- warm up, then count allocations of 100 calls.
+	AwesomeMod.tagLinesPmr(tag, lines)
+	local pmr = AwesomeMod.allocations(function() for i = 1, 100 do AwesomeMod.tagLinesPmr(tag, lines) end end)
+	local std = AwesomeMod.allocations(function() for i = 1, 100 do AwesomeMod.tagLines(tag, lines) end end)
+	assert(pmr == 0 and std > 0)
+	print(string.format("operator new per call: pmr %d, std %d", pmr / 100, std / 100))
+end
+
+function testStream()
+	if WITHOUT_CPP_STDLIB then
+		print("stream needs the C++ std lib")
+		return
+	end
+	-- job converts 4 numbers per step.
+	local job = AwesomeMod.numbers(10, 4)
+	local done, total = job:progress()
+	assert(done == 0 and total == 10)
+	local finished
+	finished, done, total = job:step()
+	assert(not finished and done == 4 and total == 10)
+	repeat finished, done = job:step() until finished
+	local t = job:result()
+	assert(#t == 10 and t[10] == 10)
+	-- inside a coroutine run() yields progress between steps (lua 5.3+).
+	job = AwesomeMod.numbers(10, 4)
+	local co, progress = coroutine.wrap(function() return job:run() end), {}
+	local r, n = co()
+	while type(r) == "number" do
+		progress[#progress + 1] = r .. "/" .. n
+		r, n = co()
+	end
+	assert(#r == 10 and r[4] == 4)
+	if _VERSION ~= "Lua 5.1" and _VERSION ~= "Lua 5.2" then
+		assert(table.concat(progress, " ") == "4/10 8/10")
+	end
+	-- outside coroutines run() converts at once.
+	assert(#AwesomeMod.numbers(5, 2):run() == 5)
+	-- reader and writer in C++.
+	local sum, steps = AwesomeMod.sumSteps({1, 2, 3, 4, 5, 6, 7}, 3)
+	assert(sum == 28 and steps == 3)
+	t, steps = AwesomeMod.writeSquares(5, 2)
+	assert(#t == 5 and t[5] == 25 and steps == 3)
+	print("streamed job yields: " .. table.concat(progress, " "))
+end
+
+function testFunctionRef()
+	if WITHOUT_CPP_STDLIB then
+		print("function ref needs the C++ std lib")
+		return
+	end
+	local seen
+	-- function is kept by C++ after its coroutine is collected.
+	local co = coroutine.create(function()
+		AwesomeMod.rememberFunction(function(v) seen = v end)
+	end)
+	assert(coroutine.resume(co))
+	co = nil
+	collectgarbage()
+	AwesomeMod.recallFunction(42)
+	assert(seen == 42)
+	print("recalled function got " .. seen)
+end
+
+function testOverride()
+	if WITHOUT_CPP_STDLIB then
+		print("override needs the C++ std lib")
+		return
+	end
+	local Orc = Behavior.extend()
+	function Orc:tick(dt)
+		return 100 + Orc.super.tick(self, dt)
+	end
+	function Orc:name()
+		return "orc"
+	end
+
+	-- lua calls C++, which calls lua override, super runs the C++ implementation once.
+	local orc = Orc.new()
+	assert(orc:tick(3) == 103 and AwesomeMod.runBehavior(orc, 3) == 103)
+	assert(AwesomeMod.behaviorName(orc) == "orc" and AwesomeMod.behaviorName(Behavior.new()) == "")
+
+	-- error of override reaches lua caller of the bound function.
+	local Broken = Behavior.extend()
+	function Broken:tick(dt)
+		error("broken tick")
+	end
+	local ok, err = pcall(AwesomeMod.runBehavior, Broken.new(), 1)
+	assert(not ok and err:find("broken tick"))
+
+	-- C++ calls overrides while no lua code runs.
+	local ticked, name, cppErr, typeErr = AwesomeMod.testOverride()
+	assert(ticked == 103 and name == "orc" and cppErr:find("broken tick") and typeErr:find("name"))
+	print("override called from C++: " .. ticked .. ", " .. name .. ", error: " .. cppErr:match("[^\n]*"))
+	print("override returning wrong type: " .. typeErr:match("[^\n]*"))
+end
+
+print ("\nLUAAA_WITHOUT_CPP_STDLIB:", WITHOUT_CPP_STDLIB);
+
+print ("\n\n-- 1 --. Test auto GC\n")
+testAutoGC();
+
+print ("\n\n-- 2 --. Test AwesomeCat class\n")
+testAwesomeCat();
+
+print ("\n\n-- 3 --. Test AwesomeMod module\n")
+testAwesomeMod ();
+
+print ("\n\n-- 4 --. Test others\n")
+print ("pi = " .. pi .. "\n")
+
+print ("\n\n-- 5 --. Test Callback\n")
+testCallback();
+
+print ("\n\n-- 6 --. Test CallbackFunctor\n")
+testCallbackFunctor();
+
+print ("\n\n-- 7 --. Test Class Inheritance\n")
+testClassInheritance();
+
+print ("\n>>>>" .. collectgarbage ("count"))
+collectgarbage ()
+print ("\n<<<<" .. collectgarbage ("count"))
+
+print("\n\n-- 8 --. Test Singleton and GC\n")
+testSingletonAndGC()
+
+print("\n>>>>"..collectgarbage("count"))
+collectgarbage()
+print("\n<<<<"..collectgarbage("count"))
+
+print("\n\n-- 9 --. Test Json\n")
+testJson()
+
+print("\n\n-- 10 --. Test MessagePack\n")
+testMsgpack()
+
+print("\n\n-- 11 --. Test Transfer\n")
+testTransfer()
+
+print("\n\n-- 12 --. Test Channel\n")
+testChannel()
+
+print("\n\n-- 13 --. Test StateHandle\n")
+testStateHandle()
+
+print("\n\n-- 14 --. Test SharedView\n")
+testSharedView()
+
+print("\n\n-- 15 --. Test Class Hierarchy\n")
+testClassHierarchy()
+
+print("\n\n-- 16 --. Test Arity\n")
+testArity()
+
+print("\n\n-- 17 --. Test Batch\n")
+testBatch()
+
+print("\n\n-- 18 --. Test FunctionRef\n")
+testFunctionRef()
+
+print("\n\n-- 19 --. Test Override\n")
+testOverride()
+
+print("\n\n-- 20 --. Test Operators\n")
+testOperators()
+
+print("\n\n-- 21 --. Test Math\n")
+testMath()
+
+print("\n\n-- 22 --. Test RangeView\n")
+testRangeView()
+
+print("\n\n-- 23 --. Test MapView\n")
+testMapView()
+
+print("\n\n-- 24 --. Test Reuse\n")
+testReuse()
+
+print("\n\n-- 25 --. Test Scratch\n")
+testScratch()
+
+print("\n\n-- 26 --. Test Stream\n")
+testStream()
@@ -1,3362 +1,7890 @@
-
-/*
- Copyright (c) 2019 gengyong
- https://github.com/gengyong/luaaa
- licensed under MIT License.
-*/
-
-#ifndef HEADER_LUAAA_HPP
-#define HEADER_LUAAA_HPP
-
-#define LUAAA_NS luaaa
-#define LUAAA_VER_MAJOR (1)
-#define LUAAA_VER_MINOR (4)
-
-/// if you want to disable C++ std libs, set to 1
-#ifndef LUAAA_WITHOUT_CPP_STDLIB
-#define LUAAA_WITHOUT_CPP_STDLIB 0
-#endif
-
-#ifndef LUAAA_DEBUG
-#define LUAAA_DEBUG 0
-#endif
-
-/// enable to check LuaClass constructor name conflict
-/// exposed constructor should have unique name, otherwise the early one will be overwriten. 
-#ifndef LUAAA_CHECK_CONSTRUCTOR_NAME_CONFLICT
-#define LUAAA_CHECK_CONSTRUCTOR_NAME_CONFLICT 1
-#endif
-
-#ifndef LUAAA_FEATURE_PROPERTY
-#define LUAAA_FEATURE_PROPERTY 1
-#endif
-
-extern "C"
-{
-#include "lua.h"
-#include "lualib.h"
-#include "lauxlib.h"
-}
-
-#if !defined LUA_VERSION_NUM || LUA_VERSION_NUM <= 501
-inline void luaL_setfuncs(lua_State * L, const luaL_Reg * l, int nup) {
-    luaL_checkstack(L, nup + 1, "too many upvalues");
-    for (; l->name != nullptr; l++) {
-        int i;
-        lua_pushstring(L, l->name);
-        for (i = 0; i < nup; i++)
-            lua_pushvalue(L, -(nup + 1));
-        lua_pushcclosure(L, l->func, nup);
-        lua_settable(L, -(nup + 3));
-    }
-    lua_pop(L, nup);
-}
-
-inline void luaL_setmetatable(lua_State * L, const char * tname) {
-    luaL_getmetatable(L, tname);
-    lua_setmetatable(L, -2);
-}
-#endif
-
-#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM > 501 && !defined(LUA_COMPAT_MODULE)
-#	define USE_NEW_MODULE_REGISTRY 1
-#else
-#	define USE_NEW_MODULE_REGISTRY 0
-#endif
-
-#include <cassert>
-#include <typeinfo>
-#include <utility>
-
-#if defined(_MSC_VER)
-#   define RTTI_CLASS_NAME(a) typeid(a).name() //vc always has this operator even if RTTI was disabled.
-#elif __GXX_RTTI
-#   define RTTI_CLASS_NAME(a) typeid(a).name()
-#elif _HAS_STATIC_RTTI
-#   define RTTI_CLASS_NAME(a) typeid(a).name()
-#else
-#   define RTTI_CLASS_NAME(a) "?"
-#endif
-
-#if LUAAA_WITHOUT_CPP_STDLIB
-#   include <type_traits>
-#   include <cstring>
-#else
-#   if defined(__GNUC__)
-#       include <cstring>
-#   endif
-#   include <string>
-#   include <functional>
-#endif
-
-#if LUAAA_DEBUG
-inline size_t LUAAA_DUMP_OBJECT(char* buffer, size_t buflen, lua_State * L, int idx, int indent=0) {
-    char prefix[32] = {0};
-    if (indent > sizeof(prefix) - 1) {
-        indent = sizeof(prefix) - 1;
-    }
-    for (int i = 0; i < indent; i++) {
-        prefix[i] = '\t';
-    }
-    switch (lua_type(L, idx)) {
-    default:
-        return snprintf(buffer, buflen, "<%s>(%p)", luaL_typename(L, idx), lua_topointer(L, idx));
-    case LUA_TNUMBER:
-    case LUA_TSTRING:
-        return snprintf(buffer, buflen, "\"%s\"", lua_tostring(L, idx));
-    case LUA_TBOOLEAN:
-        return snprintf(buffer, buflen, "%s", (lua_toboolean(L, idx) ? "true" : "false"));
-    case LUA_TNIL:
-        return snprintf(buffer, buflen, "%s", "nil");
-    case LUA_TTABLE:
-        int ret = 0;
-        if (luaL_getmetafield(L, idx, "__name")) {
-            ret = snprintf(buffer, buflen, "<%s>(%p):", lua_tostring(L, -1), lua_topointer(L, idx));
-            lua_pop(L, 1);
-        } else {
-            ret = snprintf(buffer, buflen, "<%s>(%p):", luaL_typename(L, idx), lua_topointer(L, idx));
-        }
-        if (ret > 0) {
-            size_t wrote = ret;
-            lua_pushnil(L);
-            while (lua_next(L, idx)) {
-                const int top = lua_gettop(L);
-                if (buflen > wrote) {
-                    ret = snprintf(buffer + wrote, buflen - wrote, "\n%s", prefix);
-                    if (ret > 0) {
-                        wrote += ret;
-                    }
-                }
-
-                if (buflen > wrote) {
-                    lua_pushvalue(L, top - 1);
-                    ret = snprintf(buffer + wrote, buflen - wrote, "\"%s\":", lua_tostring(L, -1));
-                    lua_pop(L, 1);
-                    if (ret > 0) {
-                        wrote += ret;
-                    }
-                }
-
-                if (buflen > wrote) {
-                    if (lua_topointer(L, top) == lua_topointer(L, idx)) {
-                        ret = snprintf(buffer + wrote, buflen - wrote, "<self>(%p)", lua_topointer(L, top));
-                    } else {
-                        if (indent < 3)
-                        {
-                            ret = LUAAA_DUMP_OBJECT(buffer + wrote, buflen - wrote, L, top, indent + 1);
-                        }
-                        else
-                        {
-                            ret = snprintf(buffer + wrote, buflen - wrote, "...");
-                        }
-                    }
-                    if (ret > 0) {
-                        wrote += ret;
-                    }
-                }
-                lua_pop(L, 1);
-            }
-            //lua_pop(L, 0);
-            return wrote;
-        }
-    }
-    return 0;
-}
-
-inline void LUAAA_DUMP(lua_State * L, const char * name = "") {
-    printf(">>>>>>>>>>>>>>>>>>>>>>>>>[%s]\n", name);
-    char buffer[4096] = {0};
-    int top = lua_gettop(L);
-    for (int i = 1; i <= top; i++) {
-        LUAAA_DUMP_OBJECT(buffer, sizeof(buffer) - 1, L, i, 1);
-        printf("%d\t%s\n", i, buffer);
-    }
-    printf("<<<<<<<<<<<<<<<<<<<<<<<<<\n");
-}
-#else
-# define LUAAA_DUMP(L,...)
-#endif
-
-#if LUAAA_CHECK_CONSTRUCTOR_NAME_CONFLICT
-#   define luaaa_check_constructor_name_conflict(ctorName) { \
-        lua_getglobal(m_state, (LuaClass<TCLASS, TAG>::klassName)); \
-        if (!lua_isnil(m_state, -1)) { \
-            lua_pushstring(m_state, ctorName); \
-            lua_gettable(m_state, -2); \
-            if (!lua_isnil(m_state, -1)) { \
-                printf("Error: LuaClass<%s>::ctor has duplicated name:`%s`\n", LuaClass<TCLASS, TAG>::klassName, ctorName);\
-            } \
-            lua_pop(m_state, 1); \
-        } \
-        lua_pop(m_state, 1); \
-    }
-#else
-#   define luaaa_check_constructor_name_conflict(ctorName)
-#endif
-
-namespace LUAAA_NS
-{
-#if !LUAAA_WITHOUT_CPP_STDLIB
-    // to_function
-    template <typename F>
-    struct function_traits : public function_traits<decltype(&F::operator())> {};
-
-    template <typename TRET, typename CLASS, typename... ARGS>
-    struct function_traits<TRET(CLASS::*)(ARGS...) const>
-    {
-        using function_type = std::function<TRET(ARGS...)>;
-    };
-
-    template <typename F>
-    using function_type_t = typename function_traits<F>::function_type;
-
-    template <typename F>
-    function_type_t<F> to_function(F& f)
-    {
-        return static_cast<function_type_t<F>>(f);
-    }
-
-    // to_class_getter_function
-    template <typename TCLASS, typename F>
-    struct class_getter_function_traits : public class_getter_function_traits<TCLASS, decltype(&F::operator())> {};
-
-    template <typename TCLASS, typename TRET, typename CLASS, typename ARG, typename... ARGS>
-    struct class_getter_function_traits<TCLASS, TRET(CLASS::*)(ARG, ARGS...) const>
-    {
-        static_assert((sizeof...(ARGS) == 0) && (std::is_same<typename std::decay<TCLASS>::type, typename std::decay<ARG>::type>::value), "Error: property getter does not accept param except current Class reference.");
-        using function_type = std::function<TRET(ARG, ARGS...)>;
-    };
-
-    template <typename TCLASS, typename TRET, typename CLASS>
-    struct class_getter_function_traits<TCLASS, TRET(CLASS::*)() const>
-    {
-        using function_type = std::function<TRET()>;
-    };
-
-    template <typename TCLASS, typename F>
-    using class_getter_function_type_t = typename class_getter_function_traits<TCLASS, F>::function_type;
-
-    template <typename TCLASS, typename F>
-    class_getter_function_type_t<TCLASS, F> to_class_getter_function(F& f)
-    {
-        return static_cast<class_getter_function_type_t<TCLASS, F>>(f);
-    }
-
-    // to_class_setter_function
-    template <typename TCLASS, typename F>
-    struct class_setter_function_traits : public class_setter_function_traits<TCLASS, decltype(&F::operator())> {};
-
-
-    template <typename TCLASS, typename TRET, typename CLASS, typename ARG1, typename... ARGS>
-    struct class_setter_function_traits<TCLASS, TRET(CLASS::*)(ARG1, ARGS...) const>
-    {
-        static_assert((sizeof...(ARGS) == 0) || ((sizeof...(ARGS) == 1) && std::is_same<typename std::decay<TCLASS>::type, typename std::decay<ARG1>::type>::value), "Error: property setter accepts only [1 value] or [self instance and 1 value].");
-        using function_type = std::function<TRET(ARG1, ARGS...)>;
-    };
-
-    template <typename TCLASS, typename TRET, typename CLASS, typename ARG1>
-    struct class_setter_function_traits<TCLASS, TRET(CLASS::*)(ARG1) const>
-    {
-        using function_type = std::function<TRET(ARG1)>;
-    };
-
-    template <typename TCLASS, typename F>
-    using class_setter_function_type_t = typename class_setter_function_traits<TCLASS, F>::function_type;
-
-    template <typename TCLASS, typename F>
-    class_setter_function_type_t<TCLASS, F> to_class_setter_function(F& f)
-    {
-        return static_cast<class_setter_function_type_t<TCLASS, F>>(f);
-    }
-
-    // to_module_getter_function
-    template <typename F>
-    struct module_getter_function_traits : public module_getter_function_traits<decltype(&F::operator())> {};
-
-    template <typename TRET, typename... ARGS>
-    struct module_getter_function_traits<TRET(*)(ARGS...)>
-    {
-        static_assert((sizeof...(ARGS) == 0), "Error: property getter does not accept param.");
-        using function_type = std::function<TRET(ARGS...)>;
-    };
-
-    template <typename TRET, typename CLASS, typename... ARGS>
-    struct module_getter_function_traits<TRET(CLASS::*)(ARGS...) const>
-    {
-        static_assert((sizeof...(ARGS) == 0), "Error: property getter does not accept param.");
-        using function_type = std::function<TRET(ARGS...)>;
-    };
-
-    template <typename F>
-    using module_getter_function_type_t = typename module_getter_function_traits<F>::function_type;
-
-    template <typename F>
-    module_getter_function_type_t<F> to_module_getter_function(F& f)
-    {
-        return static_cast<module_getter_function_type_t<F>>(f);
-    }
-
-    // to_module_setter_function
-    template <typename F>
-    struct module_setter_function_traits : public module_setter_function_traits<decltype(&F::operator())> {};
-
-    template <typename TRET, typename ARG1, typename... ARGS>
-    struct module_setter_function_traits<TRET(*)(ARG1, ARGS...)>
-    {
-        static_assert((sizeof...(ARGS) == 0), "Error: property setter accepts only 1 value.");
-        using function_type = std::function<TRET(ARG1, ARGS...)>;
-    };
-
-    template <typename TRET, typename CLASS, typename ARG1, typename... ARGS>
-    struct module_setter_function_traits<TRET(CLASS::*)(ARG1, ARGS...) const>
-    {
-        static_assert((sizeof...(ARGS) == 0), "Error: property setter accepts only 1 value.");
-        using function_type = std::function<TRET(ARG1, ARGS...)>;
-    };
-
-    template <typename F>
-    using module_setter_function_type_t = typename module_setter_function_traits<F>::function_type;
-
-    template <typename F>
-    module_setter_function_type_t<F> to_module_setter_function(F& f)
-    {
-        return static_cast<module_setter_function_type_t<F>>(f);
-    }
-#endif
-
-    //========================================================
-    // Lua Class
-    //========================================================
-
-    template <typename, int = 0> struct LuaClass;
-
-    //========================================================
-    // Lua stack operator
-    //========================================================
-
-    template <typename T> struct LuaStack
-    {
-        inline static T& get(lua_State * state, int idx)
-        {
-#if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(state, LuaClass<T>::klassName != nullptr, 1, "cpp class not export");
-#else
-            luaL_argcheck(state, LuaClass<T>::klassName != nullptr, 1, (std::string("cpp class `") + RTTI_CLASS_NAME(T) + "` not export").c_str());
-#endif
-            if (lua_istable(state, idx)) {
-#if !defined LUA_VERSION_NUM || LUA_VERSION_NUM <= 502
-                if (lua_getmetatable(state, idx)) {
-                    lua_getfield(state, LUA_REGISTRYINDEX, LuaClass<T>::klassName);
-                    if (lua_rawequal(state, -1, -2)) {
-                        lua_getfield(state, idx, "@");
-                        if (lua_type(state, -1) == LUA_TUSERDATA) {
-                            T ** t = (T**)luaL_checkudata(state, -1, LuaClass<T>::klassName);
-                            luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
-                            return (**t);
-                        }
-                    }
-                }
-#else
-                if (luaL_getmetafield(state, idx, "__name") == LUA_TSTRING) {
-                    if (LuaClass<T>::klassName && strcmp(lua_tostring(state, -1), LuaClass<T>::klassName) == 0) {
-                        if (lua_getfield(state, idx, "@") == LUA_TUSERDATA) {
-                            T ** t = (T**)luaL_checkudata(state, -1, LuaClass<T>::klassName);
-                            luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
-                            return (**t);
-                        }
-                    }
-                }
-#endif
-            }
-            T ** t = (T**)luaL_checkudata(state, idx, LuaClass<T>::klassName);
-            luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
-            return (**t);
-        }
-
-        inline static void put(lua_State * L, T * t)
-        {
-            lua_pushlightuserdata(L, t);
-        }
-    };
-
-    template <typename T> struct LuaStack<const T> : public LuaStack<T> {};
-    template <typename T> struct LuaStack<T&> : public LuaStack<T> {};
-    template <typename T> struct LuaStack<const T&> : public LuaStack<T> {};
-
-    template <typename T> struct LuaStack<volatile T&> : public LuaStack<T> 
-    {
-        inline static void put(lua_State * L, volatile T & t)
-        {
-            LuaStack<T>::put(L, const_cast<const T &>(t));
-        }
-    };
-
-    template <typename T> struct LuaStack<const volatile T&> : public LuaStack<T>
-    {
-        inline static void put(lua_State * L, const volatile T & t)
-        {
-            LuaStack<T>::put(L, const_cast<const T &>(t));
-        }
-    };
-
-    template <typename T> struct LuaStack<T&&> : public LuaStack<T>
-    {
-        inline static void put(lua_State * L, T && t)
-        {
-            LuaStack<T>::put(L, std::forward<T>(t));
-        }
-    };
-
-    template <typename T> struct LuaStack<T*>
-    {
-        inline static T * get(lua_State * state, int idx)
-        {
-            if (lua_islightuserdata(state, idx))
-            {
-                T * t = (T*)lua_touserdata(state, idx);
-                return t;
-            }
-            else if (lua_isuserdata(state, idx)) 
-            {
-                if (LuaClass<T*>::klassName != nullptr)
-                {
-                    T ** t = (T**)luaL_checkudata(state, idx, LuaClass<T*>::klassName);
-                    luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
-                    return *t;
-                }
-                if (LuaClass<T>::klassName != nullptr)
-                {
-                    T ** t = (T**)luaL_checkudata(state, idx, LuaClass<T>::klassName);
-                    luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
-                    return *t;
-                }
-            }
-            return nullptr;
-        }
-
-        inline static void put(lua_State * L, T * t)
-        {
-            lua_pushlightuserdata(L, t);
-        }
-    };
-
-    template<>
-    struct LuaStack<float>
-    {
-        inline static float get(lua_State * L, int idx)
-        {
-            if (lua_isnumber(L, idx) || lua_isstring(L, idx))
-            {
-                return float(lua_tonumber(L, idx));
-            }
-            else
-            {
-                luaL_checktype(L, idx, LUA_TNUMBER);
-            }
-            return 0;
-        }
-
-        inline static void put(lua_State * L, const float & t)
-        {
-            lua_pushnumber(L, t);
-        }
-    };
-
-    template<>
-    struct LuaStack<double>
-    {
-        inline static double get(lua_State * L, int idx)
-        {
-            if (lua_isnumber(L, idx) || lua_isstring(L, idx))
-            {
-                return double(lua_tonumber(L, idx));
-            }
-            else
-            {
-                luaL_checktype(L, idx, LUA_TNUMBER);
-            }
-            return 0;
-        }
-
-        inline static void put(lua_State * L, const double & t)
-        {
-            lua_pushnumber(L, t);
-        }
-    };
-
-    template<>
-    struct LuaStack<int>
-    {
-        inline static int get(lua_State * L, int idx)
-        {
-            if (lua_isnumber(L, idx) || lua_isstring(L, idx))
-            {
-                return int(lua_tointeger(L, idx));
-            }
-            else
-            {
-                luaL_checktype(L, idx, LUA_TNUMBER);
-            }
-            return 0;
-        }
-
-        inline static void put(lua_State * L, const int & t)
-        {
-            lua_pushinteger(L, t);
-        }
-    };
-
-    template<>
-    struct LuaStack<bool>
-    {
-        inline static bool get(lua_State * L, int idx)
-        {
-            luaL_checktype(L, idx, LUA_TBOOLEAN);
-            return lua_toboolean(L, idx) != 0;
-        }
-
-        inline static void put(lua_State * L, const bool & t)
-        {
-            lua_pushboolean(L, t);
-        }
-    };
-
-    template<>
-    struct LuaStack<const char *>
-    {
-        inline static const char * get(lua_State * L, int idx)
-        {
-            switch (lua_type(L, idx))
-            {
-            case LUA_TBOOLEAN:
-                return (lua_toboolean(L, idx) ? "true" : "false");
-            case LUA_TNUMBER:
-                return lua_tostring(L, idx);
-            case LUA_TSTRING:
-                return lua_tostring(L, idx);
-            default:
-                luaL_checktype(L, idx, LUA_TSTRING);
-                break;
-            }
-            return "";
-        }
-
-        inline static void put(lua_State * L, const char * s)
-        {
-            lua_pushstring(L, s);
-        }
-    };
-
-    template<>
-    struct LuaStack<char *>
-    {
-        inline static char * get(lua_State * L, int idx)
-        {
-            return const_cast<char*>(LuaStack<const char *>::get(L, idx));
-        }
-
-        inline static void put(lua_State * L, const char * s)
-        {
-            LuaStack<const char *>::put(L, s);
-        }
-    };
-
-#if !LUAAA_WITHOUT_CPP_STDLIB
-    template<>
-    struct LuaStack<std::string>
-    {
-        inline static std::string get(lua_State * L, int idx)
-        {
-            return LuaStack<const char *>::get(L, idx);
-        }
-
-        inline static void put(lua_State * L, const std::string& s)
-        {
-            LuaStack<const char *>::put(L, s.c_str());
-        }
-    };
-#endif
-
-    template<>
-    struct LuaStack<lua_State *>
-    {
-        inline static lua_State * get(lua_State * L, int)
-        {
-            return L;
-        }
-
-        inline static void put(lua_State *, lua_State *)
-        {
-            // do thing here.
-        }
-    };
-
-    // push ret data to stack
-    template <typename T>
-    inline void LuaStackReturn(lua_State * L, T t)
-    {
-        lua_settop(L, 0);
-        LuaStack<T>::put(L, t);
-    }
-
-
-#define IMPLEMENT_CALLBACK_INVOKER(CALLCONV) \
-    template<typename RET, typename ...ARGS> \
-    struct LuaStack<RET(CALLCONV*)(ARGS...)> \
-    { \
-        typedef RET(CALLCONV*FTYPE)(ARGS...); \
-        inline static FTYPE get(lua_State * L, int idx) \
-        { \
-            static lua_State * cacheLuaState = nullptr; \
-            static int cacheLuaFuncId = 0; \
-            struct HelperClass \
-            { \
-                static RET CALLCONV f_callback(ARGS... args) \
-                { \
-                    lua_rawgeti(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId); \
-                    if (lua_isfunction(cacheLuaState, -1)) \
-                    { \
-                        int initParams[] = { (LuaStack<ARGS>::put(cacheLuaState, args), 0)..., 0 }; (void)initParams; \
-                        if (lua_pcall(cacheLuaState, sizeof...(ARGS), 1, 0) != 0) \
-                        { \
-                            lua_error(cacheLuaState); \
-                        } \
-                        luaL_unref(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId); \
-                    } \
-                    else \
-                    { \
-                        lua_pushnil(cacheLuaState); \
-                    } \
-                    return LuaStack<RET>::get(cacheLuaState, lua_gettop(cacheLuaState)); \
-                } \
-            }; \
-            if (lua_isfunction(L, idx)) \
-            { \
-                cacheLuaState = L; \
-                lua_pushvalue(L, idx); \
-                cacheLuaFuncId = luaL_ref(L, LUA_REGISTRYINDEX); \
-                return HelperClass::f_callback; \
-            } \
-            return nullptr; \
-        } \
-        inline void put(lua_State * L, FTYPE f) \
-        { \
-            lua_pushcfunction(L, NonMemberFunctionCaller(f)); \
-        } \
-    }; \
-    template<typename ...ARGS> \
-    struct LuaStack<void(CALLCONV*)(ARGS...)> \
-    { \
-        typedef void(CALLCONV*FTYPE)(ARGS...); \
-        inline static FTYPE get(lua_State * L, int idx) \
-        { \
-            static lua_State * cacheLuaState = nullptr; \
-            static int cacheLuaFuncId = 0; \
-            struct HelperClass \
-            { \
-                static void CALLCONV f_callback(ARGS... args) \
-                { \
-                    lua_rawgeti(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId); \
-                    if (lua_isfunction(cacheLuaState, -1)) \
-                    { \
-                        int initParams[] = { (LuaStack<ARGS>::put(cacheLuaState, args), 0)..., 0 }; (void)initParams; \
-                        if (lua_pcall(cacheLuaState, sizeof...(ARGS), 1, 0) != 0) \
-                        { \
-                            lua_error(cacheLuaState); \
-                        } \
-                        luaL_unref(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId); \
-                    } \
-                    return; \
-                } \
-            }; \
-            if (lua_isfunction(L, idx)) \
-            { \
-                cacheLuaState = L; \
-                lua_pushvalue(L, idx); \
-                cacheLuaFuncId = luaL_ref(L, LUA_REGISTRYINDEX); \
-                return HelperClass::f_callback; \
-            } \
-            return nullptr; \
-        } \
-        inline void put(lua_State * L, FTYPE f) \
-        { \
-            lua_pushcfunction(L, NonMemberFunctionCaller(f)); \
-        } \
-    };
-
-#if !LUAAA_WITHOUT_CPP_STDLIB
-    template<typename RET, typename ...ARGS>
-    struct LuaStack<std::function<RET(ARGS...)>>
-    {
-        typedef std::function<RET(ARGS...)> FTYPE;
-        inline static FTYPE get(lua_State * L, int idx)
-        {
-            static lua_State * cacheLuaState = nullptr;
-            static int cacheLuaFuncId = 0;
-            struct HelperClass
-            {
-                static RET f_callback(ARGS... args)
-                {
-                    lua_rawgeti(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId);
-                    if (lua_isfunction(cacheLuaState, -1))
-                    {
-                        int initParams[] = { (LuaStack<ARGS>::put(cacheLuaState, args), 0)..., 0 }; (void)initParams;
-                        if (lua_pcall(cacheLuaState, sizeof...(ARGS), 1, 0) != 0)
-                        {
-                            lua_error(cacheLuaState);
-                        }
-                        luaL_unref(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId);
-                    }
-                    else
-                    {
-                        lua_pushnil(cacheLuaState);
-                    }
-                    return LuaStack<RET>::get(cacheLuaState, lua_gettop(cacheLuaState));
-                }
-            };
-            if (lua_isfunction(L, idx))
-            {
-                cacheLuaState = L;
-                lua_pushvalue(L, idx);
-                cacheLuaFuncId = luaL_ref(L, LUA_REGISTRYINDEX);
-                return HelperClass::f_callback;
-            }
-            return nullptr;
-        }
-        inline void put(lua_State * L, FTYPE f)
-        {
-            lua_pushcfunction(L, NonMemberFunctionCaller(f));
-        }
-    };
-    
-    template<typename ...ARGS>
-    struct LuaStack<std::function<void(ARGS...)>>
-    {
-        typedef std::function<void(ARGS...)> FTYPE;
-        inline static FTYPE get(lua_State * L, int idx)
-        {
-            static lua_State * cacheLuaState = nullptr;
-            static int cacheLuaFuncId = 0;
-            struct HelperClass
-            {
-                static void f_callback(ARGS... args)
-                {
-                    lua_rawgeti(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId);
-                    if (lua_isfunction(cacheLuaState, -1))
-                    {
-                        int initParams[] = { (LuaStack<ARGS>::put(cacheLuaState, args), 0)..., 0 };
-                        if (lua_pcall(cacheLuaState, sizeof...(ARGS), 1, 0) != 0)
-                        {
-                            lua_error(cacheLuaState);
-                        }
-                        luaL_unref(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId);
-                    }
-                    return;
-                }
-            };
-            if (lua_isfunction(L, idx))
-            {
-                cacheLuaState = L;
-                lua_pushvalue(L, idx);
-                cacheLuaFuncId = luaL_ref(L, LUA_REGISTRYINDEX);
-                return HelperClass::f_callback;
-            }
-            return nullptr;
-        }
-        inline void put(lua_State * L, FTYPE f)
-        {
-            lua_pushcfunction(L, NonMemberFunctionCaller(f));
-        }
-    };
-#endif
-
-    //========================================================
-    // index generation helper
-    //========================================================
-    template<std::size_t... Ns>
-    struct indices
-    {
-        using next = indices<Ns..., sizeof...(Ns)>;
-    };
-
-    template<std::size_t N>
-    struct make_indices
-    {
-        using type = typename make_indices<N - 1>::type::next;
-    };
-
-    template<>
-    struct make_indices<0>
-    {
-        using type = indices<>;
-    };
-
-    //========================================================
-    // non-member function caller & static member function caller
-    //========================================================
-    template<typename TRET, typename FTYPE, typename ...ARGS, std::size_t... Ns>
-    TRET LuaInvokeImpl(lua_State* state, void* calleePtr, size_t skip, indices<Ns...>)
-    {
-        return (*(FTYPE*)(calleePtr))(LuaStack<ARGS>::get(state, Ns + 1 + skip)...);
-    }
-
-    template<typename TRET, typename FTYPE, typename ...ARGS>
-    inline TRET LuaInvoke(lua_State* state, void* calleePtr, size_t skip)
-    {
-        return LuaInvokeImpl<TRET, FTYPE, ARGS...>(state, calleePtr, skip, typename make_indices<sizeof...(ARGS)>::type());
-    }
-
-
-#define IMPLEMENT_FUNCTION_CALLER(CALLERNAME, CALLCONV, SKIPPARAM) \
-    template<typename TRET, typename ...ARGS> \
-    lua_CFunction CALLERNAME(TRET(CALLCONV*func)(ARGS...)) \
-    { \
-        typedef decltype(func) FTYPE; (void)(func); \
-        struct HelperClass \
-        { \
-            static int Invoke(lua_State* state) \
-            { \
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1)); \
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found."); \
-                if (calleePtr) \
-                { \
-                    LuaStackReturn<TRET>(state, LuaInvoke<TRET, FTYPE, ARGS...>(state, calleePtr, SKIPPARAM)); \
-                    return 1; \
-                } \
-                return 0; \
-            } \
-        }; \
-        return HelperClass::Invoke; \
-    } \
-    template<typename ...ARGS> \
-    lua_CFunction CALLERNAME(void(CALLCONV*func)(ARGS...)) \
-    { \
-        typedef decltype(func) FTYPE; (void)(func); \
-        struct HelperClass \
-        { \
-            static int Invoke(lua_State* state) \
-            { \
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1)); \
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found."); \
-                if (calleePtr) \
-                { \
-                    LuaInvoke<void, FTYPE, ARGS...>(state, calleePtr, SKIPPARAM); \
-                } \
-                return 0; \
-            } \
-        }; \
-        return HelperClass::Invoke; \
-    }
-
-#if defined(_MSC_VER)
-    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __cdecl, 0);
-    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __cdecl, 1);
-    IMPLEMENT_CALLBACK_INVOKER(__cdecl);
-
-#	ifdef _M_CEE
-    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __clrcall, 0);
-    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __clrcall, 1);
-    IMPLEMENT_CALLBACK_INVOKER(__clrcall);
-#	endif
-
-#	if defined(_M_IX86) && !defined(_M_CEE)
-    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __fastcall, 0);
-    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __fastcall, 1);
-    IMPLEMENT_CALLBACK_INVOKER(__fastcall);
-#	endif
-
-#	ifdef _M_IX86
-    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __stdcall, 0);
-    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __stdcall, 1);
-    IMPLEMENT_CALLBACK_INVOKER(__stdcall);
-#	endif
-
-#	if ((defined(_M_IX86) && _M_IX86_FP >= 2) || defined(_M_X64)) && !defined(_M_CEE)
-    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __vectorcall, 0);
-    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __vectorcall, 1);
-    IMPLEMENT_CALLBACK_INVOKER(__vectorcall);
-#	endif
-#elif defined(__clang__)
-#	define _NOTHING
-    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, _NOTHING, 0);
-    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, _NOTHING, 1);
-    IMPLEMENT_CALLBACK_INVOKER(_NOTHING);
-#	undef _NOTHING
-#elif defined(__GNUC__)
-#	define _NOTHING
-    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, _NOTHING, 0);
-    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, _NOTHING, 1);
-    IMPLEMENT_CALLBACK_INVOKER(_NOTHING);
-#	undef _NOTHING
-#else
-#	define _NOTHING
-    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, _NOTHING, 0);
-    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, _NOTHING, 1);
-    IMPLEMENT_CALLBACK_INVOKER(_NOTHING);
-#	undef _NOTHING
-#endif	
-
-    //========================================================
-    // member function invoker
-    //========================================================
-    template<typename TCLASS, typename TRET, typename FTYPE, typename ...ARGS, std::size_t... Ns>
-    TRET LuaInvokeInstanceMemberImpl(lua_State* state, void* calleePtr, indices<Ns...>)
-    {
-        return (LuaStack<TCLASS>::get(state, 1).**(FTYPE*)(calleePtr))(LuaStack<ARGS>::get(state, Ns + 2)...);
-    }
-
-    template<typename TCLASS, typename TRET, typename FTYPE, typename ...ARGS>
-    inline TRET LuaInvokeInstanceMember(lua_State* state, void* calleePtr)
-    {
-        return LuaInvokeInstanceMemberImpl<TCLASS, TRET, FTYPE, ARGS...>(state, calleePtr, typename make_indices<sizeof...(ARGS)>::type());
-    }
-
-
-    template<typename TCLASS, typename TRET, typename ...ARGS>
-    lua_CFunction MemberFunctionCaller(TRET(TCLASS::*func)(ARGS...))
-    {
-        typedef decltype(func) FTYPE; (void)(func);
-        struct HelperClass
-        {
-            static int Invoke(lua_State* state)
-            {
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
-                if (calleePtr)
-                {
-                    LuaStackReturn<TRET>(state, LuaInvokeInstanceMember<TCLASS, TRET, FTYPE, ARGS...>(state, calleePtr));
-                    return 1;
-                }
-                return 0;
-            }
-        };
-        return HelperClass::Invoke;
-    }
-
-    template<typename TCLASS, typename TRET, typename ...ARGS>
-    lua_CFunction MemberFunctionCaller(TRET(TCLASS::*func)(ARGS...)const)
-    {
-        typedef decltype(func) FTYPE; (void)(func);
-        struct HelperClass
-        {
-            static int Invoke(lua_State* state)
-            {
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
-                if (calleePtr)
-                {
-                    LuaStackReturn<TRET>(state, LuaInvokeInstanceMember<TCLASS, TRET, FTYPE, ARGS...>(state, calleePtr));
-                    return 1;
-                }
-                return 0;
-            }
-        };
-        return HelperClass::Invoke;
-    }
-
-    template<typename TCLASS, typename ...ARGS>
-    lua_CFunction MemberFunctionCaller(void(TCLASS::*func)(ARGS...))
-    {
-        typedef decltype(func) FTYPE; (void)(func);
-        struct HelperClass
-        {
-            static int Invoke(lua_State* state)
-            {
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
-                if (calleePtr)
-                {
-                    LuaInvokeInstanceMember<TCLASS, void, FTYPE, ARGS...>(state, calleePtr);
-                }
-                return 0;
-            }
-        };
-        return HelperClass::Invoke;
-    }
-
-    template<typename TCLASS, typename ...ARGS>
-    lua_CFunction MemberFunctionCaller(void(TCLASS::*func)(ARGS...)const)
-    {
-        typedef decltype(func) FTYPE; (void)(func);
-        struct HelperClass
-        {
-            static int Invoke(lua_State* state)
-            {
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
-                if (calleePtr)
-                {
-                    LuaInvokeInstanceMember<TCLASS, void, FTYPE, ARGS...>(state, calleePtr);
-                }
-                return 0;
-            }
-        };
-        return HelperClass::Invoke;
-    }
-
-#if !LUAAA_WITHOUT_CPP_STDLIB
-    template<typename TRET, typename ...ARGS>
-    lua_CFunction MemberFunctionCaller(const std::function<TRET(ARGS...)>& func)
-    {
-        typedef std::function<TRET(ARGS...)> FTYPE; (void)(func);
-        struct HelperClass
-        {
-            static int Invoke(lua_State* state)
-            {
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
-                if (calleePtr)
-                {
-                    LuaStackReturn<TRET>(state, LuaInvoke<TRET, FTYPE, ARGS...>(state, calleePtr, 1));
-                    return 1;
-                }
-                return 0;
-            }
-        };
-        return HelperClass::Invoke;
-    }
-
-    template<typename ...ARGS>
-    lua_CFunction MemberFunctionCaller(const std::function<void(ARGS...)>& func)
-    {
-        typedef std::function<void(ARGS...)> FTYPE; (void)(func);
-        struct HelperClass
-        {
-            static int Invoke(lua_State* state)
-            {
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
-                if (calleePtr)
-                {
-                    LuaInvoke<void, FTYPE, ARGS...>(state, calleePtr, 1);
-                }
-                return 0;
-            }
-        };
-        return HelperClass::Invoke;
-    }
-
-    template<typename TRET, typename ...ARGS>
-    lua_CFunction NonMemberFunctionCaller(const std::function<TRET(ARGS...)>& func)
-    {
-        typedef std::function<TRET(ARGS...)> FTYPE; (void)(func);
-        struct HelperClass
-        {
-            static int Invoke(lua_State* state)
-            {
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
-                if (calleePtr)
-                {
-                    LuaStackReturn<TRET>(state, LuaInvoke<TRET, FTYPE, ARGS...>(state, calleePtr, 0));
-                    return 1;
-                }
-                return 0;
-            }
-        };
-        return HelperClass::Invoke;
-    }
-
-    template<typename ...ARGS>
-    lua_CFunction NonMemberFunctionCaller(const std::function<void(ARGS...)>& func)
-    {
-        typedef std::function<void(ARGS...)> FTYPE; (void)(func);
-        struct HelperClass
-        {
-            static int Invoke(lua_State* state)
-            {
-                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
-                if (calleePtr)
-                {
-                    LuaInvoke<void, FTYPE, ARGS...>(state, calleePtr, 0);
-                }
-                return 0;
-            }
-        };
-        return HelperClass::Invoke;
-    }
-#endif
-
-    //========================================================
-    // constructor invoker
-    //========================================================
-    template<typename TCLASS, typename ...ARGS>
-    struct PlacementConstructorCaller
-    {
-        static TCLASS * Invoke(lua_State * state, void * mem, size_t skip)
-        {
-            return InvokeImpl(state, mem, typename make_indices<sizeof...(ARGS)>::type(), skip);
-        }
-
-    private:
-        template<std::size_t ...Ns>
-        static TCLASS * InvokeImpl(lua_State * state, void * mem, indices<Ns...>, size_t skip)
-        {
-            return new(mem) TCLASS(LuaStack<ARGS>::get(state, Ns + 1 + skip)...);
-        }
-    };
-
-    //========================================================
-    // Destructor invoker
-    //========================================================
-    template<typename TCLASS, bool = std::is_destructible<TCLASS>::value>
-    struct DestructorCaller
-    {
-        static void Invoke(TCLASS * obj)
-        {
-            delete obj;
-        }
-    };
-
-    template<typename TCLASS>
-    struct DestructorCaller<TCLASS, false>
-    {
-        static void Invoke(TCLASS * obj)
-        {
-            // do thing here.
-        }
-    };
-
-    //========================================================
-    // export class
-    //========================================================
-    template <typename TCLASS, int TAG>
-    struct LuaClass
-    {
-        friend struct DestructorCaller<TCLASS>;
-        template<typename> friend struct LuaStack;
-        friend struct LuaModule;
-
-        typedef struct _UserDataDetail {
-            TCLASS * obj;
-            int (*dtor)(_UserDataDetail*);
-            void* free_func;
-        } UserDataDetail;
-
-    public:
-        LuaClass(lua_State * state, const char * name, const luaL_Reg * functions = nullptr)
-            : m_state(state)
-        {
-            assert(state != nullptr);
-            assert(klassName == nullptr);
-
-#if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(state, (klassName == nullptr), 1, "LuaCalss<CLASS> name conflict, use LuaClass<CLASS, TAG> to identify them");
-#else
-            luaL_argcheck(state, (klassName == nullptr), 1, (std::string("C++ class `") + RTTI_CLASS_NAME(TCLASS) + "` bind to conflict lua name `" + name + "`, origin name: `" + klassName + "`. use use LuaClass<CLASS, TAG> to identify them.").c_str());
-#endif
-
-            struct HelperClass {
-                static int f__clsgc(lua_State*) {
-                    LuaClass<TCLASS, TAG>::klassName = nullptr;
-                    return 0; 
-                }
-
-                static int f__objgc(lua_State* state) {
-                    if (lua_isuserdata(state, -1)) {
-                        auto uData = (UserDataDetail*)luaL_checkudata(state, -1, (LuaClass<TCLASS, TAG>::klassName));
-                        if (uData)
-                        {
-                            lua_getmetatable(state, -1);
-                            lua_getfield(state, -1, "!__gc");
-                            if (lua_isfunction(state, -1))
-                            {
-                                lua_insert(state, 1);
-                                lua_pcall(state, lua_gettop(state) - 1, 0, 0);
-                            }
-
-                            if (uData->dtor)
-                            {
-                                return (uData->dtor)(uData);
-                            }
-                        }
-                    }
-                    return 0;
-                }
-
-#if LUAAA_FEATURE_PROPERTY
-                static int f_internal_index(lua_State* state)
-                {
-                    const char* key = luaL_checkstring(state, 2);
-                    if (!key)
-                    {
-                        lua_pushnil(state);
-                        return 1;
-                    }
-
-                    lua_getmetatable(state, 1);
-                    lua_getfield(state, -1, key);
-                    if (!lua_isnil(state, -1))
-                    {
-                        return 1;
-                    }
-
-                    lua_pop(state, 1);
-
-                    char internal_name[256];
-                    snprintf(internal_name, sizeof(internal_name), "<%s", key);
-
-                    lua_getfield(state, -1, internal_name);
-                    if (lua_isfunction(state, -1))
-                    {
-                        lua_insert(state, 1);
-                        lua_pcall(state, lua_gettop(state) - 1, 1, 0);
-                    }
-                    else if (lua_isnil(state, -1))
-                    {
-                        // check if user defined __index method
-                        lua_pop(state, 1);
-                        lua_getfield(state, -1, "!__index");
-                        if (lua_isfunction(state, -1))
-                        {
-                            lua_insert(state, 1);
-                            lua_pcall(state, lua_gettop(state) - 1, 0, 0);
-                        }
-                        else if (lua_istable(state, -1))
-                        {
-                            lua_replace(state, 1);
-                            lua_pop(state, 1);
-                            lua_rawget(state, 1);
-                        }
-                        else
-                        {
-                            lua_pop(state, 1);
-                            snprintf(internal_name, sizeof(internal_name), ">%s", key);
-                            lua_getfield(state, -1, internal_name);
-                            if (lua_isfunction(state, -1))
-                            {
-                                // Yes, there are something write-only, e.g., stdout, printer, digital io pin in output mode.
-                                luaL_error(state, "attempt to read Write-Only property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
-                            }
-                            else
-                            {
-                                // do nothing here. nil will be return.
-                                // luaL_error(state, "attempt to access Non-existing property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
-                            }
-                        }
-                    }
-                    return 1;
-                }
-
-                static int f_internal_newindex(lua_State* state)
-                {
-                    const char* key = luaL_checkstring(state, 2);
-                    if (!key)
-                    {
-                        lua_pushnil(state);
-                        return 1;
-                    }
-
-                    char internal_name[256];
-                    snprintf(internal_name, sizeof(internal_name), ">%s", key);
-
-
-                    lua_getmetatable(state, 1);
-                    lua_getfield(state, -1, internal_name);
-                    if (lua_isfunction(state, -1))
-                    {
-                        lua_insert(state, 1);
-                        lua_pcall(state, lua_gettop(state) - 1, 0, 0);
-                    }
-                    else if (lua_istable(state, 1)) // if is extended lua class
-                    {
-                        lua_pop(state, 2);
-                        lua_rawset(state, 1);
-                    }
-                    else
-                    {
-                        // check if user defined __newindex method
-                        lua_pop(state, 1);
-                        lua_getfield(state, -1, "!__newindex");
-                        if (lua_isfunction(state, -1))
-                        {
-                            lua_insert(state, 1);
-                            lua_pcall(state, lua_gettop(state) - 1, 0, 0);
-                        }
-                        else if (lua_istable(state, -1))
-                        {
-                            lua_replace(state, 1);
-                            lua_pop(state, 1);
-                            lua_rawset(state, 1);
-                        }
-                        else
-                        {
-                            lua_pop(state, 1);
-                            snprintf(internal_name, sizeof(internal_name), "<%s", key);
-                            lua_getfield(state, -1, internal_name);
-                            if (lua_isfunction(state, -1))
-                            {
-                                luaL_error(state, "attempt to write Read-Only property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
-                            }
-                            else
-                            {
-                                luaL_error(state, "attempt to access Non-existing property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
-                            }
-                        }
-                    }
-                    return 0;
-                }
-#endif
-            };
-
-            size_t strBufLen = strlen(name) + 1;
-            klassName = reinterpret_cast<char *>(lua_newuserdata(state, strBufLen + 1));
-            memcpy(klassName, name, strBufLen);
-
-            klassName[strBufLen - 1] = '$';
-            klassName[strBufLen] = 0;
-            luaL_newmetatable(state, klassName);
-            luaL_Reg clsgc[] = { { "__gc", HelperClass::f__clsgc }, { nullptr, nullptr } };
-            luaL_setfuncs(state, clsgc, 0);
-            lua_setmetatable(state, -2);
-          
-            klassName[strBufLen - 1] = 0;
-            luaL_newmetatable(state, klassName);
-            luaL_Reg objgc[] = { 
-                { "__gc", HelperClass::f__objgc }, 
-#if LUAAA_FEATURE_PROPERTY
-                { "__index", HelperClass::f_internal_index },
-                { "__newindex", HelperClass::f_internal_newindex },
-#endif
-                { nullptr, nullptr } 
-            };
-            luaL_setfuncs(state, objgc, 0);
-
-#if !LUAAA_FEATURE_PROPERTY
-            // if not register __index function, uncomment below codes
-            lua_pushvalue(state, -1);
-            lua_setfield(state, -2, "__index");
-#endif
-
-            lua_pushvalue(state, -2);
-            lua_setfield(state, -2, "$");
-
-            if (functions)
-            {
-                luaL_setfuncs(state, functions, 0);
-            }
-
-            lua_pop(state, 2);
-        }
-
-#if !LUAAA_WITHOUT_CPP_STDLIB
-        LuaClass(lua_State * state, const std::string& name, const luaL_Reg * functions = nullptr)
-            : LuaClass(state, name.c_str(), functions)
-        {}
-#endif
-
-        template<typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& ctor(const char * name = "new")
-        {
-            struct HelperClass {
-                static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail * uData) {
-                    if (uData && uData->obj)
-                    {
-                        (uData->obj)->~TCLASS();
-                    }
-                    return 0;
-                }
-
-                static int f_new(lua_State* state) {
-                    auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(state, sizeof(LuaClass<TCLASS, TAG>::UserDataDetail) + sizeof(TCLASS));
-                    if (uData)
-                    {
-                        TCLASS * obj = PlacementConstructorCaller<TCLASS, ARGS...>::Invoke(state, (void*)(uData + 1), 0);
-                        if (obj)
-                        {
-                            uData->obj = obj;
-                            uData->dtor = HelperClass::f_dtor;
-                            luaL_setmetatable(state, (LuaClass<TCLASS, TAG>::klassName));
-                            return 1;
-                        }
-                        lua_pop(state, 1);
-                    }
-                    lua_pushnil(state);
-                    return 1;
-                }
-            };
-
-            luaaa_check_constructor_name_conflict(name);
-
-            luaL_Reg constructor[] = { { name, HelperClass::f_new }, { nullptr, nullptr } };
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, klassName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-            }
-            luaL_setfuncs(m_state, constructor, 0);
-            lua_setglobal(m_state, klassName);
-#else
-            luaL_openlib(m_state, klassName, constructor, 0);
-#endif
-            return (*this);
-        }
-
-        template<typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& ctor(const char * name, TCLASS*(*spawner)(ARGS...)) {
-            typedef decltype(spawner) SPAWNERFTYPE;
-            struct HelperClass {
-                static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail* uData) {
-                    if (uData && uData->obj)
-                    {
-                        DestructorCaller<TCLASS>::Invoke(uData->obj);
-                    }
-                    return 0;
-                }
-
-                static int f_new(lua_State* state) {
-                    void * spawner = lua_touserdata(state, lua_upvalueindex(1));
-                    luaL_argcheck(state, spawner, 1, "cpp closure spawner not found.");
-                    if (spawner) {
-                        auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(state, sizeof(LuaClass<TCLASS, TAG>::UserDataDetail));
-                        if (uData)
-                        {
-                            auto obj = LuaInvoke<TCLASS*, SPAWNERFTYPE, ARGS...>(state, spawner, 0);
-                            if (obj)
-                            {
-                                uData->obj = obj;
-                                uData->dtor = HelperClass::f_dtor;
-                                luaL_setmetatable(state, (LuaClass<TCLASS, TAG>::klassName));
-                                return 1;
-                            }
-                            lua_pop(state, 1);
-                        }
-                    }
-                    lua_pushnil(state);
-                    return 1;
-                }
-            };
-
-            luaaa_check_constructor_name_conflict(name);
-
-            luaL_Reg constructor[] = { { name, HelperClass::f_new }, { nullptr, nullptr } };
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, klassName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-            }
-#endif
-
-            SPAWNERFTYPE * spawnerPtr = (SPAWNERFTYPE*)lua_newuserdata(m_state, sizeof(SPAWNERFTYPE));
-#if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(m_state, spawnerPtr != nullptr, 1, "faild to alloc mem to store spawner for ctor");
-#else
-            luaL_argcheck(m_state, spawnerPtr != nullptr, 1, (std::string("faild to alloc mem to store spawner for ctor `") + name + "`").c_str());
-#endif
-            if (!spawnerPtr)
-            {
-                lua_pop(m_state, 1);
-                return  (*this);
-            }
-
-            memset(spawnerPtr, 0, sizeof(SPAWNERFTYPE));
-            *spawnerPtr = spawner;
-
-#if USE_NEW_MODULE_REGISTRY
-            luaL_setfuncs(m_state, constructor, 1);
-            lua_setglobal(m_state, klassName);
-#else
-            luaL_openlib(m_state, klassName, constructor, 1);
-#endif
-            return (*this);
-        }
-
-        template<typename TRET, typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& ctor(const char * name, TCLASS*(*spawner)(ARGS...), TRET(*deleter)(TCLASS*)){
-            typedef decltype(spawner) SPAWNERFTYPE;
-            typedef decltype(deleter) DELETERFTYPE;
-
-            struct HelperClass {
-                static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail* uData) {
-                    if (uData && uData->obj && uData->free_func)
-                    {
-                        (*(DELETERFTYPE*)(uData->free_func))(uData->obj);
-                    }
-                    return 0;
-                }
-
-                static int f_new(lua_State* state) {
-                    void * spawner = lua_touserdata(state, lua_upvalueindex(1));
-                    luaL_argcheck(state, spawner, 1, "cpp closure spawner not found.");
-
-                    void * deleter = lua_touserdata(state, lua_upvalueindex(2));
-                    luaL_argcheck(state, deleter, 2, "cpp closure deleter not found.");
-
-                    if (spawner) {
-                        auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(state, sizeof(LuaClass<TCLASS, TAG>::UserDataDetail));
-                        if (uData)
-                        {
-                            auto obj = LuaInvoke<TCLASS*, SPAWNERFTYPE, ARGS...>(state, spawner, 0);
-                            if (obj)
-                            {
-                                uData->obj = obj;
-                                uData->dtor = HelperClass::f_dtor;
-                                uData->free_func = deleter;
-                                luaL_setmetatable(state, (LuaClass<TCLASS, TAG>::klassName));
-                                return 1;
-                            }
-                            lua_pop(state, 1);
-                        }
-                    }
-                    lua_pushnil(state);
-                    return 1;
-                }
-            };
-
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, klassName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-            }
-#endif
-
-            SPAWNERFTYPE * spawnerPtr = (SPAWNERFTYPE*)lua_newuserdata(m_state, sizeof(SPAWNERFTYPE));
-#if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(m_state, spawnerPtr != nullptr, 0, ("faild to alloc mem to store spawner for ctor"));
-#else
-            luaL_argcheck(m_state, spawnerPtr != nullptr, 0, (std::string("faild to alloc mem to store spawner for ctor `") + name + "`").c_str());
-#endif
-            if (!spawnerPtr)
-            {
-                lua_pop(m_state, 2);
-                return (*this);
-            }
-
-            memset(spawnerPtr, 0, sizeof(SPAWNERFTYPE));
-            *spawnerPtr = spawner;
-
-            DELETERFTYPE * deleterPtr = (DELETERFTYPE*)lua_newuserdata(m_state, sizeof(DELETERFTYPE));
-#if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(m_state, deleterPtr != nullptr, 0, ("faild to alloc mem to store deleter for ctor"));
-#else
-            luaL_argcheck(m_state, deleterPtr != nullptr, 0, (std::string("faild to alloc mem to store deleter for ctor `") + name + "`").c_str());
-#endif
-            if (!deleterPtr)
-            {
-                lua_pop(m_state, 3);
-                return (*this);
-            }
-
-            memset(deleterPtr, 0, sizeof(DELETERFTYPE));
-            *deleterPtr = deleter;
-
-            luaL_Reg constructor[] = { { name, HelperClass::f_new }, { nullptr, nullptr } };
-#if USE_NEW_MODULE_REGISTRY
-            luaL_setfuncs(m_state, constructor, 2);
-            lua_setglobal(m_state, klassName);
-#else
-            luaL_openlib(m_state, klassName, constructor, 2);
-#endif
-            return (*this);
-        }
-
-        template<typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& ctor(const char * name, TCLASS*(*spawner)(ARGS...), std::nullptr_t) {
-            typedef decltype(spawner) SPAWNERFTYPE;
-
-            struct HelperClass {
-                static int f_new(lua_State* state) {
-                    void * spawner = lua_touserdata(state, lua_upvalueindex(1));
-                    luaL_argcheck(state, spawner, 1, "cpp closure spawner not found.");
-                    if (spawner) {
-                        auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(state, sizeof(LuaClass<TCLASS, TAG>::UserDataDetail));
-                        if (uData)
-                        {
-                            auto obj = LuaInvoke<TCLASS*, SPAWNERFTYPE, ARGS...>(state, spawner, 0);
-                            if (obj)
-                            {
-                                uData->obj = obj;
-                                uData->dtor = nullptr;
-                                luaL_setmetatable(state, (LuaClass<TCLASS, TAG>::klassName));
-                                return 1;
-                            }
-                            lua_pop(state, 1);
-                        }
-                    }
-                    lua_pushnil(state);
-                    return 1;
-                }
-
-            };
-
-            luaaa_check_constructor_name_conflict(name);
-
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, klassName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-            }
-#endif
-            SPAWNERFTYPE * spawnerPtr = (SPAWNERFTYPE*)lua_newuserdata(m_state, sizeof(SPAWNERFTYPE));
-#if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(m_state, spawnerPtr != nullptr, 1, "faild to alloc mem to store spawner for ctor of cpp class");
-#else
-            luaL_argcheck(m_state, spawnerPtr != nullptr, 1, (std::string("faild to alloc mem to store spawner for ctor `") + name + "`").c_str());
-#endif
-            if (!spawnerPtr)
-            {
-                lua_pop(m_state, 1);
-                return (*this);
-            }
-
-            memset(spawnerPtr, 0, sizeof(SPAWNERFTYPE));
-            *spawnerPtr = spawner;
-
-            luaL_Reg constructor[] = { { name, HelperClass::f_new }, { nullptr, nullptr } };
-#if USE_NEW_MODULE_REGISTRY
-            luaL_setfuncs(m_state, constructor, 1);
-            lua_setglobal(m_state, klassName);
-#else
-            luaL_openlib(m_state, klassName, constructor, 1);
-#endif
-            return (*this);
-        }
-
-       
-#if !LUAAA_WITHOUT_CPP_STDLIB
-        template<typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& ctor(const std::string& name)
-        {
-            return ctor<ARGS...>(name.c_str());
-        }
-
-        template<typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& ctor(const std::string& name, TCLASS*(*spawner)(ARGS...)) {
-            return ctor(name.c_str(), spawner);
-        }
-
-        template<typename TRET, typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& ctor(const std::string& name, TCLASS*(*spawner)(ARGS...), TRET(*deleter)(TCLASS*)) {
-            return ctor(name.c_str(), spawner, deleter);
-        }
-
-        template<typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& ctor(const std::string& name, TCLASS*(*spawner)(ARGS...), std::nullptr_t) {
-            return ctor(name.c_str(), spawner, nullptr);
-        }
-#endif
-
-    private:
-        template<typename F>
-        inline LuaClass<TCLASS, TAG>& _registerClassFunction(const char* name, lua_CFunction caller, F f)
-        {
-            luaL_getmetatable(m_state, klassName);
-            if (strcmp(name, "__gc") == 0)
-            {
-                lua_pushstring(m_state, "!__gc");
-            }
-#if LUAAA_FEATURE_PROPERTY
-            else if (strcmp(name, "__index") == 0)
-            {
-                lua_pushstring(m_state, "!__index");
-            }
-            else if (strcmp(name, "__newindex") == 0)
-            {
-                lua_pushstring(m_state, "!__newindex");
-            }
-#endif
-            else
-            {
-                lua_pushstring(m_state, name);
-            }
-
-            F* funPtr = (F*)lua_newuserdata(m_state, sizeof(F));
-#if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(m_state, funPtr != nullptr, 1, "faild to alloc mem to store function");
-#else
-            luaL_argcheck(m_state, funPtr != nullptr, 1, (std::string("faild to alloc mem to store function `") + name + "`").c_str());
-#endif
-            if (funPtr)
-            {
-                memset(funPtr, 0, sizeof(F));
-                *funPtr = f;
-                lua_pushcclosure(m_state, caller, 1);
-                lua_settable(m_state, -3);
-                lua_pop(m_state, 1);
-            }
-            else
-            {
-                lua_pop(m_state, 2);
-            }
-            return (*this);
-        }
-
-    private:
-        template<typename F>
-        inline LuaClass<TCLASS, TAG>& _funImpl(const char * name, F f)
-        {
-            return _registerClassFunction(name, MemberFunctionCaller(f), f);
-        }
-
-    public:
-        template<typename FCLASS, typename FRET, typename ...FARGS>
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, FRET(FCLASS::*f)(FARGS...))
-        {
-            return _funImpl(name, f);
-        }
-
-        template<typename FCLASS, typename FRET, typename ...FARGS>
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, FRET(FCLASS::*f)(FARGS...) const)
-        {
-            return _funImpl(name, f);
-        }
-
-        template<typename FCLASS, typename ...FARGS>
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, void(FCLASS::*f)(FARGS...))
-        {
-            return _funImpl(name, f);
-        }
-
-        template<typename FCLASS, typename ...FARGS>
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, void(FCLASS::*f)(FARGS...) const)
-        {
-            return _funImpl(name, f);
-        }
-
-        template<typename FRET, typename ...FARGS>
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, FRET(*f)(FARGS...))
-        {
-            return _funImpl(name, f);
-        }
-
-        template<typename ...FARGS>
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, void(*f)(FARGS...))
-        {
-            return _funImpl(name, f);
-        }
-
-#if !LUAAA_WITHOUT_CPP_STDLIB
-        // register lambdas as lua class function
-        template<typename TRET, typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, const std::function<TRET(ARGS...)>& f)
-        {
-            return _funImpl<std::function<TRET(ARGS...)>>(name, f);
-        }
-
-        template<typename ...ARGS>
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, const std::function<void(ARGS...)>& f)
-        {
-            return _funImpl<std::function<void(ARGS...)>>(name, f);
-        }
-
-        template<typename F>
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, F f)
-        {
-            return fun(name, to_function(f));
-        }
-#endif
-
-        inline LuaClass<TCLASS, TAG>& fun(const char * name, lua_CFunction f)
-        {
-            luaL_getmetatable(m_state, klassName);
-            if (strcmp(name, "__gc") == 0)
-            {
-                lua_pushstring(m_state, "!__gc");
-            }
-#if LUAAA_FEATURE_PROPERTY
-            else if (strcmp(name, "__index") == 0)
-            {
-                lua_pushstring(m_state, "!__index");
-            }
-            else  if (strcmp(name, "__newindex") == 0)
-            {
-                lua_pushstring(m_state, "!__newindex");
-            }
-#endif
-            else
-            {
-                lua_pushstring(m_state, name);
-            }
-            lua_pushcclosure(m_state, f, 0);
-            lua_settable(m_state, -3);
-            lua_pop(m_state, 1);
-            return (*this);
-        }
-
-        template <typename V>
-        inline LuaClass<TCLASS, TAG>& def(const char * name, const V& val)
-        {
-            luaL_getmetatable(m_state, klassName);
-            lua_pushstring(m_state, name);
-            LuaStack<V>::put(m_state, val);
-            lua_settable(m_state, -3);
-            lua_pop(m_state, 1);
-            return (*this);
-        }
-
-        // disable cast from "const char [#]" to "char (*)[#]"
-        inline LuaClass<TCLASS, TAG>& def(const char* name, const char* str)
-        {
-            luaL_getmetatable(m_state, klassName);
-            lua_pushstring(m_state, name);
-            LuaStack<decltype(str)>::put(m_state, str);
-            lua_settable(m_state, -3);
-            lua_pop(m_state, 1);
-            return (*this);
-        }
-      
-    private:
-        template <typename F>
-        inline LuaClass<TCLASS, TAG>& _getterImpl(const char* name, lua_CFunction invoker, F f)
-        {
-#if LUAAA_FEATURE_PROPERTY
-            char internal_name[256];
-            snprintf(internal_name, sizeof(internal_name), "<%s", name);
-            return _registerClassFunction(internal_name, invoker, f);
-#else
-            return *this;
-#endif
-        }
-
-        template<typename F>
-        inline LuaClass<TCLASS, TAG>& _setterImpl(const char* name, lua_CFunction invoker, F f)
-        {
-#if LUAAA_FEATURE_PROPERTY
-            char internal_name[256];
-            snprintf(internal_name, sizeof(internal_name), ">%s", name);
-            return _registerClassFunction(internal_name, invoker, f);
-#else
-            return *this;
-#endif
-        }
-
-    public:
-        template<typename P>
-        inline LuaClass<TCLASS, TAG>& get(const char* name, P(*f)())
-        {
-            struct HelperClass {
-                typedef decltype(f) FTYPE;
-                static inline int Invoke(lua_State* state) {
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1)); 
-                    if (calleePtr)
-                    {
-                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))());
-                    }
-                    else
-                    {
-                        lua_pushnil(state);
-                    }
-                    return 1;
-                }
-            };
-            return _getterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename P>
-        inline LuaClass<TCLASS, TAG>& get(const char* name, P(*f)(const TCLASS&))
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1)));
-                    }
-                    else
-                    {
-                        lua_pushnil(state);
-                    }
-                    return 1;
-                }
-            };
-            return _getterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename P, typename FCLASS>
-        inline LuaClass<TCLASS, TAG>& get(const char* name, P(FCLASS::*f)()const)
-        {
-            static_assert(std::is_same<std::decay<TCLASS>, std::decay<FCLASS>>::value, "Error: prop function can be member function of only associated class");
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        LuaStackReturn<P>(state, (LuaStack<TCLASS>::get(state, 1).**(FTYPE*)(calleePtr))());
-                    }
-                    else
-                    {
-                        lua_pushnil(state);
-                    }
-                    return 1;
-                }
-            };
-            return _getterImpl(name, HelperClass::Invoke, f);
-        }
-
-
-        template<typename P, typename TRET>
-        inline LuaClass<TCLASS, TAG>& set(const char* name, TRET(*f)(P))
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        (*(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
-                    }
-                    return 0;
-                }
-            };
-            return _setterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename P, typename TRET, typename FCLASS>
-        inline LuaClass<TCLASS, TAG>& set(const char* name, TRET(FCLASS::* f)(P))
-        {
-            static_assert(std::is_same<std::decay<TCLASS>, std::decay<FCLASS>>::value, "prop function can be member function of only associated class");
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        (LuaStack<TCLASS>::get(state, 1).**(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
-                    }
-                    return 0;
-                }
-            };
-            return _setterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename P, typename TRET>
-        inline LuaClass<TCLASS, TAG>& set(const char* name, TRET(*f)(TCLASS&, P))
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1), LuaStack<P>::get(state, 3));
-                    }
-                    return 0;
-                }
-            };
-            return _setterImpl(name, HelperClass::Invoke, f);
-        }
-
-
-    public:
-#if !LUAAA_WITHOUT_CPP_STDLIB
-        // access prop from lambdas
-        template<typename P>
-        inline LuaClass<TCLASS, TAG>& get(const char* name, std::function<P()> f)
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))());
-                    }
-                    else
-                    {
-                        lua_pushnil(state);
-                    }
-                    return 1;
-                }
-            };
-            return _getterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename P>
-        inline LuaClass<TCLASS, TAG>& get(const char* name, std::function<P(const TCLASS&)> f)
-        {
-            struct HelperClass {
-                
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1)));
-                    }
-                    else
-                    {
-                        lua_pushnil(state);
-                    }
-                    return 1;
-                }
-            };
-            return _getterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename P>
-        inline LuaClass<TCLASS, TAG>& get(const char* name, std::function<P(TCLASS&)> f)
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1)));
-                    }
-                    else
-                    {
-                        lua_pushnil(state);
-                    }
-                    return 1;
-                }
-            };
-            return _getterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename F>
-        inline LuaClass<TCLASS, TAG>& get(const char* name, F f)
-        {
-            return get(name, to_class_getter_function<TCLASS>(f));
-        }
-
-        template<typename P, typename TRET>
-        inline LuaClass<TCLASS, TAG>& set(const char* name, std::function<TRET(P)> f)
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        (*(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
-                    }
-                    return 0;
-                }
-            };
-            return _setterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename P, typename TRET>
-        inline LuaClass<TCLASS, TAG>& set(const char* name, std::function<TRET(TCLASS&, P)> f)
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1), LuaStack<P>::get(state, 3));
-                    }
-                    return 0;
-                }
-            };
-            return _setterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename P, typename TRET>
-        inline LuaClass<TCLASS, TAG>& set(const char* name, std::function<TRET(const TCLASS&, P)> f)
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1), LuaStack<P>::get(state, 3));
-                    }
-                    return 0;
-                }
-            };
-            return _setterImpl(name, HelperClass::Invoke, f);
-        }
-
-        //template<typename F>
-        //inline LuaClass<TCLASS, TAG>& set(const char* name, std::function<F> f)
-        //{
-        //    //static_assert(false, "Error: invalid signature of setter function");
-        //    assert(!"Error: invalid signature of setter function");
-        //    return (*this);
-        //}
-
-        template<typename F>
-        inline LuaClass<TCLASS, TAG>& set(const char* name, F f)
-        {
-            return set(name, to_class_setter_function<TCLASS>(f));
-        }
-#endif
-
-    public:
-#if !LUAAA_WITHOUT_CPP_STDLIB
-        template <typename F>
-        inline LuaClass<TCLASS, TAG>& fun(const std::string& name, F f)
-        {
-            return fun(name.c_str(), f);
-        }
-
-        template <typename V>
-        inline LuaClass<TCLASS, TAG>& def(const std::string& name, const V& val)
-        {
-            return def(name.c_str(), val);
-        }
-
-        template <typename F>
-        inline LuaClass<TCLASS, TAG>& get(const std::string& name, F f)
-        {
-            return get(name.c_str(), f);
-        }
-
-        template <typename F>
-        inline LuaClass<TCLASS, TAG>& set(const std::string& name, F f)
-        {
-            return set(name.c_str(), f);
-        }
-#endif
-
-    private:
-        lua_State * m_state;
-
-    private:
-        static char * klassName;
-    };
-
-    template <typename TCLASS, int TAG> char * LuaClass<TCLASS, TAG>::klassName = nullptr;
-
-
-    // -----------------------------------
-    // export module
-    // -----------------------------------
-    struct LuaModule
-    {
-    public:
-        LuaModule(lua_State * state, const char * name = "_G")
-            : m_state(state)
-        {
-            size_t strBufLen = strlen(name) + 1;
-            m_moduleName = new char[strBufLen];
-            memcpy(m_moduleName, name, strBufLen);
-            def("__name", m_moduleName);
-        }
-
-#if !LUAAA_WITHOUT_CPP_STDLIB
-        LuaModule(lua_State * state, const std::string& name)
-            : LuaModule(state, name.empty() ? "_G" : name.c_str())
-        {}
-#endif
-
-        ~LuaModule()
-        {
-            if (m_moduleName) {
-                delete[] m_moduleName;
-                m_moduleName = nullptr;
-            }
-        }
-
-    private:
-        void _initMetaTable(lua_State * state, int idx) {
-            struct HelperClass {
-#if LUAAA_FEATURE_PROPERTY
-                static int f_internal_index(lua_State* state)
-                {
-                    const char* key = luaL_checkstring(state, 2);
-                    if (!key)
-                    {
-                        lua_pushnil(state);
-                        return 1;
-                    }
-                    // lookup module first
-                    lua_pushstring(state, key);
-                    lua_rawget(state, 1);
-                    if (!lua_isnil(state, -1))
-                    {
-                        return 1;
-                    }
-
-                    lua_pop(state, 1);
-
-                    // then lookup registered property
-                    char internal_name[256];
-                    snprintf(internal_name, sizeof(internal_name), "<%s", key);
-
-                    lua_getmetatable(state, 1);
-                    lua_pushstring(state, internal_name);
-                    lua_rawget(state, -2);
-                    if (lua_isfunction(state, -1))
-                    {
-                        lua_insert(state, 1);
-                        lua_pcall(state, lua_gettop(state) - 1, 1, 0);
-                    }
-                    else
-                    {
-                        // check if user defined __index method
-                        lua_pop(state, 3);
-                        lua_pushstring(state, "__index");
-                        lua_rawget(state, 1);
-                        if (lua_isfunction(state, -1))
-                        {
-                            lua_insert(state, 1);
-                            lua_pcall(state, lua_gettop(state) - 1, 1, 0);
-                        }
-                        else if (lua_istable(state, -1))
-                        {
-                            lua_replace(state, 1);
-                            lua_rawget(state, 1);
-                        }
-                        else
-                        {
-                            // no custom __index
-                            lua_getmetatable(state, 1);
-                            snprintf(internal_name, sizeof(internal_name), ">%s", key);
-                            lua_pushstring(state, internal_name);
-                            lua_rawget(state, -2);
-                            if (lua_isfunction(state, -1))
-                            {
-                                lua_pushstring(state, "__name");
-                                lua_rawget(state, -3);
-                                luaL_error(state, "attempt to read Write-Only property '%s' of '%s'", luaL_optstring(state, -1, "?"));
-                            }
-                            else
-                            {
-                                // do nothing here. nil will be return.
-                                // luaL_error(state, "attempt to access Non-existing property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
-                            }
-                        }
-                    }
-                    return 1;
-                }
-
-                static int f_internal_newindex(lua_State* state)
-                {
-                    const char* key = luaL_checkstring(state, 2);
-                    if (!key)
-                    {
-                        lua_pushnil(state);
-                        return 1;
-                    }
-
-                    char internal_name[256];
-                    snprintf(internal_name, sizeof(internal_name), ">%s", key);
-
-                    lua_getmetatable(state, 1);
-                    lua_pushstring(state, internal_name);
-                    lua_rawget(state, -2);
-                    if (lua_isfunction(state, -1))
-                    {
-                        lua_insert(state, 1);
-                        lua_pcall(state, lua_gettop(state) - 1, 0, 0);
-                    }
-                    else
-                    {
-                        lua_pop(state, 1);
-                        snprintf(internal_name, sizeof(internal_name), "<%s", key);
-                        lua_pushstring(state, internal_name);
-                        lua_rawget(state, -2);
-                        if (lua_isfunction(state, -1))
-                        {
-                            luaL_error(state, "attempt to write Read-Only property '%s' of '?'", key);
-                        }
-                        else
-                        {
-                            lua_pop(state, 2);
-                            // no associated property, lookup current module
-                            if (lua_istable(state, 1))
-                            {
-                                // check if user defined __newindex
-                                lua_pushstring(state, "__newindex");
-                                lua_rawget(state, 1);
-                                if (lua_isfunction(state, -1))
-                                {
-                                    lua_insert(state, 1);
-                                    lua_pcall(state, lua_gettop(state) - 1, 0, 0);
-                                }
-                                else if (lua_istable(state, -1))
-                                {
-                                    lua_replace(state, 1);
-                                    lua_rawset(state, 1);
-                                }
-                                else
-                                {
-                                    // no custom __newindex
-                                    lua_pop(state, 1);
-                                    lua_rawset(state, 1);
-                                }
-                            }
-                        }
-                    }
-                    return 0;
-                }
-#endif
-            };
-
-            luaL_newmetatable(state, m_moduleName);
-            luaL_Reg objfunc[] = {
-#if LUAAA_FEATURE_PROPERTY
-                { "__index", HelperClass::f_internal_index },
-                { "__newindex", HelperClass::f_internal_newindex },
-#endif
-                { nullptr, nullptr }
-            };
-            luaL_setfuncs(state, objfunc, 0);
-            lua_setmetatable(state, -2);
-        }
-
-        template<typename F>
-        inline LuaModule& _registerModuleFunction(const char* name, lua_CFunction caller, F f) {
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, m_moduleName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-                _initMetaTable(m_state, -1);
-            }
-
-            F* funPtr = (F*)lua_newuserdata(m_state, sizeof(F));
-#   if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(m_state, funPtr != nullptr, 1, "faild to alloc mem to store function of module");
-#   else
-            luaL_argcheck(m_state, funPtr != nullptr, 1, (std::string("faild to alloc mem to store function `") + name + "`").c_str());
-#   endif
-            if (!funPtr)
-            {
-                lua_pop(m_state, 2);
-                return (*this);
-            }
-
-            memset(funPtr, 0, sizeof(F));
-            *funPtr = f;
-
-            lua_pushvalue(m_state, -1);
-            lua_pushcclosure(m_state, caller, 1);
-            lua_pushstring(m_state, name);
-            lua_insert(m_state, -2);
-            lua_rawset(m_state, -4);
-            lua_pop(m_state, 1);
-            lua_setglobal(m_state, m_moduleName);
-#else
-            luaL_Reg regtab[] = { { name, caller },{ nullptr, nullptr } };
-            F* funPtr = (F*)lua_newuserdata(m_state, sizeof(F));
-#   if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(m_state, funPtr != nullptr, 1, "faild to alloc mem to store function of module");
-#   else
-            luaL_argcheck(m_state, funPtr != nullptr, 1, (std::string("faild to alloc mem to store function `") + name + "`").c_str());
-#   endif
-            if (funPtr)
-            {
-                memset(funPtr, 0, sizeof(F));
-                *funPtr = f;
-                luaL_openlib(m_state, m_moduleName, regtab, 1);
-            }
-#endif
-            return (*this);
-        }
-
-        template<typename F>
-        inline LuaModule& _funImpl(const char * name, F f)
-        {
-            return _registerModuleFunction(name, NonMemberFunctionCaller(f), f);
-        }
-
-    public:
-        template<typename FRET, typename ...FARGS>
-        inline LuaModule& fun(const char * name, FRET(*f)(FARGS...))
-        {
-            return _funImpl(name, f);
-        }
-
-        template<typename ...FARGS>
-        inline LuaModule& fun(const char * name, void(*f)(FARGS...))
-        {
-            return _funImpl(name, f);
-        }
-
-#if !LUAAA_WITHOUT_CPP_STDLIB
-        template<typename TRET, typename ...ARGS>
-        inline LuaModule& fun(const char * name, const std::function<TRET(ARGS...)>& f)
-        {
-            return _funImpl<std::function<TRET(ARGS...)>>(name, f);
-        }
-
-        template<typename ...ARGS>
-        inline LuaModule& fun(const char * name, const std::function<void(ARGS...)>& f)
-        {
-            return _funImpl<std::function<void(ARGS...)>>(name, f);
-        }
-
-        template<typename F>
-        inline LuaModule& fun(const char * name, F f)
-        {
-            return fun(name, to_function(f));
-        }
-#endif
-
-        inline LuaModule& fun(const char * name, lua_CFunction f)
-        {
-            
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, m_moduleName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-                _initMetaTable(m_state, -1);
-            }
-            lua_pushcclosure(m_state, f, 0);
-            lua_pushstring(m_state, name);
-            lua_insert(m_state, -2);
-            lua_rawset(m_state, -3);
-            lua_setglobal(m_state, m_moduleName);
-#else
-            luaL_Reg regtab[] = { { name, f },{ nullptr, nullptr } };
-            luaL_openlib(m_state, m_moduleName, regtab, 0);
-#endif
-            return (*this);
-        }
-
-        template <typename V>
-        inline LuaModule& def(const char * name, const V& val)
-        {
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, m_moduleName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-                _initMetaTable(m_state, -1);
-            }
-            LuaStack<V>::put(m_state, val);
-            lua_pushstring(m_state, name);
-            lua_insert(m_state, -2);
-            lua_rawset(m_state, -3);
-            lua_setglobal(m_state, m_moduleName);
-#else
-            luaL_Reg regtab = { nullptr, nullptr };
-            luaL_openlib(m_state, m_moduleName, &regtab, 0);
-            LuaStack<V>::put(m_state, val);
-            lua_pushstring(m_state, name);
-            lua_insert(m_state, -2);
-            lua_rawset(m_state, -3);
-#endif
-            return (*this);
-        }
-
-        template <typename TCLASS, int TAG>
-        inline LuaModule& def(const char* name, const luaaa::LuaClass<TCLASS, TAG>&, const TCLASS* obj = nullptr, void(*deleter)(TCLASS*) = nullptr)
-        {
-            typename LuaClass<TCLASS, TAG>::UserDataDetail userData{};
-            if (obj)
-            {
-                userData.obj = const_cast<TCLASS*>(obj);
-                if (deleter)
-                {
-                    struct HelperClass
-                    {
-                        static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail* uData) {
-                            typedef decltype(deleter) DELETERFTYPE;
-                            if (uData && uData->obj && uData->free_func)
-                            {
-                                ((DELETERFTYPE)(uData->free_func))(uData->obj);
-                                uData->obj = nullptr;
-                            }
-                            return 0;
-                        }
-                    };
-
-                    userData.dtor = HelperClass::f_dtor;
-                    userData.free_func = (void*)(deleter);
-                }
-                else
-                {
-                    userData.dtor = nullptr;
-                    userData.free_func = nullptr;
-                }
-            }
-            else
-            {
-                struct HelperClass
-                {
-                    static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail* uData)
-                    {
-                        if (uData && uData->obj)
-                        {
-                            delete uData->obj;
-                            uData->obj = nullptr;
-                        }
-                        return 0;
-                    }
-                };
-                userData.obj = new TCLASS;
-                userData.dtor = HelperClass::f_dtor;
-                userData.free_func = nullptr;
-            }
-
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, m_moduleName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-                _initMetaTable(m_state, -1);
-            }
-            auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(m_state, sizeof(typename LuaClass<TCLASS, TAG>::UserDataDetail));
-#if LUAAA_WITHOUT_CPP_STDLIB
-            luaL_argcheck(m_state, uData != nullptr, 1, "faild to alloc mem to store object");
-#else
-            luaL_argcheck(m_state, uData != nullptr, 1, (std::string("faild to alloc mem to store object `") + name + "`").c_str());
-#endif
-            if (uData)
-            {
-                uData->obj = userData.obj;
-                uData->dtor = userData.dtor;
-                uData->free_func = userData.free_func;
-                luaL_setmetatable(m_state, (LuaClass<TCLASS, TAG>::klassName));
-                lua_pushstring(m_state, name);
-                lua_insert(m_state, -2);
-                lua_rawset(m_state, -3);
-                lua_setglobal(m_state, m_moduleName);
-            }
-            else
-            {
-                lua_pop(m_state, 2);
-            }
-#else
-            luaL_Reg regtab = { nullptr, nullptr };
-            luaL_openlib(m_state, m_moduleName, &regtab, 0);
-            auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(m_state, sizeof(typename LuaClass<TCLASS, TAG>::UserDataDetail));
-            if (uData)
-            {
-                uData->obj = userData.obj;
-                uData->dtor = userData.dtor;
-                uData->free_func = userData.free_func;
-                luaL_setmetatable(m_state, (LuaClass<TCLASS, TAG>::klassName));
-                lua_pushstring(m_state, name);
-                lua_insert(m_state, -2);
-                lua_rawset(m_state, -3);
-            }
-            else
-            {
-                lua_pop(m_state, 1);
-            }
-#endif
-            return (*this);
-        }
-
-        template <typename V>
-        inline LuaModule& def(const char * name, const V val[], size_t length)
-        {
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, m_moduleName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-                _initMetaTable(m_state, -1);
-            }
-            lua_newtable(m_state);
-            for (size_t idx = 0; idx < length; ++idx)
-            {
-                LuaStack<V>::put(m_state, val[idx]);
-                lua_rawseti(m_state, -2, idx + 1);
-            }
-            lua_pushstring(m_state, name);
-            lua_insert(m_state, -2);
-            lua_rawset(m_state, -3);
-            lua_setglobal(m_state, m_moduleName);
-#else
-            luaL_Reg regtab = { nullptr, nullptr };
-            luaL_openlib(m_state, m_moduleName, &regtab, 0);
-            lua_newtable(m_state);
-            for (size_t idx = 0; idx < length; ++idx)
-            {
-                LuaStack<V>::put(m_state, val[idx]);
-                lua_rawseti(m_state, -2, idx + 1);
-            }
-            lua_pushstring(m_state, name);
-            lua_insert(m_state, -2);
-            lua_rawset(m_state, -3);
-#endif
-            return (*this);
-        }
-
-        // disable the cast from "const char [#]" to "char (*)[#]"
-        inline LuaModule& def(const char * name, const char * str)
-        {
-#if USE_NEW_MODULE_REGISTRY
-            lua_getglobal(m_state, m_moduleName);
-            if (lua_isnil(m_state, -1))
-            {
-                lua_pop(m_state, 1);
-                lua_newtable(m_state);
-                _initMetaTable(m_state, -1);
-            }
-            LuaStack<decltype(str)>::put(m_state, str);
-            lua_pushstring(m_state, name);
-            lua_insert(m_state, -2);
-            lua_rawset(m_state, -3);
-            lua_setglobal(m_state, m_moduleName);
-#else
-            luaL_Reg regtab = { nullptr, nullptr };
-            luaL_openlib(m_state, m_moduleName, &regtab, 0);
-            LuaStack<decltype(str)>::put(m_state, str);
-            lua_pushstring(m_state, name);
-            lua_insert(m_state, -2);
-            lua_rawset(m_state, -3);
-#endif
-            return (*this);
-        }
-
-#if !LUAAA_WITHOUT_CPP_STDLIB
-        template<typename F>
-        inline LuaModule& fun(const std::string& name, F f)
-        {
-            return fun(name.c_str(), f);
-        }
-
-        template <typename V>
-        inline LuaModule& def(const std::string& name, const V& val)
-        {
-            return def(name.c_str(), val);
-        }
-#endif
-
-    private:
-        template <typename F>
-        inline LuaModule& _getterImpl(const char* name, lua_CFunction invoker, F f)
-        {
-#if LUAAA_FEATURE_PROPERTY
-            char internal_name[256];
-            snprintf(internal_name, sizeof(internal_name), "<%s", name);
-            return _registerModuleFunction(internal_name, invoker, f);
-#else
-            return *this;
-#endif
-        }
-
-        template<typename F>
-        inline LuaModule& _setterImpl(const char* name, lua_CFunction invoker, F f)
-        {
-#if LUAAA_FEATURE_PROPERTY
-            char internal_name[256];
-            snprintf(internal_name, sizeof(internal_name), ">%s", name);
-            return _registerModuleFunction(internal_name, invoker, f);
-#else
-            return *this;
-#endif
-        }
-
-    public:
-        template<typename P>
-        inline LuaModule& get(const char* name, P(*f)())
-        {
-            static_assert(!std::is_void<P>::value, "Error: getter function must return a value.");
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))());
-                    }
-                    else
-                    {
-                        lua_pushnil(state);
-                    }
-                    return 1;
-                }
-            };
-            return _getterImpl(name, HelperClass::Invoke, f);
-        }
-
-        template<typename P, typename TRET>
-        inline LuaModule& set(const char* name, TRET(*f)(P))
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        (*(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
-                    }
-                    return 0;
-                }
-            };
-            return _setterImpl(name, HelperClass::Invoke, f);
-        }
-
-    public:
-#if !LUAAA_WITHOUT_CPP_STDLIB
-        // access prop from lambdas
-        template<typename P>
-        inline LuaModule& get(const char* name, std::function<P()> f)
-        {
-            static_assert(!std::is_void<P>::value, "Error: getter function must return a value.");
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))());
-                    }
-                    else
-                    {
-                        lua_pushnil(state);
-                    }
-                    return 1;
-                }
-            };
-            return _getterImpl(name, HelperClass::Invoke, f);
-        }
-
-        // template<typename F>
-        // inline LuaModule& get(const char* name, std::function<F> f)
-        // {
-        //     //static_assert(false, "Error: invalid signature of getter function");
-        //     assert(!"Error: invalid signature of getter function");
-        //     return (*this);
-        // }
-
-        template<typename F>
-        inline LuaModule& get(const char* name, F f)
-        {
-            return get(name, to_module_getter_function(f));
-        }
-
-        template<typename P, typename TRET>
-        inline LuaModule& set(const char* name, std::function<TRET(P)> f)
-        {
-            struct HelperClass {
-                static inline int Invoke(lua_State* state) {
-                    typedef decltype(f) FTYPE;
-                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
-                    if (calleePtr)
-                    {
-                        (*(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
-                    }
-                    return 0;
-                }
-            };
-            return _setterImpl(name, HelperClass::Invoke, f);
-        }
-
-        // template<typename F>
-        // inline LuaModule& set(const char* name, std::function<F> f)
-        // {
-        //     //static_assert(std::false_type::value, "Error: invalid signature of setter function");
-        //     //assert(!"Error: invalid signature of setter function");
-        //     return (*this);
-        // }
-
-        template<typename F>
-        inline LuaModule& set(const char* name, F f)
-        {
-            return set(name, to_module_setter_function(f));
-        }
-
-        template <typename F>
-        inline LuaModule& get(const std::string& name, F f)
-        {
-            return get(name.c_str(), f);
-        }
-
-        template <typename F>
-        inline LuaModule& set(const std::string& name, F f)
-        {
-            return set(name.c_str(), f);
-        }
-#endif
-
-    private:
-        lua_State * m_state;
-        char * m_moduleName;
-    };
-
-}
-
-
-
-#if !LUAAA_WITHOUT_CPP_STDLIB
-
-#include <array>
-#include <vector>
-#include <deque>
-#include <list>
-#include <forward_list>
-#include <set>
-#include <map>
-#include <unordered_set>
-#include <unordered_map>
-#include <tuple>
-
-namespace LUAAA_NS
-{
-    // array
-    template<typename K, size_t N>
-    struct LuaStack<std::array<K, N>>
-    {
-        typedef std::array<K, N> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                int index = 0;
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx) && index < N)
-                {
-                    result[index++] = LuaStack<typename Container::value_type>::get(L, lua_gettop(L));
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            int index = 1;
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::value_type>::put(L, *it);
-                lua_rawseti(L, -2, index++);
-            }
-        }
-    };
-
-    // vector
-    template<typename K, typename ...ARGS>
-    struct LuaStack<std::vector<K, ARGS...>>
-    {
-        typedef std::vector<K, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    result.push_back(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            int index = 1;
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::value_type>::put(L, *it);
-                lua_rawseti(L, -2, index++);
-            }
-        }
-    };
-
-    // deque
-    template<typename K, typename ...ARGS>
-    struct LuaStack<std::deque<K, ARGS...>>
-    {
-        typedef std::deque<K, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    result.push_back(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            int index = 1;
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::value_type>::put(L, *it);
-                lua_rawseti(L, -2, index++);
-            }
-        }
-    };
-
-    // list
-    template<typename K, typename ...ARGS>
-    struct LuaStack<std::list<K, ARGS...>>
-    {
-        typedef std::list<K, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    result.push_back(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            int index = 1;
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::value_type>::put(L, *it);
-                lua_rawseti(L, -2, index++);
-            }
-        }
-    };
-
-    // forward_list
-    template<typename K, typename ...ARGS>
-    struct LuaStack<std::forward_list<K, ARGS...>>
-    {
-        typedef std::forward_list<K, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    result.push_back(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            int index = 1;
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::value_type>::put(L, *it);
-                lua_rawseti(L, -2, index++);
-            }
-        }
-    };
-
-    // set
-    template<typename K, typename ...ARGS>
-    struct LuaStack<std::set<K, ARGS...>>
-    {
-        typedef std::set<K, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    result.insert(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            int index = 1;
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::value_type>::put(L, *it);
-                lua_rawseti(L, -2, index++);
-            }
-        }
-    };
-
-    // multiset
-    template<typename K, typename ...ARGS>
-    struct LuaStack<std::multiset<K, ARGS...>>
-    {
-        typedef std::multiset<K, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    result.insert(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            int index = 1;
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::value_type>::put(L, *it);
-                lua_rawseti(L, -2, index++);
-            }
-        }
-    };
-
-    // unordered_set
-    template<typename K, typename ...ARGS>
-    struct LuaStack<std::unordered_set<K, ARGS...>>
-    {
-        typedef std::unordered_set<K, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    result.insert(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            int index = 1;
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::value_type>::put(L, *it);
-                lua_rawseti(L, -2, index++);
-            }
-        }
-    };
-
-    // unordered_multiset
-    template<typename K, typename ...ARGS>
-    struct LuaStack<std::unordered_multiset<K, ARGS...>>
-    {
-        typedef std::unordered_multiset<K, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    result.insert(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            int index = 1;
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::value_type>::put(L, *it);
-                lua_rawseti(L, -2, index++);
-            }
-        }
-    };
-
-    // map
-    template<typename K, typename V, typename ...ARGS>
-    struct LuaStack<std::map<K, V, ARGS...>>
-    {
-        typedef std::map<K, V, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    const int top = lua_gettop(L);
-                    result[LuaStack<typename Container::key_type>::get(L, top - 1)] = LuaStack<typename Container::mapped_type>::get(L, top);
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::key_type>::put(L, it->first);
-                LuaStack<typename Container::mapped_type>::put(L, it->second);
-                lua_rawset(L, -3);
-            }
-        }
-    };
-
-    // multimap
-    template<typename K, typename V, typename ...ARGS>
-    struct LuaStack<std::multimap<K, V, ARGS...>>
-    {
-        typedef std::multimap<K, V, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    const int top = lua_gettop(L);
-                    result[LuaStack<typename Container::key_type>::get(L, top - 1)] = LuaStack<typename Container::mapped_type>::get(L, top);
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::key_type>::put(L, it->first);
-                LuaStack<typename Container::mapped_type>::put(L, it->second);
-                lua_rawset(L, -3);
-            }
-        }
-    };
-
-    // unordered_map
-    template<typename K, typename V, typename ...ARGS>
-    struct LuaStack<std::unordered_map<K, V, ARGS...>>
-    {
-        typedef std::unordered_map<K, V, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    const int top = lua_gettop(L);
-                    result[LuaStack<typename Container::key_type>::get(L, top - 1)] = LuaStack<typename Container::mapped_type>::get(L, top);
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::key_type>::put(L, it->first);
-                LuaStack<typename Container::mapped_type>::put(L, it->second);
-                lua_rawset(L, -3);
-            }
-        }
-    };
-
-    // unordered_multimap
-    template<typename K, typename V, typename ...ARGS>
-    struct LuaStack<std::unordered_multimap<K, V, ARGS...>>
-    {
-        typedef std::unordered_multimap<K, V, ARGS...> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                lua_pushnil(L);
-                while (0 != lua_next(L, idx))
-                {
-                    const int top = lua_gettop(L);
-                    result[LuaStack<typename Container::key_type>::get(L, top - 1)] = LuaStack<typename Container::mapped_type>::get(L, top);
-                    lua_pop(L, 1);
-                }
-            }
-            return result;
-        }
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            for (auto it = s.begin(); it != s.end(); ++it)
-            {
-                LuaStack<typename Container::key_type>::put(L, it->first);
-                LuaStack<typename Container::mapped_type>::put(L, it->second);
-                lua_rawset(L, -3);
-            }
-        }
-    };
-
-    // std::pair
-    template<typename U, typename V>
-    struct LuaStack<std::pair<U, V>>
-    {
-        typedef std::pair<U, V> Container;
-        inline static Container get(lua_State * L, int idx)
-        {
-            Container result;
-            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-            if (lua_istable(L, idx))
-            {
-                result.first = LuaStack<typename Container::first_type>::get(L, idx + 1);
-                result.second = LuaStack<typename Container::second_type>::get(L, idx + 2);
-            }
-            return result;
-        }
-
-        inline static void put(lua_State * L, const Container& s)
-        {
-            lua_newtable(L);
-            LuaStack<typename Container::first_type>::put(L, s.first);
-            lua_rawseti(L, -2, 1);
-            LuaStack<typename Container::second_type>::put(L, s.second);
-            lua_rawseti(L, -2, 2);
-        }
-    };
- 
-    // std::tuple 
-#if __cplusplus >= 201402 || _MSVC_LANG >= 201402
-    template <typename> struct is_tuple : std::false_type {};
-    template <typename ...T> struct is_tuple<std::tuple<T...>> : std::true_type {};
-
-    template<typename Tuple, std::size_t ...Index, typename = typename std::enable_if<is_tuple<Tuple>::value>::type>
-    inline void load_tuple_from_lua_table(lua_State* L, int idx, Tuple& tuple, std::index_sequence<Index...>)
-    {
-        luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
-        if (lua_istable(L, idx))
-        {
-            lua_pushnil(L);
-            (void)std::initializer_list<int>{(
-                lua_next(L, idx) && (std::get<Index>(tuple) = LuaStack<decltype(std::get<Index>(tuple))>::get(L, lua_gettop(L)), 1) && (lua_pop(L, 1), 1),
-                0)...};
-        }
-    }
-
-    template<typename Tuple, std::size_t ...Index, typename = typename std::enable_if<is_tuple<Tuple>::value>::type>
-    inline void save_tuple_to_lua_table(lua_State* L, const Tuple& tuple, std::index_sequence<Index...>)
-    {
-        lua_newtable(L);
-        (void)std::initializer_list<int>{(
-            LuaStack<decltype(std::get<Index>(tuple))>::put(L, std::get<Index>(tuple)),
-            lua_rawseti(L, -2, Index + 1),
-            0)...};
-    }
-
-    template<typename ...TS> 
-    struct LuaStack<std::tuple<TS...>>
-    {
-        typedef std::tuple<TS...> Container;
-        inline static Container get(lua_State* L, int idx)
-        {
-            Container result;
-            load_tuple_from_lua_table(L, idx, result, std::make_index_sequence<std::tuple_size<Container>::value>{});
-            return result;
-        }
-
-        inline static void put(lua_State* L, const Container& s)
-        {
-            save_tuple_to_lua_table(L, s, std::make_index_sequence<std::tuple_size<Container>::value>{});
-        }
-    };
-#elif __cplusplus
-    template <typename T, size_t N>
-    struct TupleAccessor
-    {
-        static void get(lua_State* L, int idx, T& tuple)
-        {
-            TupleAccessor<T, N - 1>::get(L, idx, tuple);
-            if (lua_next(L, idx))
-            {
-                const int top = lua_gettop(L);
-                std::get<N - 1>(tuple) = LuaStack<typename std::tuple_element<N - 1, T>::type>::get(L, top);
-                lua_pop(L, 1);
-            }
-        }
-
-        static void put(lua_State* L, const T& tuple) {
-            TupleAccessor<T, N - 1>::put(L, tuple);
-            LuaStack<typename std::tuple_element<N - 1, T>::type>::put(L, std::get<N - 1>(tuple));
-            lua_rawseti(L, -2, N);
-        }
-    };
-
-    template <typename T>
-    struct TupleAccessor<T, 1>
-    {
-        static void get(lua_State* L, int idx, T& tuple)
-        {
-            if (lua_next(L, idx))
-            {
-                const int top = lua_gettop(L);
-                std::get<0>(tuple) = LuaStack<decltype(std::get<0>(tuple))>::get(L, top);
-                lua_pop(L, 1);
-            }
-        }
-
-        static void put(lua_State* L, const T& tuple) {
-            LuaStack<typename std::tuple_element<0, T>::type>::put(L, std::get<0>(tuple));
-            lua_rawseti(L, -2, 1);
-        }
-    };
-
-    template <typename T>
-    struct TupleAccessor<T, 0>
-    {
-        static void get(lua_State*, int, T&) {}
-        static void put(lua_State*, const T&) {}
-    };
-
-    template<typename ...TS> 
-    struct LuaStack<std::tuple<TS...>>
-    {
-        typedef std::tuple<TS...> Container;
-        inline static Container get(lua_State* L, int idx)
-        {
-            Container result;
-            lua_pushnil(L);
-            TupleAccessor<Container, std::tuple_size<Container>::value>::get(L, idx, result);
-            return result;
-        }
-
-        inline static void put(lua_State* L, const Container& s)
-        {
-            lua_newtable(L);
-            TupleAccessor<Container, std::tuple_size<Container>::value>::put(L, s);
-        }
-    };
-#endif
-
-}
-
-#endif //#if !LUAAA_WITHOUT_CPP_STDLIB
-
-#endif
-
+
+/*
+ Copyright (c) 2019 gengyong
+ https://github.com/gengyong/luaaa
+ licensed under MIT License.
+*/
+
+#ifndef HEADER_LUAAA_HPP
+#define HEADER_LUAAA_HPP
+
+#define LUAAA_NS luaaa
+#define LUAAA_VER_MAJOR (1)
+#define LUAAA_VER_MINOR (4)
+
+/// if you want to disable C++ std libs, set to 1
+#ifndef LUAAA_WITHOUT_CPP_STDLIB
+#define LUAAA_WITHOUT_CPP_STDLIB 0
+#endif
+
+#ifndef LUAAA_DEBUG
+#define LUAAA_DEBUG 0
+#endif
+
+/// set to 1 to bind every function with luaaa::unchecked policy by default.
+/// unchecked bindings read args without type check or coercion, only for trusted scripts.
+/// they are turned back to checked bindings unless NDEBUG is defined and LUAAA_DEBUG is 0.
+#ifndef LUAAA_UNCHECKED
+#define LUAAA_UNCHECKED 0
+#endif
+
+/// enable to check LuaClass constructor name conflict
+/// exposed constructor should have unique name, otherwise the early one will be overwriten. 
+#ifndef LUAAA_CHECK_CONSTRUCTOR_NAME_CONFLICT
+#define LUAAA_CHECK_CONSTRUCTOR_NAME_CONFLICT 1
+#endif
+
+#ifndef LUAAA_FEATURE_PROPERTY
+#define LUAAA_FEATURE_PROPERTY 1
+#endif
+
+/// nesting limit of tables copied by luaaa::transfer.
+#ifndef LUAAA_TRANSFER_MAX_DEPTH
+#define LUAAA_TRANSFER_MAX_DEPTH 128
+#endif
+
+extern "C"
+{
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+}
+
+#if !defined LUA_VERSION_NUM || LUA_VERSION_NUM <= 501
+inline void luaL_setfuncs(lua_State * L, const luaL_Reg * l, int nup) {
+    luaL_checkstack(L, nup + 1, "too many upvalues");
+    for (; l->name != nullptr; l++) {
+        int i;
+        lua_pushstring(L, l->name);
+        for (i = 0; i < nup; i++)
+            lua_pushvalue(L, -(nup + 1));
+        lua_pushcclosure(L, l->func, nup);
+        lua_settable(L, -(nup + 3));
+    }
+    lua_pop(L, nup);
+}
+
+inline void luaL_setmetatable(lua_State * L, const char * tname) {
+    luaL_getmetatable(L, tname);
+    lua_setmetatable(L, -2);
+}
+
+inline void lua_getuservalue(lua_State * L, int idx) {
+    lua_getfenv(L, idx);
+}
+
+inline void lua_setuservalue(lua_State * L, int idx) {
+    lua_setfenv(L, idx);
+}
+
+inline size_t lua_rawlen(lua_State * L, int idx) {
+    return lua_objlen(L, idx);
+}
+
+inline void * luaL_testudata(lua_State * L, int ud, const char * tname) {
+    void * p = lua_touserdata(L, ud);
+    if (p != nullptr && lua_getmetatable(L, ud)) {
+        luaL_getmetatable(L, tname);
+        if (!lua_rawequal(L, -1, -2))
+            p = nullptr;
+        lua_pop(L, 2);
+        return p;
+    }
+    return nullptr;
+}
+
+inline int lua_absindex(lua_State * L, int idx) {
+    return (idx > 0 || idx <= LUA_REGISTRYINDEX) ? idx : lua_gettop(L) + idx + 1;
+}
+#endif
+
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM > 501 && !defined(LUA_COMPAT_MODULE)
+#	define USE_NEW_MODULE_REGISTRY 1
+#else
+#	define USE_NEW_MODULE_REGISTRY 0
+#endif
+
+#include <cassert>
+#include <typeinfo>
+#include <utility>
+
+#if defined(_MSC_VER)
+#   define RTTI_CLASS_NAME(a) typeid(a).name() //vc always has this operator even if RTTI was disabled.
+#elif __GXX_RTTI
+#   define RTTI_CLASS_NAME(a) typeid(a).name()
+#elif _HAS_STATIC_RTTI
+#   define RTTI_CLASS_NAME(a) typeid(a).name()
+#else
+#   define RTTI_CLASS_NAME(a) "?"
+#endif
+
+#include <cstdlib>
+
+#if LUAAA_WITHOUT_CPP_STDLIB
+#   include <type_traits>
+#   include <cstring>
+#else
+#   if defined(__GNUC__)
+#       include <cstring>
+#   endif
+#   include <string>
+#   include <functional>
+#   include <mutex>
+#   include <atomic>
+#   include <stdexcept>
+#endif
+
+#if LUAAA_DEBUG
+inline size_t LUAAA_DUMP_OBJECT(char* buffer, size_t buflen, lua_State * L, int idx, int indent=0) {
+    char prefix[32] = {0};
+    if (indent > sizeof(prefix) - 1) {
+        indent = sizeof(prefix) - 1;
+    }
+    for (int i = 0; i < indent; i++) {
+        prefix[i] = '\t';
+    }
+    switch (lua_type(L, idx)) {
+    default:
+        return snprintf(buffer, buflen, "<%s>(%p)", luaL_typename(L, idx), lua_topointer(L, idx));
+    case LUA_TNUMBER:
+    case LUA_TSTRING:
+        return snprintf(buffer, buflen, "\"%s\"", lua_tostring(L, idx));
+    case LUA_TBOOLEAN:
+        return snprintf(buffer, buflen, "%s", (lua_toboolean(L, idx) ? "true" : "false"));
+    case LUA_TNIL:
+        return snprintf(buffer, buflen, "%s", "nil");
+    case LUA_TTABLE:
+        int ret = 0;
+        if (luaL_getmetafield(L, idx, "__name")) {
+            ret = snprintf(buffer, buflen, "<%s>(%p):", lua_tostring(L, -1), lua_topointer(L, idx));
+            lua_pop(L, 1);
+        } else {
+            ret = snprintf(buffer, buflen, "<%s>(%p):", luaL_typename(L, idx), lua_topointer(L, idx));
+        }
+        if (ret > 0) {
+            size_t wrote = ret;
+            lua_pushnil(L);
+            while (lua_next(L, idx)) {
+                const int top = lua_gettop(L);
+                if (buflen > wrote) {
+                    ret = snprintf(buffer + wrote, buflen - wrote, "\n%s", prefix);
+                    if (ret > 0) {
+                        wrote += ret;
+                    }
+                }
+
+                if (buflen > wrote) {
+                    lua_pushvalue(L, top - 1);
+                    ret = snprintf(buffer + wrote, buflen - wrote, "\"%s\":", lua_tostring(L, -1));
+                    lua_pop(L, 1);
+                    if (ret > 0) {
+                        wrote += ret;
+                    }
+                }
+
+                if (buflen > wrote) {
+                    if (lua_topointer(L, top) == lua_topointer(L, idx)) {
+                        ret = snprintf(buffer + wrote, buflen - wrote, "<self>(%p)", lua_topointer(L, top));
+                    } else {
+                        if (indent < 3)
+                        {
+                            ret = LUAAA_DUMP_OBJECT(buffer + wrote, buflen - wrote, L, top, indent + 1);
+                        }
+                        else
+                        {
+                            ret = snprintf(buffer + wrote, buflen - wrote, "...");
+                        }
+                    }
+                    if (ret > 0) {
+                        wrote += ret;
+                    }
+                }
+                lua_pop(L, 1);
+            }
+            //lua_pop(L, 0);
+            return wrote;
+        }
+    }
+    return 0;
+}
+
+inline void LUAAA_DUMP(lua_State * L, const char * name = "") {
+    printf(">>>>>>>>>>>>>>>>>>>>>>>>>[%s]\n", name);
+    char buffer[4096] = {0};
+    int top = lua_gettop(L);
+    for (int i = 1; i <= top; i++) {
+        LUAAA_DUMP_OBJECT(buffer, sizeof(buffer) - 1, L, i, 1);
+        printf("%d\t%s\n", i, buffer);
+    }
+    printf("<<<<<<<<<<<<<<<<<<<<<<<<<\n");
+}
+#else
+# define LUAAA_DUMP(L,...)
+#endif
+
+#if LUAAA_CHECK_CONSTRUCTOR_NAME_CONFLICT
+#   define luaaa_check_constructor_name_conflict(ctorName) { \
+        lua_getglobal(m_state, (LuaClass<TCLASS, TAG>::klassName)); \
+        if (!lua_isnil(m_state, -1)) { \
+            lua_pushstring(m_state, ctorName); \
+            lua_gettable(m_state, -2); \
+            if (!lua_isnil(m_state, -1)) { \
+                printf("Error: LuaClass<%s>::ctor has duplicated name:`%s`\n", LuaClass<TCLASS, TAG>::klassName, ctorName);\
+            } \
+            lua_pop(m_state, 1); \
+        } \
+        lua_pop(m_state, 1); \
+    }
+#else
+#   define luaaa_check_constructor_name_conflict(ctorName)
+#endif
+
+namespace LUAAA_NS
+{
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    // to_function
+    template <typename F>
+    struct function_traits : public function_traits<decltype(&F::operator())> {};
+
+    template <typename TRET, typename CLASS, typename... ARGS>
+    struct function_traits<TRET(CLASS::*)(ARGS...) const>
+    {
+        using function_type = std::function<TRET(ARGS...)>;
+    };
+
+    template <typename F>
+    using function_type_t = typename function_traits<F>::function_type;
+
+    template <typename F>
+    function_type_t<F> to_function(F& f)
+    {
+        return static_cast<function_type_t<F>>(f);
+    }
+
+    // to_class_getter_function
+    template <typename TCLASS, typename F>
+    struct class_getter_function_traits : public class_getter_function_traits<TCLASS, decltype(&F::operator())> {};
+
+    template <typename TCLASS, typename TRET, typename CLASS, typename ARG, typename... ARGS>
+    struct class_getter_function_traits<TCLASS, TRET(CLASS::*)(ARG, ARGS...) const>
+    {
+        static_assert((sizeof...(ARGS) == 0) && (std::is_same<typename std::decay<TCLASS>::type, typename std::decay<ARG>::type>::value), "Error: property getter does not accept param except current Class reference.");
+        using function_type = std::function<TRET(ARG, ARGS...)>;
+    };
+
+    template <typename TCLASS, typename TRET, typename CLASS>
+    struct class_getter_function_traits<TCLASS, TRET(CLASS::*)() const>
+    {
+        using function_type = std::function<TRET()>;
+    };
+
+    template <typename TCLASS, typename F>
+    using class_getter_function_type_t = typename class_getter_function_traits<TCLASS, F>::function_type;
+
+    template <typename TCLASS, typename F>
+    class_getter_function_type_t<TCLASS, F> to_class_getter_function(F& f)
+    {
+        return static_cast<class_getter_function_type_t<TCLASS, F>>(f);
+    }
+
+    // to_class_setter_function
+    template <typename TCLASS, typename F>
+    struct class_setter_function_traits : public class_setter_function_traits<TCLASS, decltype(&F::operator())> {};
+
+
+    template <typename TCLASS, typename TRET, typename CLASS, typename ARG1, typename... ARGS>
+    struct class_setter_function_traits<TCLASS, TRET(CLASS::*)(ARG1, ARGS...) const>
+    {
+        static_assert((sizeof...(ARGS) == 0) || ((sizeof...(ARGS) == 1) && std::is_same<typename std::decay<TCLASS>::type, typename std::decay<ARG1>::type>::value), "Error: property setter accepts only [1 value] or [self instance and 1 value].");
+        using function_type = std::function<TRET(ARG1, ARGS...)>;
+    };
+
+    template <typename TCLASS, typename TRET, typename CLASS, typename ARG1>
+    struct class_setter_function_traits<TCLASS, TRET(CLASS::*)(ARG1) const>
+    {
+        using function_type = std::function<TRET(ARG1)>;
+    };
+
+    template <typename TCLASS, typename F>
+    using class_setter_function_type_t = typename class_setter_function_traits<TCLASS, F>::function_type;
+
+    template <typename TCLASS, typename F>
+    class_setter_function_type_t<TCLASS, F> to_class_setter_function(F& f)
+    {
+        return static_cast<class_setter_function_type_t<TCLASS, F>>(f);
+    }
+
+    // to_module_getter_function
+    template <typename F>
+    struct module_getter_function_traits : public module_getter_function_traits<decltype(&F::operator())> {};
+
+    template <typename TRET, typename... ARGS>
+    struct module_getter_function_traits<TRET(*)(ARGS...)>
+    {
+        static_assert((sizeof...(ARGS) == 0), "Error: property getter does not accept param.");
+        using function_type = std::function<TRET(ARGS...)>;
+    };
+
+    template <typename TRET, typename CLASS, typename... ARGS>
+    struct module_getter_function_traits<TRET(CLASS::*)(ARGS...) const>
+    {
+        static_assert((sizeof...(ARGS) == 0), "Error: property getter does not accept param.");
+        using function_type = std::function<TRET(ARGS...)>;
+    };
+
+    template <typename F>
+    using module_getter_function_type_t = typename module_getter_function_traits<F>::function_type;
+
+    template <typename F>
+    module_getter_function_type_t<F> to_module_getter_function(F& f)
+    {
+        return static_cast<module_getter_function_type_t<F>>(f);
+    }
+
+    // to_module_setter_function
+    template <typename F>
+    struct module_setter_function_traits : public module_setter_function_traits<decltype(&F::operator())> {};
+
+    template <typename TRET, typename ARG1, typename... ARGS>
+    struct module_setter_function_traits<TRET(*)(ARG1, ARGS...)>
+    {
+        static_assert((sizeof...(ARGS) == 0), "Error: property setter accepts only 1 value.");
+        using function_type = std::function<TRET(ARG1, ARGS...)>;
+    };
+
+    template <typename TRET, typename CLASS, typename ARG1, typename... ARGS>
+    struct module_setter_function_traits<TRET(CLASS::*)(ARG1, ARGS...) const>
+    {
+        static_assert((sizeof...(ARGS) == 0), "Error: property setter accepts only 1 value.");
+        using function_type = std::function<TRET(ARG1, ARGS...)>;
+    };
+
+    template <typename F>
+    using module_setter_function_type_t = typename module_setter_function_traits<F>::function_type;
+
+    template <typename F>
+    module_setter_function_type_t<F> to_module_setter_function(F& f)
+    {
+        return static_cast<module_setter_function_type_t<F>>(f);
+    }
+#endif
+
+    //========================================================
+    // Lua Class
+    //========================================================
+
+    template <typename, int = 0> struct LuaClass;
+
+    // stored in class metatable by LuaClass::clone, makes a copy of object at idx of src on top of dst.
+    struct LuaCloneHook
+    {
+        bool (*clone)(lua_State * src, int idx, lua_State * dst, void * hook);
+    };
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    // guards class names shared by states living in different threads.
+    inline std::mutex& LuaClassLock()
+    {
+        static std::mutex lock;
+        return lock;
+    }
+#endif
+
+    //========================================================
+    // Lua stack operator
+    //========================================================
+
+    // derived class metatable maps key of each base class to pointer offset of that base, see LuaClass::base.
+    inline void * LuaUpcast(lua_State * state, int idx, const void * baseKey)
+    {
+        if (lua_type(state, idx) != LUA_TUSERDATA)
+        {
+            return nullptr;
+        }
+        void ** obj = (void**)lua_touserdata(state, idx);
+        if (obj == nullptr || *obj == nullptr || !lua_getmetatable(state, idx))
+        {
+            return nullptr;
+        }
+        lua_pushlightuserdata(state, (void*)baseKey);
+        lua_rawget(state, -2);
+        void * base = lua_isnumber(state, -1) ? (void*)((char*)(*obj) + lua_tointeger(state, -1)) : nullptr;
+        lua_pop(state, 2);
+        return base;
+    }
+
+    // whether value at idx is object of a derived class whose object pointer was cleared, e.g. unit taken from an invalidated view.
+    inline bool LuaUpcastReleased(lua_State * state, int idx, const void * baseKey)
+    {
+        if (lua_type(state, idx) != LUA_TUSERDATA || *(void**)lua_touserdata(state, idx) != nullptr || !lua_getmetatable(state, idx))
+        {
+            return false;
+        }
+        lua_pushlightuserdata(state, (void*)baseKey);
+        lua_rawget(state, -2);
+        const bool derived = lua_isnumber(state, -1) != 0;
+        lua_pop(state, 2);
+        return derived;
+    }
+
+    template <typename T> struct LuaStack
+    {
+        typedef T class_type;
+
+        inline static T& get(lua_State * state, int idx)
+        {
+#if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(state, LuaClass<T>::klassName != nullptr, 1, "cpp class not export");
+#else
+            luaL_argcheck(state, LuaClass<T>::klassName != nullptr, 1, (std::string("cpp class `") + RTTI_CLASS_NAME(T) + "` not export").c_str());
+#endif
+            if (lua_istable(state, idx)) {
+#if !defined LUA_VERSION_NUM || LUA_VERSION_NUM <= 502
+                if (lua_getmetatable(state, idx)) {
+                    lua_getfield(state, LUA_REGISTRYINDEX, LuaClass<T>::klassName);
+                    if (lua_rawequal(state, -1, -2)) {
+                        lua_getfield(state, idx, "@");
+                        if (lua_type(state, -1) == LUA_TUSERDATA) {
+                            T ** t = (T**)luaL_checkudata(state, -1, LuaClass<T>::klassName);
+                            luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
+                            return (**t);
+                        }
+                    }
+                }
+#else
+                if (luaL_getmetafield(state, idx, "__name") == LUA_TSTRING) {
+                    if (LuaClass<T>::klassName && strcmp(lua_tostring(state, -1), LuaClass<T>::klassName) == 0) {
+                        if (lua_getfield(state, idx, "@") == LUA_TUSERDATA) {
+                            T ** t = (T**)luaL_checkudata(state, -1, LuaClass<T>::klassName);
+                            luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
+                            return (**t);
+                        }
+                    }
+                }
+#endif
+            }
+            T ** t = (T**)luaL_testudata(state, idx, LuaClass<T>::klassName);
+            if (t == nullptr)
+            {
+                T * base = (T*)LuaUpcast(state, idx, &LuaClass<T>::klassName);
+                if (base != nullptr)
+                {
+                    return *base;
+                }
+                luaL_argcheck(state, !LuaUpcastReleased(state, idx, &LuaClass<T>::klassName), idx, "invalid user data");
+                t = (T**)luaL_checkudata(state, idx, LuaClass<T>::klassName);
+            }
+            luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
+            return (**t);
+        }
+
+        inline static void put(lua_State * L, T * t)
+        {
+            lua_pushlightuserdata(L, t);
+        }
+
+        // values are copied inline into a new userdata of the bound class, e.g. results of operators.
+        inline static void put(lua_State * L, const T & t)
+        {
+            typedef typename LuaClass<T>::UserDataDetail UserDataDetail;
+            if (LuaClass<T>::klassName == nullptr)
+            {
+                luaL_error(L, "cpp class `%s` not export", RTTI_CLASS_NAME(T));
+            }
+            auto uData = (UserDataDetail*)lua_newuserdata(L, sizeof(UserDataDetail) + sizeof(T));
+            uData->obj = new(uData + 1) T(t);
+            uData->dtor = f_dtor;
+            uData->free_func = nullptr;
+            luaL_setmetatable(L, LuaClass<T>::klassName);
+        }
+
+    private:
+        static int f_dtor(typename LuaClass<T>::UserDataDetail * uData)
+        {
+            if (uData && uData->obj)
+            {
+                (uData->obj)->~T();
+            }
+            return 0;
+        }
+    };
+
+    template <typename T> struct LuaStack<const T> : public LuaStack<T> {};
+    template <typename T> struct LuaStack<T&> : public LuaStack<T> {};
+    template <typename T> struct LuaStack<const T&> : public LuaStack<T> {};
+
+    template <typename T> struct LuaStack<volatile T&> : public LuaStack<T> 
+    {
+        inline static void put(lua_State * L, volatile T & t)
+        {
+            LuaStack<T>::put(L, const_cast<const T &>(t));
+        }
+    };
+
+    template <typename T> struct LuaStack<const volatile T&> : public LuaStack<T>
+    {
+        inline static void put(lua_State * L, const volatile T & t)
+        {
+            LuaStack<T>::put(L, const_cast<const T &>(t));
+        }
+    };
+
+    template <typename T> struct LuaStack<T&&> : public LuaStack<T>
+    {
+        inline static void put(lua_State * L, T && t)
+        {
+            LuaStack<T>::put(L, std::forward<T>(t));
+        }
+    };
+
+    template <typename T> struct LuaStack<T*>
+    {
+        inline static T * get(lua_State * state, int idx)
+        {
+            if (lua_islightuserdata(state, idx))
+            {
+                T * t = (T*)lua_touserdata(state, idx);
+                return t;
+            }
+            else if (lua_isuserdata(state, idx)) 
+            {
+                if (LuaClass<T*>::klassName != nullptr)
+                {
+                    T ** t = (T**)luaL_checkudata(state, idx, LuaClass<T*>::klassName);
+                    luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
+                    return *t;
+                }
+                if (LuaClass<T>::klassName != nullptr)
+                {
+                    T ** t = (T**)luaL_testudata(state, idx, LuaClass<T>::klassName);
+                    if (t == nullptr)
+                    {
+                        T * base = (T*)LuaUpcast(state, idx, &LuaClass<T>::klassName);
+                        if (base != nullptr)
+                        {
+                            return base;
+                        }
+                        luaL_argcheck(state, !LuaUpcastReleased(state, idx, &LuaClass<T>::klassName), idx, "invalid user data");
+                        t = (T**)luaL_checkudata(state, idx, LuaClass<T>::klassName);
+                    }
+                    luaL_argcheck(state, t != nullptr && *t != nullptr, 1, "invalid user data");
+                    return *t;
+                }
+            }
+            return nullptr;
+        }
+
+        inline static void put(lua_State * L, T * t)
+        {
+            lua_pushlightuserdata(L, t);
+        }
+    };
+
+    template<>
+    struct LuaStack<float>
+    {
+        inline static float get(lua_State * L, int idx)
+        {
+            if (lua_isnumber(L, idx) || lua_isstring(L, idx))
+            {
+                return float(lua_tonumber(L, idx));
+            }
+            else
+            {
+                luaL_checktype(L, idx, LUA_TNUMBER);
+            }
+            return 0;
+        }
+
+        inline static void put(lua_State * L, const float & t)
+        {
+            lua_pushnumber(L, t);
+        }
+    };
+
+    template<>
+    struct LuaStack<double>
+    {
+        inline static double get(lua_State * L, int idx)
+        {
+            if (lua_isnumber(L, idx) || lua_isstring(L, idx))
+            {
+                return double(lua_tonumber(L, idx));
+            }
+            else
+            {
+                luaL_checktype(L, idx, LUA_TNUMBER);
+            }
+            return 0;
+        }
+
+        inline static void put(lua_State * L, const double & t)
+        {
+            lua_pushnumber(L, t);
+        }
+    };
+
+    template<>
+    struct LuaStack<int>
+    {
+        inline static int get(lua_State * L, int idx)
+        {
+            if (lua_isnumber(L, idx) || lua_isstring(L, idx))
+            {
+                return int(lua_tointeger(L, idx));
+            }
+            else
+            {
+                luaL_checktype(L, idx, LUA_TNUMBER);
+            }
+            return 0;
+        }
+
+        inline static void put(lua_State * L, const int & t)
+        {
+            lua_pushinteger(L, t);
+        }
+    };
+
+    template<>
+    struct LuaStack<bool>
+    {
+        inline static bool get(lua_State * L, int idx)
+        {
+            luaL_checktype(L, idx, LUA_TBOOLEAN);
+            return lua_toboolean(L, idx) != 0;
+        }
+
+        inline static void put(lua_State * L, const bool & t)
+        {
+            lua_pushboolean(L, t);
+        }
+    };
+
+    template<>
+    struct LuaStack<const char *>
+    {
+        inline static const char * get(lua_State * L, int idx)
+        {
+            switch (lua_type(L, idx))
+            {
+            case LUA_TBOOLEAN:
+                return (lua_toboolean(L, idx) ? "true" : "false");
+            case LUA_TNUMBER:
+                return lua_tostring(L, idx);
+            case LUA_TSTRING:
+                return lua_tostring(L, idx);
+            default:
+                luaL_checktype(L, idx, LUA_TSTRING);
+                break;
+            }
+            return "";
+        }
+
+        inline static void put(lua_State * L, const char * s)
+        {
+            lua_pushstring(L, s);
+        }
+    };
+
+    template<>
+    struct LuaStack<char *>
+    {
+        inline static char * get(lua_State * L, int idx)
+        {
+            return const_cast<char*>(LuaStack<const char *>::get(L, idx));
+        }
+
+        inline static void put(lua_State * L, const char * s)
+        {
+            LuaStack<const char *>::put(L, s);
+        }
+    };
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    template<>
+    struct LuaStack<std::string>
+    {
+        // binary safe, strings may hold '\0' (e.g. msgpack data).
+        inline static std::string get(lua_State * L, int idx)
+        {
+            if (lua_type(L, idx) == LUA_TSTRING)
+            {
+                size_t n = 0;
+                const char * s = lua_tolstring(L, idx, &n);
+                return std::string(s, n);
+            }
+            return LuaStack<const char *>::get(L, idx);
+        }
+
+        inline static void put(lua_State * L, const std::string& s)
+        {
+            lua_pushlstring(L, s.data(), s.size());
+        }
+    };
+#endif
+
+    template<>
+    struct LuaStack<lua_State *>
+    {
+        inline static lua_State * get(lua_State * L, int)
+        {
+            return L;
+        }
+
+        inline static void put(lua_State *, lua_State *)
+        {
+            // do thing here.
+        }
+    };
+
+    // push ret data to stack
+    template <typename T>
+    inline void LuaStackReturn(lua_State * L, T t)
+    {
+        lua_settop(L, 0);
+        LuaStack<T>::put(L, t);
+    }
+
+
+    //========================================================
+    // borrow token
+    //========================================================
+    // C++ side of views lent to lua, views issued before invalidate() raise error when used.
+    // class objects and array views pushed from such views are linked to the token, invalidate() clears their pointers,
+    // so they raise errors too.
+    class LuaBorrow
+    {
+    public:
+        // stored after UserDataDetail of element objects.
+        struct Link
+        {
+            void ** obj;
+            size_t * count;     // zeroed too if not null, e.g. size of array view
+            Link * prev;
+            Link * next;
+        };
+
+        struct Token
+        {
+            int refs;
+            bool valid;
+            Link * links;
+        };
+
+        LuaBorrow() : m_token(nullptr) {}
+        ~LuaBorrow() { invalidate(); }
+
+        // call before lent container is changed or destroyed.
+        void invalidate()
+        {
+            if (m_token)
+            {
+                m_token->valid = false;
+                for (Link * link = m_token->links; link != nullptr; link = link->next)
+                {
+                    *link->obj = nullptr;
+                    if (link->count)
+                    {
+                        *link->count = 0;
+                    }
+                }
+                Release(m_token);
+                m_token = nullptr;
+            }
+        }
+
+        Token * acquire()
+        {
+            if (m_token == nullptr)
+            {
+                m_token = new Token();
+                m_token->refs = 1;
+                m_token->valid = true;
+                m_token->links = nullptr;
+            }
+            ++m_token->refs;
+            return m_token;
+        }
+
+        static void Release(Token * token)
+        {
+            if (token && --token->refs == 0)
+            {
+                delete token;
+            }
+        }
+
+        static void Attach(Token * token, Link * link)
+        {
+            link->prev = nullptr;
+            link->next = token->links;
+            if (token->links)
+            {
+                token->links->prev = link;
+            }
+            token->links = link;
+            ++token->refs;
+        }
+
+        static void Detach(Token * token, Link * link)
+        {
+            if (link->prev)
+            {
+                link->prev->next = link->next;
+            }
+            else
+            {
+                token->links = link->next;
+            }
+            if (link->next)
+            {
+                link->next->prev = link->prev;
+            }
+            Release(token);
+        }
+
+        // clears element objects pointing to obj, e.g. map entry erased from lua.
+        static void Forget(Token * token, const void * obj)
+        {
+            for (Link * link = token ? token->links : nullptr; link != nullptr; link = link->next)
+            {
+                if (*link->obj == obj)
+                {
+                    *link->obj = nullptr;
+                }
+            }
+        }
+
+        // free_func of element objects, they are not owned by lua, so class `__gc` is not called on them.
+        static void * Mark()
+        {
+            static char mark;
+            return &mark;
+        }
+
+    private:
+        LuaBorrow(const LuaBorrow&);
+        LuaBorrow& operator=(const LuaBorrow&);
+        Token * m_token;
+    };
+
+    //========================================================
+    // array view
+    //========================================================
+    // element types which can be viewed, integers are pushed as lua integers, others as lua numbers.
+    template<typename T> struct LuaArrayElement;
+
+#define LUAAA_ARRAY_ELEMENT(T, PUSH, CHECK) \
+    template<> struct LuaArrayElement<T> \
+    { \
+        static const char * name() { return "luaaa.ArrayView<" #T ">"; } \
+        static void push(lua_State * L, T v) { PUSH(L, v); } \
+        static T get(lua_State * L, int idx) { return (T)CHECK(L, idx); } \
+        static lua_Number number(const void * p) { return lua_Number(*(const T*)p); } \
+    }; \
+    template<> struct LuaArrayElement<const T> : public LuaArrayElement<T> \
+    { \
+        static const char * name() { return "luaaa.ArrayView<const " #T ">"; } \
+    };
+
+    LUAAA_ARRAY_ELEMENT(float, lua_pushnumber, luaL_checknumber);
+    LUAAA_ARRAY_ELEMENT(double, lua_pushnumber, luaL_checknumber);
+    LUAAA_ARRAY_ELEMENT(char, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(signed char, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(unsigned char, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(short, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(unsigned short, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(int, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(unsigned int, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(long, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(unsigned long, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(long long, lua_pushinteger, luaL_checkinteger);
+    LUAAA_ARRAY_ELEMENT(unsigned long long, lua_pushinteger, luaL_checkinteger);
+
+#undef LUAAA_ARRAY_ELEMENT
+
+    // stored in array view metatable as '__luaaa_view', to read elements of any view as lua number.
+    struct LuaArrayViewInfo
+    {
+        lua_Number(*number)(const void *);
+        unsigned char size;     // element size in bytes
+        char kind;              // 'f' floating point, 'i' signed or 'u' unsigned integer
+    };
+
+    // non-owning strided view of a numeric array, lua indexes it from 1 and gets its size by '#'.
+    // viewed memory must outlive the lua value, views of const elements are read-only in lua.
+    template<typename T>
+    struct LuaArrayView
+    {
+        T * data;
+        size_t size;
+        size_t stride; // in bytes
+
+        LuaArrayView() : data(nullptr), size(0), stride(sizeof(T)) {}
+        LuaArrayView(T * data, size_t size, size_t stride = sizeof(T)) : data(data), size(size), stride(stride) {}
+
+        inline T& operator[](size_t i) const
+        {
+            return *(T*)((char*)data + i * stride);
+        }
+    };
+
+    template<typename T> inline bool LuaArrayStore(T& e, lua_State * L, int idx) { e = LuaArrayElement<T>::get(L, idx); return true; }
+    template<typename T> inline bool LuaArrayStore(const T&, lua_State *, int) { return false; }
+
+    template<typename T>
+    struct LuaStack<LuaArrayView<T>>
+    {
+        typedef LuaArrayView<T> View;
+
+        // view lent with a borrow token, which clears data and size of the view when invalidated.
+        struct Lent
+        {
+            View view;
+            LuaBorrow::Link link;
+            LuaBorrow::Token * token;
+        };
+
+        inline static View get(lua_State * L, int idx)
+        {
+            luaL_checkudata(L, idx, LuaArrayElement<T>::name());
+            return *Check(L, idx);
+        }
+
+        inline static void put(lua_State * L, const View& v, LuaBorrow::Token * token = nullptr)
+        {
+            View * view = (View*)lua_newuserdata(L, token ? sizeof(Lent) : sizeof(View));
+            luaL_argcheck(L, view != nullptr, 1, "faild to alloc mem to store array view");
+            *view = v;
+            if (token)
+            {
+                Lent * lent = (Lent*)view;
+                lent->link.obj = (void**)&lent->view.data;
+                lent->link.count = &lent->view.size;
+                lent->token = token;
+                LuaBorrow::Attach(token, &lent->link);
+            }
+            if (luaL_newmetatable(L, LuaArrayElement<T>::name()))
+            {
+                const luaL_Reg metas[] = {
+                    { "__index", Index },
+                    { "__newindex", NewIndex },
+                    { "__len", Length },
+                    { "__gc", Gc },
+                    { nullptr, nullptr }
+                };
+                luaL_setfuncs(L, metas, 0);
+                static const LuaArrayViewInfo info = { LuaArrayElement<T>::number, (unsigned char)sizeof(T),
+                    std::is_floating_point<T>::value ? 'f' : (std::is_signed<T>::value ? 'i' : 'u') };
+                lua_pushlightuserdata(L, (void*)&info);
+                lua_setfield(L, -2, "__luaaa_view");
+            }
+            lua_setmetatable(L, -2);
+        }
+
+    private:
+        static View * Check(lua_State * L, int idx)
+        {
+            View * view = (View*)lua_touserdata(L, idx);
+            luaL_argcheck(L, lua_rawlen(L, idx) != sizeof(Lent) || ((Lent*)view)->token->valid, idx, "array view is no longer valid");
+            return view;
+        }
+
+        static int Index(lua_State * L)
+        {
+            View * view = Check(L, 1);
+            const lua_Integer i = lua_tointeger(L, 2);
+            if (i >= 1 && size_t(i) <= view->size)
+            {
+                LuaArrayElement<T>::push(L, (*view)[size_t(i - 1)]);
+                return 1;
+            }
+            return 0;
+        }
+
+        static int NewIndex(lua_State * L)
+        {
+            View * view = Check(L, 1);
+            const lua_Integer i = luaL_checkinteger(L, 2);
+            luaL_argcheck(L, i >= 1 && size_t(i) <= view->size, 2, "array view index out of range");
+            luaL_argcheck(L, LuaArrayStore((*view)[size_t(i - 1)], L, 3), 1, "array view is read-only");
+            return 0;
+        }
+
+        static int Length(lua_State * L)
+        {
+            View * view = Check(L, 1);
+            lua_pushinteger(L, lua_Integer(view->size));
+            return 1;
+        }
+
+        static int Gc(lua_State * L)
+        {
+            if (lua_rawlen(L, 1) == sizeof(Lent))
+            {
+                Lent * lent = (Lent*)lua_touserdata(L, 1);
+                LuaBorrow::Detach(lent->token, &lent->link);
+            }
+            return 0;
+        }
+    };
+
+    //========================================================
+    // stack slots
+    //========================================================
+    // max lua stack slots used at once by LuaStack<T>::get or put, specialized for nested containers.
+    template<typename T> struct LuaStackSlots
+    {
+        enum { value = 1 };
+    };
+
+    template<typename T> struct LuaStackSlots<const T> : public LuaStackSlots<T> {};
+    template<typename T> struct LuaStackSlots<T&> : public LuaStackSlots<T> {};
+    template<typename T> struct LuaStackSlots<const T&> : public LuaStackSlots<T> {};
+    template<typename T> struct LuaStackSlots<T&&> : public LuaStackSlots<T> {};
+
+    template<> struct LuaStackSlots<void>
+    {
+        enum { value = 0 };
+    };
+
+    template<typename ...TS> struct LuaMaxSlots
+    {
+        enum { value = 0 };
+    };
+
+    template<typename T, typename ...TS> struct LuaMaxSlots<T, TS...>
+    {
+        enum { value = (int(LuaStackSlots<T>::value) > int(LuaMaxSlots<TS...>::value)) ? int(LuaStackSlots<T>::value) : int(LuaMaxSlots<TS...>::value) };
+    };
+
+    // a bound call reads args one by one, then pushes the return value.
+    template<typename TRET, typename ...ARGS> struct LuaCallSlots
+    {
+        enum { value = (int(LuaStackSlots<TRET>::value) > int(LuaMaxSlots<ARGS...>::value)) ? int(LuaStackSlots<TRET>::value) : int(LuaMaxSlots<ARGS...>::value) };
+    };
+
+    // a callback pushes function and all args, then reads the return value.
+    template<typename TRET, typename ...ARGS> struct LuaCallbackSlots
+    {
+        enum { value = 1 + int(sizeof...(ARGS)) + int(LuaCallSlots<TRET, ARGS...>::value) };
+    };
+
+    template<typename TRET, typename ...ARGS>
+    inline void LuaReserveCallbackStack(lua_State * L)
+    {
+        if (LuaCallbackSlots<TRET, ARGS...>::value > LUA_MINSTACK)
+        {
+            luaL_checkstack(L, LuaCallbackSlots<TRET, ARGS...>::value, "too many nested values for lua callback");
+        }
+    }
+
+#define IMPLEMENT_CALLBACK_INVOKER(CALLCONV) \
+    template<typename RET, typename ...ARGS> \
+    struct LuaStack<RET(CALLCONV*)(ARGS...)> \
+    { \
+        typedef RET(CALLCONV*FTYPE)(ARGS...); \
+        inline static FTYPE get(lua_State * L, int idx) \
+        { \
+            static lua_State * cacheLuaState = nullptr; \
+            static int cacheLuaFuncId = 0; \
+            struct HelperClass \
+            { \
+                static RET CALLCONV f_callback(ARGS... args) \
+                { \
+                    LuaReserveCallbackStack<RET, ARGS...>(cacheLuaState); \
+                    lua_rawgeti(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId); \
+                    if (lua_isfunction(cacheLuaState, -1)) \
+                    { \
+                        int initParams[] = { (LuaStack<ARGS>::put(cacheLuaState, args), 0)..., 0 }; (void)initParams; \
+                        if (lua_pcall(cacheLuaState, sizeof...(ARGS), 1, 0) != 0) \
+                        { \
+                            lua_error(cacheLuaState); \
+                        } \
+                        luaL_unref(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId); \
+                    } \
+                    else \
+                    { \
+                        lua_pushnil(cacheLuaState); \
+                    } \
+                    return LuaStack<RET>::get(cacheLuaState, lua_gettop(cacheLuaState)); \
+                } \
+            }; \
+            if (lua_isfunction(L, idx)) \
+            { \
+                cacheLuaState = L; \
+                lua_pushvalue(L, idx); \
+                cacheLuaFuncId = luaL_ref(L, LUA_REGISTRYINDEX); \
+                return HelperClass::f_callback; \
+            } \
+            return nullptr; \
+        } \
+        inline void put(lua_State * L, FTYPE f) \
+        { \
+            lua_pushcfunction(L, NonMemberFunctionCaller(f)); \
+        } \
+    }; \
+    template<typename ...ARGS> \
+    struct LuaStack<void(CALLCONV*)(ARGS...)> \
+    { \
+        typedef void(CALLCONV*FTYPE)(ARGS...); \
+        inline static FTYPE get(lua_State * L, int idx) \
+        { \
+            static lua_State * cacheLuaState = nullptr; \
+            static int cacheLuaFuncId = 0; \
+            struct HelperClass \
+            { \
+                static void CALLCONV f_callback(ARGS... args) \
+                { \
+                    LuaReserveCallbackStack<void, ARGS...>(cacheLuaState); \
+                    lua_rawgeti(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId); \
+                    if (lua_isfunction(cacheLuaState, -1)) \
+                    { \
+                        int initParams[] = { (LuaStack<ARGS>::put(cacheLuaState, args), 0)..., 0 }; (void)initParams; \
+                        if (lua_pcall(cacheLuaState, sizeof...(ARGS), 1, 0) != 0) \
+                        { \
+                            lua_error(cacheLuaState); \
+                        } \
+                        luaL_unref(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId); \
+                    } \
+                    return; \
+                } \
+            }; \
+            if (lua_isfunction(L, idx)) \
+            { \
+                cacheLuaState = L; \
+                lua_pushvalue(L, idx); \
+                cacheLuaFuncId = luaL_ref(L, LUA_REGISTRYINDEX); \
+                return HelperClass::f_callback; \
+            } \
+            return nullptr; \
+        } \
+        inline void put(lua_State * L, FTYPE f) \
+        { \
+            lua_pushcfunction(L, NonMemberFunctionCaller(f)); \
+        } \
+    };
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    template<typename RET, typename ...ARGS>
+    struct LuaStack<std::function<RET(ARGS...)>>
+    {
+        typedef std::function<RET(ARGS...)> FTYPE;
+        inline static FTYPE get(lua_State * L, int idx)
+        {
+            static lua_State * cacheLuaState = nullptr;
+            static int cacheLuaFuncId = 0;
+            struct HelperClass
+            {
+                static RET f_callback(ARGS... args)
+                {
+                    LuaReserveCallbackStack<RET, ARGS...>(cacheLuaState);
+                    lua_rawgeti(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId);
+                    if (lua_isfunction(cacheLuaState, -1))
+                    {
+                        int initParams[] = { (LuaStack<ARGS>::put(cacheLuaState, args), 0)..., 0 }; (void)initParams;
+                        if (lua_pcall(cacheLuaState, sizeof...(ARGS), 1, 0) != 0)
+                        {
+                            lua_error(cacheLuaState);
+                        }
+                        luaL_unref(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId);
+                    }
+                    else
+                    {
+                        lua_pushnil(cacheLuaState);
+                    }
+                    return LuaStack<RET>::get(cacheLuaState, lua_gettop(cacheLuaState));
+                }
+            };
+            if (lua_isfunction(L, idx))
+            {
+                cacheLuaState = L;
+                lua_pushvalue(L, idx);
+                cacheLuaFuncId = luaL_ref(L, LUA_REGISTRYINDEX);
+                return HelperClass::f_callback;
+            }
+            return nullptr;
+        }
+        inline void put(lua_State * L, FTYPE f)
+        {
+            lua_pushcfunction(L, NonMemberFunctionCaller(f));
+        }
+    };
+    
+    template<typename ...ARGS>
+    struct LuaStack<std::function<void(ARGS...)>>
+    {
+        typedef std::function<void(ARGS...)> FTYPE;
+        inline static FTYPE get(lua_State * L, int idx)
+        {
+            static lua_State * cacheLuaState = nullptr;
+            static int cacheLuaFuncId = 0;
+            struct HelperClass
+            {
+                static void f_callback(ARGS... args)
+                {
+                    LuaReserveCallbackStack<void, ARGS...>(cacheLuaState);
+                    lua_rawgeti(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId);
+                    if (lua_isfunction(cacheLuaState, -1))
+                    {
+                        int initParams[] = { (LuaStack<ARGS>::put(cacheLuaState, args), 0)..., 0 };
+                        if (lua_pcall(cacheLuaState, sizeof...(ARGS), 1, 0) != 0)
+                        {
+                            lua_error(cacheLuaState);
+                        }
+                        luaL_unref(cacheLuaState, LUA_REGISTRYINDEX, cacheLuaFuncId);
+                    }
+                    return;
+                }
+            };
+            if (lua_isfunction(L, idx))
+            {
+                cacheLuaState = L;
+                lua_pushvalue(L, idx);
+                cacheLuaFuncId = luaL_ref(L, LUA_REGISTRYINDEX);
+                return HelperClass::f_callback;
+            }
+            return nullptr;
+        }
+        inline void put(lua_State * L, FTYPE f)
+        {
+            lua_pushcfunction(L, NonMemberFunctionCaller(f));
+        }
+    };
+#endif
+
+    //========================================================
+    // argument read policy
+    //========================================================
+    // checked: args are validated and coerced by LuaStack<T>::get, the default.
+    struct checked {};
+    // unchecked: args are read by raw lua_tonumber/lua_tointeger/lua_touserdata.
+    struct unchecked {};
+
+#if LUAAA_UNCHECKED
+    typedef unchecked LuaDefaultPolicy;
+#else
+    typedef checked LuaDefaultPolicy;
+#endif
+
+    template<typename T> struct LuaVoid { typedef void type; };
+
+    // args of bound calls are read by LuaArgStack<T>, which is LuaStack<T> unless the arg takes memory of the call (e.g. std::pmr::string).
+    template<typename T, typename = void> struct LuaArgStack : public LuaStack<T> {};
+
+    // types without raw reader are read by LuaArgStack<T>::get.
+    template<typename T, typename = void>
+    struct LuaStackUncheckedImpl
+    {
+        inline static auto get(lua_State * L, int idx) -> decltype(LuaArgStack<T>::get(L, idx))
+        {
+            return LuaArgStack<T>::get(L, idx);
+        }
+    };
+
+    // bound class, only userdata is read raw, extended lua objects go checked way.
+    // objects of classes derived by LuaClass::base may need pointer adjustment, which is looked up in their metatable.
+    template<typename T>
+    struct LuaStackUncheckedImpl<T, typename LuaVoid<typename LuaStack<T>::class_type>::type>
+    {
+        typedef typename LuaStack<T>::class_type U;
+        inline static U& get(lua_State * L, int idx)
+        {
+            if (lua_type(L, idx) == LUA_TUSERDATA)
+            {
+                if (LuaClass<U>::klassDerived)
+                {
+                    U * base = (U*)LuaUpcast(L, idx, &LuaClass<U>::klassName);
+                    if (base != nullptr)
+                    {
+                        return *base;
+                    }
+                }
+                U * obj = *(U**)lua_touserdata(L, idx);
+                if (obj != nullptr)
+                {
+                    return *obj;
+                }
+            }
+            return LuaStack<U>::get(L, idx);
+        }
+    };
+
+    template<typename T> struct LuaStackUnchecked : public LuaStackUncheckedImpl<T> {};
+    template<typename T> struct LuaStackUnchecked<const T> : public LuaStackUnchecked<T> {};
+    template<typename T> struct LuaStackUnchecked<T&> : public LuaStackUnchecked<T> {};
+    template<typename T> struct LuaStackUnchecked<const T&> : public LuaStackUnchecked<T> {};
+    template<typename T> struct LuaStackUnchecked<T&&> : public LuaStackUnchecked<T> {};
+
+    template<typename T>
+    struct LuaStackUnchecked<T*>
+    {
+        inline static T * get(lua_State * L, int idx)
+        {
+            switch (lua_type(L, idx))
+            {
+            case LUA_TLIGHTUSERDATA:
+                return (T*)lua_touserdata(L, idx);
+            case LUA_TUSERDATA:
+                return *(T**)lua_touserdata(L, idx);
+            default:
+                return LuaStack<T*>::get(L, idx);
+            }
+        }
+    };
+
+    template<>
+    struct LuaStackUnchecked<float>
+    {
+        inline static float get(lua_State * L, int idx)
+        {
+            return float(lua_tonumber(L, idx));
+        }
+    };
+
+    template<>
+    struct LuaStackUnchecked<double>
+    {
+        inline static double get(lua_State * L, int idx)
+        {
+            return double(lua_tonumber(L, idx));
+        }
+    };
+
+    template<>
+    struct LuaStackUnchecked<int>
+    {
+        inline static int get(lua_State * L, int idx)
+        {
+            return int(lua_tointeger(L, idx));
+        }
+    };
+
+    template<>
+    struct LuaStackUnchecked<bool>
+    {
+        inline static bool get(lua_State * L, int idx)
+        {
+            return lua_toboolean(L, idx) != 0;
+        }
+    };
+
+    template<typename POLICY, typename T> struct LuaArg;
+    template<typename T> struct LuaArg<checked, T> : public LuaArgStack<T> {};
+#if defined(NDEBUG) && !LUAAA_DEBUG
+    template<typename T> struct LuaArg<unchecked, T> : public LuaStackUnchecked<T> {};
+#else
+    template<typename T> struct LuaArg<unchecked, T> : public LuaArgStack<T> {};
+#endif
+
+    //========================================================
+    // lua type mask of LuaStack<T>::get
+    //========================================================
+#define LUAAA_TYPE_BIT(t) (1u << ((t) + 1))
+#define LUAAA_TYPE_ANY (~0u)
+
+    // lua types accepted by LuaStack<T>::get, 'exact' matches without coercion, 'loose' includes coercion.
+    // specialize it for custom LuaStack<T> if it accepts other types than userdata or table.
+    template <typename T> struct LuaTypeMask
+    {
+        static const unsigned exact = LUAAA_TYPE_BIT(LUA_TUSERDATA) | LUAAA_TYPE_BIT(LUA_TTABLE);
+        static const unsigned loose = exact;
+        // marks the guessed mask, see LuaRequiredArgs.
+        typedef void guessed;
+    };
+
+    template <typename T> struct LuaTypeMask<const T> : public LuaTypeMask<T> {};
+    template <typename T> struct LuaTypeMask<T&> : public LuaTypeMask<T> {};
+    template <typename T> struct LuaTypeMask<const T&> : public LuaTypeMask<T> {};
+    template <typename T> struct LuaTypeMask<T&&> : public LuaTypeMask<T> {};
+
+    template <typename T> struct LuaTypeMask<T*>
+    {
+        static const unsigned exact = LUAAA_TYPE_BIT(LUA_TUSERDATA) | LUAAA_TYPE_BIT(LUA_TLIGHTUSERDATA);
+        static const unsigned loose = exact | LUAAA_TYPE_BIT(LUA_TNIL) | LUAAA_TYPE_BIT(LUA_TNONE);
+    };
+
+    struct LuaNumberTypeMask
+    {
+        static const unsigned exact = LUAAA_TYPE_BIT(LUA_TNUMBER);
+        static const unsigned loose = exact | LUAAA_TYPE_BIT(LUA_TSTRING);
+    };
+
+    struct LuaStringTypeMask
+    {
+        static const unsigned exact = LUAAA_TYPE_BIT(LUA_TSTRING);
+        static const unsigned loose = exact | LUAAA_TYPE_BIT(LUA_TNUMBER) | LUAAA_TYPE_BIT(LUA_TBOOLEAN);
+    };
+
+    struct LuaFunctionTypeMask
+    {
+        static const unsigned exact = LUAAA_TYPE_BIT(LUA_TFUNCTION);
+        static const unsigned loose = exact | LUAAA_TYPE_BIT(LUA_TNIL) | LUAAA_TYPE_BIT(LUA_TNONE);
+    };
+
+    struct LuaTableTypeMask
+    {
+        static const unsigned exact = LUAAA_TYPE_BIT(LUA_TTABLE);
+        static const unsigned loose = exact;
+    };
+
+    template <> struct LuaTypeMask<float> : public LuaNumberTypeMask {};
+    template <> struct LuaTypeMask<double> : public LuaNumberTypeMask {};
+    template <> struct LuaTypeMask<int> : public LuaNumberTypeMask {};
+    template <> struct LuaTypeMask<const char *> : public LuaStringTypeMask {};
+    template <> struct LuaTypeMask<char *> : public LuaStringTypeMask {};
+
+    template <> struct LuaTypeMask<bool>
+    {
+        static const unsigned exact = LUAAA_TYPE_BIT(LUA_TBOOLEAN);
+        static const unsigned loose = exact;
+    };
+
+    template <> struct LuaTypeMask<lua_State *>
+    {
+        static const unsigned exact = LUAAA_TYPE_ANY;
+        static const unsigned loose = LUAAA_TYPE_ANY;
+    };
+
+    template <typename RET, typename ...ARGS> struct LuaTypeMask<RET(*)(ARGS...)> : public LuaFunctionTypeMask {};
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    template <> struct LuaTypeMask<std::string> : public LuaStringTypeMask {};
+    template <typename RET, typename ...ARGS> struct LuaTypeMask<std::function<RET(ARGS...)>> : public LuaFunctionTypeMask {};
+#endif
+
+    // whether a missing arg of type T is passed to LuaStack<T>::get instead of raising error.
+    // custom LuaStack<T> without own LuaTypeMask may accept none (e.g. by returning a default value), so it can be omitted,
+    // bound classes always need their userdata.
+    template<typename T, typename = void> struct LuaOmittableArg
+    {
+        enum { value = (LuaTypeMask<T>::loose & LUAAA_TYPE_BIT(LUA_TNONE)) != 0 };
+    };
+
+    template<typename T> struct LuaOmittableArg<T, typename LuaVoid<typename LuaTypeMask<T>::guessed>::type>
+    {
+        template<typename U, typename = void> struct Bound { enum { value = 0 }; };
+        template<typename U> struct Bound<U, typename LuaVoid<typename LuaStack<U>::class_type>::type> { enum { value = 1 }; };
+        enum { value = !Bound<typename std::remove_cv<typename std::remove_reference<T>::type>::type>::value };
+    };
+
+    // count of leading parameters which can not be omitted.
+    template<typename ...ARGS> struct LuaRequiredArgs
+    {
+        enum { value = 0 };
+    };
+
+    template<typename T, typename ...ARGS> struct LuaRequiredArgs<T, ARGS...>
+    {
+        enum { value = (LuaRequiredArgs<ARGS...>::value > 0) ? (1 + LuaRequiredArgs<ARGS...>::value) : (LuaOmittableArg<T>::value ? 0 : 1) };
+    };
+
+    //========================================================
+    // index generation helper
+    //========================================================
+    template<std::size_t... Ns>
+    struct indices
+    {
+        using next = indices<Ns..., sizeof...(Ns)>;
+    };
+
+    template<std::size_t N>
+    struct make_indices
+    {
+        using type = typename make_indices<N - 1>::type::next;
+    };
+
+    template<>
+    struct make_indices<0>
+    {
+        using type = indices<>;
+    };
+
+    //========================================================
+    // call scope
+    //========================================================
+    // args whose storage belongs to the running call open a call scope, value holds the LUAAA_SCOPE_* bits it needs.
+#define LUAAA_SCOPE_DEPTH 1     // call depth, e.g. luaaa::reuse
+#define LUAAA_SCOPE_SCRATCH 2   // scratch arena, e.g. std::pmr::string
+
+    template<typename T> struct LuaScopedArg { enum { value = 0 }; };
+    template<typename T> struct LuaScopedArg<const T> : public LuaScopedArg<T> {};
+    template<typename T> struct LuaScopedArg<T&> : public LuaScopedArg<T> {};
+    template<typename T> struct LuaScopedArg<const T&> : public LuaScopedArg<T> {};
+    template<typename T> struct LuaScopedArg<T&&> : public LuaScopedArg<T> {};
+
+    template<typename ...ARGS> struct LuaScopedArgs { enum { value = 0 }; };
+    template<typename T, typename ...ARGS> struct LuaScopedArgs<T, ARGS...>
+    {
+        enum { value = int(LuaScopedArg<T>::value) | int(LuaScopedArgs<ARGS...>::value) };
+    };
+
+    // scopes entered by running calls, by address of the scope object on the C stack.
+    // a scope nested in an entered one lives deeper on the C stack (assumed to grow downwards), so entered scopes
+    // at or above the address of a new scope were left by a longjmp of lua error, which skipped their destructors.
+    // lua limits nesting of C calls, scopes deeper than LUAAA_MAX_CALL_SCOPES are counted but not checked.
+#ifndef LUAAA_MAX_CALL_SCOPES
+#define LUAAA_MAX_CALL_SCOPES 256
+#endif
+    struct LuaCallFrames
+    {
+        const void * frames[LUAAA_MAX_CALL_SCOPES];
+        int count;
+
+        // drops scopes the one at self is not nested in, returns the number left.
+        inline int repair(const void * self)
+        {
+            if (count <= LUAAA_MAX_CALL_SCOPES)
+            {
+                while (count > 0 && (const char*)frames[count - 1] <= (const char*)self)
+                {
+                    --count;
+                }
+            }
+            return count;
+        }
+
+        inline void enter(int outer, const void * self)
+        {
+            if (outer < LUAAA_MAX_CALL_SCOPES)
+            {
+                frames[outer] = self;
+            }
+            count = outer + 1;
+        }
+    };
+
+    inline LuaCallFrames& LuaDepthFrames()
+    {
+#if LUAAA_WITHOUT_CPP_STDLIB
+        static LuaCallFrames frames;
+#else
+        static thread_local LuaCallFrames frames;
+#endif
+        return frames;
+    }
+
+    // nesting depth of running calls with scoped args on this thread.
+    inline int& LuaCallDepth()
+    {
+        return LuaDepthFrames().count;
+    }
+
+    // args are read at the depth of the caller, enter() is called after all of them are read,
+    // so a lua error raised while reading args (which longjmps past destructors) leaves depth as it was.
+    // leave() is called before bound calls raise lua errors themselves, scopes skipped by lua errors raised
+    // by the callee are dropped when the next scope is made.
+    // scopes with LUAAA_SCOPE_SCRATCH are specialized where the arena is defined.
+    template<int SCOPE> struct LuaCallScope
+    {
+        int saved;
+        LuaCallScope() : saved(LuaDepthFrames().repair(this)) {}
+        ~LuaCallScope() { leave(); }
+        inline void enter() { LuaDepthFrames().enter(saved, this); }
+        inline void leave() { LuaCallDepth() = saved; }
+    };
+
+    template<> struct LuaCallScope<0>
+    {
+        inline void enter() {}
+        inline void leave() {}
+    };
+
+    // calls f with args already read, entering the scope in between.
+    template<typename TRET, typename SCOPE, typename FTYPE>
+    struct LuaScopedCall
+    {
+        SCOPE& scope;
+        FTYPE& f;
+
+        template<typename ...A>
+        inline TRET operator()(A&&... args)
+        {
+            scope.enter();
+            return f(std::forward<A>(args)...);
+        }
+    };
+
+    template<typename TRET, typename SCOPE, typename FTYPE>
+    struct LuaScopedMemberCall
+    {
+        SCOPE& scope;
+        FTYPE& f;
+
+        template<typename C, typename ...A>
+        inline TRET operator()(C& obj, A&&... args)
+        {
+            scope.enter();
+            return (obj.*f)(std::forward<A>(args)...);
+        }
+    };
+
+    //========================================================
+    // override error
+    //========================================================
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    // lua error raised by an override of C++ virtual, see LUAAA_OVERRIDE.
+    // bound calls turn it back into lua error, so it reaches the lua caller of a bound function.
+    class LuaOverrideError : public std::runtime_error
+    {
+    public:
+        explicit LuaOverrideError(const std::string& message) : std::runtime_error(message) {}
+    };
+
+    // raises lua error with message on stack top.
+    [[noreturn]] inline void LuaRaiseError(lua_State * L)
+    {
+        lua_error(L);
+        std::abort();
+    }
+
+#   define LUAAA_CALL_TRY try
+#   define LUAAA_CALL_CATCH(L, SCOPE) \
+    catch (const LuaOverrideError& e) { lua_pushstring(L, e.what()); } \
+    SCOPE.leave(); \
+    LuaRaiseError(L);
+#else
+#   define LUAAA_CALL_TRY
+#   define LUAAA_CALL_CATCH(L, SCOPE)
+#endif
+
+    //========================================================
+    // non-member function caller & static member function caller
+    //========================================================
+    // reserve stack once for the deepest arg read or return value push, and check missing args.
+    template<typename TRET, typename ...ARGS>
+    inline void LuaPrepareCall(lua_State* state, int skip)
+    {
+        if (LuaCallSlots<TRET, ARGS...>::value > LUA_MINSTACK)
+        {
+            luaL_checkstack(state, LuaCallSlots<TRET, ARGS...>::value, "too many nested values for cpp function");
+        }
+        const int nargs = (lua_gettop(state) > skip) ? (lua_gettop(state) - skip) : 0;
+        if (nargs < LuaRequiredArgs<ARGS...>::value)
+        {
+            luaL_error(state, "cpp function requires %d args, got %d", int(LuaRequiredArgs<ARGS...>::value), nargs);
+        }
+    }
+
+    template<typename POLICY, typename TRET, typename FTYPE, typename ...ARGS, std::size_t... Ns>
+    TRET LuaInvokeImpl(lua_State* state, void* calleePtr, size_t skip, indices<Ns...>)
+    {
+        typedef LuaCallScope<LuaScopedArgs<ARGS...>::value> Scope;
+        Scope scope;
+        LUAAA_CALL_TRY
+        {
+            LuaScopedCall<TRET, Scope, FTYPE> call = { scope, *(FTYPE*)(calleePtr) };
+            return call(LuaArg<POLICY, ARGS>::get(state, Ns + 1 + skip)...);
+        }
+        LUAAA_CALL_CATCH(state, scope)
+    }
+
+    template<typename POLICY, typename TRET, typename FTYPE, typename ...ARGS>
+    inline TRET LuaInvoke(lua_State* state, void* calleePtr, size_t skip)
+    {
+        return LuaInvokeImpl<POLICY, TRET, FTYPE, ARGS...>(state, calleePtr, skip, typename make_indices<sizeof...(ARGS)>::type());
+    }
+
+
+#define IMPLEMENT_FUNCTION_CALLER(CALLERNAME, CALLCONV, SKIPPARAM) \
+    template<typename POLICY = LuaDefaultPolicy, typename TRET, typename ...ARGS> \
+    lua_CFunction CALLERNAME(TRET(CALLCONV*func)(ARGS...)) \
+    { \
+        typedef decltype(func) FTYPE; (void)(func); \
+        struct HelperClass \
+        { \
+            static int Invoke(lua_State* state) \
+            { \
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1)); \
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found."); \
+                if (calleePtr) \
+                { \
+                    LuaPrepareCall<TRET, ARGS...>(state, SKIPPARAM); \
+                    LuaStackReturn<TRET>(state, LuaInvoke<POLICY, TRET, FTYPE, ARGS...>(state, calleePtr, SKIPPARAM)); \
+                    return 1; \
+                } \
+                return 0; \
+            } \
+        }; \
+        return HelperClass::Invoke; \
+    } \
+    template<typename POLICY = LuaDefaultPolicy, typename ...ARGS> \
+    lua_CFunction CALLERNAME(void(CALLCONV*func)(ARGS...)) \
+    { \
+        typedef decltype(func) FTYPE; (void)(func); \
+        struct HelperClass \
+        { \
+            static int Invoke(lua_State* state) \
+            { \
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1)); \
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found."); \
+                if (calleePtr) \
+                { \
+                    LuaPrepareCall<void, ARGS...>(state, SKIPPARAM); \
+                    LuaInvoke<POLICY, void, FTYPE, ARGS...>(state, calleePtr, SKIPPARAM); \
+                } \
+                return 0; \
+            } \
+        }; \
+        return HelperClass::Invoke; \
+    }
+
+#if defined(_MSC_VER)
+    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __cdecl, 0);
+    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __cdecl, 1);
+    IMPLEMENT_CALLBACK_INVOKER(__cdecl);
+
+#	ifdef _M_CEE
+    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __clrcall, 0);
+    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __clrcall, 1);
+    IMPLEMENT_CALLBACK_INVOKER(__clrcall);
+#	endif
+
+#	if defined(_M_IX86) && !defined(_M_CEE)
+    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __fastcall, 0);
+    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __fastcall, 1);
+    IMPLEMENT_CALLBACK_INVOKER(__fastcall);
+#	endif
+
+#	ifdef _M_IX86
+    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __stdcall, 0);
+    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __stdcall, 1);
+    IMPLEMENT_CALLBACK_INVOKER(__stdcall);
+#	endif
+
+#	if ((defined(_M_IX86) && _M_IX86_FP >= 2) || defined(_M_X64)) && !defined(_M_CEE)
+    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, __vectorcall, 0);
+    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, __vectorcall, 1);
+    IMPLEMENT_CALLBACK_INVOKER(__vectorcall);
+#	endif
+#elif defined(__clang__)
+#	define _NOTHING
+    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, _NOTHING, 0);
+    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, _NOTHING, 1);
+    IMPLEMENT_CALLBACK_INVOKER(_NOTHING);
+#	undef _NOTHING
+#elif defined(__GNUC__)
+#	define _NOTHING
+    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, _NOTHING, 0);
+    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, _NOTHING, 1);
+    IMPLEMENT_CALLBACK_INVOKER(_NOTHING);
+#	undef _NOTHING
+#else
+#	define _NOTHING
+    IMPLEMENT_FUNCTION_CALLER(NonMemberFunctionCaller, _NOTHING, 0);
+    IMPLEMENT_FUNCTION_CALLER(MemberFunctionCaller, _NOTHING, 1);
+    IMPLEMENT_CALLBACK_INVOKER(_NOTHING);
+#	undef _NOTHING
+#endif	
+
+    //========================================================
+    // member function invoker
+    //========================================================
+    template<typename POLICY, typename TCLASS, typename TRET, typename FTYPE, typename ...ARGS, std::size_t... Ns>
+    TRET LuaInvokeInstanceMemberImpl(lua_State* state, void* calleePtr, indices<Ns...>)
+    {
+        typedef LuaCallScope<LuaScopedArgs<ARGS...>::value> Scope;
+        Scope scope;
+        LUAAA_CALL_TRY
+        {
+            LuaScopedMemberCall<TRET, Scope, FTYPE> call = { scope, *(FTYPE*)(calleePtr) };
+            return call(LuaArg<POLICY, TCLASS>::get(state, 1), LuaArg<POLICY, ARGS>::get(state, Ns + 2)...);
+        }
+        LUAAA_CALL_CATCH(state, scope)
+    }
+
+    template<typename POLICY, typename TCLASS, typename TRET, typename FTYPE, typename ...ARGS>
+    inline TRET LuaInvokeInstanceMember(lua_State* state, void* calleePtr)
+    {
+        return LuaInvokeInstanceMemberImpl<POLICY, TCLASS, TRET, FTYPE, ARGS...>(state, calleePtr, typename make_indices<sizeof...(ARGS)>::type());
+    }
+
+
+    template<typename POLICY = LuaDefaultPolicy, typename TCLASS, typename TRET, typename ...ARGS>
+    lua_CFunction MemberFunctionCaller(TRET(TCLASS::*func)(ARGS...))
+    {
+        typedef decltype(func) FTYPE; (void)(func);
+        struct HelperClass
+        {
+            static int Invoke(lua_State* state)
+            {
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
+                if (calleePtr)
+                {
+                    LuaPrepareCall<TRET, ARGS...>(state, 1);
+                    LuaStackReturn<TRET>(state, LuaInvokeInstanceMember<POLICY, TCLASS, TRET, FTYPE, ARGS...>(state, calleePtr));
+                    return 1;
+                }
+                return 0;
+            }
+        };
+        return HelperClass::Invoke;
+    }
+
+    template<typename POLICY = LuaDefaultPolicy, typename TCLASS, typename TRET, typename ...ARGS>
+    lua_CFunction MemberFunctionCaller(TRET(TCLASS::*func)(ARGS...)const)
+    {
+        typedef decltype(func) FTYPE; (void)(func);
+        struct HelperClass
+        {
+            static int Invoke(lua_State* state)
+            {
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
+                if (calleePtr)
+                {
+                    LuaPrepareCall<TRET, ARGS...>(state, 1);
+                    LuaStackReturn<TRET>(state, LuaInvokeInstanceMember<POLICY, TCLASS, TRET, FTYPE, ARGS...>(state, calleePtr));
+                    return 1;
+                }
+                return 0;
+            }
+        };
+        return HelperClass::Invoke;
+    }
+
+    template<typename POLICY = LuaDefaultPolicy, typename TCLASS, typename ...ARGS>
+    lua_CFunction MemberFunctionCaller(void(TCLASS::*func)(ARGS...))
+    {
+        typedef decltype(func) FTYPE; (void)(func);
+        struct HelperClass
+        {
+            static int Invoke(lua_State* state)
+            {
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
+                if (calleePtr)
+                {
+                    LuaPrepareCall<void, ARGS...>(state, 1);
+                    LuaInvokeInstanceMember<POLICY, TCLASS, void, FTYPE, ARGS...>(state, calleePtr);
+                }
+                return 0;
+            }
+        };
+        return HelperClass::Invoke;
+    }
+
+    template<typename POLICY = LuaDefaultPolicy, typename TCLASS, typename ...ARGS>
+    lua_CFunction MemberFunctionCaller(void(TCLASS::*func)(ARGS...)const)
+    {
+        typedef decltype(func) FTYPE; (void)(func);
+        struct HelperClass
+        {
+            static int Invoke(lua_State* state)
+            {
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
+                if (calleePtr)
+                {
+                    LuaPrepareCall<void, ARGS...>(state, 1);
+                    LuaInvokeInstanceMember<POLICY, TCLASS, void, FTYPE, ARGS...>(state, calleePtr);
+                }
+                return 0;
+            }
+        };
+        return HelperClass::Invoke;
+    }
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    template<typename POLICY = LuaDefaultPolicy, typename TRET, typename ...ARGS>
+    lua_CFunction MemberFunctionCaller(const std::function<TRET(ARGS...)>& func)
+    {
+        typedef std::function<TRET(ARGS...)> FTYPE; (void)(func);
+        struct HelperClass
+        {
+            static int Invoke(lua_State* state)
+            {
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
+                if (calleePtr)
+                {
+                    LuaPrepareCall<TRET, ARGS...>(state, 1);
+                    LuaStackReturn<TRET>(state, LuaInvoke<POLICY, TRET, FTYPE, ARGS...>(state, calleePtr, 1));
+                    return 1;
+                }
+                return 0;
+            }
+        };
+        return HelperClass::Invoke;
+    }
+
+    template<typename POLICY = LuaDefaultPolicy, typename ...ARGS>
+    lua_CFunction MemberFunctionCaller(const std::function<void(ARGS...)>& func)
+    {
+        typedef std::function<void(ARGS...)> FTYPE; (void)(func);
+        struct HelperClass
+        {
+            static int Invoke(lua_State* state)
+            {
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
+                if (calleePtr)
+                {
+                    LuaPrepareCall<void, ARGS...>(state, 1);
+                    LuaInvoke<POLICY, void, FTYPE, ARGS...>(state, calleePtr, 1);
+                }
+                return 0;
+            }
+        };
+        return HelperClass::Invoke;
+    }
+
+    template<typename POLICY = LuaDefaultPolicy, typename TRET, typename ...ARGS>
+    lua_CFunction NonMemberFunctionCaller(const std::function<TRET(ARGS...)>& func)
+    {
+        typedef std::function<TRET(ARGS...)> FTYPE; (void)(func);
+        struct HelperClass
+        {
+            static int Invoke(lua_State* state)
+            {
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
+                if (calleePtr)
+                {
+                    LuaPrepareCall<TRET, ARGS...>(state, 0);
+                    LuaStackReturn<TRET>(state, LuaInvoke<POLICY, TRET, FTYPE, ARGS...>(state, calleePtr, 0));
+                    return 1;
+                }
+                return 0;
+            }
+        };
+        return HelperClass::Invoke;
+    }
+
+    template<typename POLICY = LuaDefaultPolicy, typename ...ARGS>
+    lua_CFunction NonMemberFunctionCaller(const std::function<void(ARGS...)>& func)
+    {
+        typedef std::function<void(ARGS...)> FTYPE; (void)(func);
+        struct HelperClass
+        {
+            static int Invoke(lua_State* state)
+            {
+                void * calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                luaL_argcheck(state, calleePtr, 1, "cpp closure function not found.");
+                if (calleePtr)
+                {
+                    LuaPrepareCall<void, ARGS...>(state, 0);
+                    LuaInvoke<POLICY, void, FTYPE, ARGS...>(state, calleePtr, 0);
+                }
+                return 0;
+            }
+        };
+        return HelperClass::Invoke;
+    }
+#endif
+
+    //========================================================
+    // overload dispatcher
+    //========================================================
+    struct LuaOverloadSignature
+    {
+        int arity;      // count of declared parameters
+        int required;   // parameters which can not be omitted
+        const unsigned * exact;
+        const unsigned * loose;
+    };
+
+    template<typename ...ARGS>
+    struct LuaSignature
+    {
+        static const LuaOverloadSignature * get()
+        {
+            static const unsigned exact[] = { LuaTypeMask<ARGS>::exact..., 0 };
+            static const unsigned loose[] = { LuaTypeMask<ARGS>::loose..., 0 };
+            static const LuaOverloadSignature signature = { int(sizeof...(ARGS)), int(LuaRequiredArgs<ARGS...>::value), exact, loose };
+            return &signature;
+        }
+    };
+
+    template<typename F> struct LuaFunctionSignature;
+
+    template<typename TRET, typename ...ARGS>
+    struct LuaFunctionSignature<TRET(*)(ARGS...)> : public LuaSignature<ARGS...> {};
+
+    template<typename TCLASS, typename TRET, typename ...ARGS>
+    struct LuaFunctionSignature<TRET(TCLASS::*)(ARGS...)> : public LuaSignature<ARGS...> {};
+
+    template<typename TCLASS, typename TRET, typename ...ARGS>
+    struct LuaFunctionSignature<TRET(TCLASS::*)(ARGS...) const> : public LuaSignature<ARGS...> {};
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    template<typename TRET, typename ...ARGS>
+    struct LuaFunctionSignature<std::function<TRET(ARGS...)>> : public LuaSignature<ARGS...> {};
+#endif
+
+    // function pointers are registered as is, lambdas are converted to std::function.
+    template<typename F, typename = void>
+    struct LuaCallable
+    {
+        typedef F type;
+        static const F& get(const F& f) { return f; }
+    };
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    template<typename F>
+    struct LuaCallable<F, decltype(void(&F::operator()))>
+    {
+        typedef function_type_t<F> type;
+        static type get(F& f) { return to_function(f); }
+    };
+#endif
+
+    struct LuaOverloadTable
+    {
+        int skip;       // 1 for class function which receives self as the first param
+        int count;
+        const char * name;
+        const LuaOverloadSignature * signatures[1];
+
+        // exact pass requires the arg count in range and no coercion, loose pass accepts any convertible args.
+        inline int match(lua_State * state, int nargs) const
+        {
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    const LuaOverloadSignature * sig = signatures[i];
+                    if (nargs < sig->required || (pass == 0 && nargs > sig->arity))
+                    {
+                        continue;
+                    }
+                    const unsigned * masks = (pass == 0) ? sig->exact : sig->loose;
+                    int n = 0;
+                    while (n < sig->arity && (masks[n] & LUAAA_TYPE_BIT(lua_type(state, skip + n + 1))))
+                    {
+                        ++n;
+                    }
+                    if (n == sig->arity)
+                    {
+                        return i;
+                    }
+                }
+            }
+            return -1;
+        }
+    };
+
+    inline int LuaOverloadDispatcher(lua_State * state)
+    {
+        const LuaOverloadTable * table = (const LuaOverloadTable*)lua_touserdata(state, lua_upvalueindex(1));
+        luaL_argcheck(state, table, 1, "cpp overload table not found.");
+        if (!table)
+        {
+            return 0;
+        }
+
+        const int target = table->match(state, lua_gettop(state) - table->skip);
+        if (target < 0)
+        {
+            char types[256] = { 0 };
+            size_t wrote = 0;
+            for (int i = table->skip + 1; i <= lua_gettop(state) && wrote < sizeof(types); ++i)
+            {
+                int ret = snprintf(types + wrote, sizeof(types) - wrote, (i > table->skip + 1) ? ", %s" : "%s", luaL_typename(state, i));
+                if (ret > 0)
+                {
+                    wrote += ret;
+                }
+            }
+            return luaL_error(state, "no overload of '%s' matches arguments (%s)", table->name, types);
+        }
+
+        lua_pushvalue(state, lua_upvalueindex(target + 2));
+        lua_insert(state, 1);
+        lua_call(state, lua_gettop(state) - 1, LUA_MULTRET);
+        return lua_gettop(state);
+    }
+
+    template<typename POLICY>
+    struct LuaMemberFunctionCallerMaker
+    {
+        enum { skip = 1 };
+        template<typename F> static lua_CFunction make(const F& f) { return MemberFunctionCaller<POLICY>(f); }
+    };
+
+    template<typename POLICY>
+    struct LuaNonMemberFunctionCallerMaker
+    {
+        enum { skip = 0 };
+        template<typename F> static lua_CFunction make(const F& f) { return NonMemberFunctionCaller<POLICY>(f); }
+    };
+
+    template<typename MAKER, typename F>
+    inline void LuaPushOverloadClosure(lua_State * state, const F& f)
+    {
+        F* funPtr = (F*)lua_newuserdata(state, sizeof(F));
+        luaL_argcheck(state, funPtr != nullptr, 1, "faild to alloc mem to store function");
+        new(funPtr) F(f);
+        lua_pushcclosure(state, MAKER::make(f), 1);
+    }
+
+    // push a dispatcher which selects overload by arg count and lua types, signatures are resolved at registration.
+    template<typename MAKER, typename ...FS>
+    inline void LuaPushOverloadSet(lua_State * state, const char * name, FS... fs)
+    {
+        const LuaOverloadSignature * signatures[] = { LuaFunctionSignature<typename LuaCallable<FS>::type>::get()... };
+        const size_t count = sizeof...(FS);
+        const size_t nameLen = strlen(name) + 1;
+        const size_t tableSize = sizeof(LuaOverloadTable) + sizeof(signatures[0]) * (count - 1);
+
+        luaL_checkstack(state, int(count) + 2, "too many overloads");
+        LuaOverloadTable * table = (LuaOverloadTable*)lua_newuserdata(state, tableSize + nameLen);
+        luaL_argcheck(state, table != nullptr, 1, "faild to alloc mem to store overload table");
+        table->skip = MAKER::skip;
+        table->count = int(count);
+        table->name = reinterpret_cast<char*>(table) + tableSize;
+        memcpy(reinterpret_cast<char*>(table) + tableSize, name, nameLen);
+        memcpy(table->signatures, signatures, sizeof(signatures));
+
+        int initClosures[] = { (LuaPushOverloadClosure<MAKER>(state, LuaCallable<FS>::get(fs)), 0)... };
+        (void)initClosures;
+        lua_pushcclosure(state, LuaOverloadDispatcher, int(count) + 1);
+    }
+
+    //========================================================
+    // batch caller
+    //========================================================
+    template<typename T> struct LuaBareType { typedef T type; };
+    template<typename T> struct LuaBareType<const T> { typedef T type; };
+    template<typename T> struct LuaBareType<T&> { typedef T type; };
+    template<typename T> struct LuaBareType<const T&> { typedef T type; };
+    template<typename T> struct LuaBareType<T&&> { typedef T type; };
+
+    // array view source of batch call, any numeric view is accepted by numeric element types.
+    struct LuaBatchSource
+    {
+        const char * data;
+        size_t size;
+        size_t stride;
+        lua_Number(*number)(const void *);
+
+        inline lua_Number operator[](size_t i) const
+        {
+            return number(data + i * stride);
+        }
+    };
+
+    template<typename T, typename = void>
+    struct LuaBatchView
+    {
+        static bool test(lua_State *, int, LuaBatchSource&) { return false; }
+        template<typename FN> static void each(const LuaBatchSource&, FN) {}
+    };
+
+    template<typename T>
+    struct LuaBatchView<T, typename LuaVoid<decltype(LuaArrayElement<T>::name())>::type>
+    {
+        static bool test(lua_State * L, int idx, LuaBatchSource& source)
+        {
+            if (lua_type(L, idx) != LUA_TUSERDATA || !luaL_getmetafield(L, idx, "__luaaa_view"))
+            {
+                return false;
+            }
+            const LuaArrayViewInfo * info = (const LuaArrayViewInfo*)lua_touserdata(L, -1);
+            lua_pop(L, 1);
+            const LuaArrayView<const char> * view = (const LuaArrayView<const char>*)lua_touserdata(L, idx);
+            if (!info || !view)
+            {
+                return false;
+            }
+            source.data = view->data;
+            source.size = view->size;
+            source.stride = view->stride;
+            source.number = info->number;
+            return true;
+        }
+
+        template<typename FN> static void each(const LuaBatchSource& source, FN fn)
+        {
+            for (size_t i = 0; i < source.size; ++i)
+            {
+                fn(i, T(source[i]));
+            }
+        }
+    };
+
+    // calls f on every element of a lua array or array view at arg 1, results go to table at arg 2 or a new table.
+    template<typename TRET, typename TARG, typename FTYPE>
+    struct LuaBatchCaller
+    {
+        typedef typename LuaBareType<TARG>::type ARG;
+
+        static int Invoke(lua_State * state)
+        {
+            FTYPE * f = (FTYPE*)lua_touserdata(state, lua_upvalueindex(1));
+            luaL_argcheck(state, f, 1, "cpp closure function not found.");
+            if (!f)
+            {
+                return 0;
+            }
+
+            LuaBatchSource view;
+            const bool isView = LuaBatchView<ARG>::test(state, 1, view);
+            if (!isView)
+            {
+                luaL_checktype(state, 1, LUA_TTABLE);
+            }
+            const size_t n = isView ? view.size : lua_rawlen(state, 1);
+
+            size_t stale = 0;
+            if (lua_istable(state, 2))
+            {
+                lua_settop(state, 2);
+                stale = lua_rawlen(state, 2);
+            }
+            else
+            {
+                lua_settop(state, 1);
+                lua_createtable(state, int(n), 0);
+            }
+            luaL_checkstack(state, LuaCallSlots<TRET, TARG>::value + 1, "too many nested values for cpp function");
+
+            if (isView)
+            {
+                LuaBatchView<ARG>::each(view, [state, f](size_t i, ARG v) {
+                    LuaStack<TRET>::put(state, (*f)(v));
+                    lua_rawseti(state, 2, int(i + 1));
+                });
+            }
+            else
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    lua_rawgeti(state, 1, int(i + 1));
+                    LuaStack<TRET>::put(state, (*f)(LuaStack<TARG>::get(state, 3)));
+                    lua_rawseti(state, 2, int(i + 1));
+                    lua_pop(state, 1);
+                }
+            }
+
+            // reused table keeps no results of a previous longer batch.
+            for (size_t i = stale; i > n; --i)
+            {
+                lua_pushnil(state);
+                lua_rawseti(state, 2, int(i));
+            }
+            return 1;
+        }
+    };
+
+    template<typename TARG, typename FTYPE>
+    struct LuaBatchCaller<void, TARG, FTYPE>
+    {
+        typedef typename LuaBareType<TARG>::type ARG;
+
+        static int Invoke(lua_State * state)
+        {
+            FTYPE * f = (FTYPE*)lua_touserdata(state, lua_upvalueindex(1));
+            luaL_argcheck(state, f, 1, "cpp closure function not found.");
+            if (!f)
+            {
+                return 0;
+            }
+
+            LuaBatchSource view;
+            if (LuaBatchView<ARG>::test(state, 1, view))
+            {
+                LuaBatchView<ARG>::each(view, [f](size_t, ARG v) { (*f)(v); });
+                return 0;
+            }
+
+            luaL_checktype(state, 1, LUA_TTABLE);
+            lua_settop(state, 1);
+            luaL_checkstack(state, LuaStackSlots<TARG>::value + 1, "too many nested values for cpp function");
+            const size_t n = lua_rawlen(state, 1);
+            for (size_t i = 0; i < n; ++i)
+            {
+                lua_rawgeti(state, 1, int(i + 1));
+                (*f)(LuaStack<TARG>::get(state, 2));
+                lua_settop(state, 1);
+            }
+            return 0;
+        }
+    };
+
+    template<typename F> struct LuaBatchFunction;
+
+    template<typename TRET, typename TARG>
+    struct LuaBatchFunction<TRET(*)(TARG)>
+    {
+        static lua_CFunction caller() { return LuaBatchCaller<TRET, TARG, TRET(*)(TARG)>::Invoke; }
+    };
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+    template<typename TRET, typename TARG>
+    struct LuaBatchFunction<std::function<TRET(TARG)>>
+    {
+        static lua_CFunction caller() { return LuaBatchCaller<TRET, TARG, std::function<TRET(TARG)>>::Invoke; }
+    };
+#endif
+
+    // push batched variant of f(T) -> R, it takes a lua array or array view and returns a table of results.
+    template<typename F>
+    inline void map(lua_State * state, F f)
+    {
+        typedef typename LuaCallable<F>::type FTYPE;
+        FTYPE * funPtr = (FTYPE*)lua_newuserdata(state, sizeof(FTYPE));
+        luaL_argcheck(state, funPtr != nullptr, 1, "faild to alloc mem to store function");
+        new(funPtr) FTYPE(LuaCallable<F>::get(f));
+        lua_pushcclosure(state, LuaBatchFunction<FTYPE>::caller(), 1);
+    }
+
+    //========================================================
+    // lua function reference
+    //========================================================
+    // main thread of state, it lives as long as the state while a coroutine may be collected any time.
+    // lua 5.1 has no registry entry for it, the given thread is returned there.
+    inline lua_State * LuaMainThread(lua_State * state)
+    {
+#if defined(LUA_RIDX_MAINTHREAD)
+        lua_rawgeti(state, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+        lua_State * main = lua_tothread(state, -1);
+        lua_pop(state, 1);
+        return main;
+#else
+        return state;
+#endif
+    }
+
+    // keeps a lua function alive in registry, so C++ can call it later.
+    // it must be released before the lua state is closed.
+    class LuaFunctionRef
+    {
+    public:
+        LuaFunctionRef() : m_state(nullptr), m_ref(LUA_NOREF) {}
+
+        LuaFunctionRef(lua_State * state, int idx) : m_state(LuaMainThread(state)), m_ref(LUA_NOREF)
+        {
+            if (lua_isfunction(state, idx))
+            {
+                lua_pushvalue(state, idx);
+                m_ref = luaL_ref(state, LUA_REGISTRYINDEX);
+            }
+        }
+
+        LuaFunctionRef(const LuaFunctionRef& other) : m_state(other.m_state), m_ref(LUA_NOREF)
+        {
+            if (other.valid())
+            {
+                other.push(m_state);
+                m_ref = luaL_ref(m_state, LUA_REGISTRYINDEX);
+            }
+        }
+
+        LuaFunctionRef(LuaFunctionRef&& other) : m_state(other.m_state), m_ref(other.m_ref)
+        {
+            other.m_ref = LUA_NOREF;
+        }
+
+        ~LuaFunctionRef()
+        {
+            reset();
+        }
+
+        LuaFunctionRef& operator=(LuaFunctionRef other)
+        {
+            reset();
+            m_state = other.m_state;
+            m_ref = other.m_ref;
+            other.m_ref = LUA_NOREF;
+            return (*this);
+        }
+
+        inline void reset()
+        {
+            if (valid())
+            {
+                luaL_unref(m_state, LUA_REGISTRYINDEX, m_ref);
+                m_ref = LUA_NOREF;
+            }
+        }
+
+        inline bool valid() const { return m_state != nullptr && m_ref != LUA_NOREF && m_ref != LUA_REFNIL; }
+        inline lua_State * state() const { return m_state; }
+
+        // push the function to stack of state, or thread which shares its registry.
+        inline void push(lua_State * state) const
+        {
+            if (valid())
+            {
+                lua_rawgeti(state, LUA_REGISTRYINDEX, m_ref);
+            }
+            else
+            {
+                lua_pushnil(state);
+            }
+        }
+
+    private:
+        lua_State * m_state;
+        int m_ref;
+    };
+
+    template<>
+    struct LuaStack<LuaFunctionRef>
+    {
+        inline static LuaFunctionRef get(lua_State * L, int idx)
+        {
+            luaL_checktype(L, idx, LUA_TFUNCTION);
+            return LuaFunctionRef(L, idx);
+        }
+
+        inline static void put(lua_State * L, const LuaFunctionRef& f)
+        {
+            f.push(L);
+        }
+    };
+
+    template <> struct LuaTypeMask<LuaFunctionRef> : public LuaFunctionTypeMask {};
+
+    // message handler of protected calls from C++, appends traceback to error message.
+    inline int LuaMessageHandler(lua_State * L)
+    {
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM > 501
+        const char * msg = lua_tostring(L, 1);
+        if (msg)
+        {
+            luaL_traceback(L, L, msg, 1);
+        }
+#endif
+        return 1;
+    }
+
+    // calls fn for every element of range, or for chunks of elements as lua array when chunk > 0.
+    // the chunk table is reused between calls, copy it in lua if it should be kept.
+    // iteration stops once fn returns false. returns 0, or lua_pcall error code with message on stack top.
+    template<typename RANGE>
+    inline int for_each(lua_State * L, const RANGE& range, const LuaFunctionRef& fn, size_t chunk = 0)
+    {
+        typedef decltype(*range.begin()) ELEMENT;
+        luaL_checkstack(L, 4 + LuaStackSlots<ELEMENT>::value, "too many nested values for lua callback");
+
+        const int base = lua_gettop(L);
+        const int handler = base + 1;
+        const int func = base + 2;
+        const int table = base + 3;
+        lua_pushcfunction(L, LuaMessageHandler);
+        fn.push(L);
+        if (chunk > 0)
+        {
+            lua_createtable(L, int(chunk), 0);
+        }
+
+        size_t count = 0;
+        size_t filled = 0;
+        bool stop = false;
+        int status = 0;
+        auto it = range.begin();
+        const auto end = range.end();
+        while (!stop && status == 0)
+        {
+            const bool done = (it == end);
+            if (!done)
+            {
+                LuaStack<ELEMENT>::put(L, *it);
+                ++it;
+                if (chunk == 0)
+                {
+                    lua_pushvalue(L, func);
+                    lua_insert(L, -2);
+                }
+                else
+                {
+                    lua_rawseti(L, table, int(++count));
+                    if (count < chunk)
+                    {
+                        continue;
+                    }
+                }
+            }
+            else if (count == 0)
+            {
+                break;
+            }
+
+            if (chunk > 0)
+            {
+                for (size_t i = count + 1; i <= filled; ++i)
+                {
+                    lua_pushnil(L);
+                    lua_rawseti(L, table, int(i));
+                }
+                filled = count;
+                count = 0;
+                lua_pushvalue(L, func);
+                lua_pushvalue(L, table);
+            }
+
+            status = lua_pcall(L, 1, 1, handler);
+            if (status == 0)
+            {
+                stop = done || (lua_type(L, -1) == LUA_TBOOLEAN && !lua_toboolean(L, -1));
+                lua_pop(L, 1);
+            }
+        }
+
+        if (status != 0)
+        {
+            lua_replace(L, base + 1);
+            lua_settop(L, base + 1);
+            return status;
+        }
+        lua_settop(L, base);
+        return 0;
+    }
+
+    //========================================================
+    // constructor invoker
+    //========================================================
+    template<typename TCLASS, typename ...ARGS>
+    struct PlacementConstructorCaller
+    {
+        static TCLASS * Invoke(lua_State * state, void * mem, size_t skip)
+        {
+            return InvokeImpl(state, mem, typename make_indices<sizeof...(ARGS)>::type(), skip);
+        }
+
+    private:
+        template<std::size_t ...Ns>
+        static TCLASS * InvokeImpl(lua_State * state, void * mem, indices<Ns...>, size_t skip)
+        {
+            return new(mem) TCLASS(LuaStack<ARGS>::get(state, Ns + 1 + skip)...);
+        }
+    };
+
+    //========================================================
+    // Destructor invoker
+    //========================================================
+    template<typename TCLASS, bool = std::is_destructible<TCLASS>::value>
+    struct DestructorCaller
+    {
+        static void Invoke(TCLASS * obj)
+        {
+            delete obj;
+        }
+    };
+
+    template<typename TCLASS>
+    struct DestructorCaller<TCLASS, false>
+    {
+        static void Invoke(TCLASS * obj)
+        {
+            // do thing here.
+        }
+    };
+
+    //========================================================
+    // operators
+    //========================================================
+    // tags of LuaClass::op, each maps a lua metamethod to a C++ operator.
+    // kept in their own namespace, so `using namespace luaaa` does not clash with names like ::div.
+    namespace ops
+    {
+        struct add { enum { unary = 0 }; static const char * name() { return "__add"; } template<typename A, typename B> static auto apply(const A& a, const B& b) -> decltype(a + b) { return a + b; } };
+        struct sub { enum { unary = 0 }; static const char * name() { return "__sub"; } template<typename A, typename B> static auto apply(const A& a, const B& b) -> decltype(a - b) { return a - b; } };
+        struct mul { enum { unary = 0 }; static const char * name() { return "__mul"; } template<typename A, typename B> static auto apply(const A& a, const B& b) -> decltype(a * b) { return a * b; } };
+        struct div { enum { unary = 0 }; static const char * name() { return "__div"; } template<typename A, typename B> static auto apply(const A& a, const B& b) -> decltype(a / b) { return a / b; } };
+        struct mod { enum { unary = 0 }; static const char * name() { return "__mod"; } template<typename A, typename B> static auto apply(const A& a, const B& b) -> decltype(a % b) { return a % b; } };
+        struct eq { enum { unary = 0 }; static const char * name() { return "__eq"; } template<typename A, typename B> static bool apply(const A& a, const B& b) { return a == b; } };
+        struct lt { enum { unary = 0 }; static const char * name() { return "__lt"; } template<typename A, typename B> static bool apply(const A& a, const B& b) { return a < b; } };
+        struct le { enum { unary = 0 }; static const char * name() { return "__le"; } template<typename A, typename B> static bool apply(const A& a, const B& b) { return a <= b; } };
+        struct unm { enum { unary = 1 }; static const char * name() { return "__unm"; } template<typename A> static auto apply(const A& a) -> decltype(-a) { return -a; } };
+        struct len { enum { unary = 1 }; static const char * name() { return "__len"; } template<typename A> static int apply(const A& a) { return int(a.size()); } };
+        // binds T::operator(), args follow the object.
+        struct call { static const char * name() { return "__call"; } };
+    }
+
+    // whether value at idx can be an operand of type T, without raising errors.
+    template<typename T, typename = void>
+    struct LuaOperand
+    {
+        inline static bool test(lua_State * L, int idx)
+        {
+            return (LuaTypeMask<T>::exact & LUAAA_TYPE_BIT(lua_type(L, idx))) != 0;
+        }
+    };
+
+    template<typename T>
+    struct LuaOperand<T, typename LuaVoid<typename LuaStack<T>::class_type>::type>
+    {
+        inline static bool test(lua_State * L, int idx)
+        {
+            return lua_type(L, idx) == LUA_TUSERDATA && LuaClass<T>::klassName != nullptr
+                && (luaL_testudata(L, idx, LuaClass<T>::klassName) != nullptr || LuaUpcast(L, idx, &LuaClass<T>::klassName) != nullptr);
+        }
+    };
+
+    template<typename OP>
+    inline int LuaOperatorFallback(lua_State * L)
+    {
+        if (lua_isfunction(L, lua_upvalueindex(1)))
+        {
+            const int nargs = lua_gettop(L);
+            lua_pushvalue(L, lua_upvalueindex(1));
+            lua_insert(L, 1);
+            lua_call(L, nargs, 1);
+            return 1;
+        }
+        return luaL_error(L, "no operator '%s' for %s and %s", OP::name(), luaL_typename(L, 1), luaL_typename(L, 2));
+    }
+
+    // calls OP on operands of type A and B directly, operands of other types go to upvalue 1,
+    // which is the metamethod registered before for other operand types.
+    template<typename OP, typename A, typename B, bool UNARY = OP::unary != 0>
+    struct LuaOperator
+    {
+        static int invoke(lua_State * L)
+        {
+            if (LuaOperand<A>::test(L, 1) && LuaOperand<B>::test(L, 2))
+            {
+                LuaStackReturn(L, OP::apply(LuaStack<const A&>::get(L, 1), LuaStack<const B&>::get(L, 2)));
+                return 1;
+            }
+            return LuaOperatorFallback<OP>(L);
+        }
+    };
+
+    // second operand of unary metamethods is the operand again or nil, depends on lua version.
+    template<typename OP, typename A, typename B>
+    struct LuaOperator<OP, A, B, true>
+    {
+        static int invoke(lua_State * L)
+        {
+            if (LuaOperand<A>::test(L, 1))
+            {
+                LuaStackReturn(L, OP::apply(LuaStack<const A&>::get(L, 1)));
+                return 1;
+            }
+            return LuaOperatorFallback<OP>(L);
+        }
+    };
+
+    //========================================================
+    // struct mapping
+    //========================================================
+    // visits fields in declaration order, names are static arrays, so lua 5.4 finds them in its string cache by address.
+    struct LuaStructReader
+    {
+        lua_State * L;
+        int t;
+        const char * const * names;
+        int i;
+
+        // missing fields keep the value of default constructed struct.
+        template<typename F>
+        inline void operator()(F& field)
+        {
+#if LUA_VERSION_NUM >= 503
+            if (lua_getfield(L, t, names[i++]) != LUA_TNIL)
+#else
+            lua_getfield(L, t, names[i++]);
+            if (!lua_isnil(L, -1))
+#endif
+            {
+                field = LuaStack<F>::get(L, lua_gettop(L));
+            }
+            lua_pop(L, 1);
+        }
+    };
+
+    struct LuaStructWriter
+    {
+        lua_State * L;
+        int t;
+        const char * const * names;
+        int i;
+
+        template<typename F>
+        inline void operator()(const F& field)
+        {
+            LuaStack<F>::put(L, field);
+            lua_setfield(L, t, names[i++]);
+        }
+    };
+
+    // base of LuaStack<T> generated by LUAAA_STRUCT.
+    template<typename T>
+    struct LuaStructStack
+    {
+        static T get(lua_State * L, int idx)
+        {
+            T v = T();
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            luaL_checkstack(L, 2, "too deep to convert struct");
+            int count = 0;
+            LuaStructReader reader = { L, lua_absindex(L, idx), LuaStack<T>::Names(count), 0 };
+            LuaStack<T>::Fields(v, reader);
+            return v;
+        }
+
+        static void put(lua_State * L, const T& v)
+        {
+            luaL_checkstack(L, 2, "too deep to convert struct");
+            int count = 0;
+            const char * const * names = LuaStack<T>::Names(count);
+            lua_createtable(L, 0, count);
+            LuaStructWriter writer = { L, lua_gettop(L), names, 0 };
+            LuaStack<T>::Fields(v, writer);
+        }
+    };
+
+#define LUAAA_PP_EXPAND(x) x
+#define LUAAA_PP_CAT(a, b) LUAAA_PP_CAT_(a, b)
+#define LUAAA_PP_CAT_(a, b) a##b
+#define LUAAA_PP_NARG(...) LUAAA_PP_EXPAND(LUAAA_PP_ARG_N(__VA_ARGS__, 64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define LUAAA_PP_ARG_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, _45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, _59, _60, _61, _62, _63, _64, N, ...) N
+#define LUAAA_PP_FOR_EACH(M, ...) LUAAA_PP_EXPAND(LUAAA_PP_CAT(LUAAA_PP_FE_, LUAAA_PP_NARG(__VA_ARGS__))(M, __VA_ARGS__))
+#define LUAAA_PP_FE_1(M, a) M(a)
+#define LUAAA_PP_FE_2(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_1(M, __VA_ARGS__))
+#define LUAAA_PP_FE_3(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_2(M, __VA_ARGS__))
+#define LUAAA_PP_FE_4(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_3(M, __VA_ARGS__))
+#define LUAAA_PP_FE_5(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_4(M, __VA_ARGS__))
+#define LUAAA_PP_FE_6(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_5(M, __VA_ARGS__))
+#define LUAAA_PP_FE_7(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_6(M, __VA_ARGS__))
+#define LUAAA_PP_FE_8(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_7(M, __VA_ARGS__))
+#define LUAAA_PP_FE_9(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_8(M, __VA_ARGS__))
+#define LUAAA_PP_FE_10(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_9(M, __VA_ARGS__))
+#define LUAAA_PP_FE_11(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_10(M, __VA_ARGS__))
+#define LUAAA_PP_FE_12(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_11(M, __VA_ARGS__))
+#define LUAAA_PP_FE_13(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_12(M, __VA_ARGS__))
+#define LUAAA_PP_FE_14(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_13(M, __VA_ARGS__))
+#define LUAAA_PP_FE_15(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_14(M, __VA_ARGS__))
+#define LUAAA_PP_FE_16(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_15(M, __VA_ARGS__))
+#define LUAAA_PP_FE_17(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_16(M, __VA_ARGS__))
+#define LUAAA_PP_FE_18(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_17(M, __VA_ARGS__))
+#define LUAAA_PP_FE_19(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_18(M, __VA_ARGS__))
+#define LUAAA_PP_FE_20(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_19(M, __VA_ARGS__))
+#define LUAAA_PP_FE_21(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_20(M, __VA_ARGS__))
+#define LUAAA_PP_FE_22(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_21(M, __VA_ARGS__))
+#define LUAAA_PP_FE_23(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_22(M, __VA_ARGS__))
+#define LUAAA_PP_FE_24(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_23(M, __VA_ARGS__))
+#define LUAAA_PP_FE_25(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_24(M, __VA_ARGS__))
+#define LUAAA_PP_FE_26(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_25(M, __VA_ARGS__))
+#define LUAAA_PP_FE_27(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_26(M, __VA_ARGS__))
+#define LUAAA_PP_FE_28(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_27(M, __VA_ARGS__))
+#define LUAAA_PP_FE_29(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_28(M, __VA_ARGS__))
+#define LUAAA_PP_FE_30(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_29(M, __VA_ARGS__))
+#define LUAAA_PP_FE_31(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_30(M, __VA_ARGS__))
+#define LUAAA_PP_FE_32(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_31(M, __VA_ARGS__))
+#define LUAAA_PP_FE_33(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_32(M, __VA_ARGS__))
+#define LUAAA_PP_FE_34(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_33(M, __VA_ARGS__))
+#define LUAAA_PP_FE_35(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_34(M, __VA_ARGS__))
+#define LUAAA_PP_FE_36(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_35(M, __VA_ARGS__))
+#define LUAAA_PP_FE_37(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_36(M, __VA_ARGS__))
+#define LUAAA_PP_FE_38(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_37(M, __VA_ARGS__))
+#define LUAAA_PP_FE_39(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_38(M, __VA_ARGS__))
+#define LUAAA_PP_FE_40(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_39(M, __VA_ARGS__))
+#define LUAAA_PP_FE_41(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_40(M, __VA_ARGS__))
+#define LUAAA_PP_FE_42(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_41(M, __VA_ARGS__))
+#define LUAAA_PP_FE_43(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_42(M, __VA_ARGS__))
+#define LUAAA_PP_FE_44(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_43(M, __VA_ARGS__))
+#define LUAAA_PP_FE_45(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_44(M, __VA_ARGS__))
+#define LUAAA_PP_FE_46(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_45(M, __VA_ARGS__))
+#define LUAAA_PP_FE_47(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_46(M, __VA_ARGS__))
+#define LUAAA_PP_FE_48(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_47(M, __VA_ARGS__))
+#define LUAAA_PP_FE_49(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_48(M, __VA_ARGS__))
+#define LUAAA_PP_FE_50(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_49(M, __VA_ARGS__))
+#define LUAAA_PP_FE_51(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_50(M, __VA_ARGS__))
+#define LUAAA_PP_FE_52(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_51(M, __VA_ARGS__))
+#define LUAAA_PP_FE_53(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_52(M, __VA_ARGS__))
+#define LUAAA_PP_FE_54(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_53(M, __VA_ARGS__))
+#define LUAAA_PP_FE_55(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_54(M, __VA_ARGS__))
+#define LUAAA_PP_FE_56(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_55(M, __VA_ARGS__))
+#define LUAAA_PP_FE_57(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_56(M, __VA_ARGS__))
+#define LUAAA_PP_FE_58(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_57(M, __VA_ARGS__))
+#define LUAAA_PP_FE_59(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_58(M, __VA_ARGS__))
+#define LUAAA_PP_FE_60(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_59(M, __VA_ARGS__))
+#define LUAAA_PP_FE_61(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_60(M, __VA_ARGS__))
+#define LUAAA_PP_FE_62(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_61(M, __VA_ARGS__))
+#define LUAAA_PP_FE_63(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_62(M, __VA_ARGS__))
+#define LUAAA_PP_FE_64(M, a, ...) M(a) LUAAA_PP_EXPAND(LUAAA_PP_FE_63(M, __VA_ARGS__))
+
+#define LUAAA_STRUCT_NAME(f) #f,
+#define LUAAA_STRUCT_FIELD(f) v(s.f);
+
+// generates LuaStack<TYPE> converting struct from/to lua table with the listed fields (up to 64), use it at global scope.
+// field types need LuaStack too, so nested structs and containers of them work.
+#define LUAAA_STRUCT(TYPE, ...) \
+    namespace LUAAA_NS \
+    { \
+        template<> struct LuaStack<TYPE> : public LuaStructStack<TYPE> \
+        { \
+            static const char * const * Names(int& count) \
+            { \
+                static const char * const names[] = { LUAAA_PP_FOR_EACH(LUAAA_STRUCT_NAME, __VA_ARGS__) }; \
+                count = int(sizeof(names) / sizeof(names[0])); \
+                return names; \
+            } \
+            template<typename S, typename V> static void Fields(S& s, V& v) \
+            { \
+                LUAAA_PP_FOR_EACH(LUAAA_STRUCT_FIELD, __VA_ARGS__) \
+            } \
+        }; \
+    }
+
+    //========================================================
+    // container views
+    //========================================================
+    // pushes element of viewed container, bound class objects are pushed as references, not copies.
+    // references are cleared when token is invalidated.
+    template<typename E, typename = void>
+    struct LuaViewElement
+    {
+        inline static void push(lua_State * L, const E& e, LuaBorrow::Token *)
+        {
+            LuaStack<E>::put(L, e);
+        }
+    };
+
+    template<typename E>
+    struct LuaViewElement<E, typename LuaVoid<typename LuaStack<E>::class_type>::type>
+    {
+        typedef typename LuaClass<E>::UserDataDetail UserDataDetail;
+
+        inline static void push(lua_State * L, const E& e, LuaBorrow::Token * token)
+        {
+            if (LuaClass<E>::klassName == nullptr)
+            {
+                lua_pushlightuserdata(L, (void*)&e);
+                return;
+            }
+            auto uData = (UserDataDetail*)lua_newuserdata(L, sizeof(UserDataDetail) + sizeof(LuaBorrow::Link) + sizeof(LuaBorrow::Token*));
+            uData->obj = const_cast<E*>(&e);
+            uData->dtor = token ? f_release : nullptr;
+            uData->free_func = LuaBorrow::Mark();
+            if (token)
+            {
+                LuaBorrow::Link * link = (LuaBorrow::Link*)(uData + 1);
+                link->obj = (void**)&uData->obj;
+                link->count = nullptr;
+                *(LuaBorrow::Token**)(link + 1) = token;
+                LuaBorrow::Attach(token, link);
+            }
+            luaL_setmetatable(L, LuaClass<E>::klassName);
+        }
+
+    private:
+        static int f_release(UserDataDetail * uData)
+        {
+            LuaBorrow::Link * link = (LuaBorrow::Link*)(uData + 1);
+            LuaBorrow::Detach(*(LuaBorrow::Token**)(link + 1), link);
+            uData->obj = nullptr;
+            return 0;
+        }
+    };
+
+    template<typename E>
+    struct LuaViewElement<E*>
+    {
+        inline static void push(lua_State * L, E * e, LuaBorrow::Token * token)
+        {
+            if (e == nullptr)
+            {
+                lua_pushnil(L);
+                return;
+            }
+            LuaViewElement<E>::push(L, *e, token);
+        }
+    };
+
+    template<typename E> struct LuaViewElement<const E> : public LuaViewElement<E> {};
+
+    // lazy view of random access container (vector, deque, array), view[i] pushes i-th element on access.
+    // with cache on, elements pushed once are kept in the user value, so they keep identity.
+    template<typename C>
+    struct LuaRangeView
+    {
+        C * container;
+        LuaBorrow * borrow;
+        bool cache;
+
+        LuaRangeView() : container(nullptr), borrow(nullptr), cache(false) {}
+        LuaRangeView(C& container, LuaBorrow * borrow = nullptr, bool cache = false) : container(&container), borrow(borrow), cache(cache) {}
+    };
+
+    // userdata of container views.
+    template<typename C>
+    struct LuaViewData
+    {
+        C * container;
+        LuaBorrow::Token * token;
+        bool cache;
+
+        // metatable is kept in registry with address of methods as key, one per view type.
+        static void PushMetatable(lua_State * L, const luaL_Reg * methods)
+        {
+            lua_pushlightuserdata(L, (void*)methods);
+            lua_rawget(L, LUA_REGISTRYINDEX);
+            if (lua_istable(L, -1))
+            {
+                return;
+            }
+            lua_pop(L, 1);
+            lua_newtable(L);
+            luaL_setfuncs(L, methods, 0);
+            lua_pushlightuserdata(L, (void*)methods);
+            lua_pushvalue(L, -2);
+            lua_rawset(L, LUA_REGISTRYINDEX);
+        }
+
+        static LuaViewData * Check(lua_State * L, int idx, const luaL_Reg * methods)
+        {
+            LuaViewData * data = (LuaViewData*)lua_touserdata(L, idx);
+            bool ok = data != nullptr && lua_type(L, idx) == LUA_TUSERDATA && lua_getmetatable(L, idx);
+            if (ok)
+            {
+                PushMetatable(L, methods);
+                ok = lua_rawequal(L, -1, -2) != 0;
+                lua_pop(L, 2);
+            }
+            luaL_argcheck(L, ok, idx, "container view expected");
+            luaL_argcheck(L, data->token == nullptr || data->token->valid, idx, "container view is no longer valid");
+            return data;
+        }
+
+        static void Push(lua_State * L, C * container, LuaBorrow * borrow, bool cache, const luaL_Reg * methods)
+        {
+            LuaViewData * data = (LuaViewData*)lua_newuserdata(L, sizeof(LuaViewData));
+            data->container = container;
+            data->token = borrow ? borrow->acquire() : nullptr;
+            data->cache = cache;
+            PushMetatable(L, methods);
+            lua_setmetatable(L, -2);
+            if (cache)
+            {
+                lua_newtable(L);
+                lua_setuservalue(L, -2);
+            }
+        }
+
+        static int Gc(lua_State * L)
+        {
+            LuaViewData * data = (LuaViewData*)lua_touserdata(L, 1);
+            if (data)
+            {
+                LuaBorrow::Release(data->token);
+                data->token = nullptr;
+            }
+            return 0;
+        }
+    };
+
+    template<typename C>
+    struct LuaStack<LuaRangeView<C>>
+    {
+        typedef LuaViewData<C> Data;
+
+        inline static LuaRangeView<C> get(lua_State * L, int idx)
+        {
+            Data * data = Data::Check(L, idx, Methods());
+            LuaRangeView<C> view;
+            view.container = data->container;
+            view.cache = data->cache;
+            return view;
+        }
+
+        inline static void put(lua_State * L, const LuaRangeView<C>& view)
+        {
+            if (view.container == nullptr)
+            {
+                lua_pushnil(L);
+                return;
+            }
+            Data::Push(L, view.container, view.borrow, view.cache, Methods());
+        }
+
+    private:
+        // pushes element at lua index i, or nil if out of range.
+        static void PushElement(lua_State * L, int idx, Data * data, lua_Integer i)
+        {
+            if (i < 1 || i > lua_Integer(data->container->size()))
+            {
+                lua_pushnil(L);
+                return;
+            }
+            if (data->cache)
+            {
+                lua_getuservalue(L, idx);
+                lua_rawgeti(L, -1, i);
+                if (!lua_isnil(L, -1))
+                {
+                    lua_remove(L, -2);
+                    return;
+                }
+                lua_pop(L, 1);
+                LuaViewElement<typename C::value_type>::push(L, (*data->container)[size_t(i - 1)], data->token);
+                lua_pushvalue(L, -1);
+                lua_rawseti(L, -3, i);
+                lua_remove(L, -2);
+                return;
+            }
+            LuaViewElement<typename C::value_type>::push(L, (*data->container)[size_t(i - 1)], data->token);
+        }
+
+        static int Index(lua_State * L)
+        {
+            Data * data = Data::Check(L, 1, Methods());
+            if (lua_type(L, 2) != LUA_TNUMBER)
+            {
+                lua_pushnil(L);
+                return 1;
+            }
+            PushElement(L, 1, data, lua_tointeger(L, 2));
+            return 1;
+        }
+
+        static int Length(lua_State * L)
+        {
+            Data * data = Data::Check(L, 1, Methods());
+            lua_pushinteger(L, lua_Integer(data->container->size()));
+            return 1;
+        }
+
+        static int Next(lua_State * L)
+        {
+            Data * data = Data::Check(L, 1, Methods());
+            const lua_Integer i = luaL_optinteger(L, 2, 0) + 1;
+            if (i > lua_Integer(data->container->size()))
+            {
+                return 0;
+            }
+            lua_pushinteger(L, i);
+            PushElement(L, 1, data, i);
+            return 2;
+        }
+
+        static int Pairs(lua_State * L)
+        {
+            Data::Check(L, 1, Methods());
+            lua_pushcfunction(L, Next);
+            lua_pushvalue(L, 1);
+            lua_pushinteger(L, 0);
+            return 3;
+        }
+
+        static const luaL_Reg * Methods()
+        {
+            static const luaL_Reg methods[] = {
+                { "__index", Index },
+                { "__len", Length },
+                { "__pairs", Pairs },
+                { "__ipairs", Pairs },
+                { "__gc", Data::Gc },
+                { nullptr, nullptr }
+            };
+            return methods;
+        }
+    };
+
+    // lazy view of map/unordered_map, view[key] looks key up by find, pairs(view) walks the map.
+    // assignment writes through unless map is const, assigning nil erases the key.
+    template<typename M>
+    struct LuaMapView
+    {
+        M * map;
+        LuaBorrow * borrow;
+
+        LuaMapView() : map(nullptr), borrow(nullptr) {}
+        LuaMapView(M& map, LuaBorrow * borrow = nullptr) : map(&map), borrow(borrow) {}
+    };
+
+    template<typename M, typename K>
+    inline bool LuaMapStore(M& m, const K& key, lua_State * L, int idx, LuaBorrow::Token * token)
+    {
+        if (lua_isnil(L, idx))
+        {
+            auto it = m.find(key);
+            if (it != m.end())
+            {
+                LuaBorrow::Forget(token, &it->second);
+                m.erase(it);
+            }
+        }
+        else
+        {
+            m[key] = LuaStack<typename M::mapped_type>::get(L, idx);
+        }
+        return true;
+    }
+    template<typename M, typename K> inline bool LuaMapStore(const M&, const K&, lua_State *, int, LuaBorrow::Token *) { return false; }
+
+    // whether lua value at idx is a key of map view, exactly, values converted to other keys are not.
+    // numbers are integral keys only when they hold an integer in range of K, strings are not number keys and vice versa.
+    template<typename K, bool INTEGRAL = std::is_integral<K>::value && !std::is_same<K, bool>::value>
+    struct LuaMapKey
+    {
+        inline static bool test(lua_State * L, int idx)
+        {
+            return (LuaTypeMask<K>::exact & LUAAA_TYPE_BIT(lua_type(L, idx))) != 0;
+        }
+    };
+
+    template<typename K>
+    struct LuaMapKey<K, true>
+    {
+        inline static bool test(lua_State * L, int idx)
+        {
+            if (lua_type(L, idx) != LUA_TNUMBER)
+            {
+                return false;
+            }
+            long long v = 0;
+#if LUA_VERSION_NUM >= 503
+            if (lua_isinteger(L, idx))
+            {
+                v = (long long)lua_tointeger(L, idx);
+            }
+            else
+#endif
+            {
+                const lua_Number n = lua_tonumber(L, idx);
+                // also false for nan.
+                if (!(n >= -9223372036854775808.0 && n < 9223372036854775808.0))
+                {
+                    return false;
+                }
+                v = (long long)n;
+                if ((lua_Number)v != n)
+                {
+                    return false;
+                }
+            }
+            return (long long)K(v) == v && (v < 0) == (K(v) < 0);
+        }
+    };
+
+    // iterator after key, ordered maps continue from upper_bound, so the current key may be erased during pairs.
+    template<typename M, typename = void>
+    struct LuaMapAfter
+    {
+        typedef decltype(std::declval<M&>().begin()) Iterator;
+        inline static Iterator get(lua_State * L, M& m, const typename M::key_type& key)
+        {
+            Iterator it = m.find(key);
+            if (it == m.end())
+            {
+                luaL_error(L, "key of map view is erased during pairs, hashed maps can not go on");
+            }
+            return ++it;
+        }
+    };
+
+    template<typename M>
+    struct LuaMapAfter<M, typename LuaVoid<decltype(std::declval<M&>().upper_bound(std::declval<const typename M::key_type&>()))>::type>
+    {
+        typedef decltype(std::declval<M&>().begin()) Iterator;
+        inline static Iterator get(lua_State *, M& m, const typename M::key_type& key)
+        {
+            return m.upper_bound(key);
+        }
+    };
+
+    template<typename M>
+    struct LuaStack<LuaMapView<M>>
+    {
+        typedef LuaViewData<M> Data;
+        typedef typename M::key_type Key;
+
+        inline static LuaMapView<M> get(lua_State * L, int idx)
+        {
+            Data * data = Data::Check(L, idx, Methods());
+            LuaMapView<M> view;
+            view.map = data->container;
+            return view;
+        }
+
+        inline static void put(lua_State * L, const LuaMapView<M>& view)
+        {
+            if (view.map == nullptr)
+            {
+                lua_pushnil(L);
+                return;
+            }
+            Data::Push(L, view.map, view.borrow, false, Methods());
+        }
+
+    private:
+        // lua keys of other types can not be in map, they are not converted.
+        static bool IsKey(lua_State * L, int idx)
+        {
+            return LuaMapKey<Key>::test(L, idx);
+        }
+
+        static int Index(lua_State * L)
+        {
+            Data * data = Data::Check(L, 1, Methods());
+            if (IsKey(L, 2))
+            {
+                auto it = data->container->find(LuaStack<Key>::get(L, 2));
+                if (it != data->container->end())
+                {
+                    LuaViewElement<typename M::mapped_type>::push(L, it->second, data->token);
+                    return 1;
+                }
+            }
+            lua_pushnil(L);
+            return 1;
+        }
+
+        static int NewIndex(lua_State * L)
+        {
+            Data * data = Data::Check(L, 1, Methods());
+            luaL_argcheck(L, IsKey(L, 2), 2, "invalid key type of map view");
+            const Key key = LuaStack<Key>::get(L, 2);
+            luaL_argcheck(L, LuaMapStore(*data->container, key, L, 3, data->token), 1, "map view is read-only");
+            return 0;
+        }
+
+        static int Length(lua_State * L)
+        {
+            Data * data = Data::Check(L, 1, Methods());
+            lua_pushinteger(L, lua_Integer(data->container->size()));
+            return 1;
+        }
+
+        // next key is found from the previous one, so no iterator is kept between calls.
+        // erasing the current key during pairs is fine for ordered maps, hashed maps raise error at the next step.
+        static int Next(lua_State * L)
+        {
+            Data * data = Data::Check(L, 1, Methods());
+            auto it = data->container->begin();
+            if (!lua_isnoneornil(L, 2))
+            {
+                luaL_argcheck(L, IsKey(L, 2), 2, "invalid key type of map view");
+                it = LuaMapAfter<M>::get(L, *data->container, LuaStack<Key>::get(L, 2));
+            }
+            if (it == data->container->end())
+            {
+                return 0;
+            }
+            LuaStack<Key>::put(L, it->first);
+            LuaViewElement<typename M::mapped_type>::push(L, it->second, data->token);
+            return 2;
+        }
+
+        static int Pairs(lua_State * L)
+        {
+            Data::Check(L, 1, Methods());
+            lua_pushcfunction(L, Next);
+            lua_pushvalue(L, 1);
+            lua_pushnil(L);
+            return 3;
+        }
+
+        static const luaL_Reg * Methods()
+        {
+            static const luaL_Reg methods[] = {
+                { "__index", Index },
+                { "__newindex", NewIndex },
+                { "__len", Length },
+                { "__pairs", Pairs },
+                { "__gc", Data::Gc },
+                { nullptr, nullptr }
+            };
+            return methods;
+        }
+    };
+
+    //========================================================
+    // column views
+    //========================================================
+    // how a field is viewed as column: 1 numeric field of each row, 2 contiguous numeric container, 0 not viewable.
+    // containers of char are strings, not columns.
+    template<typename F, typename = void> struct LuaColumnKind { enum { value = 0 }; };
+    template<typename F> struct LuaColumnKind<F, typename LuaVoid<decltype(LuaArrayElement<F>::name())>::type> { enum { value = 1 }; };
+    template<typename F> struct LuaColumnKind<F, typename LuaVoid<decltype(LuaArrayElement<typename std::remove_pointer<decltype(std::declval<F&>().data())>::type>::name())>::type>
+    {
+        enum { value = std::is_same<typename std::remove_cv<typename std::remove_pointer<decltype(std::declval<F&>().data())>::type>::type, char>::value ? 0 : 2 };
+    };
+
+    template<typename F, int KIND = LuaColumnKind<F>::value>
+    struct LuaColumn
+    {
+        inline static void push(lua_State * L, F&, size_t, size_t, bool, LuaBorrow::Token *) { lua_pushnil(L); }
+        inline static size_t size(const F&, size_t rows) { return rows; }
+    };
+
+    // field of the first row, the view strides over rows.
+    template<typename F>
+    struct LuaColumn<F, 1>
+    {
+        inline static void push(lua_State * L, F& f, size_t rows, size_t stride, bool soa, LuaBorrow::Token * token)
+        {
+            if (soa)
+            {
+                lua_pushnil(L);
+                return;
+            }
+            LuaStack<LuaArrayView<F>>::put(L, LuaArrayView<F>(&f, rows, stride), token);
+        }
+        inline static size_t size(const F&, size_t rows) { return rows; }
+    };
+
+    template<typename F>
+    struct LuaColumn<F, 2>
+    {
+        typedef typename std::remove_pointer<decltype(std::declval<F&>().data())>::type E;
+
+        inline static void push(lua_State * L, F& f, size_t, size_t, bool soa, LuaBorrow::Token * token)
+        {
+            if (!soa)
+            {
+                lua_pushnil(L);
+                return;
+            }
+            LuaStack<LuaArrayView<E>>::put(L, LuaArrayView<E>(f.data(), f.size()), token);
+        }
+        inline static size_t size(const F& f, size_t) { return f.size(); }
+    };
+
+    // pushes column of the field at index target.
+    struct LuaColumnPusher
+    {
+        lua_State * L;
+        size_t rows;
+        size_t stride;
+        bool soa;
+        LuaBorrow::Token * token;
+        int target;
+        int i;
+
+        template<typename F>
+        inline void operator()(F& f)
+        {
+            if (i++ == target)
+            {
+                LuaColumn<F>::push(L, f, rows, stride, soa, token);
+            }
+        }
+    };
+
+    // row count of struct of arrays is the size of its first column.
+    struct LuaColumnCounter
+    {
+        size_t rows;
+        bool found;
+
+        template<typename F>
+        inline void operator()(F& f)
+        {
+            if (!found && LuaColumnKind<F>::value == 2)
+            {
+                rows = LuaColumn<F>::size(f, 0);
+                found = true;
+            }
+        }
+    };
+
+    // views fields of struct S mapped by LUAAA_STRUCT as columns, columns.hp[i] reads field hp of row i.
+    // numeric fields of an array of structs are strided views, a struct of arrays exposes its numeric containers.
+    // columns are LuaArrayView, so they point to memory of the rows, get them again after rows are reallocated.
+    // columns of lent rows share the borrow token, they raise error after invalidate() like the columns object.
+    template<typename S>
+    struct LuaColumns
+    {
+        S * data;
+        size_t rows;
+        bool soa;
+        LuaBorrow * borrow;
+
+        LuaColumns() : data(nullptr), rows(0), soa(false), borrow(nullptr) {}
+
+        // array of structs, e.g. std::vector<S>.
+        template<typename C>
+        LuaColumns(C& rows, LuaBorrow * borrow = nullptr) : data(rows.data()), rows(rows.size()), soa(false), borrow(borrow) {}
+        LuaColumns(S * rows, size_t count, LuaBorrow * borrow = nullptr) : data(rows), rows(count), soa(false), borrow(borrow) {}
+
+        // struct of arrays, each viewed field is a contiguous container, e.g. std::vector<float>.
+        LuaColumns(S& columns, LuaBorrow * borrow = nullptr) : data(&columns), rows(0), soa(true), borrow(borrow)
+        {
+            LuaColumnCounter counter = { 0, false };
+            LuaStack<S>::Fields(columns, counter);
+            rows = counter.rows;
+        }
+    };
+
+    template<typename S>
+    struct LuaStack<LuaColumns<S>>
+    {
+        struct Data
+        {
+            S * data;
+            size_t rows;
+            bool soa;
+            LuaBorrow::Token * token;
+        };
+
+        inline static void put(lua_State * L, const LuaColumns<S>& columns)
+        {
+            Data * data = (Data*)lua_newuserdata(L, sizeof(Data));
+            data->data = columns.data;
+            data->rows = columns.rows;
+            data->soa = columns.soa;
+            data->token = columns.borrow ? columns.borrow->acquire() : nullptr;
+            LuaViewData<S>::PushMetatable(L, Methods());
+            lua_setmetatable(L, -2);
+            lua_newtable(L);
+            lua_setuservalue(L, -2);
+        }
+
+    private:
+        // column view at index 1, or nullptr when it is something else.
+        static Data * ToData(lua_State * L)
+        {
+            Data * data = (Data*)lua_touserdata(L, 1);
+            bool ok = data != nullptr && lua_type(L, 1) == LUA_TUSERDATA && lua_getmetatable(L, 1);
+            if (ok)
+            {
+                LuaViewData<S>::PushMetatable(L, Methods());
+                ok = lua_rawequal(L, -1, -2) != 0;
+                lua_pop(L, 2);
+            }
+            return ok ? data : nullptr;
+        }
+
+        static Data * Check(lua_State * L)
+        {
+            Data * data = ToData(L);
+            luaL_argcheck(L, data != nullptr, 1, "column view expected");
+            luaL_argcheck(L, data->token == nullptr || data->token->valid, 1, "column view is no longer valid");
+            return data;
+        }
+
+        // columns are made on first access and kept in the user value.
+        static int Index(lua_State * L)
+        {
+            Data * data = Check(L);
+            lua_getuservalue(L, 1);
+            lua_pushvalue(L, 2);
+            lua_rawget(L, -2);
+            if (!lua_isnil(L, -1) || lua_type(L, 2) != LUA_TSTRING)
+            {
+                return 1;
+            }
+            lua_pop(L, 1);
+            const char * key = lua_tostring(L, 2);
+            int count = 0;
+            const char * const * names = LuaStack<S>::Names(count);
+            int target = 0;
+            while (target < count && strcmp(names[target], key) != 0)
+            {
+                ++target;
+            }
+            if (target == count)
+            {
+                lua_pushnil(L);
+                return 1;
+            }
+            // an empty array of structs has no row to take the fields from.
+            S none = S();
+            S& first = (data->soa || data->rows > 0) ? *data->data : none;
+            LuaColumnPusher pusher = { L, data->rows, sizeof(S), data->soa, data->token, target, 0 };
+            LuaStack<S>::Fields(first, pusher);
+            lua_pushvalue(L, 2);
+            lua_pushvalue(L, -2);
+            lua_rawset(L, -4);
+            return 1;
+        }
+
+        static int Length(lua_State * L)
+        {
+            lua_pushinteger(L, lua_Integer(Check(L)->rows));
+            return 1;
+        }
+
+        static int Gc(lua_State * L)
+        {
+            Data * data = ToData(L);
+            if (data)
+            {
+                LuaBorrow::Release(data->token);
+                data->token = nullptr;
+            }
+            return 0;
+        }
+
+        static const luaL_Reg * Methods()
+        {
+            static const luaL_Reg methods[] = {
+                { "__index", Index },
+                { "__len", Length },
+                { "__gc", Gc },
+                { nullptr, nullptr },
+            };
+            return methods;
+        }
+    };
+
+    //========================================================
+    // lua subclass
+    //========================================================
+    // lua subclass of bound class is a table, which is also metatable of per-instance tables.
+    // instance table is stored as user value of the userdata, so self is still the userdata.
+    struct LuaSubclass
+    {
+        // whether class with metatable at idx has lua subclass, only then its objects may have instance tables.
+        static inline bool Extended(lua_State * L, int idx)
+        {
+            lua_getfield(L, idx, "!extended");
+            const bool extended = lua_toboolean(L, -1) != 0;
+            lua_pop(L, 1);
+            return extended;
+        }
+
+        // adds Class.extend() to class table at top of stack, unless it is there.
+        static inline void Bind(lua_State * L, const char * klassName)
+        {
+            lua_getfield(L, -1, "extend");
+            const bool bound = !lua_isnil(L, -1);
+            lua_pop(L, 1);
+            if (!bound)
+            {
+                luaL_getmetatable(L, klassName);
+                lua_pushvalue(L, -2);
+                lua_pushboolean(L, 1);
+                luaL_getmetatable(L, klassName);
+                lua_pushcclosure(L, Extend, 4);
+                lua_setfield(L, -2, "extend");
+            }
+        }
+
+        // pushes instance table of subclass object at idx and returns true, pushes nothing for plain objects.
+        static inline bool PushInstanceTable(lua_State * L, int idx)
+        {
+            lua_getuservalue(L, idx);
+#if !defined LUA_VERSION_NUM || LUA_VERSION_NUM <= 501
+            // userdata env is globals by default on 5.1, only tables with subclass metatable count.
+            if (lua_istable(L, -1) && lua_getmetatable(L, -1))
+            {
+                lua_pushliteral(L, "super");
+                lua_rawget(L, -2);
+                const bool isInstance = !lua_isnil(L, -1);
+                lua_pop(L, 2);
+                if (isInstance)
+                {
+                    return true;
+                }
+            }
+#else
+            if (lua_istable(L, -1))
+            {
+                return true;
+            }
+#endif
+            lua_pop(L, 1);
+            return false;
+        }
+
+        // object and method name of running super call, the trampoline of that virtual then runs the C++ implementation
+        // instead of the lua override again. see LuaOverridable.
+        struct SuperCallInfo
+        {
+            const void * object;
+            const char * name;
+        };
+
+        static inline SuperCallInfo& PendingSuperCall()
+        {
+#if LUAAA_WITHOUT_CPP_STDLIB
+            static SuperCallInfo call = { nullptr, nullptr };
+#else
+            static thread_local SuperCallInfo call = { nullptr, nullptr };
+#endif
+            return call;
+        }
+
+        // true once for the trampoline entered by the running super call of object.
+        static inline bool TakeSuperCall(const void * object, const char * name)
+        {
+            SuperCallInfo& call = PendingSuperCall();
+            if (call.object == object && object != nullptr && strcmp(call.name, name) == 0)
+            {
+                call.object = nullptr;
+                return true;
+            }
+            return false;
+        }
+
+        // upvalue 1: method of bound class, upvalue 2: its name.
+        static int SuperCall(lua_State * L)
+        {
+            const int nargs = lua_gettop(L);
+            SuperCallInfo& call = PendingSuperCall();
+            const SuperCallInfo saved = call;
+            call.object = lua_touserdata(L, 1);
+            call.name = lua_tostring(L, lua_upvalueindex(2));
+            lua_pushvalue(L, lua_upvalueindex(1));
+            lua_insert(L, 1);
+            const int status = lua_pcall(L, nargs, LUA_MULTRET, 0);
+            call = saved;
+            if (status != 0)
+            {
+                return lua_error(L);
+            }
+            return lua_gettop(L);
+        }
+
+        // __index of Sub.super, upvalue 1: lookup table of Base, upvalue 2: class metatable.
+        // methods of bound class are wrapped by SuperCall, other values are returned as is.
+        static int SuperIndex(lua_State * L)
+        {
+            lua_settop(L, 2);
+            lua_pushvalue(L, 2);
+            lua_gettable(L, lua_upvalueindex(1));
+            if (lua_isfunction(L, 3))
+            {
+                lua_pushvalue(L, 2);
+                lua_rawget(L, lua_upvalueindex(2));
+                const bool bound = lua_rawequal(L, 3, 4) != 0;
+                lua_pop(L, 1);
+                if (bound)
+                {
+                    lua_pushvalue(L, 2);
+                    lua_pushcclosure(L, SuperCall, 2);
+                    lua_pushvalue(L, 2);
+                    lua_pushvalue(L, 3);
+                    lua_rawset(L, 1);
+                }
+            }
+            return 1;
+        }
+
+        // upvalue 1: ctor of bound class, upvalue 2: subclass.
+        static int Construct(lua_State * L)
+        {
+            const int nargs = lua_gettop(L);
+            lua_pushvalue(L, lua_upvalueindex(1));
+            lua_insert(L, 1);
+            lua_call(L, nargs, 1);
+            if (lua_type(L, -1) == LUA_TUSERDATA)
+            {
+                lua_newtable(L);
+                lua_pushvalue(L, lua_upvalueindex(2));
+                lua_setmetatable(L, -2);
+                lua_setuservalue(L, -2);
+            }
+            return 1;
+        }
+
+        // Base.extend([t]) makes t a subclass of Base and returns it.
+        // upvalue 1: lookup table of Base, upvalue 2: table holding ctors of Base, upvalue 3: whether Base is bound class,
+        // upvalue 4: class metatable.
+        static int Extend(lua_State * L)
+        {
+            lua_settop(L, 1);
+            if (lua_isnil(L, 1))
+            {
+                lua_pop(L, 1);
+                lua_newtable(L);
+            }
+            luaL_checktype(L, 1, LUA_TTABLE);
+
+            lua_pushvalue(L, 1);
+            lua_setfield(L, 1, "__index");
+
+            // Sub.super.f(self, ...) calls f of Base.
+            lua_newtable(L);
+            lua_createtable(L, 0, 1);
+            lua_pushvalue(L, lua_upvalueindex(1));
+            lua_pushvalue(L, lua_upvalueindex(4));
+            lua_pushcclosure(L, SuperIndex, 2);
+            lua_setfield(L, -2, "__index");
+            lua_setmetatable(L, -2);
+            lua_setfield(L, 1, "super");
+
+            // methods not found in subclass are looked up in Base.
+            lua_createtable(L, 0, 1);
+            lua_pushvalue(L, lua_upvalueindex(1));
+            lua_setfield(L, -2, "__index");
+            lua_setmetatable(L, 1);
+
+            const bool fromClass = lua_toboolean(L, lua_upvalueindex(3)) != 0;
+            if (fromClass)
+            {
+                lua_pushboolean(L, 1);
+                lua_setfield(L, lua_upvalueindex(1), "!extended");
+            }
+            lua_pushvalue(L, lua_upvalueindex(2));
+            lua_pushnil(L);
+            while (lua_next(L, 2) != 0)
+            {
+                const lua_CFunction f = lua_tocfunction(L, -1);
+                if (f == Construct)
+                {
+                    lua_getupvalue(L, -1, 1);
+                    lua_replace(L, -2);
+                }
+                if (lua_isfunction(L, -1) && f != Extend && (fromClass || f == Construct))
+                {
+                    lua_pushvalue(L, 1);
+                    lua_pushcclosure(L, Construct, 2);
+                    lua_pushvalue(L, -2);
+                    lua_insert(L, -2);
+                    lua_rawset(L, 1);
+                }
+                else
+                {
+                    lua_pop(L, 1);
+                }
+            }
+            lua_pop(L, 1);
+
+            lua_pushvalue(L, 1);
+            lua_pushvalue(L, 1);
+            lua_pushboolean(L, 0);
+            lua_pushvalue(L, lua_upvalueindex(4));
+            lua_pushcclosure(L, Extend, 4);
+            lua_setfield(L, 1, "extend");
+            return 1;
+        }
+    };
+
+    //========================================================
+    // lua overridable virtuals
+    //========================================================
+    // objects created by lua ctor register themselves here, so trampolines can find the lua instance.
+    class LuaOverridableBase
+    {
+    public:
+        LuaOverridableBase() : m_luaState(nullptr), m_luaObject(nullptr), m_luaResolved(0), m_luaPresent(0) {}
+        LuaOverridableBase(const LuaOverridableBase&) : LuaOverridableBase() {}
+        LuaOverridableBase& operator=(const LuaOverridableBase&) { return *this; }
+        virtual ~LuaOverridableBase() {}
+
+        // userdata at idx now owns this object, cached override lookups are dropped.
+        void luaBind(lua_State * L, int idx)
+        {
+            idx = lua_absindex(L, idx);
+            PushInstances(L);
+            lua_pushlightuserdata(L, this);
+            lua_pushvalue(L, idx);
+            lua_rawset(L, -3);
+            lua_pop(L, 1);
+            // overrides run on main thread, the creating coroutine may be gone when C++ calls them.
+            m_luaState = LuaMainThread(L);
+            m_luaObject = lua_touserdata(L, idx);
+            luaReset();
+        }
+
+        // call after adding methods to a lua subclass whose instances already ran a virtual.
+        void luaReset()
+        {
+            m_luaResolved = 0;
+            m_luaPresent = 0;
+        }
+
+    protected:
+        enum { MAX_CACHED_SLOTS = 64 };
+
+        // pushes message handler, lua override and self, returns false with nothing pushed if virtual is not overridden.
+        bool luaPushOverride(unsigned slot, const char * name) const
+        {
+            // super call of lua subclass goes to C++ implementation.
+            if (m_luaState == nullptr || LuaSubclass::TakeSuperCall(m_luaObject, name))
+            {
+                return false;
+            }
+            // slots beyond the cache are looked up on every call.
+            const unsigned long long bit = (slot < MAX_CACHED_SLOTS) ? (1ull << slot) : 0;
+            if ((m_luaResolved & bit) && !(m_luaPresent & bit))
+            {
+                return false;
+            }
+
+            lua_State * L = m_luaState;
+            bool present = false;
+            lua_pushcfunction(L, LuaMessageHandler);
+            PushInstances(L);
+            lua_pushlightuserdata(L, (void*)this);
+            lua_rawget(L, -2);
+            lua_remove(L, -2);
+            if (lua_type(L, -1) == LUA_TUSERDATA && LuaSubclass::PushInstanceTable(L, -1))
+            {
+                lua_getfield(L, -1, name);
+                lua_remove(L, -2);
+                // method of bound class lives in metatable of userdata, anything else is an override.
+                if (lua_isfunction(L, -1))
+                {
+                    if (luaL_getmetafield(L, -2, name))
+                    {
+                        present = !lua_rawequal(L, -1, -2);
+                        lua_pop(L, 1);
+                    }
+                    else
+                    {
+                        present = true;
+                    }
+                }
+                if (present)
+                {
+                    lua_insert(L, -2);
+                }
+                else
+                {
+                    lua_pop(L, 3);
+                }
+            }
+            else
+            {
+                lua_pop(L, 2);
+            }
+
+            m_luaResolved |= bit;
+            if (present)
+            {
+                m_luaPresent |= bit;
+            }
+            return present;
+        }
+
+        lua_State * m_luaState;
+        const void * m_luaObject;
+        // lookup cache is not part of object state, so const virtuals can be overridden too.
+        mutable unsigned long long m_luaResolved;
+        mutable unsigned long long m_luaPresent;
+
+    private:
+        // weak table: this -> userdata.
+        static void PushInstances(lua_State * L)
+        {
+            static char key = 0;
+            lua_pushlightuserdata(L, &key);
+            lua_rawget(L, LUA_REGISTRYINDEX);
+            if (!lua_istable(L, -1))
+            {
+                lua_pop(L, 1);
+                lua_newtable(L);
+                lua_createtable(L, 0, 1);
+                lua_pushliteral(L, "v");
+                lua_setfield(L, -2, "__mode");
+                lua_setmetatable(L, -2);
+                lua_pushlightuserdata(L, &key);
+                lua_pushvalue(L, -2);
+                lua_rawset(L, LUA_REGISTRYINDEX);
+            }
+        }
+    };
+
+    // return value of lua override, converted in protected mode, so a value of wrong type raises no lua error either.
+    template<typename RET>
+    struct LuaOverrideResult
+    {
+        typename std::aligned_storage<sizeof(RET), alignof(RET)>::type storage;
+        bool done;
+
+        LuaOverrideResult() : done(false) {}
+        ~LuaOverrideResult()
+        {
+            if (done)
+            {
+                ((RET*)&storage)->~RET();
+            }
+        }
+
+        // value on top, false with error message pushed if it can not be converted.
+        bool read(lua_State * L, int handler)
+        {
+            lua_pushcfunction(L, Read);
+            lua_pushlightuserdata(L, this);
+            lua_pushvalue(L, -3);
+            return lua_pcall(L, 2, 0, handler) == 0;
+        }
+
+        inline RET get() const { return *(const RET*)&storage; }
+
+    private:
+        static int Read(lua_State * L)
+        {
+            LuaOverrideResult * self = (LuaOverrideResult*)lua_touserdata(L, 1);
+            new (&self->storage) RET(LuaStack<RET>::get(L, 2));
+            self->done = true;
+            return 0;
+        }
+    };
+
+    template<>
+    struct LuaOverrideResult<void>
+    {
+        inline bool read(lua_State *, int) { return true; }
+        inline void get() const {}
+    };
+
+    // base of trampoline classes, see LUAAA_OVERRIDE.
+    template<typename BASE>
+    class LuaOverridable : public BASE, public LuaOverridableBase
+    {
+    public:
+        LuaOverridable() {}
+
+        // args are forwarded to BASE ctor, copies of trampoline objects use the implicit copy ctor.
+        template<typename ARG, typename ...ARGS, typename = typename std::enable_if<!std::is_base_of<LuaOverridable, typename std::decay<ARG>::type>::value>::type>
+        LuaOverridable(ARG&& arg, ARGS&&... args) : BASE(std::forward<ARG>(arg), std::forward<ARGS>(args)...) {}
+
+        // one cache bit per trampoline, allocated on first call.
+        static unsigned luaAllocSlot()
+        {
+#if LUAAA_WITHOUT_CPP_STDLIB
+            static unsigned next = 0;
+            return next++;
+#else
+            static std::atomic<unsigned> next(0);
+            return next++;
+#endif
+        }
+
+    protected:
+        // returned by luaOverride, called with args of the virtual.
+        template<typename F>
+        struct LuaOverrideCall
+        {
+            const LuaOverridable * self;
+            unsigned slot;
+            const char * name;
+            F fallback;
+
+            template<typename ...ARGS>
+            auto operator()(const ARGS&... args) const -> decltype(fallback())
+            {
+                return self->luaCallOverride(slot, name, fallback, args...);
+            }
+        };
+
+        template<typename F>
+        LuaOverrideCall<F> luaOverride(unsigned slot, const char * name, F fallback) const
+        {
+            LuaOverrideCall<F> call = { this, slot, name, fallback };
+            return call;
+        }
+
+        template<typename F, typename ...ARGS>
+        auto luaCallOverride(unsigned slot, const char * name, const F& fallback, const ARGS&... args) const -> decltype(fallback())
+        {
+            typedef decltype(fallback()) RET;
+            if (!luaPushOverride(slot, name))
+            {
+                return fallback();
+            }
+            lua_State * L = m_luaState;
+            const int handler = lua_gettop(L) - 2;
+            LuaReserveCallbackStack<RET, ARGS...>(L);
+            int initParams[] = { (LuaStack<ARGS>::put(L, args), 0)..., 0 }; (void)initParams;
+            LuaOverrideResult<RET> result;
+            if (lua_pcall(L, 1 + int(sizeof...(ARGS)), 1, handler) != 0 || !result.read(L, handler))
+            {
+                // no lua error is raised here, C++ caller may not run inside a protected call.
+#if LUAAA_WITHOUT_CPP_STDLIB
+                fprintf(stderr, "lua override `%s`: %s\n", name, lua_isstring(L, -1) ? lua_tostring(L, -1) : "error");
+                lua_settop(L, handler - 1);
+                return fallback();
+#else
+                const std::string message = std::string("lua override `") + name + "`: " + (lua_isstring(L, -1) ? lua_tostring(L, -1) : "error");
+                lua_settop(L, handler - 1);
+                throw LuaOverrideError(message);
+#endif
+            }
+            lua_settop(L, handler - 1);
+            return result.get();
+        }
+    };
+
+    inline void LuaBindOverridable(lua_State *, void *) {}
+    inline void LuaBindOverridable(lua_State * L, LuaOverridableBase * obj) { obj->luaBind(L, -1); }
+
+// trampoline body: calls override from lua subclass if any, otherwise BASE::NAME. ARGS is the parenthesized arg list.
+//   int tick(float dt) override { LUAAA_OVERRIDE(Behavior, tick, (dt)); }
+#define LUAAA_OVERRIDE(BASE, NAME, ARGS) \
+    static const unsigned luaaa_slot = LUAAA_NS::LuaOverridable<BASE>::luaAllocSlot(); \
+    return this->luaOverride(luaaa_slot, #NAME, [&]() { return BASE::NAME ARGS; }) ARGS
+
+// same as LUAAA_OVERRIDE for pure virtuals, returns RET() if lua subclass does not override it.
+#define LUAAA_OVERRIDE_PURE(RET, BASE, NAME, ARGS) \
+    static const unsigned luaaa_slot = LUAAA_NS::LuaOverridable<BASE>::luaAllocSlot(); \
+    return this->luaOverride(luaaa_slot, #NAME, [&]() -> RET { return RET(); }) ARGS
+
+    // whether TBASE* can be cast back to TCLASS* by static_cast, then the offset between them is fixed.
+    template<typename TCLASS, typename TBASE, typename = void> struct LuaStaticBase
+    {
+        enum { value = 0 };
+    };
+
+    template<typename TCLASS, typename TBASE>
+    struct LuaStaticBase<TCLASS, TBASE, typename LuaVoid<decltype(static_cast<TCLASS*>((TBASE*)nullptr))>::type>
+    {
+        enum { value = std::is_base_of<TBASE, TCLASS>::value && !std::is_same<TBASE, TCLASS>::value };
+    };
+
+    //========================================================
+    // export class
+    //========================================================
+    template <typename TCLASS, int TAG>
+    struct LuaClass
+    {
+        friend struct DestructorCaller<TCLASS>;
+        template<typename> friend struct LuaStack;
+        template<typename, int> friend struct LuaClass;
+        template<typename, typename> friend struct LuaOperand;
+        template<typename, typename> friend struct LuaViewElement;
+        template<typename, typename> friend struct LuaStackUncheckedImpl;
+        friend struct LuaModule;
+
+        typedef struct _UserDataDetail {
+            TCLASS * obj;
+            int (*dtor)(_UserDataDetail*);
+            void* free_func;
+        } UserDataDetail;
+
+    public:
+        LuaClass(lua_State * state, const char * name, const luaL_Reg * functions = nullptr)
+            : m_state(state)
+        {
+            assert(state != nullptr);
+
+            // the same class may be bound to many states (e.g. one per worker thread) under the same name,
+            // the name is shared by them and released with the last state.
+#if !LUAAA_WITHOUT_CPP_STDLIB
+            std::unique_lock<std::mutex> lock(LuaClassLock());
+#endif
+            bool conflict = (klassName != nullptr && strcmp(klassName, name) != 0);
+            if (!conflict && klassName != nullptr)
+            {
+                luaL_getmetatable(state, klassName);
+                conflict = !lua_isnil(state, -1);
+                lua_pop(state, 1);
+            }
+#if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(state, !conflict, 1, "LuaCalss<CLASS> name conflict, use LuaClass<CLASS, TAG> to identify them");
+#else
+            if (conflict)
+            {
+                const std::string message = std::string("C++ class `") + RTTI_CLASS_NAME(TCLASS) + "` bind to conflict lua name `" + name + "`, origin name: `" + klassName + "`. use use LuaClass<CLASS, TAG> to identify them.";
+                lock.unlock();
+                luaL_argcheck(state, !conflict, 1, message.c_str());
+            }
+#endif
+
+            struct HelperClass {
+                static int f__clsgc(lua_State*) {
+#if !LUAAA_WITHOUT_CPP_STDLIB
+                    std::lock_guard<std::mutex> lock(LuaClassLock());
+#endif
+                    if (--LuaClass<TCLASS, TAG>::klassRefs == 0)
+                    {
+                        free(LuaClass<TCLASS, TAG>::klassName);
+                        LuaClass<TCLASS, TAG>::klassName = nullptr;
+                    }
+                    return 0; 
+                }
+
+                static int f__objgc(lua_State* state) {
+                    if (lua_isuserdata(state, -1)) {
+                        auto uData = (UserDataDetail*)luaL_checkudata(state, -1, (LuaClass<TCLASS, TAG>::klassName));
+                        if (uData)
+                        {
+                            lua_getmetatable(state, -1);
+                            lua_getfield(state, -1, "!__gc");
+                            if (lua_isfunction(state, -1) && uData->free_func != LuaBorrow::Mark())
+                            {
+                                lua_insert(state, 1);
+                                lua_pcall(state, lua_gettop(state) - 1, 0, 0);
+                            }
+
+                            if (uData->dtor)
+                            {
+                                return (uData->dtor)(uData);
+                            }
+                        }
+                    }
+                    return 0;
+                }
+
+#if LUAAA_FEATURE_PROPERTY
+                static int f_internal_index(lua_State* state)
+                {
+                    const char* key = luaL_checkstring(state, 2);
+                    if (!key)
+                    {
+                        lua_pushnil(state);
+                        return 1;
+                    }
+
+                    lua_getmetatable(state, 1);
+
+                    // fields and methods of lua subclass object
+                    if (lua_type(state, 1) == LUA_TUSERDATA && LuaSubclass::Extended(state, -1) && LuaSubclass::PushInstanceTable(state, 1))
+                    {
+                        lua_pushvalue(state, 2);
+                        lua_gettable(state, -2);
+                        if (!lua_isnil(state, -1))
+                        {
+                            return 1;
+                        }
+                        lua_pop(state, 2);
+                    }
+
+                    lua_getfield(state, -1, key);
+                    if (!lua_isnil(state, -1))
+                    {
+                        return 1;
+                    }
+
+                    lua_pop(state, 1);
+
+                    char internal_name[256];
+                    snprintf(internal_name, sizeof(internal_name), "<%s", key);
+
+                    lua_getfield(state, -1, internal_name);
+                    if (lua_isfunction(state, -1))
+                    {
+                        lua_insert(state, 1);
+                        lua_pcall(state, lua_gettop(state) - 1, 1, 0);
+                    }
+                    else if (lua_isnil(state, -1))
+                    {
+                        // check if user defined __index method
+                        lua_pop(state, 1);
+                        lua_getfield(state, -1, "!__index");
+                        if (lua_isfunction(state, -1))
+                        {
+                            lua_insert(state, 1);
+                            lua_pcall(state, lua_gettop(state) - 1, 0, 0);
+                        }
+                        else if (lua_istable(state, -1))
+                        {
+                            lua_replace(state, 1);
+                            lua_pop(state, 1);
+                            lua_rawget(state, 1);
+                        }
+                        else
+                        {
+                            lua_pop(state, 1);
+                            snprintf(internal_name, sizeof(internal_name), ">%s", key);
+                            lua_getfield(state, -1, internal_name);
+                            if (lua_isfunction(state, -1))
+                            {
+                                // Yes, there are something write-only, e.g., stdout, printer, digital io pin in output mode.
+                                luaL_error(state, "attempt to read Write-Only property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
+                            }
+                            else
+                            {
+                                // do nothing here. nil will be return.
+                                // luaL_error(state, "attempt to access Non-existing property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
+                            }
+                        }
+                    }
+                    return 1;
+                }
+
+                static int f_internal_newindex(lua_State* state)
+                {
+                    const char* key = luaL_checkstring(state, 2);
+                    if (!key)
+                    {
+                        lua_pushnil(state);
+                        return 1;
+                    }
+
+                    char internal_name[256];
+                    snprintf(internal_name, sizeof(internal_name), ">%s", key);
+
+
+                    lua_getmetatable(state, 1);
+                    lua_getfield(state, -1, internal_name);
+                    if (lua_isfunction(state, -1))
+                    {
+                        lua_insert(state, 1);
+                        lua_pcall(state, lua_gettop(state) - 1, 0, 0);
+                    }
+                    else if (lua_istable(state, 1)) // if is extended lua class
+                    {
+                        lua_pop(state, 2);
+                        lua_rawset(state, 1);
+                    }
+                    else if (LuaSubclass::Extended(state, -2) && LuaSubclass::PushInstanceTable(state, 1)) // fields of lua subclass object
+                    {
+                        lua_replace(state, 1);
+                        lua_pop(state, 2);
+                        lua_rawset(state, 1);
+                    }
+                    else
+                    {
+                        // check if user defined __newindex method
+                        lua_pop(state, 1);
+                        lua_getfield(state, -1, "!__newindex");
+                        if (lua_isfunction(state, -1))
+                        {
+                            lua_insert(state, 1);
+                            lua_pcall(state, lua_gettop(state) - 1, 0, 0);
+                        }
+                        else if (lua_istable(state, -1))
+                        {
+                            lua_replace(state, 1);
+                            lua_pop(state, 1);
+                            lua_rawset(state, 1);
+                        }
+                        else
+                        {
+                            lua_pop(state, 1);
+                            snprintf(internal_name, sizeof(internal_name), "<%s", key);
+                            lua_getfield(state, -1, internal_name);
+                            if (lua_isfunction(state, -1))
+                            {
+                                luaL_error(state, "attempt to write Read-Only property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
+                            }
+                            else
+                            {
+                                luaL_error(state, "attempt to access Non-existing property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
+                            }
+                        }
+                    }
+                    return 0;
+                }
+#endif
+            };
+
+            size_t strBufLen = strlen(name) + 1;
+            if (klassName == nullptr)
+            {
+                klassName = reinterpret_cast<char *>(malloc(strBufLen));
+                memcpy(klassName, name, strBufLen);
+            }
+            ++klassRefs;
+#if !LUAAA_WITHOUT_CPP_STDLIB
+            lock.unlock();
+#endif
+
+            char * clsName = reinterpret_cast<char *>(lua_newuserdata(state, strBufLen + 1));
+            memcpy(clsName, name, strBufLen);
+            clsName[strBufLen - 1] = '$';
+            clsName[strBufLen] = 0;
+            luaL_newmetatable(state, clsName);
+            luaL_Reg clsgc[] = { { "__gc", HelperClass::f__clsgc }, { nullptr, nullptr } };
+            luaL_setfuncs(state, clsgc, 0);
+            lua_setmetatable(state, -2);
+          
+            luaL_newmetatable(state, klassName);
+            luaL_Reg objgc[] = { 
+                { "__gc", HelperClass::f__objgc }, 
+#if LUAAA_FEATURE_PROPERTY
+                { "__index", HelperClass::f_internal_index },
+                { "__newindex", HelperClass::f_internal_newindex },
+#endif
+                { nullptr, nullptr } 
+            };
+            luaL_setfuncs(state, objgc, 0);
+
+#if !LUAAA_FEATURE_PROPERTY
+            // if not register __index function, uncomment below codes
+            lua_pushvalue(state, -1);
+            lua_setfield(state, -2, "__index");
+#endif
+
+            lua_pushvalue(state, -2);
+            lua_setfield(state, -2, "$");
+
+            if (functions)
+            {
+                luaL_setfuncs(state, functions, 0);
+            }
+
+            lua_pop(state, 2);
+        }
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        LuaClass(lua_State * state, const std::string& name, const luaL_Reg * functions = nullptr)
+            : LuaClass(state, name.c_str(), functions)
+        {}
+#endif
+
+        template<typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& ctor(const char * name = "new")
+        {
+            struct HelperClass {
+                static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail * uData) {
+                    if (uData && uData->obj)
+                    {
+                        (uData->obj)->~TCLASS();
+                    }
+                    return 0;
+                }
+
+                static int f_new(lua_State* state) {
+                    auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(state, sizeof(LuaClass<TCLASS, TAG>::UserDataDetail) + sizeof(TCLASS));
+                    if (uData)
+                    {
+                        TCLASS * obj = PlacementConstructorCaller<TCLASS, ARGS...>::Invoke(state, (void*)(uData + 1), 0);
+                        if (obj)
+                        {
+                            uData->obj = obj;
+                            uData->dtor = HelperClass::f_dtor;
+                            luaL_setmetatable(state, (LuaClass<TCLASS, TAG>::klassName));
+                            LuaBindOverridable(state, obj);
+                            return 1;
+                        }
+                        lua_pop(state, 1);
+                    }
+                    lua_pushnil(state);
+                    return 1;
+                }
+            };
+
+            luaaa_check_constructor_name_conflict(name);
+
+            luaL_Reg constructor[] = { { name, HelperClass::f_new }, { nullptr, nullptr } };
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, klassName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+            }
+            luaL_setfuncs(m_state, constructor, 0);
+            bindExtend();
+            lua_setglobal(m_state, klassName);
+#else
+            luaL_openlib(m_state, klassName, constructor, 0);
+            bindExtend();
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+        template<typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& ctor(const char * name, TCLASS*(*spawner)(ARGS...)) {
+            typedef decltype(spawner) SPAWNERFTYPE;
+            struct HelperClass {
+                static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail* uData) {
+                    if (uData && uData->obj)
+                    {
+                        DestructorCaller<TCLASS>::Invoke(uData->obj);
+                    }
+                    return 0;
+                }
+
+                static int f_new(lua_State* state) {
+                    void * spawner = lua_touserdata(state, lua_upvalueindex(1));
+                    luaL_argcheck(state, spawner, 1, "cpp closure spawner not found.");
+                    if (spawner) {
+                        auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(state, sizeof(LuaClass<TCLASS, TAG>::UserDataDetail));
+                        if (uData)
+                        {
+                            auto obj = LuaInvoke<checked, TCLASS*, SPAWNERFTYPE, ARGS...>(state, spawner, 0);
+                            if (obj)
+                            {
+                                uData->obj = obj;
+                                uData->dtor = HelperClass::f_dtor;
+                                luaL_setmetatable(state, (LuaClass<TCLASS, TAG>::klassName));
+                                LuaBindOverridable(state, obj);
+                                return 1;
+                            }
+                            lua_pop(state, 1);
+                        }
+                    }
+                    lua_pushnil(state);
+                    return 1;
+                }
+            };
+
+            luaaa_check_constructor_name_conflict(name);
+
+            luaL_Reg constructor[] = { { name, HelperClass::f_new }, { nullptr, nullptr } };
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, klassName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+            }
+#endif
+
+            SPAWNERFTYPE * spawnerPtr = (SPAWNERFTYPE*)lua_newuserdata(m_state, sizeof(SPAWNERFTYPE));
+#if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(m_state, spawnerPtr != nullptr, 1, "faild to alloc mem to store spawner for ctor");
+#else
+            luaL_argcheck(m_state, spawnerPtr != nullptr, 1, (std::string("faild to alloc mem to store spawner for ctor `") + name + "`").c_str());
+#endif
+            if (!spawnerPtr)
+            {
+                lua_pop(m_state, 1);
+                return  (*this);
+            }
+
+            memset(spawnerPtr, 0, sizeof(SPAWNERFTYPE));
+            *spawnerPtr = spawner;
+
+#if USE_NEW_MODULE_REGISTRY
+            luaL_setfuncs(m_state, constructor, 1);
+            bindExtend();
+            lua_setglobal(m_state, klassName);
+#else
+            luaL_openlib(m_state, klassName, constructor, 1);
+            bindExtend();
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+        template<typename TRET, typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& ctor(const char * name, TCLASS*(*spawner)(ARGS...), TRET(*deleter)(TCLASS*)){
+            typedef decltype(spawner) SPAWNERFTYPE;
+            typedef decltype(deleter) DELETERFTYPE;
+
+            struct HelperClass {
+                static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail* uData) {
+                    if (uData && uData->obj && uData->free_func)
+                    {
+                        (*(DELETERFTYPE*)(uData->free_func))(uData->obj);
+                    }
+                    return 0;
+                }
+
+                static int f_new(lua_State* state) {
+                    void * spawner = lua_touserdata(state, lua_upvalueindex(1));
+                    luaL_argcheck(state, spawner, 1, "cpp closure spawner not found.");
+
+                    void * deleter = lua_touserdata(state, lua_upvalueindex(2));
+                    luaL_argcheck(state, deleter, 2, "cpp closure deleter not found.");
+
+                    if (spawner) {
+                        auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(state, sizeof(LuaClass<TCLASS, TAG>::UserDataDetail));
+                        if (uData)
+                        {
+                            auto obj = LuaInvoke<checked, TCLASS*, SPAWNERFTYPE, ARGS...>(state, spawner, 0);
+                            if (obj)
+                            {
+                                uData->obj = obj;
+                                uData->dtor = HelperClass::f_dtor;
+                                uData->free_func = deleter;
+                                luaL_setmetatable(state, (LuaClass<TCLASS, TAG>::klassName));
+                                LuaBindOverridable(state, obj);
+                                return 1;
+                            }
+                            lua_pop(state, 1);
+                        }
+                    }
+                    lua_pushnil(state);
+                    return 1;
+                }
+            };
+
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, klassName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+            }
+#endif
+
+            SPAWNERFTYPE * spawnerPtr = (SPAWNERFTYPE*)lua_newuserdata(m_state, sizeof(SPAWNERFTYPE));
+#if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(m_state, spawnerPtr != nullptr, 0, ("faild to alloc mem to store spawner for ctor"));
+#else
+            luaL_argcheck(m_state, spawnerPtr != nullptr, 0, (std::string("faild to alloc mem to store spawner for ctor `") + name + "`").c_str());
+#endif
+            if (!spawnerPtr)
+            {
+                lua_pop(m_state, 2);
+                return (*this);
+            }
+
+            memset(spawnerPtr, 0, sizeof(SPAWNERFTYPE));
+            *spawnerPtr = spawner;
+
+            DELETERFTYPE * deleterPtr = (DELETERFTYPE*)lua_newuserdata(m_state, sizeof(DELETERFTYPE));
+#if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(m_state, deleterPtr != nullptr, 0, ("faild to alloc mem to store deleter for ctor"));
+#else
+            luaL_argcheck(m_state, deleterPtr != nullptr, 0, (std::string("faild to alloc mem to store deleter for ctor `") + name + "`").c_str());
+#endif
+            if (!deleterPtr)
+            {
+                lua_pop(m_state, 3);
+                return (*this);
+            }
+
+            memset(deleterPtr, 0, sizeof(DELETERFTYPE));
+            *deleterPtr = deleter;
+
+            luaL_Reg constructor[] = { { name, HelperClass::f_new }, { nullptr, nullptr } };
+#if USE_NEW_MODULE_REGISTRY
+            luaL_setfuncs(m_state, constructor, 2);
+            bindExtend();
+            lua_setglobal(m_state, klassName);
+#else
+            luaL_openlib(m_state, klassName, constructor, 2);
+            bindExtend();
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+        template<typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& ctor(const char * name, TCLASS*(*spawner)(ARGS...), std::nullptr_t) {
+            typedef decltype(spawner) SPAWNERFTYPE;
+
+            struct HelperClass {
+                static int f_new(lua_State* state) {
+                    void * spawner = lua_touserdata(state, lua_upvalueindex(1));
+                    luaL_argcheck(state, spawner, 1, "cpp closure spawner not found.");
+                    if (spawner) {
+                        auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(state, sizeof(LuaClass<TCLASS, TAG>::UserDataDetail));
+                        if (uData)
+                        {
+                            auto obj = LuaInvoke<checked, TCLASS*, SPAWNERFTYPE, ARGS...>(state, spawner, 0);
+                            if (obj)
+                            {
+                                uData->obj = obj;
+                                uData->dtor = nullptr;
+                                luaL_setmetatable(state, (LuaClass<TCLASS, TAG>::klassName));
+                                LuaBindOverridable(state, obj);
+                                return 1;
+                            }
+                            lua_pop(state, 1);
+                        }
+                    }
+                    lua_pushnil(state);
+                    return 1;
+                }
+
+            };
+
+            luaaa_check_constructor_name_conflict(name);
+
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, klassName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+            }
+#endif
+            SPAWNERFTYPE * spawnerPtr = (SPAWNERFTYPE*)lua_newuserdata(m_state, sizeof(SPAWNERFTYPE));
+#if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(m_state, spawnerPtr != nullptr, 1, "faild to alloc mem to store spawner for ctor of cpp class");
+#else
+            luaL_argcheck(m_state, spawnerPtr != nullptr, 1, (std::string("faild to alloc mem to store spawner for ctor `") + name + "`").c_str());
+#endif
+            if (!spawnerPtr)
+            {
+                lua_pop(m_state, 1);
+                return (*this);
+            }
+
+            memset(spawnerPtr, 0, sizeof(SPAWNERFTYPE));
+            *spawnerPtr = spawner;
+
+            luaL_Reg constructor[] = { { name, HelperClass::f_new }, { nullptr, nullptr } };
+#if USE_NEW_MODULE_REGISTRY
+            luaL_setfuncs(m_state, constructor, 1);
+            bindExtend();
+            lua_setglobal(m_state, klassName);
+#else
+            luaL_openlib(m_state, klassName, constructor, 1);
+            bindExtend();
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+       
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        template<typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& ctor(const std::string& name)
+        {
+            return ctor<ARGS...>(name.c_str());
+        }
+
+        template<typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& ctor(const std::string& name, TCLASS*(*spawner)(ARGS...)) {
+            return ctor(name.c_str(), spawner);
+        }
+
+        template<typename TRET, typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& ctor(const std::string& name, TCLASS*(*spawner)(ARGS...), TRET(*deleter)(TCLASS*)) {
+            return ctor(name.c_str(), spawner, deleter);
+        }
+
+        template<typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& ctor(const std::string& name, TCLASS*(*spawner)(ARGS...), std::nullptr_t) {
+            return ctor(name.c_str(), spawner, nullptr);
+        }
+#endif
+
+        // lets luaaa::transfer copy objects of this class into other states where the class is bound too.
+        // objects are copy constructed, or made by cloner and released like objects of ctor with spawner.
+        inline LuaClass<TCLASS, TAG>& clone()
+        {
+            struct HelperClass {
+                static int f_dtor(UserDataDetail * uData) {
+                    if (uData && uData->obj)
+                    {
+                        (uData->obj)->~TCLASS();
+                    }
+                    return 0;
+                }
+
+                static bool f_clone(lua_State * src, int idx, lua_State * dst, void *) {
+                    auto from = (UserDataDetail*)lua_touserdata(src, idx);
+                    if (from == nullptr || from->obj == nullptr)
+                    {
+                        return false;
+                    }
+                    auto uData = (UserDataDetail*)lua_newuserdata(dst, sizeof(UserDataDetail) + sizeof(TCLASS));
+                    uData->obj = new(uData + 1) TCLASS(*(from->obj));
+                    uData->dtor = HelperClass::f_dtor;
+                    uData->free_func = nullptr;
+                    luaL_setmetatable(dst, klassName);
+                    LuaBindOverridable(dst, uData->obj);
+                    return true;
+                }
+            };
+            LuaCloneHook hook = { HelperClass::f_clone };
+            return _cloneImpl(hook);
+        }
+
+        inline LuaClass<TCLASS, TAG>& clone(TCLASS * (*cloner)(const TCLASS&))
+        {
+            struct Hook {
+                LuaCloneHook hook;
+                TCLASS * (*cloner)(const TCLASS&);
+            };
+            struct HelperClass {
+                static int f_dtor(UserDataDetail * uData) {
+                    if (uData && uData->obj)
+                    {
+                        DestructorCaller<TCLASS>::Invoke(uData->obj);
+                    }
+                    return 0;
+                }
+
+                static bool f_clone(lua_State * src, int idx, lua_State * dst, void * data) {
+                    auto from = (UserDataDetail*)lua_touserdata(src, idx);
+                    TCLASS * obj = (from && from->obj) ? ((Hook*)data)->cloner(*(from->obj)) : nullptr;
+                    if (obj == nullptr)
+                    {
+                        return false;
+                    }
+                    auto uData = (UserDataDetail*)lua_newuserdata(dst, sizeof(UserDataDetail));
+                    uData->obj = obj;
+                    uData->dtor = HelperClass::f_dtor;
+                    uData->free_func = nullptr;
+                    luaL_setmetatable(dst, klassName);
+                    LuaBindOverridable(dst, obj);
+                    return true;
+                }
+            };
+            Hook hook = { { HelperClass::f_clone }, cloner };
+            return _cloneImpl(hook);
+        }
+
+    private:
+        // Class.extend() for lua subclass, class table of ctors is at top of stack.
+        inline void bindExtend()
+        {
+#if LUAAA_FEATURE_PROPERTY
+            LuaSubclass::Bind(m_state, klassName);
+#endif
+        }
+
+        template<typename HOOK>
+        inline LuaClass<TCLASS, TAG>& _cloneImpl(const HOOK& hook)
+        {
+            luaL_getmetatable(m_state, klassName);
+            lua_pushstring(m_state, "$clone");
+            HOOK * hookPtr = (HOOK*)lua_newuserdata(m_state, sizeof(HOOK));
+            *hookPtr = hook;
+            lua_rawset(m_state, -3);
+            lua_pop(m_state, 1);
+            return (*this);
+        }
+
+    public:
+        // copies methods and properties of bound base class into this class, and lets this class
+        // be passed where TBASE is expected. base class must be bound before, later changes to it are not copied.
+        template<typename TBASE, int BASETAG = 0>
+        inline LuaClass<TCLASS, TAG>& base()
+        {
+            static_assert(LuaStaticBase<TCLASS, TBASE>::value, "TBASE must be an accessible, unambiguous and non-virtual base of TCLASS");
+            luaL_argcheck(m_state, (LuaClass<TBASE, BASETAG>::klassName != nullptr), 1, "base class not export");
+            // pointer adjustment from TCLASS* to TBASE*, fixed for non-virtual bases, taken on aligned local storage.
+            typename std::aligned_storage<sizeof(TCLASS), alignof(TCLASS)>::type storage;
+            const lua_Integer offset = (lua_Integer)((char*)static_cast<TBASE*>((TCLASS*)&storage) - (char*)&storage);
+
+            luaL_getmetatable(m_state, klassName);
+            luaL_getmetatable(m_state, (LuaClass<TBASE, BASETAG>::klassName));
+            lua_pushnil(m_state);
+            while (lua_next(m_state, -2) != 0)
+            {
+                bool copy = true;
+                if (lua_type(m_state, -2) == LUA_TSTRING)
+                {
+                    const char * key = lua_tostring(m_state, -2);
+                    copy = key[0] != '$' && strcmp(key, "!__gc") != 0
+                        && strcmp(key, "__gc") != 0 && strcmp(key, "__index") != 0 && strcmp(key, "__newindex") != 0
+                        && strcmp(key, "__name") != 0 && strcmp(key, "__metatable") != 0;
+                }
+                else if (lua_type(m_state, -2) == LUA_TLIGHTUSERDATA)
+                {
+                    // bases of base, offsets add up.
+                    const lua_Integer baseOffset = lua_tointeger(m_state, -1);
+                    lua_pop(m_state, 1);
+                    lua_pushinteger(m_state, baseOffset + offset);
+                }
+
+                if (copy)
+                {
+                    // own definitions win over inherited ones.
+                    lua_pushvalue(m_state, -2);
+                    lua_rawget(m_state, -5);
+                    copy = lua_isnil(m_state, -1);
+                    lua_pop(m_state, 1);
+                }
+                if (copy)
+                {
+                    lua_pushvalue(m_state, -2);
+                    lua_insert(m_state, -2);
+                    lua_rawset(m_state, -5);
+                }
+                else
+                {
+                    lua_pop(m_state, 1);
+                }
+            }
+            lua_pop(m_state, 1);
+
+            lua_pushlightuserdata(m_state, (void*)&LuaClass<TBASE, BASETAG>::klassName);
+            lua_pushinteger(m_state, offset);
+            lua_rawset(m_state, -3);
+            lua_pop(m_state, 1);
+            LuaClass<TBASE, BASETAG>::klassDerived = true;
+            return (*this);
+        }
+
+        // binds C++ operator as lua metamethod, e.g. op<luaaa::ops::add>() for T + T, op<luaaa::ops::mul, T, float>() for T * float.
+        // each call adds one pair of operand types, the metamethod tries them from the latest one.
+        template<typename OP, typename A = TCLASS, typename B = A>
+        inline LuaClass<TCLASS, TAG>& op()
+        {
+            return _op<A, B>((OP*)nullptr);
+        }
+
+    private:
+        // user defined __gc/__index/__newindex are saved with prefix '!', internal ones call them.
+        inline void _pushFunctionName(const char* name)
+        {
+            if (strcmp(name, "__gc") == 0)
+            {
+                lua_pushstring(m_state, "!__gc");
+            }
+#if LUAAA_FEATURE_PROPERTY
+            else if (strcmp(name, "__index") == 0)
+            {
+                lua_pushstring(m_state, "!__index");
+            }
+            else if (strcmp(name, "__newindex") == 0)
+            {
+                lua_pushstring(m_state, "!__newindex");
+            }
+#endif
+            else
+            {
+                lua_pushstring(m_state, name);
+            }
+        }
+
+        template<typename F>
+        inline LuaClass<TCLASS, TAG>& _registerClassFunction(const char* name, lua_CFunction caller, F f)
+        {
+            luaL_getmetatable(m_state, klassName);
+            _pushFunctionName(name);
+
+            F* funPtr = (F*)lua_newuserdata(m_state, sizeof(F));
+#if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(m_state, funPtr != nullptr, 1, "faild to alloc mem to store function");
+#else
+            luaL_argcheck(m_state, funPtr != nullptr, 1, (std::string("faild to alloc mem to store function `") + name + "`").c_str());
+#endif
+            if (funPtr)
+            {
+                memset(funPtr, 0, sizeof(F));
+                *funPtr = f;
+                lua_pushcclosure(m_state, caller, 1);
+                lua_settable(m_state, -3);
+                lua_pop(m_state, 1);
+            }
+            else
+            {
+                lua_pop(m_state, 2);
+            }
+            return (*this);
+        }
+
+    private:
+        template<typename POLICY, typename F>
+        inline LuaClass<TCLASS, TAG>& _funImpl(const char * name, F f)
+        {
+            return _registerClassFunction(name, MemberFunctionCaller<POLICY>(f), f);
+        }
+
+        template<typename A, typename B, typename OP>
+        inline LuaClass<TCLASS, TAG>& _op(OP*)
+        {
+            luaL_getmetatable(m_state, klassName);
+            lua_pushstring(m_state, OP::name());
+            lua_pushvalue(m_state, -1);
+            lua_rawget(m_state, -3);
+            lua_pushcclosure(m_state, LuaOperator<OP, A, B>::invoke, 1);
+            lua_rawset(m_state, -3);
+            lua_pop(m_state, 1);
+            return (*this);
+        }
+
+        template<typename A, typename B>
+        inline LuaClass<TCLASS, TAG>& _op(ops::call*)
+        {
+            return _funImpl<LuaDefaultPolicy>(ops::call::name(), &TCLASS::operator());
+        }
+
+    public:
+        template<typename POLICY = LuaDefaultPolicy, typename FCLASS, typename FRET, typename ...FARGS>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, FRET(FCLASS::*f)(FARGS...))
+        {
+            return _funImpl<POLICY>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename FCLASS, typename FRET, typename ...FARGS>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, FRET(FCLASS::*f)(FARGS...) const)
+        {
+            return _funImpl<POLICY>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename FCLASS, typename ...FARGS>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, void(FCLASS::*f)(FARGS...))
+        {
+            return _funImpl<POLICY>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename FCLASS, typename ...FARGS>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, void(FCLASS::*f)(FARGS...) const)
+        {
+            return _funImpl<POLICY>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename FRET, typename ...FARGS>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, FRET(*f)(FARGS...))
+        {
+            return _funImpl<POLICY>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename ...FARGS>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, void(*f)(FARGS...))
+        {
+            return _funImpl<POLICY>(name, f);
+        }
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        // register lambdas as lua class function
+        template<typename POLICY = LuaDefaultPolicy, typename TRET, typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, const std::function<TRET(ARGS...)>& f)
+        {
+            return _funImpl<POLICY, std::function<TRET(ARGS...)>>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename ...ARGS>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, const std::function<void(ARGS...)>& f)
+        {
+            return _funImpl<POLICY, std::function<void(ARGS...)>>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename F>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, F f)
+        {
+            return fun<POLICY>(name, to_function(f));
+        }
+#endif
+
+        // register overloaded functions under one name, the target is selected by lua arg count and types.
+        template<typename POLICY = LuaDefaultPolicy, typename F1, typename F2, typename ...FS>
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, F1 f1, F2 f2, FS... fs)
+        {
+            luaL_getmetatable(m_state, klassName);
+            _pushFunctionName(name);
+            LuaPushOverloadSet<LuaMemberFunctionCallerMaker<POLICY>>(m_state, name, f1, f2, fs...);
+            lua_settable(m_state, -3);
+            lua_pop(m_state, 1);
+            return (*this);
+        }
+
+        inline LuaClass<TCLASS, TAG>& fun(const char * name, lua_CFunction f)
+        {
+            luaL_getmetatable(m_state, klassName);
+            _pushFunctionName(name);
+            lua_pushcclosure(m_state, f, 0);
+            lua_settable(m_state, -3);
+            lua_pop(m_state, 1);
+            return (*this);
+        }
+
+        template <typename V>
+        inline LuaClass<TCLASS, TAG>& def(const char * name, const V& val)
+        {
+            luaL_getmetatable(m_state, klassName);
+            lua_pushstring(m_state, name);
+            LuaStack<V>::put(m_state, val);
+            lua_settable(m_state, -3);
+            lua_pop(m_state, 1);
+            return (*this);
+        }
+
+        // disable cast from "const char [#]" to "char (*)[#]"
+        inline LuaClass<TCLASS, TAG>& def(const char* name, const char* str)
+        {
+            luaL_getmetatable(m_state, klassName);
+            lua_pushstring(m_state, name);
+            LuaStack<decltype(str)>::put(m_state, str);
+            lua_settable(m_state, -3);
+            lua_pop(m_state, 1);
+            return (*this);
+        }
+      
+    private:
+        template <typename F>
+        inline LuaClass<TCLASS, TAG>& _getterImpl(const char* name, lua_CFunction invoker, F f)
+        {
+#if LUAAA_FEATURE_PROPERTY
+            char internal_name[256];
+            snprintf(internal_name, sizeof(internal_name), "<%s", name);
+            return _registerClassFunction(internal_name, invoker, f);
+#else
+            return *this;
+#endif
+        }
+
+        template<typename F>
+        inline LuaClass<TCLASS, TAG>& _setterImpl(const char* name, lua_CFunction invoker, F f)
+        {
+#if LUAAA_FEATURE_PROPERTY
+            char internal_name[256];
+            snprintf(internal_name, sizeof(internal_name), ">%s", name);
+            return _registerClassFunction(internal_name, invoker, f);
+#else
+            return *this;
+#endif
+        }
+
+    public:
+        template<typename P>
+        inline LuaClass<TCLASS, TAG>& get(const char* name, P(*f)())
+        {
+            struct HelperClass {
+                typedef decltype(f) FTYPE;
+                static inline int Invoke(lua_State* state) {
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1)); 
+                    if (calleePtr)
+                    {
+                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))());
+                    }
+                    else
+                    {
+                        lua_pushnil(state);
+                    }
+                    return 1;
+                }
+            };
+            return _getterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename P>
+        inline LuaClass<TCLASS, TAG>& get(const char* name, P(*f)(const TCLASS&))
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1)));
+                    }
+                    else
+                    {
+                        lua_pushnil(state);
+                    }
+                    return 1;
+                }
+            };
+            return _getterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename P, typename FCLASS>
+        inline LuaClass<TCLASS, TAG>& get(const char* name, P(FCLASS::*f)()const)
+        {
+            static_assert(std::is_same<std::decay<TCLASS>, std::decay<FCLASS>>::value, "Error: prop function can be member function of only associated class");
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        LuaStackReturn<P>(state, (LuaStack<TCLASS>::get(state, 1).**(FTYPE*)(calleePtr))());
+                    }
+                    else
+                    {
+                        lua_pushnil(state);
+                    }
+                    return 1;
+                }
+            };
+            return _getterImpl(name, HelperClass::Invoke, f);
+        }
+
+
+        template<typename P, typename TRET>
+        inline LuaClass<TCLASS, TAG>& set(const char* name, TRET(*f)(P))
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        (*(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
+                    }
+                    return 0;
+                }
+            };
+            return _setterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename P, typename TRET, typename FCLASS>
+        inline LuaClass<TCLASS, TAG>& set(const char* name, TRET(FCLASS::* f)(P))
+        {
+            static_assert(std::is_same<std::decay<TCLASS>, std::decay<FCLASS>>::value, "prop function can be member function of only associated class");
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        (LuaStack<TCLASS>::get(state, 1).**(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
+                    }
+                    return 0;
+                }
+            };
+            return _setterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename P, typename TRET>
+        inline LuaClass<TCLASS, TAG>& set(const char* name, TRET(*f)(TCLASS&, P))
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1), LuaStack<P>::get(state, 3));
+                    }
+                    return 0;
+                }
+            };
+            return _setterImpl(name, HelperClass::Invoke, f);
+        }
+
+
+    public:
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        // access prop from lambdas
+        template<typename P>
+        inline LuaClass<TCLASS, TAG>& get(const char* name, std::function<P()> f)
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))());
+                    }
+                    else
+                    {
+                        lua_pushnil(state);
+                    }
+                    return 1;
+                }
+            };
+            return _getterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename P>
+        inline LuaClass<TCLASS, TAG>& get(const char* name, std::function<P(const TCLASS&)> f)
+        {
+            struct HelperClass {
+                
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1)));
+                    }
+                    else
+                    {
+                        lua_pushnil(state);
+                    }
+                    return 1;
+                }
+            };
+            return _getterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename P>
+        inline LuaClass<TCLASS, TAG>& get(const char* name, std::function<P(TCLASS&)> f)
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1)));
+                    }
+                    else
+                    {
+                        lua_pushnil(state);
+                    }
+                    return 1;
+                }
+            };
+            return _getterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename F>
+        inline LuaClass<TCLASS, TAG>& get(const char* name, F f)
+        {
+            return get(name, to_class_getter_function<TCLASS>(f));
+        }
+
+        template<typename P, typename TRET>
+        inline LuaClass<TCLASS, TAG>& set(const char* name, std::function<TRET(P)> f)
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        (*(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
+                    }
+                    return 0;
+                }
+            };
+            return _setterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename P, typename TRET>
+        inline LuaClass<TCLASS, TAG>& set(const char* name, std::function<TRET(TCLASS&, P)> f)
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1), LuaStack<P>::get(state, 3));
+                    }
+                    return 0;
+                }
+            };
+            return _setterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename P, typename TRET>
+        inline LuaClass<TCLASS, TAG>& set(const char* name, std::function<TRET(const TCLASS&, P)> f)
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        (*(FTYPE*)(calleePtr))(LuaStack<TCLASS>::get(state, 1), LuaStack<P>::get(state, 3));
+                    }
+                    return 0;
+                }
+            };
+            return _setterImpl(name, HelperClass::Invoke, f);
+        }
+
+        //template<typename F>
+        //inline LuaClass<TCLASS, TAG>& set(const char* name, std::function<F> f)
+        //{
+        //    //static_assert(false, "Error: invalid signature of setter function");
+        //    assert(!"Error: invalid signature of setter function");
+        //    return (*this);
+        //}
+
+        template<typename F>
+        inline LuaClass<TCLASS, TAG>& set(const char* name, F f)
+        {
+            return set(name, to_class_setter_function<TCLASS>(f));
+        }
+#endif
+
+    public:
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        template<typename POLICY = LuaDefaultPolicy, typename F>
+        inline LuaClass<TCLASS, TAG>& fun(const std::string& name, F f)
+        {
+            return fun<POLICY>(name.c_str(), f);
+        }
+
+        inline LuaClass<TCLASS, TAG>& fun(const std::string& name, lua_CFunction f)
+        {
+            return fun(name.c_str(), f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename F1, typename F2, typename ...FS>
+        inline LuaClass<TCLASS, TAG>& fun(const std::string& name, F1 f1, F2 f2, FS... fs)
+        {
+            return fun<POLICY>(name.c_str(), f1, f2, fs...);
+        }
+
+        template <typename V>
+        inline LuaClass<TCLASS, TAG>& def(const std::string& name, const V& val)
+        {
+            return def(name.c_str(), val);
+        }
+
+        template <typename F>
+        inline LuaClass<TCLASS, TAG>& get(const std::string& name, F f)
+        {
+            return get(name.c_str(), f);
+        }
+
+        template <typename F>
+        inline LuaClass<TCLASS, TAG>& set(const std::string& name, F f)
+        {
+            return set(name.c_str(), f);
+        }
+#endif
+
+    private:
+        lua_State * m_state;
+
+    private:
+        static char * klassName;
+        static int klassRefs;
+        // set once another class called base<TCLASS>(), unchecked args then look up the upcast.
+        static bool klassDerived;
+    };
+
+    template <typename TCLASS, int TAG> char * LuaClass<TCLASS, TAG>::klassName = nullptr;
+    template <typename TCLASS, int TAG> int LuaClass<TCLASS, TAG>::klassRefs = 0;
+    template <typename TCLASS, int TAG> bool LuaClass<TCLASS, TAG>::klassDerived = false;
+
+
+    // -----------------------------------
+    // export module
+    // -----------------------------------
+    struct LuaModule
+    {
+    public:
+        LuaModule(lua_State * state, const char * name = "_G")
+            : m_state(state)
+        {
+            size_t strBufLen = strlen(name) + 1;
+            m_moduleName = new char[strBufLen];
+            memcpy(m_moduleName, name, strBufLen);
+            def("__name", m_moduleName);
+        }
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        LuaModule(lua_State * state, const std::string& name)
+            : LuaModule(state, name.empty() ? "_G" : name.c_str())
+        {}
+#endif
+
+        ~LuaModule()
+        {
+            if (m_moduleName) {
+                delete[] m_moduleName;
+                m_moduleName = nullptr;
+            }
+        }
+
+    private:
+        void _initMetaTable(lua_State * state, int idx) {
+            struct HelperClass {
+#if LUAAA_FEATURE_PROPERTY
+                static int f_internal_index(lua_State* state)
+                {
+                    const char* key = luaL_checkstring(state, 2);
+                    if (!key)
+                    {
+                        lua_pushnil(state);
+                        return 1;
+                    }
+                    // lookup module first
+                    lua_pushstring(state, key);
+                    lua_rawget(state, 1);
+                    if (!lua_isnil(state, -1))
+                    {
+                        return 1;
+                    }
+
+                    lua_pop(state, 1);
+
+                    // then lookup registered property
+                    char internal_name[256];
+                    snprintf(internal_name, sizeof(internal_name), "<%s", key);
+
+                    lua_getmetatable(state, 1);
+                    lua_pushstring(state, internal_name);
+                    lua_rawget(state, -2);
+                    if (lua_isfunction(state, -1))
+                    {
+                        lua_insert(state, 1);
+                        lua_pcall(state, lua_gettop(state) - 1, 1, 0);
+                    }
+                    else
+                    {
+                        // check if user defined __index method
+                        lua_pop(state, 3);
+                        lua_pushstring(state, "__index");
+                        lua_rawget(state, 1);
+                        if (lua_isfunction(state, -1))
+                        {
+                            lua_insert(state, 1);
+                            lua_pcall(state, lua_gettop(state) - 1, 1, 0);
+                        }
+                        else if (lua_istable(state, -1))
+                        {
+                            lua_replace(state, 1);
+                            lua_rawget(state, 1);
+                        }
+                        else
+                        {
+                            // no custom __index
+                            lua_getmetatable(state, 1);
+                            snprintf(internal_name, sizeof(internal_name), ">%s", key);
+                            lua_pushstring(state, internal_name);
+                            lua_rawget(state, -2);
+                            if (lua_isfunction(state, -1))
+                            {
+                                lua_pushstring(state, "__name");
+                                lua_rawget(state, -3);
+                                luaL_error(state, "attempt to read Write-Only property '%s' of '%s'", luaL_optstring(state, -1, "?"));
+                            }
+                            else
+                            {
+                                // do nothing here. nil will be return.
+                                // luaL_error(state, "attempt to access Non-existing property '%s' of '%s'", key, LuaClass<TCLASS, TAG>::klassName);
+                            }
+                        }
+                    }
+                    return 1;
+                }
+
+                static int f_internal_newindex(lua_State* state)
+                {
+                    const char* key = luaL_checkstring(state, 2);
+                    if (!key)
+                    {
+                        lua_pushnil(state);
+                        return 1;
+                    }
+
+                    char internal_name[256];
+                    snprintf(internal_name, sizeof(internal_name), ">%s", key);
+
+                    lua_getmetatable(state, 1);
+                    lua_pushstring(state, internal_name);
+                    lua_rawget(state, -2);
+                    if (lua_isfunction(state, -1))
+                    {
+                        lua_insert(state, 1);
+                        lua_pcall(state, lua_gettop(state) - 1, 0, 0);
+                    }
+                    else
+                    {
+                        lua_pop(state, 1);
+                        snprintf(internal_name, sizeof(internal_name), "<%s", key);
+                        lua_pushstring(state, internal_name);
+                        lua_rawget(state, -2);
+                        if (lua_isfunction(state, -1))
+                        {
+                            luaL_error(state, "attempt to write Read-Only property '%s' of '?'", key);
+                        }
+                        else
+                        {
+                            lua_pop(state, 2);
+                            // no associated property, lookup current module
+                            if (lua_istable(state, 1))
+                            {
+                                // check if user defined __newindex
+                                lua_pushstring(state, "__newindex");
+                                lua_rawget(state, 1);
+                                if (lua_isfunction(state, -1))
+                                {
+                                    lua_insert(state, 1);
+                                    lua_pcall(state, lua_gettop(state) - 1, 0, 0);
+                                }
+                                else if (lua_istable(state, -1))
+                                {
+                                    lua_replace(state, 1);
+                                    lua_rawset(state, 1);
+                                }
+                                else
+                                {
+                                    // no custom __newindex
+                                    lua_pop(state, 1);
+                                    lua_rawset(state, 1);
+                                }
+                            }
+                        }
+                    }
+                    return 0;
+                }
+#endif
+            };
+
+            luaL_newmetatable(state, m_moduleName);
+            luaL_Reg objfunc[] = {
+#if LUAAA_FEATURE_PROPERTY
+                { "__index", HelperClass::f_internal_index },
+                { "__newindex", HelperClass::f_internal_newindex },
+#endif
+                { nullptr, nullptr }
+            };
+            luaL_setfuncs(state, objfunc, 0);
+            lua_setmetatable(state, -2);
+        }
+
+        template<typename F>
+        inline LuaModule& _registerModuleFunction(const char* name, lua_CFunction caller, F f) {
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, m_moduleName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+                _initMetaTable(m_state, -1);
+            }
+
+            F* funPtr = (F*)lua_newuserdata(m_state, sizeof(F));
+#   if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(m_state, funPtr != nullptr, 1, "faild to alloc mem to store function of module");
+#   else
+            luaL_argcheck(m_state, funPtr != nullptr, 1, (std::string("faild to alloc mem to store function `") + name + "`").c_str());
+#   endif
+            if (!funPtr)
+            {
+                lua_pop(m_state, 2);
+                return (*this);
+            }
+
+            memset(funPtr, 0, sizeof(F));
+            *funPtr = f;
+
+            lua_pushvalue(m_state, -1);
+            lua_pushcclosure(m_state, caller, 1);
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -4);
+            lua_pop(m_state, 1);
+            lua_setglobal(m_state, m_moduleName);
+#else
+            luaL_Reg regtab[] = { { name, caller },{ nullptr, nullptr } };
+            F* funPtr = (F*)lua_newuserdata(m_state, sizeof(F));
+#   if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(m_state, funPtr != nullptr, 1, "faild to alloc mem to store function of module");
+#   else
+            luaL_argcheck(m_state, funPtr != nullptr, 1, (std::string("faild to alloc mem to store function `") + name + "`").c_str());
+#   endif
+            if (funPtr)
+            {
+                memset(funPtr, 0, sizeof(F));
+                *funPtr = f;
+                luaL_openlib(m_state, m_moduleName, regtab, 1);
+                lua_pop(m_state, 1);
+            }
+#endif
+            return (*this);
+        }
+
+        template<typename POLICY, typename F>
+        inline LuaModule& _funImpl(const char * name, F f)
+        {
+            return _registerModuleFunction(name, NonMemberFunctionCaller<POLICY>(f), f);
+        }
+
+    public:
+        template<typename POLICY = LuaDefaultPolicy, typename FRET, typename ...FARGS>
+        inline LuaModule& fun(const char * name, FRET(*f)(FARGS...))
+        {
+            return _funImpl<POLICY>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename ...FARGS>
+        inline LuaModule& fun(const char * name, void(*f)(FARGS...))
+        {
+            return _funImpl<POLICY>(name, f);
+        }
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        template<typename POLICY = LuaDefaultPolicy, typename TRET, typename ...ARGS>
+        inline LuaModule& fun(const char * name, const std::function<TRET(ARGS...)>& f)
+        {
+            return _funImpl<POLICY, std::function<TRET(ARGS...)>>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename ...ARGS>
+        inline LuaModule& fun(const char * name, const std::function<void(ARGS...)>& f)
+        {
+            return _funImpl<POLICY, std::function<void(ARGS...)>>(name, f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename F>
+        inline LuaModule& fun(const char * name, F f)
+        {
+            return fun<POLICY>(name, to_function(f));
+        }
+#endif
+
+        // register overloaded functions under one name, the target is selected by lua arg count and types.
+        template<typename POLICY = LuaDefaultPolicy, typename F1, typename F2, typename ...FS>
+        inline LuaModule& fun(const char * name, F1 f1, F2 f2, FS... fs)
+        {
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, m_moduleName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+                _initMetaTable(m_state, -1);
+            }
+            LuaPushOverloadSet<LuaNonMemberFunctionCallerMaker<POLICY>>(m_state, name, f1, f2, fs...);
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -3);
+            lua_setglobal(m_state, m_moduleName);
+#else
+            luaL_Reg regtab = { nullptr, nullptr };
+            luaL_openlib(m_state, m_moduleName, &regtab, 0);
+            LuaPushOverloadSet<LuaNonMemberFunctionCallerMaker<POLICY>>(m_state, name, f1, f2, fs...);
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -3);
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+        // register batched variant of f(T) -> R, see luaaa::map.
+        template<typename F>
+        inline LuaModule& batch(const char * name, F f)
+        {
+            typedef typename LuaCallable<F>::type FTYPE;
+            return _registerModuleFunction(name, LuaBatchFunction<FTYPE>::caller(), FTYPE(LuaCallable<F>::get(f)));
+        }
+
+        inline LuaModule& fun(const char * name, lua_CFunction f)
+        {
+            
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, m_moduleName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+                _initMetaTable(m_state, -1);
+            }
+            lua_pushcclosure(m_state, f, 0);
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -3);
+            lua_setglobal(m_state, m_moduleName);
+#else
+            luaL_Reg regtab[] = { { name, f },{ nullptr, nullptr } };
+            luaL_openlib(m_state, m_moduleName, regtab, 0);
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+        template <typename V>
+        inline LuaModule& def(const char * name, const V& val)
+        {
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, m_moduleName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+                _initMetaTable(m_state, -1);
+            }
+            LuaStack<V>::put(m_state, val);
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -3);
+            lua_setglobal(m_state, m_moduleName);
+#else
+            luaL_Reg regtab = { nullptr, nullptr };
+            luaL_openlib(m_state, m_moduleName, &regtab, 0);
+            LuaStack<V>::put(m_state, val);
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -3);
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+        template <typename TCLASS, int TAG>
+        inline LuaModule& def(const char* name, const luaaa::LuaClass<TCLASS, TAG>&, const TCLASS* obj = nullptr, void(*deleter)(TCLASS*) = nullptr)
+        {
+            typename LuaClass<TCLASS, TAG>::UserDataDetail userData{};
+            if (obj)
+            {
+                userData.obj = const_cast<TCLASS*>(obj);
+                if (deleter)
+                {
+                    struct HelperClass
+                    {
+                        static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail* uData) {
+                            typedef decltype(deleter) DELETERFTYPE;
+                            if (uData && uData->obj && uData->free_func)
+                            {
+                                ((DELETERFTYPE)(uData->free_func))(uData->obj);
+                                uData->obj = nullptr;
+                            }
+                            return 0;
+                        }
+                    };
+
+                    userData.dtor = HelperClass::f_dtor;
+                    userData.free_func = (void*)(deleter);
+                }
+                else
+                {
+                    userData.dtor = nullptr;
+                    userData.free_func = nullptr;
+                }
+            }
+            else
+            {
+                struct HelperClass
+                {
+                    static int f_dtor(typename LuaClass<TCLASS, TAG>::UserDataDetail* uData)
+                    {
+                        if (uData && uData->obj)
+                        {
+                            delete uData->obj;
+                            uData->obj = nullptr;
+                        }
+                        return 0;
+                    }
+                };
+                userData.obj = new TCLASS;
+                userData.dtor = HelperClass::f_dtor;
+                userData.free_func = nullptr;
+            }
+
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, m_moduleName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+                _initMetaTable(m_state, -1);
+            }
+            auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(m_state, sizeof(typename LuaClass<TCLASS, TAG>::UserDataDetail));
+#if LUAAA_WITHOUT_CPP_STDLIB
+            luaL_argcheck(m_state, uData != nullptr, 1, "faild to alloc mem to store object");
+#else
+            luaL_argcheck(m_state, uData != nullptr, 1, (std::string("faild to alloc mem to store object `") + name + "`").c_str());
+#endif
+            if (uData)
+            {
+                uData->obj = userData.obj;
+                uData->dtor = userData.dtor;
+                uData->free_func = userData.free_func;
+                luaL_setmetatable(m_state, (LuaClass<TCLASS, TAG>::klassName));
+                lua_pushstring(m_state, name);
+                lua_insert(m_state, -2);
+                lua_rawset(m_state, -3);
+                lua_setglobal(m_state, m_moduleName);
+            }
+            else
+            {
+                lua_pop(m_state, 2);
+            }
+#else
+            luaL_Reg regtab = { nullptr, nullptr };
+            luaL_openlib(m_state, m_moduleName, &regtab, 0);
+            auto uData = (typename LuaClass<TCLASS, TAG>::UserDataDetail*)lua_newuserdata(m_state, sizeof(typename LuaClass<TCLASS, TAG>::UserDataDetail));
+            if (uData)
+            {
+                uData->obj = userData.obj;
+                uData->dtor = userData.dtor;
+                uData->free_func = userData.free_func;
+                luaL_setmetatable(m_state, (LuaClass<TCLASS, TAG>::klassName));
+                lua_pushstring(m_state, name);
+                lua_insert(m_state, -2);
+                lua_rawset(m_state, -3);
+            }
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+        template <typename V>
+        inline LuaModule& def(const char * name, const V val[], size_t length)
+        {
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, m_moduleName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+                _initMetaTable(m_state, -1);
+            }
+            lua_newtable(m_state);
+            for (size_t idx = 0; idx < length; ++idx)
+            {
+                LuaStack<V>::put(m_state, val[idx]);
+                lua_rawseti(m_state, -2, idx + 1);
+            }
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -3);
+            lua_setglobal(m_state, m_moduleName);
+#else
+            luaL_Reg regtab = { nullptr, nullptr };
+            luaL_openlib(m_state, m_moduleName, &regtab, 0);
+            lua_newtable(m_state);
+            for (size_t idx = 0; idx < length; ++idx)
+            {
+                LuaStack<V>::put(m_state, val[idx]);
+                lua_rawseti(m_state, -2, idx + 1);
+            }
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -3);
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+        // disable the cast from "const char [#]" to "char (*)[#]"
+        inline LuaModule& def(const char * name, const char * str)
+        {
+#if USE_NEW_MODULE_REGISTRY
+            lua_getglobal(m_state, m_moduleName);
+            if (lua_isnil(m_state, -1))
+            {
+                lua_pop(m_state, 1);
+                lua_newtable(m_state);
+                _initMetaTable(m_state, -1);
+            }
+            LuaStack<decltype(str)>::put(m_state, str);
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -3);
+            lua_setglobal(m_state, m_moduleName);
+#else
+            luaL_Reg regtab = { nullptr, nullptr };
+            luaL_openlib(m_state, m_moduleName, &regtab, 0);
+            LuaStack<decltype(str)>::put(m_state, str);
+            lua_pushstring(m_state, name);
+            lua_insert(m_state, -2);
+            lua_rawset(m_state, -3);
+            lua_pop(m_state, 1);
+#endif
+            return (*this);
+        }
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        template<typename POLICY = LuaDefaultPolicy, typename F>
+        inline LuaModule& fun(const std::string& name, F f)
+        {
+            return fun<POLICY>(name.c_str(), f);
+        }
+
+        inline LuaModule& fun(const std::string& name, lua_CFunction f)
+        {
+            return fun(name.c_str(), f);
+        }
+
+        template<typename POLICY = LuaDefaultPolicy, typename F1, typename F2, typename ...FS>
+        inline LuaModule& fun(const std::string& name, F1 f1, F2 f2, FS... fs)
+        {
+            return fun<POLICY>(name.c_str(), f1, f2, fs...);
+        }
+
+        template<typename F>
+        inline LuaModule& batch(const std::string& name, F f)
+        {
+            return batch(name.c_str(), f);
+        }
+
+        template <typename V>
+        inline LuaModule& def(const std::string& name, const V& val)
+        {
+            return def(name.c_str(), val);
+        }
+#endif
+
+    private:
+        template <typename F>
+        inline LuaModule& _getterImpl(const char* name, lua_CFunction invoker, F f)
+        {
+#if LUAAA_FEATURE_PROPERTY
+            char internal_name[256];
+            snprintf(internal_name, sizeof(internal_name), "<%s", name);
+            return _registerModuleFunction(internal_name, invoker, f);
+#else
+            return *this;
+#endif
+        }
+
+        template<typename F>
+        inline LuaModule& _setterImpl(const char* name, lua_CFunction invoker, F f)
+        {
+#if LUAAA_FEATURE_PROPERTY
+            char internal_name[256];
+            snprintf(internal_name, sizeof(internal_name), ">%s", name);
+            return _registerModuleFunction(internal_name, invoker, f);
+#else
+            return *this;
+#endif
+        }
+
+    public:
+        template<typename P>
+        inline LuaModule& get(const char* name, P(*f)())
+        {
+            static_assert(!std::is_void<P>::value, "Error: getter function must return a value.");
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))());
+                    }
+                    else
+                    {
+                        lua_pushnil(state);
+                    }
+                    return 1;
+                }
+            };
+            return _getterImpl(name, HelperClass::Invoke, f);
+        }
+
+        template<typename P, typename TRET>
+        inline LuaModule& set(const char* name, TRET(*f)(P))
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        (*(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
+                    }
+                    return 0;
+                }
+            };
+            return _setterImpl(name, HelperClass::Invoke, f);
+        }
+
+    public:
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        // access prop from lambdas
+        template<typename P>
+        inline LuaModule& get(const char* name, std::function<P()> f)
+        {
+            static_assert(!std::is_void<P>::value, "Error: getter function must return a value.");
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        LuaStackReturn<P>(state, (*(FTYPE*)(calleePtr))());
+                    }
+                    else
+                    {
+                        lua_pushnil(state);
+                    }
+                    return 1;
+                }
+            };
+            return _getterImpl(name, HelperClass::Invoke, f);
+        }
+
+        // template<typename F>
+        // inline LuaModule& get(const char* name, std::function<F> f)
+        // {
+        //     //static_assert(false, "Error: invalid signature of getter function");
+        //     assert(!"Error: invalid signature of getter function");
+        //     return (*this);
+        // }
+
+        template<typename F>
+        inline LuaModule& get(const char* name, F f)
+        {
+            return get(name, to_module_getter_function(f));
+        }
+
+        template<typename P, typename TRET>
+        inline LuaModule& set(const char* name, std::function<TRET(P)> f)
+        {
+            struct HelperClass {
+                static inline int Invoke(lua_State* state) {
+                    typedef decltype(f) FTYPE;
+                    void* calleePtr = lua_touserdata(state, lua_upvalueindex(1));
+                    if (calleePtr)
+                    {
+                        (*(FTYPE*)(calleePtr))(LuaStack<P>::get(state, 3));
+                    }
+                    return 0;
+                }
+            };
+            return _setterImpl(name, HelperClass::Invoke, f);
+        }
+
+        // template<typename F>
+        // inline LuaModule& set(const char* name, std::function<F> f)
+        // {
+        //     //static_assert(std::false_type::value, "Error: invalid signature of setter function");
+        //     //assert(!"Error: invalid signature of setter function");
+        //     return (*this);
+        // }
+
+        template<typename F>
+        inline LuaModule& set(const char* name, F f)
+        {
+            return set(name, to_module_setter_function(f));
+        }
+
+        template <typename F>
+        inline LuaModule& get(const std::string& name, F f)
+        {
+            return get(name.c_str(), f);
+        }
+
+        template <typename F>
+        inline LuaModule& set(const std::string& name, F f)
+        {
+            return set(name.c_str(), f);
+        }
+#endif
+
+    private:
+        lua_State * m_state;
+        char * m_moduleName;
+    };
+
+    //========================================================
+    // cross state transfer
+    //========================================================
+    struct LuaTransfer
+    {
+        lua_State * src;
+        lua_State * dst;
+        int seen;       // src: table or userdata -> slot in cache
+        int cache;      // dst: slot -> copied value
+        int count;
+        int errorType;
+        const char * error;
+
+        bool fail(int type, const char * msg)
+        {
+            errorType = type;
+            error = msg;
+            return false;
+        }
+
+        bool value(int idx, int depth)
+        {
+            const int type = lua_type(src, idx);
+            switch (type)
+            {
+            case LUA_TNIL:
+                lua_pushnil(dst);
+                return true;
+            case LUA_TBOOLEAN:
+                lua_pushboolean(dst, lua_toboolean(src, idx));
+                return true;
+            case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+                if (lua_isinteger(src, idx))
+                {
+                    lua_pushinteger(dst, lua_tointeger(src, idx));
+                    return true;
+                }
+#endif
+                lua_pushnumber(dst, lua_tonumber(src, idx));
+                return true;
+            case LUA_TSTRING:
+            {
+                size_t len = 0;
+                const char * str = lua_tolstring(src, idx, &len);
+                lua_pushlstring(dst, str, len);
+                return true;
+            }
+            case LUA_TLIGHTUSERDATA:
+                lua_pushlightuserdata(dst, lua_touserdata(src, idx));
+                return true;
+            case LUA_TTABLE:
+            case LUA_TUSERDATA:
+                break;
+            default:
+                return fail(type, "can not be copied");
+            }
+
+            // shared references and cycles map to the same copy.
+            lua_pushvalue(src, idx);
+            lua_rawget(src, seen);
+            if (!lua_isnil(src, -1))
+            {
+                lua_rawgeti(dst, cache, (int)lua_tointeger(src, -1));
+                lua_pop(src, 1);
+                return true;
+            }
+            lua_pop(src, 1);
+
+            if (type == LUA_TUSERDATA)
+            {
+                return userdata(idx);
+            }
+            if (depth >= LUAAA_TRANSFER_MAX_DEPTH)
+            {
+                return fail(type, "nested too deep");
+            }
+            if (!lua_checkstack(src, 4) || !lua_checkstack(dst, 4))
+            {
+                return fail(type, "out of stack space");
+            }
+            return table(lua_absindex(src, idx), depth);
+        }
+
+        void remember(int idx)
+        {
+            lua_pushvalue(dst, -1);
+            lua_rawseti(dst, cache, ++count);
+            lua_pushvalue(src, idx);
+            lua_pushinteger(src, count);
+            lua_rawset(src, seen);
+        }
+
+        bool userdata(int idx)
+        {
+            LuaCloneHook * hook = nullptr;
+            if (lua_getmetatable(src, idx))
+            {
+                lua_pushstring(src, "$clone");
+                lua_rawget(src, -2);
+                hook = (LuaCloneHook*)lua_touserdata(src, -1);
+                lua_pop(src, 2);
+            }
+            if (hook == nullptr)
+            {
+                return fail(LUA_TUSERDATA, "class does not allow clone");
+            }
+            if (!hook->clone(src, idx, dst, hook))
+            {
+                return fail(LUA_TUSERDATA, "clone failed");
+            }
+            remember(idx);
+            return true;
+        }
+
+        // metatables are not copied, array part is copied by index, the rest by lua_next.
+        bool table(int idx, int depth)
+        {
+            const int narr = (int)lua_rawlen(src, idx);
+            int total = 0;
+            lua_pushnil(src);
+            while (lua_next(src, idx) != 0)
+            {
+                lua_pop(src, 1);
+                ++total;
+            }
+            lua_createtable(dst, narr, total > narr ? total - narr : 0);
+            remember(idx);
+
+            for (int i = 1; i <= narr; ++i)
+            {
+                lua_rawgeti(src, idx, i);
+                if (!value(-1, depth + 1))
+                {
+                    return false;
+                }
+                lua_rawseti(dst, -2, i);
+                lua_pop(src, 1);
+            }
+
+            lua_pushnil(src);
+            while (lua_next(src, idx) != 0)
+            {
+                if (lua_type(src, -2) == LUA_TNUMBER)
+                {
+                    const lua_Number key = lua_tonumber(src, -2);
+                    if (key >= 1 && key <= narr && key == (lua_Number)(int)key)
+                    {
+                        lua_pop(src, 1);
+                        continue;
+                    }
+                }
+                if (!value(-2, depth + 1) || !value(-1, depth + 1))
+                {
+                    return false;
+                }
+                lua_rawset(dst, -3);
+                lua_pop(src, 1);
+            }
+            return true;
+        }
+    };
+
+    // deep copies value at idx of src onto the top of dst, both states must not run meanwhile.
+    // nil, boolean, number, string, light userdata and tables are copied, cycles and shared tables are kept,
+    // userdata of classes bound with LuaClass::clone are cloned. metatables of tables are not copied.
+    // returns false and pushes error message onto dst if some value can not be copied.
+    inline bool transfer(lua_State * src, int idx, lua_State * dst)
+    {
+        if (src == dst)
+        {
+            lua_pushvalue(dst, idx);
+            return true;
+        }
+        const int srcTop = lua_gettop(src);
+        const int dstTop = lua_gettop(dst);
+        idx = lua_absindex(src, idx);
+
+        LuaTransfer t = { src, dst, 0, 0, 0, LUA_TNIL, nullptr };
+        const int type = lua_type(src, idx);
+        if (type == LUA_TTABLE || type == LUA_TUSERDATA)
+        {
+            luaL_checkstack(src, 8, "transfer");
+            luaL_checkstack(dst, 8, "transfer");
+            lua_newtable(src);
+            t.seen = lua_gettop(src);
+            lua_newtable(dst);
+            t.cache = lua_gettop(dst);
+        }
+
+        if (t.value(idx, 0))
+        {
+            if (t.cache != 0)
+            {
+                lua_remove(dst, t.cache);
+            }
+            lua_settop(src, srcTop);
+            return true;
+        }
+        lua_settop(src, srcTop);
+        lua_settop(dst, dstTop);
+        lua_pushfstring(dst, "transfer: %s %s", lua_typename(src, t.errorType), t.error);
+        return false;
+    }
+
+}
+
+
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+
+#include <array>
+#include <vector>
+#include <deque>
+#include <list>
+#include <forward_list>
+#include <set>
+#include <map>
+#include <unordered_set>
+#include <unordered_map>
+#include <tuple>
+#include <memory>
+#include <iterator>
+#if __cplusplus >= 201703 || _MSVC_LANG >= 201703
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+#endif
+
+namespace LUAAA_NS
+{
+    // containers are passed as lua table
+    template<typename K, size_t N> struct LuaTypeMask<std::array<K, N>> : public LuaTableTypeMask {};
+    template<typename K, typename ...ARGS> struct LuaTypeMask<std::vector<K, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename ...ARGS> struct LuaTypeMask<std::deque<K, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename ...ARGS> struct LuaTypeMask<std::list<K, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename ...ARGS> struct LuaTypeMask<std::forward_list<K, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename ...ARGS> struct LuaTypeMask<std::set<K, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename ...ARGS> struct LuaTypeMask<std::multiset<K, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename ...ARGS> struct LuaTypeMask<std::unordered_set<K, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename ...ARGS> struct LuaTypeMask<std::unordered_multiset<K, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename V, typename ...ARGS> struct LuaTypeMask<std::map<K, V, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename V, typename ...ARGS> struct LuaTypeMask<std::multimap<K, V, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename V, typename ...ARGS> struct LuaTypeMask<std::unordered_map<K, V, ARGS...>> : public LuaTableTypeMask {};
+    template<typename K, typename V, typename ...ARGS> struct LuaTypeMask<std::unordered_multimap<K, V, ARGS...>> : public LuaTableTypeMask {};
+    template<typename U, typename V> struct LuaTypeMask<std::pair<U, V>> : public LuaTableTypeMask {};
+    template<typename ...TS> struct LuaTypeMask<std::tuple<TS...>> : public LuaTableTypeMask {};
+
+    // table, iteration key, and the deepest element.
+    template<typename K> struct LuaSequenceSlots
+    {
+        enum { value = 2 + int(LuaStackSlots<K>::value) };
+    };
+
+    // table, key and value are on stack together.
+    template<typename K, typename V> struct LuaMapSlots
+    {
+        enum { value = 2 + int(LuaStackSlots<K>::value) + int(LuaStackSlots<V>::value) };
+    };
+
+    template<typename K, size_t N> struct LuaStackSlots<std::array<K, N>> : public LuaSequenceSlots<K> {};
+    template<typename K, typename ...ARGS> struct LuaStackSlots<std::vector<K, ARGS...>> : public LuaSequenceSlots<K> {};
+    template<typename K, typename ...ARGS> struct LuaStackSlots<std::deque<K, ARGS...>> : public LuaSequenceSlots<K> {};
+    template<typename K, typename ...ARGS> struct LuaStackSlots<std::list<K, ARGS...>> : public LuaSequenceSlots<K> {};
+    template<typename K, typename ...ARGS> struct LuaStackSlots<std::forward_list<K, ARGS...>> : public LuaSequenceSlots<K> {};
+    template<typename K, typename ...ARGS> struct LuaStackSlots<std::set<K, ARGS...>> : public LuaSequenceSlots<K> {};
+    template<typename K, typename ...ARGS> struct LuaStackSlots<std::multiset<K, ARGS...>> : public LuaSequenceSlots<K> {};
+    template<typename K, typename ...ARGS> struct LuaStackSlots<std::unordered_set<K, ARGS...>> : public LuaSequenceSlots<K> {};
+    template<typename K, typename ...ARGS> struct LuaStackSlots<std::unordered_multiset<K, ARGS...>> : public LuaSequenceSlots<K> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaStackSlots<std::map<K, V, ARGS...>> : public LuaMapSlots<K, V> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaStackSlots<std::multimap<K, V, ARGS...>> : public LuaMapSlots<K, V> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaStackSlots<std::unordered_map<K, V, ARGS...>> : public LuaMapSlots<K, V> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaStackSlots<std::unordered_multimap<K, V, ARGS...>> : public LuaMapSlots<K, V> {};
+    template<typename U, typename V> struct LuaStackSlots<std::pair<U, V>>
+    {
+        enum { value = 2 + int(LuaMaxSlots<U, V>::value) };
+    };
+    template<typename ...TS> struct LuaStackSlots<std::tuple<TS...>>
+    {
+        enum { value = 2 + int(LuaMaxSlots<TS...>::value) };
+    };
+
+    // number of entries of table at idx, to reserve hashed containers before decoding.
+    inline size_t LuaTableSize(lua_State * L, int idx)
+    {
+        size_t n = 0;
+        lua_pushnil(L);
+        while (0 != lua_next(L, idx))
+        {
+            lua_pop(L, 1);
+            ++n;
+        }
+        return n;
+    }
+
+    template<typename C> inline void LuaReserve(lua_State *, int, C&) {}
+    template<typename K, typename ...ARGS> inline void LuaReserve(lua_State * L, int idx, std::unordered_set<K, ARGS...>& c) { c.reserve(LuaTableSize(L, idx)); }
+    template<typename K, typename ...ARGS> inline void LuaReserve(lua_State * L, int idx, std::unordered_multiset<K, ARGS...>& c) { c.reserve(LuaTableSize(L, idx)); }
+    template<typename K, typename V, typename ...ARGS> inline void LuaReserve(lua_State * L, int idx, std::unordered_map<K, V, ARGS...>& c) { c.reserve(LuaTableSize(L, idx)); }
+    template<typename K, typename V, typename ...ARGS> inline void LuaReserve(lua_State * L, int idx, std::unordered_multimap<K, V, ARGS...>& c) { c.reserve(LuaTableSize(L, idx)); }
+
+    // values of table become elements, decoded ones are moved in.
+    template<typename Container>
+    inline void LuaGetSet(lua_State * L, int idx, Container& result)
+    {
+        luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+        if (lua_istable(L, idx))
+        {
+            idx = lua_absindex(L, idx);
+            LuaReserve(L, idx, result);
+            lua_pushnil(L);
+            while (0 != lua_next(L, idx))
+            {
+                typename Container::value_type value = LuaStack<typename Container::value_type>::get(L, lua_gettop(L));
+                result.emplace(std::move(value));
+                lua_pop(L, 1);
+            }
+        }
+    }
+
+    template<typename Container>
+    inline Container LuaGetSet(lua_State * L, int idx)
+    {
+        Container result;
+        LuaGetSet(L, idx, result);
+        return result;
+    }
+
+    // every table entry is emplaced once, lua keys are unique so multimaps get one value per key.
+    // key is converted from a copy, lua_next must see the original key.
+    template<typename Container>
+    inline void LuaGetMap(lua_State * L, int idx, Container& result)
+    {
+        luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+        if (lua_istable(L, idx))
+        {
+            idx = lua_absindex(L, idx);
+            LuaReserve(L, idx, result);
+            lua_pushnil(L);
+            while (0 != lua_next(L, idx))
+            {
+                lua_pushvalue(L, -2);
+                typename Container::key_type key = LuaStack<typename Container::key_type>::get(L, lua_gettop(L));
+                lua_pop(L, 1);
+                typename Container::mapped_type value = LuaStack<typename Container::mapped_type>::get(L, lua_gettop(L));
+                result.emplace(std::move(key), std::move(value));
+                lua_pop(L, 1);
+            }
+        }
+    }
+
+    template<typename Container>
+    inline Container LuaGetMap(lua_State * L, int idx)
+    {
+        Container result;
+        LuaGetMap(L, idx, result);
+        return result;
+    }
+
+    // array
+    template<typename K, size_t N>
+    struct LuaStack<std::array<K, N>>
+    {
+        typedef std::array<K, N> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            Container result;
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            if (lua_istable(L, idx))
+            {
+                int index = 0;
+                lua_pushnil(L);
+                while (0 != lua_next(L, idx) && index < N)
+                {
+                    result[index++] = LuaStack<typename Container::value_type>::get(L, lua_gettop(L));
+                    lua_pop(L, 1);
+                }
+            }
+            return result;
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+
+    // vector
+    template<typename K, typename ...ARGS>
+    struct LuaStack<std::vector<K, ARGS...>>
+    {
+        typedef std::vector<K, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            Container result;
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            if (lua_istable(L, idx))
+            {
+                lua_pushnil(L);
+                while (0 != lua_next(L, idx))
+                {
+                    result.push_back(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
+                    lua_pop(L, 1);
+                }
+            }
+            return result;
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+
+    // deque
+    template<typename K, typename ...ARGS>
+    struct LuaStack<std::deque<K, ARGS...>>
+    {
+        typedef std::deque<K, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            Container result;
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            if (lua_istable(L, idx))
+            {
+                lua_pushnil(L);
+                while (0 != lua_next(L, idx))
+                {
+                    result.push_back(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
+                    lua_pop(L, 1);
+                }
+            }
+            return result;
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+
+    // list
+    template<typename K, typename ...ARGS>
+    struct LuaStack<std::list<K, ARGS...>>
+    {
+        typedef std::list<K, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            Container result;
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            if (lua_istable(L, idx))
+            {
+                lua_pushnil(L);
+                while (0 != lua_next(L, idx))
+                {
+                    result.push_back(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
+                    lua_pop(L, 1);
+                }
+            }
+            return result;
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+
+    // forward_list
+    template<typename K, typename ...ARGS>
+    struct LuaStack<std::forward_list<K, ARGS...>>
+    {
+        typedef std::forward_list<K, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            Container result;
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            if (lua_istable(L, idx))
+            {
+                lua_pushnil(L);
+                while (0 != lua_next(L, idx))
+                {
+                    result.push_back(LuaStack<typename Container::value_type>::get(L, lua_gettop(L)));
+                    lua_pop(L, 1);
+                }
+            }
+            return result;
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+
+    // set
+    template<typename K, typename ...ARGS>
+    struct LuaStack<std::set<K, ARGS...>>
+    {
+        typedef std::set<K, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            return LuaGetSet<Container>(L, idx);
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+
+    // multiset
+    template<typename K, typename ...ARGS>
+    struct LuaStack<std::multiset<K, ARGS...>>
+    {
+        typedef std::multiset<K, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            return LuaGetSet<Container>(L, idx);
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+
+    // unordered_set
+    template<typename K, typename ...ARGS>
+    struct LuaStack<std::unordered_set<K, ARGS...>>
+    {
+        typedef std::unordered_set<K, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            return LuaGetSet<Container>(L, idx);
+        }
+
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+
+    // unordered_multiset
+    template<typename K, typename ...ARGS>
+    struct LuaStack<std::unordered_multiset<K, ARGS...>>
+    {
+        typedef std::unordered_multiset<K, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            return LuaGetSet<Container>(L, idx);
+        }
+
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+
+    // map
+    template<typename K, typename V, typename ...ARGS>
+    struct LuaStack<std::map<K, V, ARGS...>>
+    {
+        typedef std::map<K, V, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            return LuaGetMap<Container>(L, idx);
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::key_type>::put(L, it->first);
+                LuaStack<typename Container::mapped_type>::put(L, it->second);
+                lua_rawset(L, -3);
+            }
+        }
+    };
+
+    // multimap
+    template<typename K, typename V, typename ...ARGS>
+    struct LuaStack<std::multimap<K, V, ARGS...>>
+    {
+        typedef std::multimap<K, V, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            return LuaGetMap<Container>(L, idx);
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::key_type>::put(L, it->first);
+                LuaStack<typename Container::mapped_type>::put(L, it->second);
+                lua_rawset(L, -3);
+            }
+        }
+    };
+
+    // unordered_map
+    template<typename K, typename V, typename ...ARGS>
+    struct LuaStack<std::unordered_map<K, V, ARGS...>>
+    {
+        typedef std::unordered_map<K, V, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            return LuaGetMap<Container>(L, idx);
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::key_type>::put(L, it->first);
+                LuaStack<typename Container::mapped_type>::put(L, it->second);
+                lua_rawset(L, -3);
+            }
+        }
+    };
+
+    // unordered_multimap
+    template<typename K, typename V, typename ...ARGS>
+    struct LuaStack<std::unordered_multimap<K, V, ARGS...>>
+    {
+        typedef std::unordered_multimap<K, V, ARGS...> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            return LuaGetMap<Container>(L, idx);
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::key_type>::put(L, it->first);
+                LuaStack<typename Container::mapped_type>::put(L, it->second);
+                lua_rawset(L, -3);
+            }
+        }
+    };
+
+    // std::pair
+    template<typename U, typename V>
+    struct LuaStack<std::pair<U, V>>
+    {
+        typedef std::pair<U, V> Container;
+        inline static Container get(lua_State * L, int idx)
+        {
+            Container result;
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            if (lua_istable(L, idx))
+            {
+                result.first = LuaStack<typename Container::first_type>::get(L, idx + 1);
+                result.second = LuaStack<typename Container::second_type>::get(L, idx + 2);
+            }
+            return result;
+        }
+
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            LuaStack<typename Container::first_type>::put(L, s.first);
+            lua_rawseti(L, -2, 1);
+            LuaStack<typename Container::second_type>::put(L, s.second);
+            lua_rawseti(L, -2, 2);
+        }
+    };
+ 
+    // std::tuple 
+#if __cplusplus >= 201402 || _MSVC_LANG >= 201402
+    template <typename> struct is_tuple : std::false_type {};
+    template <typename ...T> struct is_tuple<std::tuple<T...>> : std::true_type {};
+
+    template<typename Tuple, std::size_t ...Index, typename = typename std::enable_if<is_tuple<Tuple>::value>::type>
+    inline void load_tuple_from_lua_table(lua_State* L, int idx, Tuple& tuple, std::index_sequence<Index...>)
+    {
+        luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+        if (lua_istable(L, idx))
+        {
+            lua_pushnil(L);
+            (void)std::initializer_list<int>{(
+                lua_next(L, idx) && (std::get<Index>(tuple) = LuaStack<decltype(std::get<Index>(tuple))>::get(L, lua_gettop(L)), 1) && (lua_pop(L, 1), 1),
+                0)...};
+        }
+    }
+
+    template<typename Tuple, std::size_t ...Index, typename = typename std::enable_if<is_tuple<Tuple>::value>::type>
+    inline void save_tuple_to_lua_table(lua_State* L, const Tuple& tuple, std::index_sequence<Index...>)
+    {
+        lua_newtable(L);
+        (void)std::initializer_list<int>{(
+            LuaStack<decltype(std::get<Index>(tuple))>::put(L, std::get<Index>(tuple)),
+            lua_rawseti(L, -2, Index + 1),
+            0)...};
+    }
+
+    template<typename ...TS> 
+    struct LuaStack<std::tuple<TS...>>
+    {
+        typedef std::tuple<TS...> Container;
+        inline static Container get(lua_State* L, int idx)
+        {
+            Container result;
+            load_tuple_from_lua_table(L, idx, result, std::make_index_sequence<std::tuple_size<Container>::value>{});
+            return result;
+        }
+
+        inline static void put(lua_State* L, const Container& s)
+        {
+            save_tuple_to_lua_table(L, s, std::make_index_sequence<std::tuple_size<Container>::value>{});
+        }
+    };
+#elif __cplusplus
+    template <typename T, size_t N>
+    struct TupleAccessor
+    {
+        static void get(lua_State* L, int idx, T& tuple)
+        {
+            TupleAccessor<T, N - 1>::get(L, idx, tuple);
+            if (lua_next(L, idx))
+            {
+                const int top = lua_gettop(L);
+                std::get<N - 1>(tuple) = LuaStack<typename std::tuple_element<N - 1, T>::type>::get(L, top);
+                lua_pop(L, 1);
+            }
+        }
+
+        static void put(lua_State* L, const T& tuple) {
+            TupleAccessor<T, N - 1>::put(L, tuple);
+            LuaStack<typename std::tuple_element<N - 1, T>::type>::put(L, std::get<N - 1>(tuple));
+            lua_rawseti(L, -2, N);
+        }
+    };
+
+    template <typename T>
+    struct TupleAccessor<T, 1>
+    {
+        static void get(lua_State* L, int idx, T& tuple)
+        {
+            if (lua_next(L, idx))
+            {
+                const int top = lua_gettop(L);
+                std::get<0>(tuple) = LuaStack<decltype(std::get<0>(tuple))>::get(L, top);
+                lua_pop(L, 1);
+            }
+        }
+
+        static void put(lua_State* L, const T& tuple) {
+            LuaStack<typename std::tuple_element<0, T>::type>::put(L, std::get<0>(tuple));
+            lua_rawseti(L, -2, 1);
+        }
+    };
+
+    template <typename T>
+    struct TupleAccessor<T, 0>
+    {
+        static void get(lua_State*, int, T&) {}
+        static void put(lua_State*, const T&) {}
+    };
+
+    template<typename ...TS> 
+    struct LuaStack<std::tuple<TS...>>
+    {
+        typedef std::tuple<TS...> Container;
+        inline static Container get(lua_State* L, int idx)
+        {
+            Container result;
+            lua_pushnil(L);
+            TupleAccessor<Container, std::tuple_size<Container>::value>::get(L, idx, result);
+            return result;
+        }
+
+        inline static void put(lua_State* L, const Container& s)
+        {
+            lua_newtable(L);
+            TupleAccessor<Container, std::tuple_size<Container>::value>::put(L, s);
+        }
+    };
+#endif
+
+    //========================================================
+    // incremental sync
+    //========================================================
+    // pushes value to be stored in a slot whose current value is at idx, tables there are updated in place.
+    template<typename T>
+    struct LuaSync
+    {
+        inline static void push(lua_State * L, int, const T& v)
+        {
+            LuaStack<T>::put(L, v);
+        }
+    };
+
+    // stores value on top into t[key] where key is just below it, only if it differs from current value at idx.
+    inline void LuaSyncStore(lua_State * L, int t, int idx)
+    {
+        if (lua_rawequal(L, -1, idx))
+        {
+            lua_pop(L, 2);
+        }
+        else
+        {
+            lua_rawset(L, t);
+        }
+    }
+
+    template<typename C>
+    struct LuaSyncSequence
+    {
+        typedef typename C::value_type E;
+
+        inline static void push(lua_State * L, int idx, const C& c)
+        {
+            if (!lua_istable(L, idx))
+            {
+                LuaStack<C>::put(L, c);
+                return;
+            }
+            lua_pushvalue(L, idx);
+            sync(L, lua_gettop(L), c);
+        }
+
+        // elements are written from 1, entries after the last one are cleared from the end.
+        static void sync(lua_State * L, int t, const C& c)
+        {
+            luaL_checkstack(L, 4, "too deep to sync container");
+            lua_Integer i = 1;
+            for (auto it = c.begin(); it != c.end(); ++it, ++i)
+            {
+                lua_pushinteger(L, i);
+                lua_pushvalue(L, -1);
+                lua_rawget(L, t);
+                lua_insert(L, -2);
+                const int current = lua_gettop(L) - 1;
+                LuaSync<E>::push(L, current, *it);
+                LuaSyncStore(L, t, current);
+                lua_pop(L, 1);
+            }
+            for (lua_Integer n = lua_Integer(lua_rawlen(L, t)); n >= i; --n)
+            {
+                lua_pushnil(L);
+                lua_rawseti(L, t, n);
+            }
+        }
+    };
+
+    template<typename C>
+    struct LuaSyncMap
+    {
+        typedef typename C::key_type K;
+        typedef typename C::mapped_type V;
+
+        inline static void push(lua_State * L, int idx, const C& c)
+        {
+            if (!lua_istable(L, idx))
+            {
+                LuaStack<C>::put(L, c);
+                return;
+            }
+            lua_pushvalue(L, idx);
+            sync(L, lua_gettop(L), c);
+        }
+
+        // keys not in container are cleared first, which is allowed while traversing.
+        static void sync(lua_State * L, int t, const C& c)
+        {
+            luaL_checkstack(L, 4, "too deep to sync container");
+            lua_pushnil(L);
+            while (lua_next(L, t) != 0)
+            {
+                lua_pop(L, 1);
+                const bool keep = (LuaTypeMask<K>::exact & LUAAA_TYPE_BIT(lua_type(L, -1))) != 0
+                    && c.find(LuaStack<K>::get(L, lua_gettop(L))) != c.end();
+                if (!keep)
+                {
+                    lua_pushvalue(L, -1);
+                    lua_pushnil(L);
+                    lua_rawset(L, t);
+                }
+            }
+            for (auto it = c.begin(); it != c.end(); ++it)
+            {
+                LuaStack<K>::put(L, it->first);
+                lua_pushvalue(L, -1);
+                lua_rawget(L, t);
+                lua_insert(L, -2);
+                const int current = lua_gettop(L) - 1;
+                LuaSync<V>::push(L, current, it->second);
+                LuaSyncStore(L, t, current);
+                lua_pop(L, 1);
+            }
+        }
+    };
+
+    template<typename K, size_t N> struct LuaSync<std::array<K, N>> : public LuaSyncSequence<std::array<K, N>> {};
+    template<typename K, typename ...ARGS> struct LuaSync<std::vector<K, ARGS...>> : public LuaSyncSequence<std::vector<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaSync<std::deque<K, ARGS...>> : public LuaSyncSequence<std::deque<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaSync<std::list<K, ARGS...>> : public LuaSyncSequence<std::list<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaSync<std::forward_list<K, ARGS...>> : public LuaSyncSequence<std::forward_list<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaSync<std::set<K, ARGS...>> : public LuaSyncSequence<std::set<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaSync<std::multiset<K, ARGS...>> : public LuaSyncSequence<std::multiset<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaSync<std::unordered_set<K, ARGS...>> : public LuaSyncSequence<std::unordered_set<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaSync<std::unordered_multiset<K, ARGS...>> : public LuaSyncSequence<std::unordered_multiset<K, ARGS...>> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaSync<std::map<K, V, ARGS...>> : public LuaSyncMap<std::map<K, V, ARGS...>> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaSync<std::multimap<K, V, ARGS...>> : public LuaSyncMap<std::multimap<K, V, ARGS...>> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaSync<std::unordered_map<K, V, ARGS...>> : public LuaSyncMap<std::unordered_map<K, V, ARGS...>> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaSync<std::unordered_multimap<K, V, ARGS...>> : public LuaSyncMap<std::unordered_multimap<K, V, ARGS...>> {};
+
+    // updates table at idx to hold the same content as container would get from LuaStack<C>::put,
+    // nested containers are synced into existing sub tables, unchanged values are not written.
+    template<typename C>
+    inline void sync(lua_State * L, int idx, const C& c)
+    {
+        idx = lua_absindex(L, idx);
+        luaL_checktype(L, idx, LUA_TTABLE);
+        LuaSync<C>::push(L, idx, c);
+        lua_pop(L, 1);
+    }
+
+    //========================================================
+    // decode into existing container
+    //========================================================
+    // assigns value at idx to an existing object, containers specialize it to keep their storage.
+    template<typename T>
+    struct LuaGetInto
+    {
+        inline static void get(lua_State * L, int idx, T& v)
+        {
+            v = LuaStack<T>::get(L, idx);
+        }
+    };
+
+    template<typename ...ARGS>
+    struct LuaGetInto<std::basic_string<char, ARGS...>>
+    {
+        // binary safe like LuaStack<std::string>.
+        inline static void get(lua_State * L, int idx, std::basic_string<char, ARGS...>& v)
+        {
+            if (lua_type(L, idx) == LUA_TSTRING)
+            {
+                size_t n = 0;
+                const char * s = lua_tolstring(L, idx, &n);
+                v.assign(s, n);
+                return;
+            }
+            v.assign(LuaStack<const char *>::get(L, idx));
+        }
+    };
+
+    // existing elements are decoded in place, so nested containers keep their storage too.
+    template<typename C>
+    struct LuaGetIntoSequence
+    {
+        typedef typename C::value_type E;
+
+        static void get(lua_State * L, int idx, C& c)
+        {
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            idx = lua_absindex(L, idx);
+            auto it = c.begin();
+            lua_pushnil(L);
+            while (0 != lua_next(L, idx))
+            {
+                if (it != c.end())
+                {
+                    LuaGetInto<E>::get(L, lua_gettop(L), *it);
+                    ++it;
+                }
+                else
+                {
+                    c.push_back(LuaStack<E>::get(L, lua_gettop(L)));
+                    it = c.end();
+                }
+                lua_pop(L, 1);
+            }
+            c.erase(it, c.end());
+        }
+    };
+
+    template<typename K, size_t N>
+    struct LuaGetInto<std::array<K, N>>
+    {
+        static void get(lua_State * L, int idx, std::array<K, N>& c)
+        {
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            idx = lua_absindex(L, idx);
+            size_t index = 0;
+            lua_pushnil(L);
+            while (index < N && 0 != lua_next(L, idx))
+            {
+                LuaGetInto<K>::get(L, lua_gettop(L), c[index++]);
+                lua_pop(L, 1);
+            }
+            if (index == N)
+            {
+                lua_pop(L, 1);
+            }
+        }
+    };
+
+    // bits can not be referenced, clear keeps the capacity.
+    template<typename ...ARGS>
+    struct LuaGetInto<std::vector<bool, ARGS...>>
+    {
+        static void get(lua_State * L, int idx, std::vector<bool, ARGS...>& c)
+        {
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            idx = lua_absindex(L, idx);
+            c.clear();
+            lua_pushnil(L);
+            while (0 != lua_next(L, idx))
+            {
+                c.push_back(LuaStack<bool>::get(L, lua_gettop(L)));
+                lua_pop(L, 1);
+            }
+        }
+    };
+
+    template<typename K, typename ...ARGS>
+    struct LuaGetInto<std::forward_list<K, ARGS...>>
+    {
+        static void get(lua_State * L, int idx, std::forward_list<K, ARGS...>& c)
+        {
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            idx = lua_absindex(L, idx);
+            auto prev = c.before_begin();
+            lua_pushnil(L);
+            while (0 != lua_next(L, idx))
+            {
+                auto it = std::next(prev);
+                if (it != c.end())
+                {
+                    LuaGetInto<K>::get(L, lua_gettop(L), *it);
+                }
+                else
+                {
+                    c.insert_after(prev, LuaStack<K>::get(L, lua_gettop(L)));
+                }
+                ++prev;
+                lua_pop(L, 1);
+            }
+            c.erase_after(prev, c.end());
+        }
+    };
+
+    // set elements are immutable, hashed ones keep their buckets over clear.
+    template<typename C>
+    struct LuaGetIntoSet
+    {
+        inline static void get(lua_State * L, int idx, C& c)
+        {
+            c.clear();
+            LuaGetSet(L, idx, c);
+        }
+    };
+
+    // keys missing in table are erased, values of remaining keys are decoded in place.
+    template<typename C>
+    struct LuaGetIntoMap
+    {
+        typedef typename C::key_type K;
+        typedef typename C::mapped_type V;
+
+        static void get(lua_State * L, int idx, C& c)
+        {
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            idx = lua_absindex(L, idx);
+            for (auto it = c.begin(); it != c.end();)
+            {
+                LuaStack<K>::put(L, it->first);
+                lua_rawget(L, idx);
+                const bool keep = !lua_isnil(L, -1);
+                lua_pop(L, 1);
+                it = keep ? std::next(it) : c.erase(it);
+            }
+            LuaReserve(L, idx, c);
+            lua_pushnil(L);
+            while (0 != lua_next(L, idx))
+            {
+                lua_pushvalue(L, -2);
+                K key = LuaStack<K>::get(L, lua_gettop(L));
+                lua_pop(L, 1);
+                auto it = c.find(key);
+                if (it != c.end())
+                {
+                    LuaGetInto<V>::get(L, lua_gettop(L), it->second);
+                }
+                else
+                {
+                    V value = LuaStack<V>::get(L, lua_gettop(L));
+                    c.emplace(std::move(key), std::move(value));
+                }
+                lua_pop(L, 1);
+            }
+        }
+    };
+
+    // a key may hold several values, those can not be matched with table entries.
+    template<typename C>
+    struct LuaGetIntoMultiMap
+    {
+        inline static void get(lua_State * L, int idx, C& c)
+        {
+            c.clear();
+            LuaGetMap(L, idx, c);
+        }
+    };
+
+    template<typename K, typename ...ARGS> struct LuaGetInto<std::vector<K, ARGS...>> : public LuaGetIntoSequence<std::vector<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaGetInto<std::deque<K, ARGS...>> : public LuaGetIntoSequence<std::deque<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaGetInto<std::list<K, ARGS...>> : public LuaGetIntoSequence<std::list<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaGetInto<std::set<K, ARGS...>> : public LuaGetIntoSet<std::set<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaGetInto<std::multiset<K, ARGS...>> : public LuaGetIntoSet<std::multiset<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaGetInto<std::unordered_set<K, ARGS...>> : public LuaGetIntoSet<std::unordered_set<K, ARGS...>> {};
+    template<typename K, typename ...ARGS> struct LuaGetInto<std::unordered_multiset<K, ARGS...>> : public LuaGetIntoSet<std::unordered_multiset<K, ARGS...>> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaGetInto<std::map<K, V, ARGS...>> : public LuaGetIntoMap<std::map<K, V, ARGS...>> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaGetInto<std::multimap<K, V, ARGS...>> : public LuaGetIntoMultiMap<std::multimap<K, V, ARGS...>> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaGetInto<std::unordered_map<K, V, ARGS...>> : public LuaGetIntoMap<std::unordered_map<K, V, ARGS...>> {};
+    template<typename K, typename V, typename ...ARGS> struct LuaGetInto<std::unordered_multimap<K, V, ARGS...>> : public LuaGetIntoMultiMap<std::unordered_multimap<K, V, ARGS...>> {};
+
+    // decodes value at idx into c, same content as LuaStack<T>::get but allocations of c are reused.
+    template<typename T>
+    inline void get_into(lua_State * L, int idx, T& c)
+    {
+        LuaGetInto<T>::get(L, idx, c);
+    }
+
+    // parameter of bound function declared as reuse<T>& is decoded by get_into into a scratch instance,
+    // which is kept per thread, call depth and argument position, so it stays allocated between calls.
+    template<typename T>
+    struct reuse
+    {
+        T value;
+
+        inline T& get() { return value; }
+        inline T& operator*() { return value; }
+        inline T* operator->() { return &value; }
+        inline operator T&() { return value; }
+    };
+
+    template<typename T> struct LuaScopedArg<reuse<T>> { enum { value = LUAAA_SCOPE_DEPTH }; };
+    template<typename T> struct LuaTypeMask<reuse<T>> : public LuaTypeMask<T> {};
+    template<typename T> struct LuaStackSlots<reuse<T>> : public LuaStackSlots<T> {};
+
+    template<typename T>
+    struct LuaStack<reuse<T>>
+    {
+        // deques never move their elements, references taken by earlier args stay valid.
+        static reuse<T>& get(lua_State * L, int idx)
+        {
+            static thread_local std::deque<std::deque<reuse<T>>> pool;
+            const size_t depth = size_t(LuaCallDepth());
+            if (pool.size() <= depth)
+            {
+                pool.resize(depth + 1);
+            }
+            std::deque<reuse<T>>& slots = pool[depth];
+            if (slots.size() <= size_t(idx))
+            {
+                slots.resize(size_t(idx) + 1);
+            }
+            reuse<T>& r = slots[size_t(idx)];
+            LuaGetInto<T>::get(L, idx, r.value);
+            return r;
+        }
+
+        inline static void put(lua_State * L, const reuse<T>& r)
+        {
+            LuaStack<T>::put(L, r.value);
+        }
+    };
+
+#if __cplusplus >= 201703 || _MSVC_LANG >= 201703
+    //========================================================
+    // scratch arena
+    //========================================================
+    // monotonic memory per thread for temporaries of argument conversion, deallocate does nothing.
+    // rewinding keeps the blocks, so calls after warm up don't touch the heap.
+    class LuaScratchArena : public std::pmr::memory_resource
+    {
+        struct alignas(std::max_align_t) Block
+        {
+            Block * next;
+            size_t size;
+            inline char * data() { return reinterpret_cast<char*>(this + 1); }
+        };
+
+    public:
+        struct Mark
+        {
+            Block * block;
+            char * ptr;
+        };
+
+        explicit LuaScratchArena(size_t blockSize = 4096) : m_head(nullptr), m_block(nullptr), m_ptr(nullptr), m_end(nullptr), m_blockSize(blockSize)
+        {
+            m_frames.count = 0;
+        }
+        LuaScratchArena(const LuaScratchArena&) = delete;
+        LuaScratchArena& operator=(const LuaScratchArena&) = delete;
+
+        ~LuaScratchArena()
+        {
+            while (m_head)
+            {
+                Block * next = m_head->next;
+                ::operator delete(m_head);
+                m_head = next;
+            }
+        }
+
+        inline Mark mark() const { return Mark{ m_block, m_ptr }; }
+
+        inline void rewind(const Mark& m)
+        {
+            m_block = m.block;
+            m_ptr = m.ptr;
+            m_end = m_block ? m_block->data() + m_block->size : nullptr;
+        }
+
+        inline void reset() { rewind(Mark{ nullptr, nullptr }); }
+
+        // scopes entered on the arena and the marks they rewind to.
+        inline int& scopes() { return m_frames.count; }
+        inline LuaCallFrames& frames() { return m_frames; }
+        inline Mark * marks() { return m_marks; }
+
+        size_t capacity() const
+        {
+            size_t n = 0;
+            for (Block * b = m_head; b; b = b->next)
+            {
+                n += b->size;
+            }
+            return n;
+        }
+
+    protected:
+        void * do_allocate(size_t bytes, size_t alignment) override
+        {
+            for (;;)
+            {
+                if (m_block)
+                {
+                    const uintptr_t p = (uintptr_t(m_ptr) + alignment - 1) & ~uintptr_t(alignment - 1);
+                    if (p + bytes <= uintptr_t(m_end))
+                    {
+                        m_ptr = reinterpret_cast<char*>(p + bytes);
+                        return reinterpret_cast<void*>(p);
+                    }
+                }
+                Block * next = m_block ? m_block->next : m_head;
+                if (next == nullptr)
+                {
+                    // blocks grow geometrically, a request larger than that gets a block of its own size.
+                    size_t size = m_block ? m_block->size * 2 : m_blockSize;
+                    if (size < bytes + alignment)
+                    {
+                        size = bytes + alignment;
+                    }
+                    next = static_cast<Block*>(::operator new(sizeof(Block) + size));
+                    next->next = nullptr;
+                    next->size = size;
+                    if (m_block)
+                    {
+                        m_block->next = next;
+                    }
+                    else
+                    {
+                        m_head = next;
+                    }
+                }
+                m_block = next;
+                m_ptr = next->data();
+                m_end = m_ptr + next->size;
+            }
+        }
+
+        void do_deallocate(void *, size_t, size_t) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+    private:
+        Block * m_head;
+        Block * m_block;
+        char * m_ptr;
+        char * m_end;
+        size_t m_blockSize;
+        LuaCallFrames m_frames;
+        Mark m_marks[LUAAA_MAX_CALL_SCOPES];
+    };
+
+    inline LuaScratchArena& LuaScratch()
+    {
+        static thread_local LuaScratchArena arena;
+        return arena;
+    }
+
+    // memory taken during the call is given back when it returns, the outermost scope rewinds the whole arena.
+    // the call is counted by enter(), after args are read, so a lua error raised while reading them leaves the count as it was,
+    // memory they took is given back when the enclosing call returns or the next outermost call starts.
+    // scopes skipped by lua errors raised by the callee are dropped when the next scope is made, which rewinds their memory.
+    struct LuaScratchScope
+    {
+        LuaScratchArena::Mark saved;
+        int scopes;
+
+        LuaScratchScope()
+        {
+            LuaScratchArena& arena = LuaScratch();
+            const int entered = arena.scopes();
+            scopes = arena.frames().repair(this);
+            if (scopes == 0)
+            {
+                arena.reset();
+            }
+            else if (scopes < entered && scopes < LUAAA_MAX_CALL_SCOPES)
+            {
+                arena.rewind(arena.marks()[scopes]);
+            }
+            saved = arena.mark();
+        }
+
+        ~LuaScratchScope()
+        {
+            leave();
+        }
+
+        inline void enter()
+        {
+            LuaScratchArena& arena = LuaScratch();
+            if (scopes < LUAAA_MAX_CALL_SCOPES)
+            {
+                arena.marks()[scopes] = saved;
+            }
+            arena.frames().enter(scopes, this);
+        }
+
+        inline void leave()
+        {
+            LuaScratch().rewind(saved);
+            LuaScratch().scopes() = scopes;
+        }
+    };
+
+    template<> struct LuaCallScope<LUAAA_SCOPE_SCRATCH> : public LuaScratchScope {};
+    template<> struct LuaCallScope<LUAAA_SCOPE_SCRATCH | LUAAA_SCOPE_DEPTH> : public LuaCallScope<LUAAA_SCOPE_DEPTH>, public LuaScratchScope
+    {
+        inline void enter() { LuaCallScope<LUAAA_SCOPE_DEPTH>::enter(); LuaScratchScope::enter(); }
+        inline void leave() { LuaScratchScope::leave(); LuaCallScope<LUAAA_SCOPE_DEPTH>::leave(); }
+    };
+
+    // pmr containers of bound function args are allocated from the scratch arena, they must not be kept after the call.
+    template<> struct LuaScopedArg<std::pmr::string> { enum { value = LUAAA_SCOPE_SCRATCH }; };
+    template<typename K> struct LuaScopedArg<std::pmr::vector<K>> { enum { value = LUAAA_SCOPE_SCRATCH | int(LuaScopedArg<K>::value) }; };
+
+    template<> struct LuaTypeMask<std::pmr::string> : public LuaStringTypeMask {};
+
+    // only args of bound calls take memory from the arena, they are read by LuaArgStack.
+    // values got by LuaStack outside of bound calls may outlive any scope, they use the default resource.
+    template<typename T> struct LuaScratchType { enum { value = 0 }; };
+    template<> struct LuaScratchType<std::pmr::string> { enum { value = 1 }; };
+    template<typename K> struct LuaScratchType<std::pmr::vector<K>> { enum { value = 1 }; };
+
+    template<typename T, bool = LuaScratchType<T>::value != 0>
+    struct LuaScratchGet
+    {
+        inline static T get(lua_State * L, int idx, std::pmr::memory_resource *) { return LuaStack<T>::get(L, idx); }
+    };
+
+    template<typename T>
+    struct LuaScratchGet<T, true>
+    {
+        inline static T get(lua_State * L, int idx, std::pmr::memory_resource * r) { return LuaStack<T>::get(L, idx, r); }
+    };
+
+    template<typename T>
+    struct LuaArgStack<T, typename std::enable_if<LuaScratchType<typename std::decay<T>::type>::value != 0>::type>
+    {
+        typedef typename std::decay<T>::type V;
+        inline static V get(lua_State * L, int idx) { return LuaStack<V>::get(L, idx, &LuaScratch()); }
+    };
+
+    template<>
+    struct LuaStack<std::pmr::string>
+    {
+        // binary safe like std::string.
+        inline static std::pmr::string get(lua_State * L, int idx, std::pmr::memory_resource * r = std::pmr::get_default_resource())
+        {
+            if (lua_type(L, idx) == LUA_TSTRING)
+            {
+                size_t n = 0;
+                const char * s = lua_tolstring(L, idx, &n);
+                return std::pmr::string(s, n, r);
+            }
+            return std::pmr::string(LuaStack<const char *>::get(L, idx), r);
+        }
+
+        inline static void put(lua_State * L, const std::pmr::string& s)
+        {
+            lua_pushlstring(L, s.data(), s.size());
+        }
+    };
+
+    template<typename K>
+    struct LuaStack<std::pmr::vector<K>>
+    {
+        typedef std::pmr::vector<K> Container;
+        inline static Container get(lua_State * L, int idx, std::pmr::memory_resource * r = std::pmr::get_default_resource())
+        {
+            luaL_argcheck(L, lua_istable(L, idx), 1, "required table not found on stack.");
+            idx = lua_absindex(L, idx);
+            Container result(r);
+            result.reserve(lua_rawlen(L, idx));
+            lua_pushnil(L);
+            while (0 != lua_next(L, idx))
+            {
+                result.push_back(LuaScratchGet<K>::get(L, lua_gettop(L), r));
+                lua_pop(L, 1);
+            }
+            return result;
+        }
+        inline static void put(lua_State * L, const Container& s)
+        {
+            lua_newtable(L);
+            int index = 1;
+            for (auto it = s.begin(); it != s.end(); ++it)
+            {
+                LuaStack<typename Container::value_type>::put(L, *it);
+                lua_rawseti(L, -2, index++);
+            }
+        }
+    };
+#endif
+
+    //========================================================
+    // streaming marshalling
+    //========================================================
+    // sets and maps are read by lua_next, sequences by index, maps are written as key-value pairs.
+    template<typename C, typename = void> struct LuaStreamMapped { enum { value = 0 }; };
+    template<typename C> struct LuaStreamMapped<C, typename LuaVoid<typename C::mapped_type>::type> { enum { value = 1 }; };
+    template<typename C, typename = void> struct LuaStreamKind { enum { value = 0 }; };
+    template<typename C> struct LuaStreamKind<C, typename LuaVoid<typename C::key_type>::type> { enum { value = 1 + int(LuaStreamMapped<C>::value) }; };
+
+    template<typename C> inline void LuaStreamReserve(C&, size_t) {}
+    template<typename K, typename ...ARGS> inline void LuaStreamReserve(std::vector<K, ARGS...>& c, size_t n) { c.reserve(n); }
+    template<typename K, typename ...ARGS> inline void LuaStreamReserve(std::unordered_set<K, ARGS...>& c, size_t n) { c.reserve(n); }
+    template<typename K, typename ...ARGS> inline void LuaStreamReserve(std::unordered_multiset<K, ARGS...>& c, size_t n) { c.reserve(n); }
+    template<typename K, typename V, typename ...ARGS> inline void LuaStreamReserve(std::unordered_map<K, V, ARGS...>& c, size_t n) { c.reserve(n); }
+    template<typename K, typename V, typename ...ARGS> inline void LuaStreamReserve(std::unordered_multimap<K, V, ARGS...>& c, size_t n) { c.reserve(n); }
+
+    template<typename C, int KIND = LuaStreamKind<C>::value>
+    struct LuaStreamEntry
+    {
+        inline static void put(lua_State * L, int t, size_t n, const typename C::value_type& v)
+        {
+            LuaStack<typename C::value_type>::put(L, v);
+            lua_rawseti(L, t, lua_Integer(n));
+        }
+
+        // value on top is appended.
+        inline static void get(lua_State * L, C& c)
+        {
+            c.push_back(LuaStack<typename C::value_type>::get(L, lua_gettop(L)));
+        }
+    };
+
+    template<typename C>
+    struct LuaStreamEntry<C, 1> : public LuaStreamEntry<C, 0>
+    {
+        inline static void get(lua_State * L, C& c)
+        {
+            typename C::value_type value = LuaStack<typename C::value_type>::get(L, lua_gettop(L));
+            c.emplace(std::move(value));
+        }
+    };
+
+    template<typename C>
+    struct LuaStreamEntry<C, 2>
+    {
+        inline static void put(lua_State * L, int t, size_t, const typename C::value_type& v)
+        {
+            LuaStack<typename C::key_type>::put(L, v.first);
+            LuaStack<typename C::mapped_type>::put(L, v.second);
+            lua_rawset(L, t);
+        }
+
+        // value on top, key below it.
+        inline static void get(lua_State * L, C& c)
+        {
+            lua_pushvalue(L, -2);
+            typename C::key_type key = LuaStack<typename C::key_type>::get(L, lua_gettop(L));
+            lua_pop(L, 1);
+            typename C::mapped_type value = LuaStack<typename C::mapped_type>::get(L, lua_gettop(L));
+            c.emplace(std::move(key), std::move(value));
+        }
+    };
+
+    // converts a container into a lua table a chunk of elements per step(), so a huge container
+    // doesn't stall the caller in one long C call. the table is kept in registry until release().
+    template<typename C>
+    class LuaTableWriter
+    {
+    public:
+        // container must stay unchanged until the writer is finished.
+        LuaTableWriter(lua_State * L, const C& container) : m_state(L), m_container(&container), m_it(container.begin()), m_done(0), m_size(0), m_table(LUA_NOREF)
+        {
+            m_size = size_t(std::distance(container.begin(), container.end()));
+            const bool mapped = LuaStreamKind<C>::value == 2;
+            lua_createtable(L, mapped ? 0 : int(m_size), mapped ? int(m_size) : 0);
+            m_table = luaL_ref(L, LUA_REGISTRYINDEX);
+        }
+
+        LuaTableWriter(lua_State * L, std::shared_ptr<const C> container) : LuaTableWriter(L, *container)
+        {
+            m_owner = std::move(container);
+        }
+
+        ~LuaTableWriter() { release(m_state); }
+
+        // converts up to n elements, returns true once all are converted. L may be any thread of the state.
+        bool step(lua_State * L, size_t n)
+        {
+            if (m_table == LUA_NOREF || finished())
+            {
+                return true;
+            }
+            luaL_checkstack(L, 3 + int(LuaStackSlots<typename C::value_type>::value), "too deep to convert container");
+            lua_rawgeti(L, LUA_REGISTRYINDEX, m_table);
+            const int t = lua_gettop(L);
+            for (; n > 0 && m_it != m_container->end(); --n, ++m_it)
+            {
+                LuaStreamEntry<C>::put(L, t, ++m_done, *m_it);
+            }
+            lua_pop(L, 1);
+            return finished();
+        }
+
+        inline bool step(size_t n) { return step(m_state, n); }
+
+        // pushes the table, with the elements converted so far.
+        inline void push(lua_State * L) const { lua_rawgeti(L, LUA_REGISTRYINDEX, m_table); }
+
+        void release(lua_State * L)
+        {
+            if (m_table != LUA_NOREF)
+            {
+                luaL_unref(L, LUA_REGISTRYINDEX, m_table);
+                m_table = LUA_NOREF;
+            }
+        }
+
+        inline bool finished() const { return m_done == m_size; }
+        inline size_t done() const { return m_done; }
+        inline size_t size() const { return m_size; }
+
+    private:
+        LuaTableWriter(const LuaTableWriter&);
+        LuaTableWriter& operator=(const LuaTableWriter&);
+
+        lua_State * m_state;
+        const C * m_container;
+        std::shared_ptr<const C> m_owner;
+        typename C::const_iterator m_it;
+        size_t m_done;
+        size_t m_size;
+        int m_table;
+    };
+
+    // decodes a lua table into a container a chunk of entries per step().
+    // sequences read t[1] .. t[#t], sets and maps traverse the table, which must not get new keys meanwhile.
+    template<typename C>
+    class LuaTableReader
+    {
+    public:
+        LuaTableReader(lua_State * L, int idx) : m_state(L), m_done(0), m_size(0), m_table(LUA_NOREF), m_key(LUA_NOREF), m_finished(false)
+        {
+            idx = lua_absindex(L, idx);
+            luaL_checktype(L, idx, LUA_TTABLE);
+            m_size = LuaStreamKind<C>::value == 0 ? size_t(lua_rawlen(L, idx)) : LuaTableSize(L, idx);
+            LuaStreamReserve(m_container, m_size);
+            lua_pushvalue(L, idx);
+            m_table = luaL_ref(L, LUA_REGISTRYINDEX);
+        }
+
+        ~LuaTableReader() { release(m_state); }
+
+        // decodes up to n entries, returns true once the whole table is read. L may be any thread of the state.
+        bool step(lua_State * L, size_t n)
+        {
+            if (m_table == LUA_NOREF || m_finished)
+            {
+                return true;
+            }
+            luaL_checkstack(L, 4 + int(LuaStackSlots<typename C::value_type>::value), "too deep to convert table");
+            lua_rawgeti(L, LUA_REGISTRYINDEX, m_table);
+            const int t = lua_gettop(L);
+            if (LuaStreamKind<C>::value == 0)
+            {
+                for (; n > 0 && m_done < m_size; --n)
+                {
+                    lua_rawgeti(L, t, lua_Integer(++m_done));
+                    LuaStreamEntry<C>::get(L, m_container);
+                    lua_pop(L, 1);
+                }
+                m_finished = m_done == m_size;
+            }
+            else
+            {
+                // traversal resumes from the last key, which is kept in registry between steps.
+                lua_rawgeti(L, LUA_REGISTRYINDEX, m_key);
+                luaL_unref(L, LUA_REGISTRYINDEX, m_key);
+                m_key = LUA_NOREF;
+                m_finished = true;
+                while (n > 0)
+                {
+                    if (0 == lua_next(L, t))
+                    {
+                        break;
+                    }
+                    LuaStreamEntry<C>::get(L, m_container);
+                    lua_pop(L, 1);
+                    ++m_done;
+                    if (--n == 0)
+                    {
+                        m_key = luaL_ref(L, LUA_REGISTRYINDEX);
+                        m_finished = false;
+                    }
+                }
+            }
+            lua_settop(L, t - 1);
+            if (m_finished)
+            {
+                release(L);
+            }
+            return m_finished;
+        }
+
+        inline bool step(size_t n) { return step(m_state, n); }
+
+        void release(lua_State * L)
+        {
+            luaL_unref(L, LUA_REGISTRYINDEX, m_key);
+            luaL_unref(L, LUA_REGISTRYINDEX, m_table);
+            m_key = LUA_NOREF;
+            m_table = LUA_NOREF;
+        }
+
+        inline C& container() { return m_container; }
+        inline bool finished() const { return m_finished; }
+        inline size_t done() const { return m_done; }
+        inline size_t size() const { return m_size; }
+
+    private:
+        LuaTableReader(const LuaTableReader&);
+        LuaTableReader& operator=(const LuaTableReader&);
+
+        lua_State * m_state;
+        C m_container;
+        size_t m_done;
+        size_t m_size;
+        int m_table;
+        int m_key;
+        bool m_finished;
+    };
+
+    // return value of bound function, which hands the container to lua as a job converting chunk elements per step,
+    // instead of one table converted at once.
+    template<typename C>
+    struct streamed
+    {
+        std::shared_ptr<const C> container;
+        size_t chunk;
+
+        streamed(C c, size_t chunk = 65536) : container(std::make_shared<const C>(std::move(c))), chunk(chunk) {}
+        streamed(std::shared_ptr<const C> c, size_t chunk = 65536) : container(std::move(c)), chunk(chunk) {}
+    };
+
+    // job:step([n]) returns finished, done, total. job:progress() returns done, total. job:result() returns the table.
+    // job:run([n]) converts everything and returns the table, inside a coroutine it yields done, total between steps (lua 5.3+).
+    template<typename C>
+    struct LuaStack<streamed<C>>
+    {
+        struct Job
+        {
+            LuaTableWriter<C> writer;
+            size_t chunk;
+
+            Job(lua_State * L, const streamed<C>& s) : writer(L, s.container), chunk(s.chunk > 0 ? s.chunk : 1) {}
+        };
+
+        // the userdata block, alive is cleared once __gc destroyed the job.
+        struct Slot
+        {
+            typename std::aligned_storage<sizeof(Job), alignof(Job)>::type job;
+            bool alive;
+        };
+
+        inline static void put(lua_State * L, const streamed<C>& s)
+        {
+            Slot * slot = (Slot*)lua_newuserdata(L, sizeof(Slot));
+            slot->alive = false;
+            PushMetatable(L);
+            lua_setmetatable(L, -2);
+            new (&slot->job) Job(L, s);
+            slot->alive = true;
+        }
+
+    private:
+        // methods live in their own __index table so that lua code cannot reach __gc through a job,
+        // the metatable is kept in registry like the ones of container views.
+        static void PushMetatable(lua_State * L)
+        {
+            lua_pushlightuserdata(L, (void*)Methods());
+            lua_rawget(L, LUA_REGISTRYINDEX);
+            if (lua_istable(L, -1))
+            {
+                return;
+            }
+            lua_pop(L, 1);
+            lua_newtable(L);
+            lua_newtable(L);
+            luaL_setfuncs(L, Methods(), 0);
+            lua_setfield(L, -2, "__index");
+            lua_pushcfunction(L, Gc);
+            lua_setfield(L, -2, "__gc");
+            lua_pushlightuserdata(L, (void*)Methods());
+            lua_pushvalue(L, -2);
+            lua_rawset(L, LUA_REGISTRYINDEX);
+        }
+
+        static Slot * ToSlot(lua_State * L)
+        {
+            Slot * slot = (Slot*)lua_touserdata(L, 1);
+            bool ok = slot != nullptr && lua_type(L, 1) == LUA_TUSERDATA && lua_getmetatable(L, 1);
+            if (ok)
+            {
+                PushMetatable(L);
+                ok = lua_rawequal(L, -1, -2) != 0;
+                lua_pop(L, 2);
+            }
+            return ok ? slot : nullptr;
+        }
+
+        static Job * Check(lua_State * L)
+        {
+            Slot * slot = ToSlot(L);
+            luaL_argcheck(L, slot != nullptr, 1, "streaming job expected");
+            luaL_argcheck(L, slot->alive, 1, "streaming job is already released");
+            return (Job*)&slot->job;
+        }
+
+        static size_t Chunk(lua_State * L, Job * job)
+        {
+            const lua_Integer n = luaL_optinteger(L, 2, lua_Integer(job->chunk));
+            return n > 0 ? size_t(n) : 1;
+        }
+
+        static int Progress(lua_State * L, Job * job)
+        {
+            lua_pushinteger(L, lua_Integer(job->writer.done()));
+            lua_pushinteger(L, lua_Integer(job->writer.size()));
+            return 2;
+        }
+
+        static int Step(lua_State * L)
+        {
+            Job * job = Check(L);
+            lua_pushboolean(L, job->writer.step(L, Chunk(L, job)));
+            return 1 + Progress(L, job);
+        }
+
+        static int GetProgress(lua_State * L)
+        {
+            return Progress(L, Check(L));
+        }
+
+        static int Result(lua_State * L)
+        {
+            Check(L)->writer.push(L);
+            return 1;
+        }
+
+#if LUA_VERSION_NUM >= 503
+        static int Resume(lua_State * L, int, lua_KContext ctx)
+        {
+            Job * job = Check(L);
+            while (!job->writer.step(L, size_t(ctx)))
+            {
+                if (lua_isyieldable(L))
+                {
+                    lua_settop(L, 1);
+                    return lua_yieldk(L, Progress(L, job), ctx, Resume);
+                }
+            }
+            job->writer.push(L);
+            return 1;
+        }
+
+        static int Run(lua_State * L)
+        {
+            return Resume(L, LUA_OK, lua_KContext(Chunk(L, Check(L))));
+        }
+#else
+        static int Run(lua_State * L)
+        {
+            Job * job = Check(L);
+            const size_t n = Chunk(L, job);
+            while (!job->writer.step(L, n)) {}
+            job->writer.push(L);
+            return 1;
+        }
+#endif
+
+        static int Gc(lua_State * L)
+        {
+            Slot * slot = ToSlot(L);
+            if (slot != nullptr && slot->alive)
+            {
+                Job * job = (Job*)&slot->job;
+                slot->alive = false;
+                job->writer.release(L);
+                job->~Job();
+            }
+            return 0;
+        }
+
+        static const luaL_Reg * Methods()
+        {
+            static const luaL_Reg methods[] = {
+                { "step", Step },
+                { "progress", GetProgress },
+                { "result", Result },
+                { "run", Run },
+                { nullptr, nullptr },
+            };
+            return methods;
+        }
+    };
+
+}
+
+#endif //#if !LUAAA_WITHOUT_CPP_STDLIB
+
+#endif
+
@@ -0,0 +1,1081 @@
+/*
+ Copyright (c) 2019 gengyong
+ https://github.com/gengyong/luaaa
+ licensed under MIT License.
+*/
+
+#ifndef HEADER_LUAAA_JSON_HPP
+#define HEADER_LUAAA_JSON_HPP
+
+// optional native json codec, include after or instead of luaaa.hpp.
+// encoder walks lua values on the stack and writes straight into a Writer, which grows in memory or
+// flushes to a FILE* / sink in chunks, decoder pushes values straight into presized tables.
+
+#include "luaaa.hpp"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+/// default nesting limit of encode/decode, deeper values (or cycles) fail with an error.
+#ifndef LUAAA_JSON_MAX_DEPTH
+#define LUAAA_JSON_MAX_DEPTH 128
+#endif
+
+namespace LUAAA_NS
+{
+    namespace json
+    {
+        //========================================================
+        // output buffer
+        //========================================================
+        class Writer
+        {
+        public:
+            // returns bytes written, short write marks writer failed.
+            typedef size_t(*Sink)(void * ud, const char * data, size_t size);
+
+            enum { SinkChunk = 16 * 1024 };
+
+            // collects whole output in memory.
+            Writer() : m_data(nullptr), m_size(0), m_capacity(0), m_sink(nullptr), m_ud(nullptr), m_error(nullptr) {}
+
+            // flushes to file every SinkChunk bytes, for fd use fdopen or a sink writing with write().
+            explicit Writer(FILE * file) : m_data(nullptr), m_size(0), m_capacity(0), m_sink(&fileSink), m_ud(file), m_error(nullptr) {}
+
+            Writer(Sink sink, void * ud) : m_data(nullptr), m_size(0), m_capacity(0), m_sink(sink), m_ud(ud), m_error(nullptr) {}
+
+            ~Writer()
+            {
+                free(m_data);
+            }
+
+            // pending output, whole output if there is no sink.
+            inline const char * data() const { return m_data; }
+            inline size_t size() const { return m_size; }
+
+            // keeps capacity.
+            inline void clear() { m_size = 0; m_error = nullptr; }
+
+            inline bool failed() const { return m_error != nullptr; }
+            inline const char * error() const { return m_error; }
+            inline void fail(const char * msg) { if (!m_error) m_error = msg; }
+
+            // writes pending output to sink.
+            inline bool flush()
+            {
+                if (m_sink && m_size > 0)
+                {
+                    if (m_sink(m_ud, m_data, m_size) != m_size)
+                    {
+                        fail("write error");
+                    }
+                    m_size = 0;
+                }
+                return !failed();
+            }
+
+            // returns room for n (<= 32) bytes at the end, fill it then commit.
+            inline char * reserve(size_t n)
+            {
+                if (m_size + n > m_capacity && !grow(n))
+                {
+                    return m_spill;
+                }
+                return m_data + m_size;
+            }
+
+            inline void commit(size_t n)
+            {
+                if (m_size + n <= m_capacity) m_size += n;
+            }
+
+            inline void put(char c)
+            {
+                if (m_size < m_capacity || grow(1))
+                {
+                    m_data[m_size++] = c;
+                }
+            }
+
+            inline void write(const char * s, size_t n)
+            {
+                if (m_size + n <= m_capacity || grow(n))
+                {
+                    memcpy(m_data + m_size, s, n);
+                    m_size += n;
+                }
+            }
+
+        private:
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            static size_t fileSink(void * ud, const char * data, size_t size)
+            {
+                return fwrite(data, 1, size, (FILE*)ud);
+            }
+
+            bool grow(size_t n)
+            {
+                if (m_error)
+                {
+                    // output is discarded after a failure.
+                    return false;
+                }
+                if (m_sink && m_size > 0 && m_capacity >= SinkChunk)
+                {
+                    flush();
+                    if (n <= m_capacity)
+                    {
+                        return !m_error;
+                    }
+                }
+                size_t capacity = m_capacity ? m_capacity * 2 : (m_sink ? (size_t)SinkChunk : (size_t)256);
+                while (capacity < m_size + n)
+                {
+                    capacity *= 2;
+                }
+                char * data = (char*)realloc(m_data, capacity);
+                if (!data)
+                {
+                    fail("not enough memory");
+                    return false;
+                }
+                m_data = data;
+                m_capacity = capacity;
+                return true;
+            }
+
+            char * m_data;
+            size_t m_size;
+            size_t m_capacity;
+            Sink m_sink;
+            void * m_ud;
+            const char * m_error;
+            char m_spill[32];
+        };
+
+        //========================================================
+        // encoder
+        //========================================================
+        namespace detail
+        {
+            // 1: plain byte, 0: needs escape.
+            inline const unsigned char * plainChars()
+            {
+                static const unsigned char table[256] = {
+                    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                    1,1,0,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+                    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,0,1,1,1,
+                    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+                    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+                    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+                    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+                    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+                };
+                return table;
+            }
+
+            inline void writeString(Writer& w, const char * s, size_t n)
+            {
+                static const char hex[] = "0123456789abcdef";
+                const unsigned char * plain = plainChars();
+                w.put('"');
+                size_t i = 0;
+                while (i < n)
+                {
+                    size_t start = i;
+                    while (i < n && plain[(unsigned char)s[i]])
+                    {
+                        ++i;
+                    }
+                    if (i > start)
+                    {
+                        w.write(s + start, i - start);
+                    }
+                    if (i == n)
+                    {
+                        break;
+                    }
+                    unsigned char c = (unsigned char)s[i++];
+                    char * out = w.reserve(6);
+                    out[0] = '\\';
+                    switch (c)
+                    {
+                    case '"': out[1] = '"'; w.commit(2); break;
+                    case '\\': out[1] = '\\'; w.commit(2); break;
+                    case '\b': out[1] = 'b'; w.commit(2); break;
+                    case '\f': out[1] = 'f'; w.commit(2); break;
+                    case '\n': out[1] = 'n'; w.commit(2); break;
+                    case '\r': out[1] = 'r'; w.commit(2); break;
+                    case '\t': out[1] = 't'; w.commit(2); break;
+                    default:
+                        out[1] = 'u'; out[2] = '0'; out[3] = '0';
+                        out[4] = hex[c >> 4]; out[5] = hex[c & 15];
+                        w.commit(6);
+                        break;
+                    }
+                }
+                w.put('"');
+            }
+
+            template<typename I>
+            inline void writeInteger(Writer& w, I v)
+            {
+                char tmp[24];
+                char * p = tmp + sizeof(tmp);
+                // negate in unsigned so the minimum value works.
+                unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+                do
+                {
+                    *--p = char('0' + u % 10);
+                    u /= 10;
+                } while (u);
+                if (v < 0)
+                {
+                    *--p = '-';
+                }
+                w.write(p, tmp + sizeof(tmp) - p);
+            }
+
+            inline void writeNumber(Writer& w, lua_Number v)
+            {
+                if (v != v || v == HUGE_VAL || v == -HUGE_VAL)
+                {
+                    // json has no nan/inf.
+                    w.write("null", 4);
+                    return;
+                }
+                if (v == std::floor(v) && std::fabs(v) < 9007199254740992.0)
+                {
+                    if (v == 0 && std::signbit(v))
+                    {
+                        // -0.0 keeps its sign.
+                        w.put('-');
+                    }
+                    writeInteger(w, (long long)v);
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 503
+                    // keep float subtype through a round trip.
+                    w.write(".0", 2);
+#endif
+                    return;
+                }
+                char * out = w.reserve(32);
+                int n = snprintf(out, 32, "%.15g", (double)v);
+                if (strtod(out, nullptr) != (double)v)
+                {
+                    n = snprintf(out, 32, "%.17g", (double)v);
+                }
+                // some locales use ',' as decimal point.
+                for (int i = 0; i < n; ++i)
+                {
+                    if (out[i] == ',') out[i] = '.';
+                }
+                w.commit(n);
+            }
+
+            struct Encoder
+            {
+                lua_State * L;
+                Writer& w;
+                int maxDepth;
+
+                Encoder(lua_State * L, Writer& w, int maxDepth) : L(L), w(w), maxDepth(maxDepth) {}
+
+                void value(int idx, int depth)
+                {
+                    switch (lua_type(L, idx))
+                    {
+                    case LUA_TNIL:
+                        w.write("null", 4);
+                        break;
+                    case LUA_TBOOLEAN:
+                        if (lua_toboolean(L, idx)) w.write("true", 4); else w.write("false", 5);
+                        break;
+                    case LUA_TNUMBER:
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 503
+                        if (lua_isinteger(L, idx))
+                        {
+                            writeInteger(w, lua_tointeger(L, idx));
+                            break;
+                        }
+#endif
+                        writeNumber(w, lua_tonumber(L, idx));
+                        break;
+                    case LUA_TSTRING:
+                    {
+                        size_t n = 0;
+                        const char * s = lua_tolstring(L, idx, &n);
+                        writeString(w, s, n);
+                        break;
+                    }
+                    case LUA_TLIGHTUSERDATA:
+                        if (lua_touserdata(L, idx) == nullptr)
+                        {
+                            w.write("null", 4);
+                            break;
+                        }
+                        w.fail("cannot encode lightuserdata");
+                        break;
+                    case LUA_TTABLE:
+                        if (!custom(idx))
+                        {
+                            table(idx, depth);
+                        }
+                        break;
+                    case LUA_TUSERDATA:
+                        if (!custom(idx) && !view(idx))
+                        {
+                            w.fail("cannot encode userdata");
+                        }
+                        break;
+                    default:
+                        w.fail("cannot encode function or thread");
+                        break;
+                    }
+                }
+
+                // __tojson(value) returns json text written as is.
+                bool custom(int idx)
+                {
+                    if (!luaL_getmetafield(L, idx, "__tojson"))
+                    {
+                        return false;
+                    }
+                    lua_pushvalue(L, idx);
+                    if (lua_pcall(L, 1, 1, 0) != 0 || lua_type(L, -1) != LUA_TSTRING)
+                    {
+                        w.fail("__tojson failed or returned no string");
+                    }
+                    else
+                    {
+                        size_t n = 0;
+                        const char * s = lua_tolstring(L, -1, &n);
+                        w.write(s, n);
+                    }
+                    lua_pop(L, 1);
+                    return true;
+                }
+
+                // numeric LuaArrayView.
+                bool view(int idx)
+                {
+                    if (!luaL_getmetafield(L, idx, "__luaaa_view"))
+                    {
+                        return false;
+                    }
+                    const LuaArrayViewInfo * info = (const LuaArrayViewInfo*)lua_touserdata(L, -1);
+                    lua_pop(L, 1);
+                    const LuaArrayView<const char> * v = (const LuaArrayView<const char>*)lua_touserdata(L, idx);
+                    if (!info || !v)
+                    {
+                        return false;
+                    }
+                    w.put('[');
+                    for (size_t i = 0; i < v->size; ++i)
+                    {
+                        if (i) w.put(',');
+                        writeNumber(w, info->number(v->data + i * v->stride));
+                    }
+                    w.put(']');
+                    return true;
+                }
+
+                // 1: array, 0: object, -1: decide by keys.
+                int forcedShape(int idx)
+                {
+                    int shape = -1;
+                    if (luaL_getmetafield(L, idx, "__jsontype"))
+                    {
+                        const char * s = lua_tostring(L, -1);
+                        if (s && strcmp(s, "array") == 0) shape = 1;
+                        else if (s && strcmp(s, "object") == 0) shape = 0;
+                        lua_pop(L, 1);
+                    }
+                    return shape;
+                }
+
+                // keys are exactly 1..n.
+                bool isArray(int idx, size_t n)
+                {
+                    if (n == 0)
+                    {
+                        return false;
+                    }
+                    size_t count = 0;
+                    lua_pushnil(L);
+                    while (lua_next(L, idx))
+                    {
+                        lua_pop(L, 1);
+                        if (lua_type(L, -1) != LUA_TNUMBER || ++count > n)
+                        {
+                            lua_pop(L, 1);
+                            return false;
+                        }
+                        lua_Number k = lua_tonumber(L, -1);
+                        if (k < 1 || k > (lua_Number)n || k != std::floor(k))
+                        {
+                            lua_pop(L, 1);
+                            return false;
+                        }
+                    }
+                    return count == n;
+                }
+
+                void table(int idx, int depth)
+                {
+                    if (depth >= maxDepth)
+                    {
+                        w.fail("nesting too deep or cycle");
+                        return;
+                    }
+                    if (!lua_checkstack(L, 4))
+                    {
+                        w.fail("stack overflow");
+                        return;
+                    }
+                    idx = lua_absindex(L, idx);
+                    size_t n = lua_rawlen(L, idx);
+                    int shape = forcedShape(idx);
+                    if (shape == 1 || (shape == -1 && isArray(idx, n)))
+                    {
+                        w.put('[');
+                        for (size_t i = 1; i <= n && !w.failed(); ++i)
+                        {
+                            if (i > 1) w.put(',');
+                            lua_rawgeti(L, idx, (int)i);
+                            value(-1, depth + 1);
+                            lua_pop(L, 1);
+                        }
+                        w.put(']');
+                        return;
+                    }
+                    w.put('{');
+                    bool first = true;
+                    lua_pushnil(L);
+                    while (lua_next(L, idx))
+                    {
+                        if (!first) w.put(',');
+                        first = false;
+                        switch (lua_type(L, -2))
+                        {
+                        case LUA_TSTRING:
+                        {
+                            size_t len = 0;
+                            const char * s = lua_tolstring(L, -2, &len);
+                            writeString(w, s, len);
+                            break;
+                        }
+                        case LUA_TNUMBER:
+                            // number keys become strings, lua_tostring would confuse lua_next.
+                            w.put('"');
+                            value(-2, depth + 1);
+                            w.put('"');
+                            break;
+                        default:
+                            w.fail("object key must be string or number");
+                            break;
+                        }
+                        w.put(':');
+                        value(-1, depth + 1);
+                        lua_pop(L, 1);
+                        if (w.failed())
+                        {
+                            lua_pop(L, 1);
+                            return;
+                        }
+                    }
+                    w.put('}');
+                }
+            };
+        }
+
+        // encodes value at idx into w, returns false with message in w.error() on unsupported value or write error.
+        // tables with keys 1..n become arrays, other tables objects, metafield __jsontype = "array"/"object" forces the shape
+        // (so empty table can be '[]'), metamethod __tojson(v) returns raw json text, nil and json null become null.
+        inline bool encode(lua_State * L, int idx, Writer& w, int maxDepth = LUAAA_JSON_MAX_DEPTH)
+        {
+            int top = lua_gettop(L);
+            detail::Encoder(L, w, maxDepth).value(lua_absindex(L, idx), 0);
+            lua_settop(L, top);
+            return w.flush();
+        }
+
+        // encodes C++ value through LuaStack<T>::put.
+        template<typename T>
+        inline bool encode(lua_State * L, const T& value, Writer& w, int maxDepth = LUAAA_JSON_MAX_DEPTH)
+        {
+            LuaStack<T>::put(L, value);
+            bool ok = encode(L, -1, w, maxDepth);
+            lua_pop(L, 1);
+            return ok;
+        }
+
+        //========================================================
+        // decoder
+        //========================================================
+        namespace detail
+        {
+            struct Decoder
+            {
+                // values collected on stack before moving into table.
+                enum { ArrayBatch = 64, ObjectBatch = 32 };
+
+                lua_State * L;
+                const char * begin;
+                const char * p;
+                const char * end;
+                int maxDepth;
+                const char * error;
+
+                Decoder(lua_State * L, const char * data, size_t size, int maxDepth)
+                    : L(L), begin(data), p(data), end(data + size), maxDepth(maxDepth), error(nullptr) {}
+
+                inline bool fail(const char * msg)
+                {
+                    if (!error) error = msg;
+                    return false;
+                }
+
+                inline void skip()
+                {
+                    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+                    {
+                        ++p;
+                    }
+                }
+
+                inline bool literal(const char * s, size_t n)
+                {
+                    if ((size_t)(end - p) < n || memcmp(p, s, n) != 0)
+                    {
+                        return fail("invalid literal");
+                    }
+                    p += n;
+                    return true;
+                }
+
+                bool value(int depth)
+                {
+                    skip();
+                    if (p == end)
+                    {
+                        return fail("unexpected end");
+                    }
+                    switch (*p)
+                    {
+                    case '{': return object(depth);
+                    case '[': return array(depth);
+                    case '"': return string();
+                    case 't': if (!literal("true", 4)) return false; lua_pushboolean(L, 1); return true;
+                    case 'f': if (!literal("false", 5)) return false; lua_pushboolean(L, 0); return true;
+                    case 'n': if (!literal("null", 4)) return false; lua_pushlightuserdata(L, nullptr); return true;
+                    default: return number();
+                    }
+                }
+
+                bool number()
+                {
+                    const char * s = p;
+                    bool negative = false;
+                    if (p < end && *p == '-')
+                    {
+                        negative = true;
+                        ++p;
+                    }
+                    if (p == end || *p < '0' || *p > '9')
+                    {
+                        return fail("unexpected character");
+                    }
+                    unsigned long long u = 0;
+                    bool overflow = false;
+                    if (*p == '0')
+                    {
+                        ++p;
+                    }
+                    else
+                    {
+                        while (p < end && *p >= '0' && *p <= '9')
+                        {
+                            const unsigned d = (unsigned)(*p++ - '0');
+                            overflow = overflow || u > (ULLONG_MAX - d) / 10;
+                            u = u * 10 + d;
+                        }
+                    }
+                    bool integral = true;
+                    if (p < end && *p == '.')
+                    {
+                        integral = false;
+                        ++p;
+                        if (p == end || *p < '0' || *p > '9') return fail("invalid number");
+                        while (p < end && *p >= '0' && *p <= '9') ++p;
+                    }
+                    if (p < end && (*p == 'e' || *p == 'E'))
+                    {
+                        integral = false;
+                        ++p;
+                        if (p < end && (*p == '+' || *p == '-')) ++p;
+                        if (p == end || *p < '0' || *p > '9') return fail("invalid number");
+                        while (p < end && *p >= '0' && *p <= '9') ++p;
+                    }
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 503
+                    // integers out of lua_Integer range are read as floats.
+                    if (integral && !overflow && u <= (unsigned long long)LUA_MAXINTEGER + (negative ? 1 : 0))
+                    {
+                        lua_pushinteger(L, !negative ? (lua_Integer)u : (u ? -(lua_Integer)(u - 1) - 1 : 0));
+                        return true;
+                    }
+#else
+                    if (integral && !overflow)
+                    {
+                        lua_pushnumber(L, negative ? -(lua_Number)u : (lua_Number)u);
+                        return true;
+                    }
+#endif
+                    // input may not be terminated, strtod needs a copy.
+                    size_t n = p - s;
+                    char tmp[64];
+                    if (n < sizeof(tmp))
+                    {
+                        memcpy(tmp, s, n);
+                        tmp[n] = 0;
+                        lua_pushnumber(L, (lua_Number)strtod(tmp, nullptr));
+                    }
+                    else
+                    {
+                        lua_pushlstring(L, s, n);
+                        lua_Number v = (lua_Number)strtod(lua_tostring(L, -1), nullptr);
+                        lua_pop(L, 1);
+                        lua_pushnumber(L, v);
+                    }
+                    return true;
+                }
+
+                inline int hex4()
+                {
+                    if (end - p < 4)
+                    {
+                        return -1;
+                    }
+                    int v = 0;
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        char c = *p++;
+                        v <<= 4;
+                        if (c >= '0' && c <= '9') v |= c - '0';
+                        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+                        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+                        else return -1;
+                    }
+                    return v;
+                }
+
+                static inline void addUtf8(luaL_Buffer * b, unsigned cp)
+                {
+                    if (cp < 0x80)
+                    {
+                        luaL_addchar(b, (char)cp);
+                    }
+                    else if (cp < 0x800)
+                    {
+                        luaL_addchar(b, (char)(0xC0 | (cp >> 6)));
+                        luaL_addchar(b, (char)(0x80 | (cp & 0x3F)));
+                    }
+                    else if (cp < 0x10000)
+                    {
+                        luaL_addchar(b, (char)(0xE0 | (cp >> 12)));
+                        luaL_addchar(b, (char)(0x80 | ((cp >> 6) & 0x3F)));
+                        luaL_addchar(b, (char)(0x80 | (cp & 0x3F)));
+                    }
+                    else
+                    {
+                        luaL_addchar(b, (char)(0xF0 | (cp >> 18)));
+                        luaL_addchar(b, (char)(0x80 | ((cp >> 12) & 0x3F)));
+                        luaL_addchar(b, (char)(0x80 | ((cp >> 6) & 0x3F)));
+                        luaL_addchar(b, (char)(0x80 | (cp & 0x3F)));
+                    }
+                }
+
+                bool string()
+                {
+                    const unsigned char * plain = plainChars();
+                    const char * s = ++p;
+                    while (p < end && plain[(unsigned char)*p])
+                    {
+                        ++p;
+                    }
+                    if (p == end)
+                    {
+                        return fail("unterminated string");
+                    }
+                    if (*p == '"')
+                    {
+                        // no escapes, single copy into lua string.
+                        lua_pushlstring(L, s, p - s);
+                        ++p;
+                        return true;
+                    }
+                    luaL_Buffer b;
+                    luaL_buffinit(L, &b);
+                    for (;;)
+                    {
+                        luaL_addlstring(&b, s, p - s);
+                        if (p == end)
+                        {
+                            return fail("unterminated string");
+                        }
+                        char c = *p++;
+                        if (c == '"')
+                        {
+                            break;
+                        }
+                        if (c != '\\' || p == end)
+                        {
+                            return fail("control character in string");
+                        }
+                        switch (*p++)
+                        {
+                        case '"': luaL_addchar(&b, '"'); break;
+                        case '\\': luaL_addchar(&b, '\\'); break;
+                        case '/': luaL_addchar(&b, '/'); break;
+                        case 'b': luaL_addchar(&b, '\b'); break;
+                        case 'f': luaL_addchar(&b, '\f'); break;
+                        case 'n': luaL_addchar(&b, '\n'); break;
+                        case 'r': luaL_addchar(&b, '\r'); break;
+                        case 't': luaL_addchar(&b, '\t'); break;
+                        case 'u':
+                        {
+                            int cp = hex4();
+                            if (cp < 0)
+                            {
+                                return fail("invalid unicode escape");
+                            }
+                            if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                            {
+                                const char * save = p;
+                                p += 2;
+                                int lo = hex4();
+                                if (lo >= 0xDC00 && lo < 0xE000)
+                                {
+                                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                                }
+                                else
+                                {
+                                    p = save;
+                                }
+                            }
+                            addUtf8(&b, (unsigned)cp);
+                            break;
+                        }
+                        default:
+                            return fail("invalid escape");
+                        }
+                        s = p;
+                        while (p < end && plain[(unsigned char)*p])
+                        {
+                            ++p;
+                        }
+                    }
+                    luaL_pushresult(&b);
+                    return true;
+                }
+
+                // moves count values on top of stack into table, creates it sized by hint on first batch.
+                inline void flushArray(int& table, int count, int& next, int hint)
+                {
+                    if (table == 0)
+                    {
+                        lua_createtable(L, hint, 0);
+                        lua_insert(L, -count - 1);
+                        table = lua_gettop(L) - count;
+                    }
+                    for (int i = count; i > 0; --i)
+                    {
+                        lua_rawseti(L, table, next + i);
+                    }
+                    next += count;
+                }
+
+                bool array(int depth)
+                {
+                    if (depth >= maxDepth)
+                    {
+                        return fail("nesting too deep");
+                    }
+                    ++p;
+                    int table = 0;
+                    int next = 0;
+                    int count = 0;
+                    skip();
+                    if (p < end && *p == ']')
+                    {
+                        ++p;
+                        lua_createtable(L, 0, 0);
+                        return true;
+                    }
+                    for (;;)
+                    {
+                        if (count == 0 && !lua_checkstack(L, ArrayBatch + LUA_MINSTACK))
+                        {
+                            return fail("stack overflow");
+                        }
+                        if (!value(depth + 1))
+                        {
+                            return false;
+                        }
+                        ++count;
+                        skip();
+                        if (p == end)
+                        {
+                            return fail("unterminated array");
+                        }
+                        if (*p == ']')
+                        {
+                            ++p;
+                            flushArray(table, count, next, count);
+                            return true;
+                        }
+                        if (*p++ != ',')
+                        {
+                            return fail("expected ',' or ']'");
+                        }
+                        if (count == ArrayBatch)
+                        {
+                            flushArray(table, count, next, ArrayBatch * 4);
+                            count = 0;
+                        }
+                    }
+                }
+
+                inline void flushObject(int& table, int count, int hint)
+                {
+                    if (table == 0)
+                    {
+                        lua_createtable(L, 0, hint);
+                        lua_insert(L, -count * 2 - 1);
+                        table = lua_gettop(L) - count * 2;
+                    }
+                    for (int i = 0; i < count; ++i)
+                    {
+                        lua_rawset(L, table);
+                    }
+                }
+
+                bool object(int depth)
+                {
+                    if (depth >= maxDepth)
+                    {
+                        return fail("nesting too deep");
+                    }
+                    ++p;
+                    int table = 0;
+                    int count = 0;
+                    skip();
+                    if (p < end && *p == '}')
+                    {
+                        ++p;
+                        lua_createtable(L, 0, 0);
+                        return true;
+                    }
+                    for (;;)
+                    {
+                        if (count == 0 && !lua_checkstack(L, ObjectBatch * 2 + LUA_MINSTACK))
+                        {
+                            return fail("stack overflow");
+                        }
+                        skip();
+                        if (p == end || *p != '"')
+                        {
+                            return fail("expected string key");
+                        }
+                        if (!string())
+                        {
+                            return false;
+                        }
+                        skip();
+                        if (p == end || *p++ != ':')
+                        {
+                            return fail("expected ':'");
+                        }
+                        if (!value(depth + 1))
+                        {
+                            return false;
+                        }
+                        ++count;
+                        skip();
+                        if (p == end)
+                        {
+                            return fail("unterminated object");
+                        }
+                        if (*p == '}')
+                        {
+                            ++p;
+                            flushObject(table, count, count);
+                            return true;
+                        }
+                        if (*p++ != ',')
+                        {
+                            return fail("expected ',' or '}'");
+                        }
+                        if (count == ObjectBatch)
+                        {
+                            flushObject(table, count, ObjectBatch * 4);
+                            count = 0;
+                        }
+                    }
+                }
+            };
+        }
+
+        // decodes json text and pushes the value, null becomes json null (NULL lightuserdata),
+        // returns false and pushes an error message instead on malformed input.
+        inline bool decode(lua_State * L, const char * data, size_t size, int maxDepth = LUAAA_JSON_MAX_DEPTH)
+        {
+            int top = lua_gettop(L);
+            detail::Decoder d(L, data, size, maxDepth);
+            if (d.value(0))
+            {
+                d.skip();
+                if (d.p == d.end)
+                {
+                    return true;
+                }
+                d.fail("trailing characters");
+            }
+            lua_settop(L, top);
+            lua_pushfstring(L, "json: %s at offset %d", d.error, (int)(d.p - d.begin));
+            return false;
+        }
+
+        // decodes json text into C++ value through LuaStack<T> (reusing its allocations when possible),
+        // returns false and pushes an error message on malformed input.
+        template<typename T>
+        inline bool decode(lua_State * L, const char * data, size_t size, T& out, int maxDepth = LUAAA_JSON_MAX_DEPTH)
+        {
+            if (!decode(L, data, size, maxDepth))
+            {
+                return false;
+            }
+#if LUAAA_WITHOUT_CPP_STDLIB
+            out = LuaStack<T>::get(L, -1);
+#else
+            get_into(L, lua_gettop(L), out);
+#endif
+            lua_pop(L, 1);
+            return true;
+        }
+
+        //========================================================
+        // lua binding
+        //========================================================
+        namespace detail
+        {
+            inline Writer * newWriter(lua_State * L)
+            {
+                Writer * w = new (lua_newuserdata(L, sizeof(Writer))) Writer();
+                if (luaL_newmetatable(L, "luaaa.json.Writer"))
+                {
+                    lua_pushcfunction(L, [](lua_State * L) -> int {
+                        ((Writer*)lua_touserdata(L, 1))->~Writer();
+                        return 0;
+                    });
+                    lua_setfield(L, -2, "__gc");
+                }
+                lua_setmetatable(L, -2);
+                return w;
+            }
+
+            inline FILE * toFile(lua_State * L, int idx)
+            {
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM > 501
+                luaL_Stream * s = (luaL_Stream*)luaL_checkudata(L, idx, LUA_FILEHANDLE);
+                luaL_argcheck(L, s->closef != nullptr && s->f != nullptr, idx, "attempt to use a closed file");
+                return s->f;
+#else
+                FILE ** f = (FILE**)luaL_checkudata(L, idx, LUA_FILEHANDLE);
+                luaL_argcheck(L, *f != nullptr, idx, "attempt to use a closed file");
+                return *f;
+#endif
+            }
+
+            // json.encode(value [, file]): returns json string, or writes it to io file and returns true.
+            inline int luaEncode(lua_State * L)
+            {
+                luaL_checkany(L, 1);
+                if (!lua_isnoneornil(L, 2))
+                {
+                    FILE * f = toFile(L, 2);
+                    lua_settop(L, 2);
+                    Writer * w = new (lua_newuserdata(L, sizeof(Writer))) Writer(f);
+                    luaL_getmetatable(L, "luaaa.json.Writer");
+                    lua_setmetatable(L, -2);
+                    if (!encode(L, 1, *w))
+                    {
+                        return luaL_error(L, "json: %s", w->error());
+                    }
+                    lua_pushboolean(L, 1);
+                    return 1;
+                }
+                lua_settop(L, 1);
+                // buffer kept in upvalue stays allocated between calls, nested calls from __tojson get their own.
+                Writer * w = (Writer*)lua_touserdata(L, lua_upvalueindex(1));
+                lua_pushboolean(L, 1);
+                bool busy = lua_toboolean(L, lua_upvalueindex(2)) != 0;
+                if (busy)
+                {
+                    w = newWriter(L);
+                }
+                else
+                {
+                    lua_replace(L, lua_upvalueindex(2));
+                    w->clear();
+                }
+                bool ok = encode(L, 1, *w);
+                if (!busy)
+                {
+                    lua_pushboolean(L, 0);
+                    lua_replace(L, lua_upvalueindex(2));
+                }
+                if (!ok)
+                {
+                    return luaL_error(L, "json: %s", w->error());
+                }
+                lua_pushlstring(L, w->data(), w->size());
+                return 1;
+            }
+
+            // json.decode(text): returns value, raises error on malformed input.
+            inline int luaDecode(lua_State * L)
+            {
+                size_t n = 0;
+                const char * s = luaL_checklstring(L, 1, &n);
+                if (!decode(L, s, n))
+                {
+                    return lua_error(L);
+                }
+                return 1;
+            }
+        }
+
+        // binds json.encode, json.decode and json.null (value that encodes to and decodes from null) into module.
+        inline void bind(lua_State * L, const char * module = "json")
+        {
+            LuaModule(L, module)
+                .fun("decode", &detail::luaDecode)
+                .def("null", (void*)nullptr);
+
+            // encode carries its reusable buffer as upvalue, so it is set into module table directly.
+            lua_getglobal(L, module);
+            detail::newWriter(L);
+            lua_pushboolean(L, 0);
+            lua_pushcclosure(L, &detail::luaEncode, 2);
+            lua_setfield(L, -2, "encode");
+            lua_pop(L, 1);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,502 @@
+
+/*
+ Copyright (c) 2019 gengyong
+ https://github.com/gengyong/luaaa
+ licensed under MIT License.
+*/
+
+#ifndef HEADER_LUAAA_MATH_HPP
+#define HEADER_LUAAA_MATH_HPP
+
+// optional vector/matrix value types, include after or instead of luaaa.hpp.
+// objects live inline in their userdata, results of operators are new userdata,
+// mutating methods (add/sub/scale/normalize/multiply/...) work in place without allocation.
+
+#include "luaaa.hpp"
+
+#include <cmath>
+
+/// set to 0 to use plain C++ kernels even if SSE2/NEON is available.
+/// note: NEON kernels are written against arm_neon.h but not tested on ARM yet, the SSE2 and plain paths are.
+#ifndef LUAAA_MATH_SIMD
+#define LUAAA_MATH_SIMD 1
+#endif
+
+#if LUAAA_MATH_SIMD && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#   define LUAAA_MATH_SSE2 1
+#   include <emmintrin.h>
+#elif LUAAA_MATH_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#   define LUAAA_MATH_NEON 1
+#   include <arm_neon.h>
+#endif
+
+namespace LUAAA_NS
+{
+    namespace math
+    {
+        //========================================================
+        // 4 lane float kernels
+        //========================================================
+        namespace simd
+        {
+#if defined(LUAAA_MATH_SSE2)
+            typedef __m128 f4;
+            inline f4 load(const float * p) { return _mm_loadu_ps(p); }
+            inline void store(float * p, f4 v) { _mm_storeu_ps(p, v); }
+            inline f4 set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+            inline f4 splat(float s) { return _mm_set1_ps(s); }
+            inline f4 add(f4 a, f4 b) { return _mm_add_ps(a, b); }
+            inline f4 sub(f4 a, f4 b) { return _mm_sub_ps(a, b); }
+            inline f4 mul(f4 a, f4 b) { return _mm_mul_ps(a, b); }
+            inline float dot(f4 a, f4 b)
+            {
+                f4 m = _mm_mul_ps(a, b);
+                f4 s = _mm_add_ps(m, _mm_movehl_ps(m, m));
+                s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+                return _mm_cvtss_f32(s);
+            }
+            // (y, z, x, w)
+            inline f4 yzxw(f4 a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)); }
+            // writes x, y, z only, so packed arrays can be updated in place.
+            inline void store3(float * p, f4 v)
+            {
+                _mm_store_ss(p, v);
+                _mm_store_ss(p + 1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+                _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+            }
+#elif defined(LUAAA_MATH_NEON)
+            typedef float32x4_t f4;
+            inline f4 load(const float * p) { return vld1q_f32(p); }
+            inline void store(float * p, f4 v) { vst1q_f32(p, v); }
+            inline f4 set(float x, float y, float z, float w) { const float t[4] = { x, y, z, w }; return vld1q_f32(t); }
+            inline f4 splat(float s) { return vdupq_n_f32(s); }
+            inline f4 add(f4 a, f4 b) { return vaddq_f32(a, b); }
+            inline f4 sub(f4 a, f4 b) { return vsubq_f32(a, b); }
+            inline f4 mul(f4 a, f4 b) { return vmulq_f32(a, b); }
+            inline float dot(f4 a, f4 b)
+            {
+                f4 m = vmulq_f32(a, b);
+#   if defined(__aarch64__) || defined(_M_ARM64)
+                return vaddvq_f32(m);
+#   else
+                float32x2_t s = vadd_f32(vget_low_f32(m), vget_high_f32(m));
+                return vget_lane_f32(vpadd_f32(s, s), 0);
+#   endif
+            }
+            inline f4 yzxw(f4 a)
+            {
+                f4 r = vextq_f32(a, a, 1);  // (y, z, w, x)
+                r = vsetq_lane_f32(vgetq_lane_f32(a, 0), r, 2);
+                return vsetq_lane_f32(vgetq_lane_f32(a, 3), r, 3);
+            }
+            inline void store3(float * p, f4 v)
+            {
+                vst1_f32(p, vget_low_f32(v));
+                p[2] = vgetq_lane_f32(v, 2);
+            }
+#else
+            struct f4 { float v[4]; };
+            inline f4 load(const float * p) { f4 r = { { p[0], p[1], p[2], p[3] } }; return r; }
+            inline void store(float * p, f4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+            inline f4 set(float x, float y, float z, float w) { f4 r = { { x, y, z, w } }; return r; }
+            inline f4 splat(float s) { f4 r = { { s, s, s, s } }; return r; }
+            inline f4 add(f4 a, f4 b) { f4 r = { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; return r; }
+            inline f4 sub(f4 a, f4 b) { f4 r = { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; return r; }
+            inline f4 mul(f4 a, f4 b) { f4 r = { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; return r; }
+            inline float dot(f4 a, f4 b) { return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2] + a.v[3] * b.v[3]; }
+            inline f4 yzxw(f4 a) { f4 r = { { a.v[1], a.v[2], a.v[0], a.v[3] } }; return r; }
+            inline void store3(float * p, f4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; }
+#endif
+            // (a.yzx * b.zxy - a.zxy * b.yzx) computed as yzx of (a * b.yzx - a.yzx * b), w stays 0 if both w are 0.
+            inline f4 cross(f4 a, f4 b)
+            {
+                return yzxw(sub(mul(a, yzxw(b)), mul(yzxw(a), b)));
+            }
+        }
+
+        //========================================================
+        // value types
+        //========================================================
+        struct Vec3
+        {
+            float x, y, z, w; // w is padding for 4 lane kernels, always 0.
+
+            Vec3() : x(0), y(0), z(0), w(0) {}
+            Vec3(float x, float y, float z) : x(x), y(y), z(z), w(0) {}
+
+            inline simd::f4 load() const { return simd::load(&x); }
+            inline void store(simd::f4 v) { simd::store(&x, v); w = 0; }
+            static inline Vec3 from(simd::f4 v) { Vec3 r; r.store(v); return r; }
+
+            inline Vec3 operator+(const Vec3& o) const { return from(simd::add(load(), o.load())); }
+            inline Vec3 operator-(const Vec3& o) const { return from(simd::sub(load(), o.load())); }
+            inline Vec3 operator*(float s) const { return from(simd::mul(load(), simd::splat(s))); }
+            inline Vec3 operator/(float s) const { return from(simd::mul(load(), simd::splat(1.0f / s))); }
+            inline Vec3 operator-() const { return Vec3(-x, -y, -z); }
+            inline bool operator==(const Vec3& o) const { return x == o.x && y == o.y && z == o.z; }
+
+            inline float dot(const Vec3& o) const { return simd::dot(load(), o.load()); }
+            inline Vec3 cross(const Vec3& o) const { return from(simd::cross(load(), o.load())); }
+            inline float length() const { return std::sqrt(dot(*this)); }
+            inline Vec3 normalized() const { Vec3 r(*this); r.normalize(); return r; }
+
+            // in place
+            inline void set(float nx, float ny, float nz) { x = nx; y = ny; z = nz; }
+            inline void add(const Vec3& o) { store(simd::add(load(), o.load())); }
+            inline void sub(const Vec3& o) { store(simd::sub(load(), o.load())); }
+            inline void scale(float s) { store(simd::mul(load(), simd::splat(s))); }
+            inline void normalize()
+            {
+                const float len = length();
+                if (len > 0)
+                {
+                    scale(1.0f / len);
+                }
+            }
+        };
+
+        inline Vec3 operator*(float s, const Vec3& v) { return v * s; }
+
+        struct Vec4
+        {
+            float x, y, z, w;
+
+            Vec4() : x(0), y(0), z(0), w(0) {}
+            Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+
+            inline simd::f4 load() const { return simd::load(&x); }
+            inline void store(simd::f4 v) { simd::store(&x, v); }
+            static inline Vec4 from(simd::f4 v) { Vec4 r; r.store(v); return r; }
+
+            inline Vec4 operator+(const Vec4& o) const { return from(simd::add(load(), o.load())); }
+            inline Vec4 operator-(const Vec4& o) const { return from(simd::sub(load(), o.load())); }
+            inline Vec4 operator*(float s) const { return from(simd::mul(load(), simd::splat(s))); }
+            inline Vec4 operator/(float s) const { return from(simd::mul(load(), simd::splat(1.0f / s))); }
+            inline Vec4 operator-() const { return Vec4(-x, -y, -z, -w); }
+            inline bool operator==(const Vec4& o) const { return x == o.x && y == o.y && z == o.z && w == o.w; }
+
+            inline float dot(const Vec4& o) const { return simd::dot(load(), o.load()); }
+            inline float length() const { return std::sqrt(dot(*this)); }
+            inline Vec4 normalized() const { Vec4 r(*this); r.normalize(); return r; }
+
+            // in place
+            inline void set(float nx, float ny, float nz, float nw) { x = nx; y = ny; z = nz; w = nw; }
+            inline void add(const Vec4& o) { store(simd::add(load(), o.load())); }
+            inline void sub(const Vec4& o) { store(simd::sub(load(), o.load())); }
+            inline void scale(float s) { store(simd::mul(load(), simd::splat(s))); }
+            inline void normalize()
+            {
+                const float len = length();
+                if (len > 0)
+                {
+                    scale(1.0f / len);
+                }
+            }
+        };
+
+        inline Vec4 operator*(float s, const Vec4& v) { return v * s; }
+
+        struct Quat
+        {
+            float x, y, z, w;
+
+            Quat() : x(0), y(0), z(0), w(1) {}
+            Quat(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+
+            static inline Quat identity() { return Quat(); }
+            static inline Quat axisAngle(const Vec3& axis, float radians)
+            {
+                const Vec3 a = axis.normalized() * std::sin(radians * 0.5f);
+                return Quat(a.x, a.y, a.z, std::cos(radians * 0.5f));
+            }
+
+            inline simd::f4 load() const { return simd::load(&x); }
+            inline void store(simd::f4 v) { simd::store(&x, v); }
+
+            inline Quat operator*(const Quat& o) const
+            {
+                return Quat(
+                    w * o.x + x * o.w + y * o.z - z * o.y,
+                    w * o.y - x * o.z + y * o.w + z * o.x,
+                    w * o.z + x * o.y - y * o.x + z * o.w,
+                    w * o.w - x * o.x - y * o.y - z * o.z);
+            }
+            inline Vec3 operator*(const Vec3& v) const { return rotate(v); }
+            inline bool operator==(const Quat& o) const { return x == o.x && y == o.y && z == o.z && w == o.w; }
+
+            inline float dot(const Quat& o) const { return simd::dot(load(), o.load()); }
+            inline float length() const { return std::sqrt(dot(*this)); }
+            inline Quat conjugated() const { return Quat(-x, -y, -z, w); }
+            inline Quat normalized() const { Quat r(*this); r.normalize(); return r; }
+
+            // v + 2w(q x v) + 2q x (q x v), q is the vector part.
+            inline simd::f4 rotate(simd::f4 v) const
+            {
+                const simd::f4 q = simd::set(x, y, z, 0);
+                const simd::f4 t = simd::mul(simd::cross(q, v), simd::splat(2.0f));
+                return simd::add(simd::add(v, simd::mul(t, simd::splat(w))), simd::cross(q, t));
+            }
+            inline Vec3 rotate(const Vec3& v) const { return Vec3::from(rotate(v.load())); }
+
+            // in place
+            inline void set(float nx, float ny, float nz, float nw) { x = nx; y = ny; z = nz; w = nw; }
+            inline void multiply(const Quat& o) { *this = (*this) * o; }
+            inline void conjugate() { x = -x; y = -y; z = -z; }
+            inline void normalize()
+            {
+                const float len = length();
+                if (len > 0)
+                {
+                    store(simd::mul(load(), simd::splat(1.0f / len)));
+                }
+            }
+
+            // rotates packed xyz triples in place.
+            inline void rotatePoints(LuaArrayView<float> points) const
+            {
+                for (size_t i = 0; i + 2 < points.size; i += 3)
+                {
+                    const simd::f4 r = rotate(simd::set(points[i], points[i + 1], points[i + 2], 0));
+                    float out[4];
+                    simd::store(out, r);
+                    points[i] = out[0]; points[i + 1] = out[1]; points[i + 2] = out[2];
+                }
+            }
+        };
+
+        // column major, m[col * 4 + row].
+        struct Mat4
+        {
+            float m[16];
+
+            Mat4() { setIdentity(); }
+
+            static inline Mat4 identity() { return Mat4(); }
+            static inline Mat4 translation(const Vec3& t)
+            {
+                Mat4 r;
+                r.m[12] = t.x; r.m[13] = t.y; r.m[14] = t.z;
+                return r;
+            }
+            static inline Mat4 scaling(const Vec3& s)
+            {
+                Mat4 r;
+                r.m[0] = s.x; r.m[5] = s.y; r.m[10] = s.z;
+                return r;
+            }
+            static inline Mat4 rotation(const Quat& q)
+            {
+                Mat4 r;
+                const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+                const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+                const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+                r.m[0] = 1 - 2 * (yy + zz); r.m[1] = 2 * (xy + wz);     r.m[2] = 2 * (xz - wy);
+                r.m[4] = 2 * (xy - wz);     r.m[5] = 1 - 2 * (xx + zz); r.m[6] = 2 * (yz + wx);
+                r.m[8] = 2 * (xz + wy);     r.m[9] = 2 * (yz - wx);     r.m[10] = 1 - 2 * (xx + yy);
+                return r;
+            }
+
+            inline simd::f4 col(int c) const { return simd::load(m + c * 4); }
+            inline float at(int row, int column) const { return m[column * 4 + row]; }
+            inline void setAt(int row, int column, float v) { m[column * 4 + row] = v; }
+
+            // c0 * x + c1 * y + c2 * z + c3 * w
+            inline simd::f4 transform(float x, float y, float z, float w) const
+            {
+                simd::f4 r = simd::mul(col(0), simd::splat(x));
+                r = simd::add(r, simd::mul(col(1), simd::splat(y)));
+                r = simd::add(r, simd::mul(col(2), simd::splat(z)));
+                return simd::add(r, simd::mul(col(3), simd::splat(w)));
+            }
+
+            inline Mat4 operator*(const Mat4& o) const
+            {
+                Mat4 r;
+                for (int c = 0; c < 4; ++c)
+                {
+                    simd::store(r.m + c * 4, transform(o.m[c * 4], o.m[c * 4 + 1], o.m[c * 4 + 2], o.m[c * 4 + 3]));
+                }
+                return r;
+            }
+            inline Vec3 operator*(const Vec3& p) const { return transformPoint(p); }
+            inline Vec4 operator*(const Vec4& v) const { return Vec4::from(transform(v.x, v.y, v.z, v.w)); }
+            inline bool operator==(const Mat4& o) const
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    if (m[i] != o.m[i])
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            inline Vec3 transformPoint(const Vec3& p) const { return Vec3::from(transform(p.x, p.y, p.z, 1)); }
+            inline Vec3 transformVector(const Vec3& v) const { return Vec3::from(transform(v.x, v.y, v.z, 0)); }
+            inline Mat4 transposed() const { Mat4 r(*this); r.transpose(); return r; }
+
+            // in place
+            inline void setIdentity()
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+                }
+            }
+            inline void multiply(const Mat4& o) { *this = (*this) * o; }
+            inline void transpose()
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    for (int r = c + 1; r < 4; ++r)
+                    {
+                        const float t = m[c * 4 + r];
+                        m[c * 4 + r] = m[r * 4 + c];
+                        m[r * 4 + c] = t;
+                    }
+                }
+            }
+
+            // transforms packed xyz triples in place, as points (w = 1) or directions (w = 0).
+            inline void transformPoints(LuaArrayView<float> points) const { transformPacked(points, 1); }
+            inline void transformVectors(LuaArrayView<float> vectors) const { transformPacked(vectors, 0); }
+
+        private:
+            inline void transformPacked(LuaArrayView<float> a, float w) const
+            {
+                if (a.stride == sizeof(float))
+                {
+                    float * p = a.data;
+                    for (size_t i = 0; i + 2 < a.size; i += 3, p += 3)
+                    {
+                        simd::store3(p, transform(p[0], p[1], p[2], w));
+                    }
+                    return;
+                }
+                for (size_t i = 0; i + 2 < a.size; i += 3)
+                {
+                    float out[4];
+                    simd::store(out, transform(a[i], a[i + 1], a[i + 2], w));
+                    a[i] = out[0]; a[i + 1] = out[1]; a[i + 2] = out[2];
+                }
+            }
+        };
+
+        // normalizes packed xyz triples in place.
+        inline void normalize3(LuaArrayView<float> a)
+        {
+            for (size_t i = 0; i + 2 < a.size; i += 3)
+            {
+                Vec3 v(a[i], a[i + 1], a[i + 2]);
+                v.normalize();
+                a[i] = v.x; a[i + 1] = v.y; a[i + 2] = v.z;
+            }
+        }
+
+        //========================================================
+        // lua binding
+        //========================================================
+        template<typename T, float T::*M> inline float getField(const T& v) { return v.*M; }
+        template<typename T, float T::*M> inline void setField(T& v, float f) { v.*M = f; }
+
+        // Mat4 element of (self, row, column), 0 based like Mat4::at, out of range indices raise lua errors.
+        inline float * mat4Element(lua_State * L)
+        {
+            Mat4& m = LuaStack<Mat4>::get(L, 1);
+            const lua_Integer row = luaL_checkinteger(L, 2);
+            const lua_Integer column = luaL_checkinteger(L, 3);
+            luaL_argcheck(L, row >= 0 && row < 4, 2, "row out of range [0, 3]");
+            luaL_argcheck(L, column >= 0 && column < 4, 3, "column out of range [0, 3]");
+            return m.m + column * 4 + row;
+        }
+        inline int mat4At(lua_State * L)
+        {
+            lua_pushnumber(L, *mat4Element(L));
+            return 1;
+        }
+        inline int mat4SetAt(lua_State * L)
+        {
+            float * e = mat4Element(L);
+            *e = (float)luaL_checknumber(L, 4);
+            return 0;
+        }
+
+        // binds classes Vec3, Vec4, Quat, Mat4, and factory/batch functions into module.
+        inline void bind(lua_State * L, const char * module = "vmath")
+        {
+            LuaClass<Vec3>(L, "Vec3")
+                .ctor<float, float, float>()
+                .get("x", &getField<Vec3, &Vec3::x>).set("x", &setField<Vec3, &Vec3::x>)
+                .get("y", &getField<Vec3, &Vec3::y>).set("y", &setField<Vec3, &Vec3::y>)
+                .get("z", &getField<Vec3, &Vec3::z>).set("z", &setField<Vec3, &Vec3::z>)
+                .op<ops::add>().op<ops::sub>().op<ops::mul, Vec3, float>().op<ops::mul, float, Vec3>().op<ops::div, Vec3, float>().op<ops::unm>().op<ops::eq>()
+                .fun("dot", &Vec3::dot)
+                .fun("cross", &Vec3::cross)
+                .fun("length", &Vec3::length)
+                .fun("normalized", &Vec3::normalized)
+                .fun("set", &Vec3::set)
+                .fun("add", &Vec3::add)
+                .fun("sub", &Vec3::sub)
+                .fun("scale", &Vec3::scale)
+                .fun("normalize", &Vec3::normalize);
+
+            LuaClass<Vec4>(L, "Vec4")
+                .ctor<float, float, float, float>()
+                .get("x", &getField<Vec4, &Vec4::x>).set("x", &setField<Vec4, &Vec4::x>)
+                .get("y", &getField<Vec4, &Vec4::y>).set("y", &setField<Vec4, &Vec4::y>)
+                .get("z", &getField<Vec4, &Vec4::z>).set("z", &setField<Vec4, &Vec4::z>)
+                .get("w", &getField<Vec4, &Vec4::w>).set("w", &setField<Vec4, &Vec4::w>)
+                .op<ops::add>().op<ops::sub>().op<ops::mul, Vec4, float>().op<ops::mul, float, Vec4>().op<ops::div, Vec4, float>().op<ops::unm>().op<ops::eq>()
+                .fun("dot", &Vec4::dot)
+                .fun("length", &Vec4::length)
+                .fun("normalized", &Vec4::normalized)
+                .fun("set", &Vec4::set)
+                .fun("add", &Vec4::add)
+                .fun("sub", &Vec4::sub)
+                .fun("scale", &Vec4::scale)
+                .fun("normalize", &Vec4::normalize);
+
+            LuaClass<Quat>(L, "Quat")
+                .ctor<float, float, float, float>()
+                .get("x", &getField<Quat, &Quat::x>).set("x", &setField<Quat, &Quat::x>)
+                .get("y", &getField<Quat, &Quat::y>).set("y", &setField<Quat, &Quat::y>)
+                .get("z", &getField<Quat, &Quat::z>).set("z", &setField<Quat, &Quat::z>)
+                .get("w", &getField<Quat, &Quat::w>).set("w", &setField<Quat, &Quat::w>)
+                .op<ops::mul>().op<ops::mul, Quat, Vec3>().op<ops::eq>()
+                .fun("dot", &Quat::dot)
+                .fun("length", &Quat::length)
+                .fun("conjugated", &Quat::conjugated)
+                .fun("normalized", &Quat::normalized)
+                .fun("rotate", (Vec3(Quat::*)(const Vec3&) const)&Quat::rotate)
+                .fun("rotatePoints", &Quat::rotatePoints)
+                .fun("set", &Quat::set)
+                .fun("multiply", &Quat::multiply)
+                .fun("conjugate", &Quat::conjugate)
+                .fun("normalize", &Quat::normalize);
+
+            LuaClass<Mat4>(L, "Mat4")
+                .ctor<>()
+                .op<ops::mul>().op<ops::mul, Mat4, Vec3>().op<ops::mul, Mat4, Vec4>().op<ops::eq>()
+                .fun("at", &mat4At)
+                .fun("setAt", &mat4SetAt)
+                .fun("transformPoint", &Mat4::transformPoint)
+                .fun("transformVector", &Mat4::transformVector)
+                .fun("transposed", &Mat4::transposed)
+                .fun("transformPoints", &Mat4::transformPoints)
+                .fun("transformVectors", &Mat4::transformVectors)
+                .fun("setIdentity", &Mat4::setIdentity)
+                .fun("multiply", &Mat4::multiply)
+                .fun("transpose", &Mat4::transpose);
+
+            LuaModule(L, module)
+                .fun("axisAngle", &Quat::axisAngle)
+                .fun("translation", &Mat4::translation)
+                .fun("scaling", &Mat4::scaling)
+                .fun("rotation", &Mat4::rotation)
+                .fun("normalize3", &normalize3);
+        }
+    }
+}
+
+#endif
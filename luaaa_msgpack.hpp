@@ -0,0 +1,1382 @@
+/*
+ Copyright (c) 2019 gengyong
+ https://github.com/gengyong/luaaa
+ licensed under MIT License.
+*/
+
+#ifndef HEADER_LUAAA_MSGPACK_HPP
+#define HEADER_LUAAA_MSGPACK_HPP
+
+// optional MessagePack codec, include after or instead of luaaa.hpp.
+// lua values are encoded straight from the stack, C++ values straight from the objects, decode is lazy:
+// arrays and maps come back as read-only views decoded level by level on first access, binary and numeric
+// arrays come back as LuaArrayView pointing into the encoded string, which the views keep alive.
+
+#include "luaaa.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+/// extension type id of packed numeric arrays (LuaArrayView, vector of numbers), payload is
+/// element kind ('f', 'i', 'u'), element size, pad count, pad bytes, then little endian elements.
+#ifndef LUAAA_MSGPACK_ARRAY_EXT
+#define LUAAA_MSGPACK_ARRAY_EXT 17
+#endif
+
+/// default nesting limit of encode/decode.
+#ifndef LUAAA_MSGPACK_MAX_DEPTH
+#define LUAAA_MSGPACK_MAX_DEPTH 128
+#endif
+
+namespace LUAAA_NS
+{
+    namespace msgpack
+    {
+        //========================================================
+        // output buffer
+        //========================================================
+        class Writer
+        {
+        public:
+            Writer() : m_data(nullptr), m_size(0), m_capacity(0), m_error(nullptr) {}
+
+            ~Writer()
+            {
+                free(m_data);
+            }
+
+            inline const char * data() const { return m_data; }
+            inline size_t size() const { return m_size; }
+
+            // keeps capacity.
+            inline void clear() { m_size = 0; m_error = nullptr; }
+
+            inline bool failed() const { return m_error != nullptr; }
+            inline const char * error() const { return m_error; }
+            inline void fail(const char * msg) { if (!m_error) m_error = msg; }
+
+            inline void put(unsigned char c)
+            {
+                if (m_size < m_capacity || grow(1))
+                {
+                    m_data[m_size++] = (char)c;
+                }
+            }
+
+            inline void write(const void * s, size_t n)
+            {
+                if (m_size + n <= m_capacity || grow(n))
+                {
+                    memcpy(m_data + m_size, s, n);
+                    m_size += n;
+                }
+            }
+
+            // type byte followed by n big endian bytes of v.
+            inline void put(unsigned char type, unsigned long long v, int n)
+            {
+                if (m_size + n + 1 <= m_capacity || grow(n + 1))
+                {
+                    char * p = m_data + m_size;
+                    p[0] = (char)type;
+                    for (int i = n; i > 0; --i, v >>= 8)
+                    {
+                        p[i] = (char)(v & 0xff);
+                    }
+                    m_size += n + 1;
+                }
+            }
+
+        private:
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            bool grow(size_t n)
+            {
+                if (m_error)
+                {
+                    return false;
+                }
+                size_t capacity = m_capacity ? m_capacity * 2 : 256;
+                while (capacity < m_size + n)
+                {
+                    capacity *= 2;
+                }
+                char * data = (char*)realloc(m_data, capacity);
+                if (!data)
+                {
+                    fail("not enough memory");
+                    return false;
+                }
+                m_data = data;
+                m_capacity = capacity;
+                return true;
+            }
+
+            char * m_data;
+            size_t m_size;
+            size_t m_capacity;
+            const char * m_error;
+        };
+
+        //========================================================
+        // primitive writers
+        //========================================================
+        inline bool littleEndian()
+        {
+            const unsigned short probe = 1;
+            return *(const unsigned char*)&probe == 1;
+        }
+
+        inline void packNil(Writer& w) { w.put(0xc0); }
+        inline void packBool(Writer& w, bool v) { w.put(v ? 0xc3 : 0xc2); }
+
+        inline void packUnsigned(Writer& w, unsigned long long v)
+        {
+            if (v < 0x80) w.put((unsigned char)v);
+            else if (v <= 0xff) w.put(0xcc, v, 1);
+            else if (v <= 0xffff) w.put(0xcd, v, 2);
+            else if (v <= 0xffffffffull) w.put(0xce, v, 4);
+            else w.put(0xcf, v, 8);
+        }
+
+        inline void packInteger(Writer& w, long long v)
+        {
+            if (v >= 0) packUnsigned(w, (unsigned long long)v);
+            else if (v >= -32) w.put((unsigned char)(v & 0xff));
+            else if (v >= -128) w.put(0xd0, (unsigned long long)v & 0xff, 1);
+            else if (v >= -32768) w.put(0xd1, (unsigned long long)v & 0xffff, 2);
+            else if (v >= -2147483647ll - 1) w.put(0xd2, (unsigned long long)v & 0xffffffffull, 4);
+            else w.put(0xd3, (unsigned long long)v, 8);
+        }
+
+        // float 32 when it keeps the value.
+        inline void packFloat(Writer& w, double v)
+        {
+            if (v != v || (std::fabs(v) <= FLT_MAX && (double)(float)v == v) || std::fabs(v) == HUGE_VAL)
+            {
+                float f = (float)v;
+                unsigned int bits;
+                memcpy(&bits, &f, 4);
+                w.put(0xca, bits, 4);
+                return;
+            }
+            unsigned long long bits;
+            memcpy(&bits, &v, 8);
+            w.put(0xcb, bits, 8);
+        }
+
+        inline void packNumber(Writer& w, lua_Number v)
+        {
+#if !defined(LUA_VERSION_NUM) || LUA_VERSION_NUM < 503
+            // no integer subtype, integral values go as integers.
+            if (v == std::floor(v) && std::fabs(v) < 9007199254740992.0)
+            {
+                packInteger(w, (long long)v);
+                return;
+            }
+#endif
+            packFloat(w, (double)v);
+        }
+
+        inline void packString(Writer& w, const char * s, size_t n)
+        {
+            if (n < 32) w.put((unsigned char)(0xa0 | n));
+            else if (n <= 0xff) w.put(0xd9, n, 1);
+            else if (n <= 0xffff) w.put(0xda, n, 2);
+            else w.put(0xdb, n, 4);
+            w.write(s, n);
+        }
+
+        inline void packBinary(Writer& w, const void * s, size_t n)
+        {
+            if (n <= 0xff) w.put(0xc4, n, 1);
+            else if (n <= 0xffff) w.put(0xc5, n, 2);
+            else w.put(0xc6, n, 4);
+            w.write(s, n);
+        }
+
+        inline void packArrayHeader(Writer& w, size_t n)
+        {
+            if (n < 16) w.put((unsigned char)(0x90 | n));
+            else if (n <= 0xffff) w.put(0xdc, n, 2);
+            else w.put(0xdd, n, 4);
+        }
+
+        inline void packMapHeader(Writer& w, size_t n)
+        {
+            if (n < 16) w.put((unsigned char)(0x80 | n));
+            else if (n <= 0xffff) w.put(0xde, n, 2);
+            else w.put(0xdf, n, 4);
+        }
+
+        // strided numeric array as LUAAA_MSGPACK_ARRAY_EXT, elements aligned to their size
+        // relative to the start of the output, so decoder can view them in place.
+        inline void packArray(Writer& w, const void * data, size_t count, size_t stride, unsigned char size, char kind)
+        {
+            const size_t bytes = count * size;
+            size_t pad = 0;
+            size_t len = 0;
+            int header = 0;
+            static const int headers[3] = { 3, 4, 6 };
+            static const size_t limits[3] = { 0xff, 0xffff, 0xffffffffull };
+            for (int h = 0; h < 3; ++h)
+            {
+                size_t pos = w.size() + headers[h] + 3;
+                pad = (size - pos % size) % size;
+                len = 3 + pad + bytes;
+                header = h;
+                if (len <= limits[h])
+                {
+                    break;
+                }
+            }
+            if (header == 0)
+            {
+                w.put(0xc7, len, 1);
+            }
+            else if (header == 1)
+            {
+                w.put(0xc8, len, 2);
+            }
+            else
+            {
+                w.put(0xc9, len, 4);
+            }
+            w.put((unsigned char)LUAAA_MSGPACK_ARRAY_EXT);
+            w.put((unsigned char)kind);
+            w.put(size);
+            w.put((unsigned char)pad);
+            for (size_t i = 0; i < pad; ++i)
+            {
+                w.put(0);
+            }
+            const bool swap = !littleEndian();
+            if (stride == size && !swap)
+            {
+                w.write(data, bytes);
+                return;
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                unsigned char e[8];
+                memcpy(e, (const char*)data + i * stride, size);
+                if (swap)
+                {
+                    for (int a = 0, b = size - 1; a < b; ++a, --b)
+                    {
+                        unsigned char t = e[a]; e[a] = e[b]; e[b] = t;
+                    }
+                }
+                w.write(e, size);
+            }
+        }
+
+        //========================================================
+        // lua value encoder
+        //========================================================
+        // metatable name of lazily decoded arrays and maps.
+        inline const char * viewName() { return "luaaa.msgpack.View"; }
+
+        // lazily decoded array or map, uservalue keeps the source alive, then is the cache table of decoded level.
+        struct View
+        {
+            const char * begin;     // header of this container
+            const char * body;      // first element
+            const char * end;       // past last element
+            size_t count;           // elements, or pairs for map
+            bool map;
+            bool ready;             // cache filled
+        };
+
+        namespace detail
+        {
+            struct Encoder
+            {
+                lua_State * L;
+                Writer& w;
+                int maxDepth;
+
+                Encoder(lua_State * L, Writer& w, int maxDepth) : L(L), w(w), maxDepth(maxDepth) {}
+
+                void value(int idx, int depth)
+                {
+                    switch (lua_type(L, idx))
+                    {
+                    case LUA_TNIL:
+                        packNil(w);
+                        break;
+                    case LUA_TBOOLEAN:
+                        packBool(w, lua_toboolean(L, idx) != 0);
+                        break;
+                    case LUA_TNUMBER:
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 503
+                        if (lua_isinteger(L, idx))
+                        {
+                            packInteger(w, (long long)lua_tointeger(L, idx));
+                            break;
+                        }
+#endif
+                        packNumber(w, lua_tonumber(L, idx));
+                        break;
+                    case LUA_TSTRING:
+                    {
+                        size_t n = 0;
+                        const char * s = lua_tolstring(L, idx, &n);
+                        packString(w, s, n);
+                        break;
+                    }
+                    case LUA_TLIGHTUSERDATA:
+                        if (lua_touserdata(L, idx) == nullptr)
+                        {
+                            packNil(w);
+                            break;
+                        }
+                        w.fail("cannot encode lightuserdata");
+                        break;
+                    case LUA_TTABLE:
+                        table(idx, depth);
+                        break;
+                    case LUA_TUSERDATA:
+                        userdata(idx);
+                        break;
+                    default:
+                        w.fail("cannot encode function or thread");
+                        break;
+                    }
+                }
+
+                void userdata(int idx)
+                {
+                    // undecoded views are copied as they are.
+                    const View * view = (const View*)luaL_testudata(L, idx, viewName());
+                    if (view)
+                    {
+                        w.write(view->begin, view->end - view->begin);
+                        return;
+                    }
+                    if (luaL_getmetafield(L, idx, "__luaaa_view"))
+                    {
+                        const LuaArrayViewInfo * info = (const LuaArrayViewInfo*)lua_touserdata(L, -1);
+                        lua_pop(L, 1);
+                        const LuaArrayView<const char> * v = (const LuaArrayView<const char>*)lua_touserdata(L, idx);
+                        if (info && v)
+                        {
+                            if (info->size == 1 && info->kind == 'u' && v->stride == 1)
+                            {
+                                packBinary(w, v->data, v->size);
+                            }
+                            else
+                            {
+                                packArray(w, v->data, v->size, v->stride, info->size, info->kind);
+                            }
+                            return;
+                        }
+                    }
+                    w.fail("cannot encode userdata");
+                }
+
+                void table(int idx, int depth)
+                {
+                    if (depth >= maxDepth)
+                    {
+                        w.fail("nesting too deep or cycle");
+                        return;
+                    }
+                    if (!lua_checkstack(L, 4))
+                    {
+                        w.fail("stack overflow");
+                        return;
+                    }
+                    idx = lua_absindex(L, idx);
+                    // one pass to count keys and see if they are exactly 1..n.
+                    size_t n = lua_rawlen(L, idx);
+                    size_t count = 0;
+                    bool array = n > 0;
+                    lua_pushnil(L);
+                    while (lua_next(L, idx))
+                    {
+                        lua_pop(L, 1);
+                        ++count;
+                        if (array)
+                        {
+                            lua_Number k = lua_type(L, -1) == LUA_TNUMBER ? lua_tonumber(L, -1) : 0;
+                            array = k >= 1 && k <= (lua_Number)n && k == std::floor(k);
+                        }
+                    }
+                    if (array && count == n)
+                    {
+                        packArrayHeader(w, n);
+                        for (size_t i = 1; i <= n && !w.failed(); ++i)
+                        {
+                            lua_rawgeti(L, idx, (int)i);
+                            value(-1, depth + 1);
+                            lua_pop(L, 1);
+                        }
+                        return;
+                    }
+                    packMapHeader(w, count);
+                    lua_pushnil(L);
+                    while (lua_next(L, idx))
+                    {
+                        value(-2, depth + 1);
+                        value(-1, depth + 1);
+                        lua_pop(L, 1);
+                        if (w.failed())
+                        {
+                            lua_pop(L, 1);
+                            return;
+                        }
+                    }
+                }
+            };
+        }
+
+        // encodes value at idx into w, returns false with message in w.error() on unsupported value.
+        // tables with keys 1..n become arrays, other tables maps, LuaArrayView a packed numeric array
+        // (binary for unsigned char), views from decode are copied undecoded, nil and msgpack null become nil.
+        inline bool encode(lua_State * L, int idx, Writer& w, int maxDepth = LUAAA_MSGPACK_MAX_DEPTH)
+        {
+            int top = lua_gettop(L);
+            detail::Encoder(L, w, maxDepth).value(lua_absindex(L, idx), 0);
+            lua_settop(L, top);
+            return !w.failed();
+        }
+
+        //========================================================
+        // C++ value encoder
+        //========================================================
+        // writes C++ values without going through lua, types without specialization go through LuaStack<T>::put.
+        template<typename T, typename = void>
+        struct Pack
+        {
+            static void write(lua_State * L, Writer& w, const T& v)
+            {
+                LuaStack<T>::put(L, v);
+                encode(L, -1, w);
+                lua_pop(L, 1);
+            }
+        };
+
+        template<>
+        struct Pack<bool>
+        {
+            static void write(lua_State *, Writer& w, bool v) { packBool(w, v); }
+        };
+
+        template<typename T>
+        struct Pack<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type>
+        {
+            static void write(lua_State *, Writer& w, T v) { packInteger(w, (long long)v); }
+        };
+
+        template<typename T>
+        struct Pack<T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value && !std::is_same<T, bool>::value>::type>
+        {
+            static void write(lua_State *, Writer& w, T v) { packUnsigned(w, (unsigned long long)v); }
+        };
+
+        template<typename T>
+        struct Pack<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+        {
+            static void write(lua_State *, Writer& w, T v) { packFloat(w, (double)v); }
+        };
+
+        template<>
+        struct Pack<const char *>
+        {
+            static void write(lua_State *, Writer& w, const char * v)
+            {
+                if (v) packString(w, v, strlen(v)); else packNil(w);
+            }
+        };
+
+        template<> struct Pack<char *> : public Pack<const char *> {};
+
+        // LUAAA_STRUCT types become maps of their fields.
+        template<typename T>
+        struct Pack<T, typename LuaVoid<decltype(LuaStack<T>::Names(std::declval<int&>()))>::type>
+        {
+            struct Fields
+            {
+                lua_State * L;
+                Writer& w;
+                const char * const * names;
+                int index;
+
+                template<typename F>
+                void operator()(const F& f)
+                {
+                    const char * name = names[index++];
+                    packString(w, name, strlen(name));
+                    Pack<F>::write(L, w, f);
+                }
+            };
+
+            static void write(lua_State * L, Writer& w, const T& v)
+            {
+                int count = 0;
+                const char * const * names = LuaStack<T>::Names(count);
+                packMapHeader(w, count);
+                Fields fields = { L, w, names, 0 };
+                LuaStack<T>::Fields(v, fields);
+            }
+        };
+
+        // numbers (not bool or char) which pack into LUAAA_MSGPACK_ARRAY_EXT from contiguous storage.
+        template<typename T>
+        struct PackElement
+        {
+            enum { value = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value && sizeof(T) <= 8 };
+            static char kind() { return std::is_floating_point<T>::value ? 'f' : (std::is_signed<T>::value ? 'i' : 'u'); }
+        };
+
+        template<typename C>
+        inline void packRange(lua_State * L, Writer& w, const C& c, size_t n)
+        {
+            packArrayHeader(w, n);
+            for (const auto& e : c)
+            {
+                Pack<typename std::decay<decltype(e)>::type>::write(L, w, e);
+            }
+        }
+
+        template<typename E>
+        inline void packContiguous(lua_State * /*L*/, Writer& w, const E * data, size_t n, std::true_type)
+        {
+            if (sizeof(E) == 1 && !std::is_signed<E>::value)
+            {
+                packBinary(w, data, n);
+            }
+            else
+            {
+                packArray(w, data, n, sizeof(E), (unsigned char)sizeof(E), PackElement<E>::kind());
+            }
+        }
+
+        template<typename E>
+        inline void packContiguous(lua_State * L, Writer& w, const E * data, size_t n, std::false_type)
+        {
+            packArrayHeader(w, n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                Pack<E>::write(L, w, data[i]);
+            }
+        }
+
+        template<typename E, size_t N>
+        struct Pack<E[N]>
+        {
+            static void write(lua_State * L, Writer& w, const E(&v)[N])
+            {
+                packContiguous(L, w, v, N, std::integral_constant<bool, PackElement<E>::value>());
+            }
+        };
+
+#if !LUAAA_WITHOUT_CPP_STDLIB
+        template<typename ...ARGS>
+        struct Pack<std::basic_string<char, ARGS...>>
+        {
+            static void write(lua_State *, Writer& w, const std::basic_string<char, ARGS...>& v) { packString(w, v.data(), v.size()); }
+        };
+
+        template<typename E, typename ...ARGS>
+        struct Pack<std::vector<E, ARGS...>>
+        {
+            static void write(lua_State * L, Writer& w, const std::vector<E, ARGS...>& v)
+            {
+                packContiguous(L, w, v.data(), v.size(), std::integral_constant<bool, PackElement<E>::value>());
+            }
+        };
+
+        template<typename ...ARGS>
+        struct Pack<std::vector<bool, ARGS...>>
+        {
+            static void write(lua_State * L, Writer& w, const std::vector<bool, ARGS...>& v) { packRange(L, w, v, v.size()); }
+        };
+
+        template<typename E, size_t N>
+        struct Pack<std::array<E, N>>
+        {
+            static void write(lua_State * L, Writer& w, const std::array<E, N>& v)
+            {
+                packContiguous(L, w, v.data(), N, std::integral_constant<bool, PackElement<E>::value>());
+            }
+        };
+
+        template<typename C>
+        struct PackSequence
+        {
+            static void write(lua_State * L, Writer& w, const C& v) { packRange(L, w, v, v.size()); }
+        };
+
+        template<typename E, typename ...ARGS> struct Pack<std::deque<E, ARGS...>> : public PackSequence<std::deque<E, ARGS...>> {};
+        template<typename E, typename ...ARGS> struct Pack<std::list<E, ARGS...>> : public PackSequence<std::list<E, ARGS...>> {};
+        template<typename E, typename ...ARGS> struct Pack<std::set<E, ARGS...>> : public PackSequence<std::set<E, ARGS...>> {};
+        template<typename E, typename ...ARGS> struct Pack<std::multiset<E, ARGS...>> : public PackSequence<std::multiset<E, ARGS...>> {};
+        template<typename E, typename ...ARGS> struct Pack<std::unordered_set<E, ARGS...>> : public PackSequence<std::unordered_set<E, ARGS...>> {};
+        template<typename E, typename ...ARGS> struct Pack<std::unordered_multiset<E, ARGS...>> : public PackSequence<std::unordered_multiset<E, ARGS...>> {};
+
+        template<typename C>
+        struct PackMap
+        {
+            static void write(lua_State * L, Writer& w, const C& v)
+            {
+                packMapHeader(w, v.size());
+                for (const auto& e : v)
+                {
+                    Pack<typename C::key_type>::write(L, w, e.first);
+                    Pack<typename C::mapped_type>::write(L, w, e.second);
+                }
+            }
+        };
+
+        template<typename K, typename V, typename ...ARGS> struct Pack<std::map<K, V, ARGS...>> : public PackMap<std::map<K, V, ARGS...>> {};
+        template<typename K, typename V, typename ...ARGS> struct Pack<std::unordered_map<K, V, ARGS...>> : public PackMap<std::unordered_map<K, V, ARGS...>> {};
+#endif
+
+        // encodes C++ value into w directly, lua state is only used by types without Pack specialization
+        // and may be nullptr if there are none.
+        template<typename T>
+        inline bool pack(lua_State * L, const T& v, Writer& w)
+        {
+            Pack<T>::write(L, w, v);
+            return !w.failed();
+        }
+
+        //========================================================
+        // decoder
+        //========================================================
+        namespace detail
+        {
+            enum Type { Nil, Bool, Int, Uint, Float, Str, Bin, Array, Map, Ext };
+
+            struct Item
+            {
+                int type;
+                long long i;
+                unsigned long long u;
+                double f;
+                const char * data;  // str/bin/ext payload
+                size_t len;         // payload bytes, or elements of array/map
+                signed char ext;
+            };
+
+            inline unsigned long long readBE(const char * p, int n)
+            {
+                unsigned long long v = 0;
+                for (int i = 0; i < n; ++i)
+                {
+                    v = (v << 8) | (unsigned char)p[i];
+                }
+                return v;
+            }
+
+            // reads header at p, moves p past the item (containers: to first element).
+            inline bool next(const char *& p, const char * end, Item& it)
+            {
+                if (p >= end)
+                {
+                    return false;
+                }
+                unsigned char c = (unsigned char)*p++;
+                int n = 0;      // bytes of length/value field
+                int payload = 0;
+                if (c < 0x80) { it.type = Uint; it.u = c; return true; }
+                if (c >= 0xe0) { it.type = Int; it.i = (signed char)c; return true; }
+                if (c < 0x90) { it.type = Map; it.len = c & 0x0f; return true; }
+                if (c < 0xa0) { it.type = Array; it.len = c & 0x0f; return true; }
+                if (c < 0xc0)
+                {
+                    it.type = Str;
+                    it.len = c & 0x1f;
+                    payload = 1;
+                }
+                else switch (c)
+                {
+                case 0xc0: it.type = Nil; return true;
+                case 0xc2: it.type = Bool; it.u = 0; return true;
+                case 0xc3: it.type = Bool; it.u = 1; return true;
+                case 0xc4: case 0xc5: case 0xc6: it.type = Bin; n = 1 << (c - 0xc4); payload = 1; break;
+                case 0xc7: case 0xc8: case 0xc9: it.type = Ext; n = 1 << (c - 0xc7); payload = 2; break;
+                case 0xca: case 0xcb:
+                {
+                    n = c == 0xca ? 4 : 8;
+                    if (end - p < n) return false;
+                    unsigned long long bits = readBE(p, n);
+                    p += n;
+                    it.type = Float;
+                    if (n == 4)
+                    {
+                        unsigned int b32 = (unsigned int)bits;
+                        float f;
+                        memcpy(&f, &b32, 4);
+                        it.f = f;
+                    }
+                    else
+                    {
+                        memcpy(&it.f, &bits, 8);
+                    }
+                    return true;
+                }
+                case 0xcc: case 0xcd: case 0xce: case 0xcf:
+                    n = 1 << (c - 0xcc);
+                    if (end - p < n) return false;
+                    it.type = Uint;
+                    it.u = readBE(p, n);
+                    p += n;
+                    return true;
+                case 0xd0: case 0xd1: case 0xd2: case 0xd3:
+                {
+                    n = 1 << (c - 0xd0);
+                    if (end - p < n) return false;
+                    unsigned long long v = readBE(p, n);
+                    p += n;
+                    // sign extend.
+                    int shift = 64 - n * 8;
+                    it.type = Int;
+                    it.i = shift ? (long long)(v << shift) >> shift : (long long)v;
+                    return true;
+                }
+                case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8:
+                    it.type = Ext;
+                    it.len = (size_t)1 << (c - 0xd4);
+                    payload = 2;
+                    break;
+                case 0xd9: case 0xda: case 0xdb: it.type = Str; n = 1 << (c - 0xd9); payload = 1; break;
+                case 0xdc: case 0xdd:
+                    n = c == 0xdc ? 2 : 4;
+                    if (end - p < n) return false;
+                    it.type = Array;
+                    it.len = (size_t)readBE(p, n);
+                    p += n;
+                    return true;
+                case 0xde: case 0xdf:
+                    n = c == 0xde ? 2 : 4;
+                    if (end - p < n) return false;
+                    it.type = Map;
+                    it.len = (size_t)readBE(p, n);
+                    p += n;
+                    return true;
+                default:
+                    return false;
+                }
+                if (n)
+                {
+                    if (end - p < n) return false;
+                    it.len = (size_t)readBE(p, n);
+                    p += n;
+                }
+                if (payload == 2)
+                {
+                    if (p >= end) return false;
+                    it.ext = (signed char)*p++;
+                }
+                if ((size_t)(end - p) < it.len)
+                {
+                    return false;
+                }
+                it.data = p;
+                p += it.len;
+                return true;
+            }
+
+            // moves p past one value, checks bounds of everything inside.
+            inline bool skip(const char *& p, const char * end, int depth)
+            {
+                Item it;
+                if (depth < 0 || !next(p, end, it))
+                {
+                    return false;
+                }
+                if (it.type == Array || it.type == Map)
+                {
+                    size_t n = it.type == Map ? it.len * 2 : it.len;
+                    // every element takes at least one byte.
+                    if (n > (size_t)(end - p))
+                    {
+                        return false;
+                    }
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        if (!skip(p, end, depth - 1))
+                        {
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            }
+
+            // packed numeric array header inside ext payload.
+            struct PackedArray
+            {
+                char kind;
+                unsigned char size;
+                const char * data;
+                size_t count;
+            };
+
+            inline bool packedArray(const Item& it, PackedArray& a)
+            {
+                if (it.ext != LUAAA_MSGPACK_ARRAY_EXT || it.len < 3)
+                {
+                    return false;
+                }
+                a.kind = it.data[0];
+                a.size = (unsigned char)it.data[1];
+                size_t pad = (unsigned char)it.data[2];
+                if ((a.kind != 'f' && a.kind != 'i' && a.kind != 'u') || !(a.size == 1 || a.size == 2 || a.size == 4 || a.size == 8)
+                    || (a.kind == 'f' && a.size < 4) || 3 + pad > it.len || (it.len - 3 - pad) % a.size)
+                {
+                    return false;
+                }
+                a.data = it.data + 3 + pad;
+                a.count = (it.len - 3 - pad) / a.size;
+                return true;
+            }
+
+            template<typename T>
+            inline void pushArrayView(lua_State * L, const PackedArray& a)
+            {
+                LuaStack<LuaArrayView<const T>>::put(L, LuaArrayView<const T>((const T*)a.data, a.count));
+            }
+
+            // in place view when elements are aligned and byte order matches, false otherwise.
+            inline bool pushArrayView(lua_State * L, const PackedArray& a)
+            {
+                if (((size_t)a.data % a.size) != 0 || (a.size > 1 && !littleEndian()))
+                {
+                    return false;
+                }
+                switch (a.kind * 16 + a.size)
+                {
+                case 'f' * 16 + 4: pushArrayView<float>(L, a); break;
+                case 'f' * 16 + 8: pushArrayView<double>(L, a); break;
+                case 'i' * 16 + 1: pushArrayView<signed char>(L, a); break;
+                case 'i' * 16 + 2: pushArrayView<short>(L, a); break;
+                case 'i' * 16 + 4: pushArrayView<int>(L, a); break;
+                case 'i' * 16 + 8: pushArrayView<long long>(L, a); break;
+                case 'u' * 16 + 1: pushArrayView<unsigned char>(L, a); break;
+                case 'u' * 16 + 2: pushArrayView<unsigned short>(L, a); break;
+                case 'u' * 16 + 4: pushArrayView<unsigned int>(L, a); break;
+                case 'u' * 16 + 8: pushArrayView<unsigned long long>(L, a); break;
+                default: return false;
+                }
+                return true;
+            }
+
+            // copies packed array into a new table.
+            inline void pushArrayTable(lua_State * L, const PackedArray& a)
+            {
+                lua_createtable(L, (int)a.count, 0);
+                for (size_t i = 0; i < a.count; ++i)
+                {
+                    unsigned char e[8];
+                    for (int b = 0; b < a.size; ++b)
+                    {
+                        // stored little endian.
+                        e[littleEndian() ? b : a.size - 1 - b] = (unsigned char)a.data[i * a.size + b];
+                    }
+                    lua_Number number = 0;
+                    long long integer = 0;
+                    bool isInteger = true;
+                    switch (a.kind * 16 + a.size)
+                    {
+                    case 'f' * 16 + 4: { float v; memcpy(&v, e, 4); number = v; isInteger = false; break; }
+                    case 'f' * 16 + 8: { double v; memcpy(&v, e, 8); number = (lua_Number)v; isInteger = false; break; }
+                    case 'i' * 16 + 1: { signed char v; memcpy(&v, e, 1); integer = v; break; }
+                    case 'i' * 16 + 2: { short v; memcpy(&v, e, 2); integer = v; break; }
+                    case 'i' * 16 + 4: { int v; memcpy(&v, e, 4); integer = v; break; }
+                    case 'i' * 16 + 8: { long long v; memcpy(&v, e, 8); integer = v; break; }
+                    case 'u' * 16 + 1: { unsigned char v; memcpy(&v, e, 1); integer = v; break; }
+                    case 'u' * 16 + 2: { unsigned short v; memcpy(&v, e, 2); integer = v; break; }
+                    case 'u' * 16 + 4: { unsigned int v; memcpy(&v, e, 4); integer = v; break; }
+                    case 'u' * 16 + 8: { unsigned long long v; memcpy(&v, e, 8); integer = (long long)v; break; }
+                    }
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 503
+                    if (isInteger) lua_pushinteger(L, (lua_Integer)integer); else lua_pushnumber(L, number);
+#else
+                    lua_pushnumber(L, isInteger ? (lua_Number)integer : number);
+#endif
+                    lua_rawseti(L, -2, (int)(i + 1));
+                }
+            }
+
+            // key of the source anchor inside view cache tables.
+            inline void * anchorKey()
+            {
+                static char key;
+                return &key;
+            }
+
+            struct Decoder
+            {
+                lua_State * L;
+                const char * begin;
+                const char * p;
+                const char * end;
+                int maxDepth;
+                int anchor;     // stack index of value keeping the buffer alive, 0 if caller keeps it
+                bool lazy;
+                const char * error;
+
+                Decoder(lua_State * L, const char * data, size_t size, int maxDepth, int anchor, bool lazy)
+                    : L(L), begin(data), p(data), end(data + size), maxDepth(maxDepth), anchor(anchor), lazy(lazy), error(nullptr) {}
+
+                inline bool fail(const char * msg)
+                {
+                    if (!error) error = msg;
+                    return false;
+                }
+
+                inline void pushInteger(long long v)
+                {
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 503
+                    lua_pushinteger(L, (lua_Integer)v);
+#else
+                    lua_pushnumber(L, (lua_Number)v);
+#endif
+                }
+
+                // anchors the buffer from userdata on top.
+                inline void anchorTop()
+                {
+                    if (anchor)
+                    {
+                        lua_pushvalue(L, anchor);
+                        lua_setuservalue(L, -2);
+                    }
+                }
+
+                bool value(int depth)
+                {
+                    const char * start = p;
+                    Item it;
+                    if (!next(p, end, it))
+                    {
+                        return fail("truncated or invalid data");
+                    }
+                    if (!lua_checkstack(L, 4))
+                    {
+                        return fail("stack overflow");
+                    }
+                    switch (it.type)
+                    {
+                    case Nil: lua_pushlightuserdata(L, nullptr); return true;
+                    case Bool: lua_pushboolean(L, (int)it.u); return true;
+                    case Int: pushInteger(it.i); return true;
+                    case Uint:
+                        if (it.u > 0x7fffffffffffffffull) lua_pushnumber(L, (lua_Number)it.u); else pushInteger((long long)it.u);
+                        return true;
+                    case Float: lua_pushnumber(L, (lua_Number)it.f); return true;
+                    case Str: lua_pushlstring(L, it.data, it.len); return true;
+                    case Bin:
+                        if (lazy)
+                        {
+                            LuaStack<LuaArrayView<const unsigned char>>::put(L, LuaArrayView<const unsigned char>((const unsigned char*)it.data, it.len));
+                            anchorTop();
+                        }
+                        else
+                        {
+                            lua_pushlstring(L, it.data, it.len);
+                        }
+                        return true;
+                    case Ext:
+                    {
+                        PackedArray a;
+                        if (!packedArray(it, a))
+                        {
+                            // other extensions come as their payload.
+                            lua_pushlstring(L, it.data, it.len);
+                            return true;
+                        }
+                        if (lazy && pushArrayView(L, a))
+                        {
+                            anchorTop();
+                        }
+                        else
+                        {
+                            pushArrayTable(L, a);
+                        }
+                        return true;
+                    }
+                    case Array:
+                    case Map:
+                        if (depth >= maxDepth)
+                        {
+                            return fail("nesting too deep");
+                        }
+                        return lazy ? view(it, start, depth) : container(it, depth);
+                    }
+                    return fail("invalid data");
+                }
+
+                bool view(const Item& it, const char * start, int depth)
+                {
+                    const char * body = p;
+                    p = start;
+                    if (!skip(p, end, maxDepth - depth))
+                    {
+                        return fail("truncated or invalid data");
+                    }
+                    View * v = (View*)lua_newuserdata(L, sizeof(View));
+                    v->begin = start;
+                    v->body = body;
+                    v->end = p;
+                    v->count = it.len;
+                    v->map = it.type == Map;
+                    v->ready = false;
+                    luaL_getmetatable(L, viewName());
+                    lua_setmetatable(L, -2);
+                    // uservalue is the anchor until first access replaces it with the cache.
+                    if (anchor)
+                    {
+                        lua_pushvalue(L, anchor);
+                        lua_setuservalue(L, -2);
+                    }
+                    return true;
+                }
+
+                bool container(const Item& it, int depth)
+                {
+                    // every element takes at least one byte.
+                    size_t n = it.type == Map ? it.len * 2 : it.len;
+                    if (n > (size_t)(end - p))
+                    {
+                        return fail("truncated or invalid data");
+                    }
+                    if (it.type == Array)
+                    {
+                        lua_createtable(L, (int)it.len, 0);
+                        for (size_t i = 0; i < it.len; ++i)
+                        {
+                            if (!value(depth + 1))
+                            {
+                                return false;
+                            }
+                            lua_rawseti(L, -2, (int)(i + 1));
+                        }
+                        return true;
+                    }
+                    lua_createtable(L, 0, (int)it.len);
+                    for (size_t i = 0; i < it.len; ++i)
+                    {
+                        if (!value(depth + 1) || !value(depth + 1))
+                        {
+                            return false;
+                        }
+                        if (!setField(-3))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+
+                // key and value on top, nil keys (from msgpack nil) and nan keys are rejected.
+                inline bool setField(int table)
+                {
+                    if ((lua_type(L, -2) == LUA_TLIGHTUSERDATA && lua_touserdata(L, -2) == nullptr)
+                        || (lua_type(L, -2) == LUA_TNUMBER && lua_tonumber(L, -2) != lua_tonumber(L, -2)))
+                    {
+                        return fail("invalid map key");
+                    }
+                    lua_rawset(L, table);
+                    return true;
+                }
+            };
+
+            // decodes one level of view into its cache table.
+            inline void fill(lua_State * L, int idx, View * v)
+            {
+                idx = lua_absindex(L, idx);
+                lua_getuservalue(L, idx);
+                int anchor = lua_isnil(L, -1) ? 0 : lua_gettop(L);
+                lua_createtable(L, v->map ? 0 : (int)v->count, v->map ? (int)v->count + 1 : 1);
+                int cache = lua_gettop(L);
+                if (anchor)
+                {
+                    lua_pushlightuserdata(L, anchorKey());
+                    lua_pushvalue(L, anchor);
+                    lua_rawset(L, cache);
+                }
+                lua_pushvalue(L, cache);
+                lua_setuservalue(L, idx);
+                Decoder d(L, v->body, v->end - v->body, LUAAA_MSGPACK_MAX_DEPTH, anchor, true);
+                for (size_t i = 0; i < v->count; ++i)
+                {
+                    if (v->map)
+                    {
+                        // bounds were checked when the view was made.
+                        if (!d.value(1) || !d.value(1) || !d.setField(cache))
+                        {
+                            luaL_error(L, "msgpack: %s", d.error);
+                        }
+                    }
+                    else
+                    {
+                        if (!d.value(1))
+                        {
+                            luaL_error(L, "msgpack: %s", d.error);
+                        }
+                        lua_rawseti(L, cache, (int)(i + 1));
+                    }
+                }
+                v->ready = true;
+                lua_settop(L, cache - 2);
+            }
+
+            inline View * checkView(lua_State * L, int idx)
+            {
+                View * v = (View*)luaL_checkudata(L, idx, viewName());
+                if (!v->ready)
+                {
+                    fill(L, idx, v);
+                }
+                return v;
+            }
+
+            inline int viewIndex(lua_State * L)
+            {
+                checkView(L, 1);
+                lua_getuservalue(L, 1);
+                lua_pushvalue(L, 2);
+                lua_rawget(L, -2);
+                return 1;
+            }
+
+            inline int viewNewIndex(lua_State * L)
+            {
+                return luaL_error(L, "msgpack view is read-only");
+            }
+
+            inline int viewLen(lua_State * L)
+            {
+                View * v = (View*)luaL_checkudata(L, 1, viewName());
+                if (!v->map)
+                {
+                    lua_pushinteger(L, (lua_Integer)v->count);
+                    return 1;
+                }
+                checkView(L, 1);
+                lua_getuservalue(L, 1);
+                lua_pushinteger(L, (lua_Integer)lua_rawlen(L, -1));
+                return 1;
+            }
+
+            inline int viewNext(lua_State * L)
+            {
+                checkView(L, 1);
+                lua_settop(L, 2);
+                lua_getuservalue(L, 1);
+                lua_insert(L, 2);
+                while (lua_next(L, 2))
+                {
+                    if (lua_type(L, -2) == LUA_TLIGHTUSERDATA && lua_touserdata(L, -2) == anchorKey())
+                    {
+                        lua_pop(L, 1);
+                        continue;
+                    }
+                    return 2;
+                }
+                return 0;
+            }
+
+            inline int viewPairs(lua_State * L)
+            {
+                luaL_checkudata(L, 1, viewName());
+                lua_pushcfunction(L, &viewNext);
+                lua_pushvalue(L, 1);
+                lua_pushnil(L);
+                return 3;
+            }
+
+            inline void registerView(lua_State * L)
+            {
+                if (luaL_newmetatable(L, viewName()))
+                {
+                    const luaL_Reg metas[] = {
+                        { "__index", &viewIndex },
+                        { "__newindex", &viewNewIndex },
+                        { "__len", &viewLen },
+                        { "__pairs", &viewPairs },
+                        { nullptr, nullptr }
+                    };
+                    luaL_setfuncs(L, metas, 0);
+                }
+                lua_pop(L, 1);
+            }
+
+            inline bool run(Decoder& d)
+            {
+                int top = lua_gettop(d.L);
+                if (d.value(0))
+                {
+                    if (d.p == d.end)
+                    {
+                        return true;
+                    }
+                    d.fail("trailing bytes");
+                }
+                lua_settop(d.L, top);
+                lua_pushfstring(d.L, "msgpack: %s at offset %d", d.error, (int)(d.p - d.begin));
+                return false;
+            }
+        }
+
+        // decodes whole buffer into plain lua values (tables, strings), nil becomes msgpack null (NULL lightuserdata),
+        // returns false and pushes an error message instead on malformed input.
+        inline bool decode(lua_State * L, const char * data, size_t size, int maxDepth = LUAAA_MSGPACK_MAX_DEPTH)
+        {
+            detail::Decoder d(L, data, size, maxDepth, 0, false);
+            return detail::run(d);
+        }
+
+        // decodes into C++ value through LuaStack<T> (reusing its allocations when possible).
+        template<typename T>
+        inline bool decode(lua_State * L, const char * data, size_t size, T& out, int maxDepth = LUAAA_MSGPACK_MAX_DEPTH)
+        {
+            if (!decode(L, data, size, maxDepth))
+            {
+                return false;
+            }
+#if LUAAA_WITHOUT_CPP_STDLIB
+            out = LuaStack<T>::get(L, -1);
+#else
+            get_into(L, lua_gettop(L), out);
+#endif
+            lua_pop(L, 1);
+            return true;
+        }
+
+        // pushes lazy view over the lua string at idx, which views keep alive: arrays and maps are
+        // decoded one level at a time on first access, binary and packed numeric arrays are LuaArrayView
+        // into the string (copied to table only if misaligned). whole buffer is validated up front.
+        inline bool view(lua_State * L, int idx)
+        {
+            idx = lua_absindex(L, idx);
+            size_t size = 0;
+            const char * data = luaL_checklstring(L, idx, &size);
+            detail::registerView(L);
+#if defined(LUA_VERSION_NUM) && LUA_VERSION_NUM >= 503
+            lua_pushvalue(L, idx);
+#else
+            // uservalue must be a table.
+            lua_createtable(L, 1, 0);
+            lua_pushvalue(L, idx);
+            lua_rawseti(L, -2, 1);
+#endif
+            int anchor = lua_gettop(L);
+            detail::Decoder d(L, data, size, LUAAA_MSGPACK_MAX_DEPTH, anchor, true);
+            bool ok = detail::run(d);
+            lua_remove(L, anchor);
+            return ok;
+        }
+
+        // lazy view over caller owned buffer, which must outlive the views.
+        inline bool view(lua_State * L, const char * data, size_t size)
+        {
+            detail::registerView(L);
+            detail::Decoder d(L, data, size, LUAAA_MSGPACK_MAX_DEPTH, 0, true);
+            return detail::run(d);
+        }
+
+        //========================================================
+        // lua binding
+        //========================================================
+        namespace detail
+        {
+            inline Writer * newWriter(lua_State * L)
+            {
+                Writer * w = new (lua_newuserdata(L, sizeof(Writer))) Writer();
+                if (luaL_newmetatable(L, "luaaa.msgpack.Writer"))
+                {
+                    lua_pushcfunction(L, [](lua_State * L) -> int {
+                        ((Writer*)lua_touserdata(L, 1))->~Writer();
+                        return 0;
+                    });
+                    lua_setfield(L, -2, "__gc");
+                }
+                lua_setmetatable(L, -2);
+                return w;
+            }
+
+            // msgpack.encode(value): returns binary string.
+            inline int luaEncode(lua_State * L)
+            {
+                luaL_checkany(L, 1);
+                lua_settop(L, 1);
+                Writer * w = (Writer*)lua_touserdata(L, lua_upvalueindex(1));
+                w->clear();
+                if (!encode(L, 1, *w))
+                {
+                    return luaL_error(L, "msgpack: %s", w->error());
+                }
+                lua_pushlstring(L, w->data(), w->size());
+                return 1;
+            }
+
+            // msgpack.decode(s): lazy views.
+            inline int luaDecode(lua_State * L)
+            {
+                luaL_checkstring(L, 1);
+                if (!view(L, 1))
+                {
+                    return lua_error(L);
+                }
+                return 1;
+            }
+
+            // msgpack.unpack(s): plain tables.
+            inline int luaUnpack(lua_State * L)
+            {
+                size_t n = 0;
+                const char * s = luaL_checklstring(L, 1, &n);
+                if (!decode(L, s, n))
+                {
+                    return lua_error(L);
+                }
+                return 1;
+            }
+
+            // msgpack.totable(view): view decoded to plain tables, other values returned as they are.
+            inline int luaToTable(lua_State * L)
+            {
+                View * v = (View*)luaL_testudata(L, 1, viewName());
+                if (!v)
+                {
+                    lua_settop(L, 1);
+                    return 1;
+                }
+                if (!decode(L, v->begin, v->end - v->begin))
+                {
+                    return lua_error(L);
+                }
+                return 1;
+            }
+        }
+
+        // binds msgpack.encode, msgpack.decode (lazy), msgpack.unpack (plain tables), msgpack.totable and msgpack.null.
+        inline void bind(lua_State * L, const char * module = "msgpack")
+        {
+            detail::registerView(L);
+            LuaModule(L, module)
+                .fun("decode", &detail::luaDecode)
+                .fun("unpack", &detail::luaUnpack)
+                .fun("totable", &detail::luaToTable)
+                .def("null", (void*)nullptr);
+
+            // encode carries its reusable buffer as upvalue, so it is set into module table directly.
+            lua_getglobal(L, module);
+            detail::newWriter(L);
+            lua_pushcclosure(L, &detail::luaEncode, 1);
+            lua_setfield(L, -2, "encode");
+            lua_pop(L, 1);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,1447 @@
+/*
+ Copyright (c) 2019 gengyong
+ https://github.com/gengyong/luaaa
+ licensed under MIT License.
+*/
+
+#ifndef HEADER_LUAAA_THREAD_HPP
+#define HEADER_LUAAA_THREAD_HPP
+
+// optional helpers for lua states living in different threads, include after or instead of luaaa.hpp.
+// Channel is a bounded lock-free ring of messages, every state that binds it holds its own endpoint
+// userdata sharing the ring. values are packed into a compact in-process message outside of the ring,
+// so sender and receiver states never run together, and ring slots keep their buffers between laps.
+// StateHandle owns a state run by one thread, other threads post calls into its lock-free mailbox and
+// get futures back, the owner runs them in batches instead of every caller taking a lock on the state.
+// SharedView lends one read-only C++ object to many states, lua reads parts of it on access.
+
+#include "luaaa.hpp"
+
+#if LUAAA_WITHOUT_CPP_STDLIB
+#   error "luaaa_thread.hpp requires C++ std libs"
+#endif
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <future>
+#include <functional>
+#include <cstdio>
+#include <stdexcept>
+#include <type_traits>
+#include <new>
+
+namespace LUAAA_NS
+{
+    //========================================================
+    // in-process message
+    //========================================================
+    // native layout, only for threads of one process: tag byte, then raw number/pointer, size and bytes of
+    // string, or array/hash counts and entries of table. tables met again are written as index of first one.
+    enum LuaMessageTag
+    {
+        LuaMessageNil, LuaMessageFalse, LuaMessageTrue, LuaMessageInteger, LuaMessageNumber,
+        LuaMessageString, LuaMessageLight, LuaMessageTable, LuaMessageRef,
+    };
+
+    struct LuaMessageWriter
+    {
+        lua_State * L;
+        std::string * out;
+        int seen;       // table -> index
+        int count;
+        int errorType;
+        const char * error;
+
+        template<typename T> inline void raw(const T& v)
+        {
+            out->append((const char*)&v, sizeof(T));
+        }
+
+        bool fail(int type, const char * msg)
+        {
+            errorType = type;
+            error = msg;
+            return false;
+        }
+
+        bool value(int idx, int depth)
+        {
+            const int type = lua_type(L, idx);
+            switch (type)
+            {
+            case LUA_TNIL:
+                out->push_back(char(LuaMessageNil));
+                return true;
+            case LUA_TBOOLEAN:
+                out->push_back(char(lua_toboolean(L, idx) ? LuaMessageTrue : LuaMessageFalse));
+                return true;
+            case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+                if (lua_isinteger(L, idx))
+                {
+                    out->push_back(char(LuaMessageInteger));
+                    raw(lua_tointeger(L, idx));
+                    return true;
+                }
+#endif
+                out->push_back(char(LuaMessageNumber));
+                raw(lua_tonumber(L, idx));
+                return true;
+            case LUA_TSTRING:
+            {
+                size_t len = 0;
+                const char * str = lua_tolstring(L, idx, &len);
+                out->push_back(char(LuaMessageString));
+                raw(len);
+                out->append(str, len);
+                return true;
+            }
+            case LUA_TLIGHTUSERDATA:
+                out->push_back(char(LuaMessageLight));
+                raw(lua_touserdata(L, idx));
+                return true;
+            case LUA_TTABLE:
+                return table(lua_absindex(L, idx), depth);
+            default:
+                return fail(type, "can not be sent");
+            }
+        }
+
+        // metatables are not sent, array part is written by index, the rest by lua_next.
+        bool table(int idx, int depth)
+        {
+            lua_pushvalue(L, idx);
+            lua_rawget(L, seen);
+            if (!lua_isnil(L, -1))
+            {
+                out->push_back(char(LuaMessageRef));
+                raw(int(lua_tointeger(L, -1)));
+                lua_pop(L, 1);
+                return true;
+            }
+            lua_pop(L, 1);
+            if (depth >= LUAAA_TRANSFER_MAX_DEPTH)
+            {
+                return fail(LUA_TTABLE, "nested too deep");
+            }
+            if (!lua_checkstack(L, 4))
+            {
+                return fail(LUA_TTABLE, "out of stack space");
+            }
+            lua_pushvalue(L, idx);
+            lua_pushinteger(L, ++count);
+            lua_rawset(L, seen);
+
+            const int narr = (int)lua_rawlen(L, idx);
+            out->push_back(char(LuaMessageTable));
+            raw(narr);
+            const size_t hashAt = out->size();
+            raw(int(0));
+
+            for (int i = 1; i <= narr; ++i)
+            {
+                lua_rawgeti(L, idx, i);
+                if (!value(-1, depth + 1))
+                {
+                    return false;
+                }
+                lua_pop(L, 1);
+            }
+
+            int nrec = 0;
+            lua_pushnil(L);
+            while (lua_next(L, idx) != 0)
+            {
+                if (lua_type(L, -2) == LUA_TNUMBER)
+                {
+                    const lua_Number key = lua_tonumber(L, -2);
+                    if (key >= 1 && key <= narr && key == (lua_Number)(int)key)
+                    {
+                        lua_pop(L, 1);
+                        continue;
+                    }
+                }
+                if (!value(-2, depth + 1) || !value(-1, depth + 1))
+                {
+                    return false;
+                }
+                lua_pop(L, 1);
+                ++nrec;
+            }
+            memcpy(&(*out)[hashAt], &nrec, sizeof(nrec));
+            return true;
+        }
+    };
+
+    struct LuaMessageReader
+    {
+        lua_State * L;
+        const char * p;
+        int cache;      // index -> table
+        int count;
+
+        template<typename T> inline T raw()
+        {
+            T v;
+            memcpy(&v, p, sizeof(T));
+            p += sizeof(T);
+            return v;
+        }
+
+        void value()
+        {
+            switch (*p++)
+            {
+            case LuaMessageNil:
+                lua_pushnil(L);
+                break;
+            case LuaMessageFalse:
+                lua_pushboolean(L, 0);
+                break;
+            case LuaMessageTrue:
+                lua_pushboolean(L, 1);
+                break;
+            case LuaMessageInteger:
+                lua_pushinteger(L, raw<lua_Integer>());
+                break;
+            case LuaMessageNumber:
+                lua_pushnumber(L, raw<lua_Number>());
+                break;
+            case LuaMessageString:
+            {
+                const size_t len = raw<size_t>();
+                lua_pushlstring(L, p, len);
+                p += len;
+                break;
+            }
+            case LuaMessageLight:
+                lua_pushlightuserdata(L, raw<void*>());
+                break;
+            case LuaMessageRef:
+                lua_rawgeti(L, cache, raw<int>());
+                break;
+            default:
+            {
+                luaL_checkstack(L, 4, "message nested too deep");
+                const int narr = raw<int>();
+                const int nrec = raw<int>();
+                lua_createtable(L, narr, nrec);
+                lua_pushvalue(L, -1);
+                lua_rawseti(L, cache, ++count);
+                for (int i = 1; i <= narr; ++i)
+                {
+                    value();
+                    lua_rawseti(L, -2, i);
+                }
+                for (int i = 0; i < nrec; ++i)
+                {
+                    value();
+                    value();
+                    lua_rawset(L, -3);
+                }
+                break;
+            }
+            }
+        }
+    };
+
+    // packs value at idx into out (appended), returns false and pushes error message if it can not be sent.
+    inline bool LuaMessagePack(lua_State * L, int idx, std::string& out)
+    {
+        idx = lua_absindex(L, idx);
+        const size_t size = out.size();
+        LuaMessageWriter w = { L, &out, 0, 0, LUA_TNIL, nullptr };
+        bool ok = true;
+        if (lua_istable(L, idx))
+        {
+            lua_newtable(L);
+            w.seen = lua_gettop(L);
+            ok = w.value(idx, 0);
+            lua_settop(L, w.seen - 1);
+        }
+        else
+        {
+            ok = w.value(idx, 0);
+        }
+        if (!ok)
+        {
+            out.resize(size);
+            lua_pushfstring(L, "message: %s %s", lua_typename(L, w.errorType), w.error);
+        }
+        return ok;
+    }
+
+    // pushes the value of message packed by LuaMessagePack.
+    inline void LuaMessageUnpack(lua_State * L, const char * data)
+    {
+        LuaMessageReader r = { L, data, 0, 0 };
+        if (*data == LuaMessageTable)
+        {
+            lua_newtable(L);
+            r.cache = lua_gettop(L);
+            r.value();
+            lua_remove(L, r.cache);
+        }
+        else
+        {
+            r.value();
+        }
+    }
+
+    //========================================================
+    // bounded lock-free ring
+    //========================================================
+    // multi producer multi consumer ring of message buffers, each slot has a sequence number telling
+    // which lap may write or read it. buffers are swapped in and out, so they are reused without allocation.
+    class LuaRing
+    {
+    public:
+        explicit LuaRing(size_t capacity)
+            : m_mask(roundUp(capacity) - 1), m_slots(new Slot[m_mask + 1]), m_closed(false)
+        {
+            for (size_t i = 0; i <= m_mask; ++i)
+            {
+                m_slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            m_head.store(0, std::memory_order_relaxed);
+            m_tail.store(0, std::memory_order_relaxed);
+        }
+
+        ~LuaRing()
+        {
+            delete[] m_slots;
+        }
+
+        // swaps msg into free slot, false if ring is full.
+        bool push(std::string& msg)
+        {
+            size_t pos = m_tail.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Slot& slot = m_slots[pos & m_mask];
+                const size_t seq = slot.sequence.load(std::memory_order_acquire);
+                const intptr_t dif = intptr_t(seq) - intptr_t(pos);
+                if (dif == 0)
+                {
+                    if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        slot.data.swap(msg);
+                        slot.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (dif < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // swaps oldest message out into msg, false if ring is empty.
+        bool pop(std::string& msg)
+        {
+            size_t pos = m_head.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Slot& slot = m_slots[pos & m_mask];
+                const size_t seq = slot.sequence.load(std::memory_order_acquire);
+                const intptr_t dif = intptr_t(seq) - intptr_t(pos + 1);
+                if (dif == 0)
+                {
+                    if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        slot.data.swap(msg);
+                        slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (dif < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        inline size_t capacity() const { return m_mask + 1; }
+
+        // approximate while other threads are running.
+        inline size_t size() const
+        {
+            const size_t tail = m_tail.load(std::memory_order_acquire);
+            const size_t head = m_head.load(std::memory_order_acquire);
+            return tail > head ? tail - head : 0;
+        }
+
+        inline void close() { m_closed.store(true, std::memory_order_release); }
+        inline bool closed() const { return m_closed.load(std::memory_order_acquire); }
+
+    private:
+        static size_t roundUp(size_t n)
+        {
+            size_t c = 2;
+            while (c < n)
+            {
+                c <<= 1;
+            }
+            return c;
+        }
+
+        struct Slot
+        {
+            std::atomic<size_t> sequence;
+            std::string data;
+        };
+
+        // producers and consumers touch different cache lines.
+        const size_t m_mask;
+        Slot * const m_slots;
+        char m_pad0[64];
+        std::atomic<size_t> m_tail;
+        char m_pad1[64];
+        std::atomic<size_t> m_head;
+        char m_pad2[64];
+        std::atomic<bool> m_closed;
+
+        LuaRing(const LuaRing&) = delete;
+        LuaRing& operator=(const LuaRing&) = delete;
+    };
+
+    // spins shortly, then gives up the cpu, then sleeps.
+    struct LuaBackoff
+    {
+        unsigned count;
+
+        LuaBackoff() : count(0) {}
+
+        void wait()
+        {
+            if (++count <= 16)
+            {
+                return;
+            }
+            if (count <= 64)
+            {
+                std::this_thread::yield();
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    };
+
+    //========================================================
+    // channel
+    //========================================================
+    // copies share the ring, each is an endpoint for sending and receiving in any thread.
+    // in lua: Channel.new(capacity), ch:try_send(v), ch:try_recv() -> ok, v, ch:send(v), ch:recv() -> ok, v,
+    // ch:close(), ch:closed(), ch:size(), ch:capacity(). send/recv yield inside coroutines (lua 5.3+) and block otherwise.
+    // tables, strings, numbers, booleans and light userdata can be sent, functions and userdata can not.
+    class Channel
+    {
+    public:
+        explicit Channel(int capacity = 256) : m_ring(std::make_shared<LuaRing>(capacity > 0 ? size_t(capacity) : 1)) {}
+
+        // packs value at idx of L, false if ring is full or closed. raises lua error if value can not be sent.
+        bool try_send(lua_State * L, int idx)
+        {
+            return !closed() && m_ring->push(pack(L, idx));
+        }
+
+        // pushes oldest value onto L, false and nothing pushed if ring is empty.
+        bool try_recv(lua_State * L)
+        {
+            std::string& msg = scratch();
+            if (!m_ring->pop(msg))
+            {
+                return false;
+            }
+            LuaMessageUnpack(L, msg.data());
+            return true;
+        }
+
+        // C++ values go through LuaStack.
+        template<typename T>
+        bool try_send(lua_State * L, const T& value)
+        {
+            LuaStack<T>::put(L, value);
+            const bool ok = try_send(L, -1);
+            lua_pop(L, 1);
+            return ok;
+        }
+
+        template<typename T>
+        bool try_recv(lua_State * L, T& value)
+        {
+            if (!try_recv(L))
+            {
+                return false;
+            }
+            get_into(L, lua_gettop(L), value);
+            lua_pop(L, 1);
+            return true;
+        }
+
+        // waits while ring is full, false if channel is closed.
+        bool send(lua_State * L, int idx)
+        {
+            std::string& msg = pack(L, idx);
+            LuaBackoff backoff;
+            while (!closed())
+            {
+                if (m_ring->push(msg))
+                {
+                    return true;
+                }
+                backoff.wait();
+            }
+            return false;
+        }
+
+        // waits while ring is empty, false if channel is closed and drained.
+        bool recv(lua_State * L)
+        {
+            LuaBackoff backoff;
+            while (!try_recv(L))
+            {
+                if (drained())
+                {
+                    return try_recv(L);
+                }
+                backoff.wait();
+            }
+            return true;
+        }
+
+        // senders fail from now on, receivers drain what is left.
+        inline void close() { m_ring->close(); }
+        inline bool closed() const { return m_ring->closed(); }
+        inline int size() const { return int(m_ring->size()); }
+        inline int capacity() const { return int(m_ring->capacity()); }
+
+        // binds class `name` to L, endpoints can be pushed by LuaStack<Channel> or copied by luaaa::transfer.
+        static void bind(lua_State * L, const char * name = "Channel")
+        {
+            LuaClass<Channel>(L, name)
+                .ctor<int>("new")
+                .clone()
+                .fun("try_send", &Channel::luaTrySend)
+                .fun("try_recv", &Channel::luaTryRecv)
+                .fun("send", &Channel::luaSend)
+                .fun("recv", &Channel::luaRecv)
+                .fun("close", &Channel::close)
+                .fun("closed", &Channel::closed)
+                .fun("size", &Channel::size)
+                .fun("capacity", &Channel::capacity);
+        }
+
+    private:
+        // message buffer of this thread, swapped with ring slots.
+        static std::string& scratch()
+        {
+            static thread_local std::string msg;
+            return msg;
+        }
+
+        static std::string& pack(lua_State * L, int idx)
+        {
+            std::string& msg = scratch();
+            msg.clear();
+            if (!LuaMessagePack(L, idx, msg))
+            {
+                lua_error(L);
+            }
+            return msg;
+        }
+
+        // close() should follow the last send, messages racing with it may be left.
+        inline bool drained() const { return closed() && m_ring->size() == 0; }
+
+        // ok, value or false.
+        static int luaResult(lua_State * L, bool ok)
+        {
+            lua_pushboolean(L, ok);
+            if (ok)
+            {
+                lua_insert(L, -2);
+                return 2;
+            }
+            return 1;
+        }
+
+        static int luaTrySend(lua_State * L)
+        {
+            luaL_checkany(L, 2);
+            lua_pushboolean(L, LuaStack<Channel>::get(L, 1).try_send(L, 2));
+            return 1;
+        }
+
+        static int luaTryRecv(lua_State * L)
+        {
+            return luaResult(L, LuaStack<Channel>::get(L, 1).try_recv(L));
+        }
+
+#if LUA_VERSION_NUM >= 503
+        // inside coroutines wait by yielding, the continuation tries again when resumed.
+        static int luaSendResume(lua_State * L, int, lua_KContext)
+        {
+            lua_settop(L, 2);
+            Channel& ch = LuaStack<Channel>::get(L, 1);
+            bool ok = ch.try_send(L, 2);
+            if (!ok && !ch.closed())
+            {
+                if (lua_isyieldable(L))
+                {
+                    return lua_yieldk(L, 0, 0, luaSendResume);
+                }
+                ok = ch.send(L, 2);
+            }
+            lua_pushboolean(L, ok);
+            return 1;
+        }
+
+        static int luaRecvResume(lua_State * L, int, lua_KContext)
+        {
+            lua_settop(L, 1);
+            Channel& ch = LuaStack<Channel>::get(L, 1);
+            bool ok = ch.try_recv(L);
+            if (!ok && !ch.drained())
+            {
+                if (lua_isyieldable(L))
+                {
+                    return lua_yieldk(L, 0, 0, luaRecvResume);
+                }
+                ok = ch.recv(L);
+            }
+            return luaResult(L, ok || ch.try_recv(L));
+        }
+
+        static int luaSend(lua_State * L)
+        {
+            luaL_checkany(L, 2);
+            return luaSendResume(L, LUA_OK, 0);
+        }
+
+        static int luaRecv(lua_State * L)
+        {
+            return luaRecvResume(L, LUA_OK, 0);
+        }
+#else
+        static int luaSend(lua_State * L)
+        {
+            luaL_checkany(L, 2);
+            lua_pushboolean(L, LuaStack<Channel>::get(L, 1).send(L, 2));
+            return 1;
+        }
+
+        static int luaRecv(lua_State * L)
+        {
+            return luaResult(L, LuaStack<Channel>::get(L, 1).recv(L));
+        }
+#endif
+
+        std::shared_ptr<LuaRing> m_ring;
+    };
+
+    //========================================================
+    // mailbox
+    //========================================================
+    struct LuaJob
+    {
+        std::atomic<LuaJob*> next;
+
+        LuaJob() : next(nullptr) {}
+        virtual ~LuaJob() {}
+        // called in protected mode by owner thread of the state, returns error message of C++ exception if not delivered.
+        virtual const char * run(lua_State *) { return nullptr; }
+        // lua error, false if not delivered.
+        virtual bool fail(const char *) { return false; }
+    };
+
+    template<typename R> struct LuaJobResult
+    {
+        template<typename F> static void run(std::promise<R>& promise, F& f, lua_State * L) { promise.set_value(f(L)); }
+    };
+
+    template<> struct LuaJobResult<void>
+    {
+        template<typename F> static void run(std::promise<void>& promise, F& f, lua_State * L) { f(L); promise.set_value(); }
+    };
+
+    template<typename R> struct LuaJobReturn
+    {
+        enum { count = 1 };
+        static R get(lua_State * L) { return LuaStack<R>::get(L, lua_gettop(L)); }
+    };
+
+    template<> struct LuaJobReturn<void>
+    {
+        enum { count = 0 };
+        static void get(lua_State *) {}
+    };
+
+    // args of posted calls are stored by value, C strings as std::string, the caller's buffer may be gone when the job runs.
+    template<typename T> struct LuaJobArg { typedef T type; };
+    template<> struct LuaJobArg<const char *> { typedef std::string type; };
+    template<> struct LuaJobArg<char *> { typedef std::string type; };
+
+    template<typename F, typename R>
+    struct LuaTask : public LuaJob
+    {
+        F f;
+        std::promise<R> promise;
+
+        explicit LuaTask(F&& fn) : f(std::move(fn)) {}
+
+        const char * run(lua_State * L) override
+        {
+            try
+            {
+                LuaJobResult<R>::run(promise, f, L);
+            }
+            catch (const std::exception&)
+            {
+                promise.set_exception(std::current_exception());
+            }
+            return nullptr;
+        }
+
+        bool fail(const char * msg) override
+        {
+            promise.set_exception(std::make_exception_ptr(std::runtime_error(msg ? msg : "lua error")));
+            return true;
+        }
+    };
+
+    // job without result, errors go to error handler of the state handle.
+    template<typename F>
+    struct LuaNotice : public LuaJob
+    {
+        F f;
+        std::string error;
+
+        explicit LuaNotice(F&& fn) : f(std::move(fn)) {}
+
+        const char * run(lua_State * L) override
+        {
+            try
+            {
+                f(L);
+            }
+            catch (const std::exception& e)
+            {
+                error = e.what();
+                return error.c_str();
+            }
+            return nullptr;
+        }
+    };
+
+    // intrusive multi producer single consumer queue: producers swap themselves in as head with one
+    // exchange, the consumer follows next links from tail. a stub node keeps the list never empty.
+    class LuaMailbox
+    {
+    public:
+        LuaMailbox() : m_head(&m_stub), m_tail(&m_stub) {}
+
+        void push(LuaJob * job)
+        {
+            job->next.store(nullptr, std::memory_order_relaxed);
+            LuaJob * prev = m_head.exchange(job, std::memory_order_acq_rel);
+            prev->next.store(job, std::memory_order_release);
+        }
+
+        // nullptr if empty, or if the next job is still being linked by its producer.
+        LuaJob * pop()
+        {
+            LuaJob * tail = m_tail;
+            LuaJob * next = tail->next.load(std::memory_order_acquire);
+            if (tail == &m_stub)
+            {
+                if (next == nullptr)
+                {
+                    return nullptr;
+                }
+                m_tail = next;
+                tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next != nullptr)
+            {
+                m_tail = next;
+                return tail;
+            }
+            if (tail != m_head.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+            push(&m_stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next != nullptr)
+            {
+                m_tail = next;
+                return tail;
+            }
+            return nullptr;
+        }
+
+    private:
+        std::atomic<LuaJob*> m_head;
+        char m_pad[64];
+        LuaJob * m_tail;
+        LuaJob m_stub;
+
+        LuaMailbox(const LuaMailbox&) = delete;
+        LuaMailbox& operator=(const LuaMailbox&) = delete;
+    };
+
+    //========================================================
+    // state handle
+    //========================================================
+    // the state is only touched by its owner thread, which calls drain() e.g. once per frame or event loop turn.
+    // post/call may be used from any thread, results and errors (lua errors as std::runtime_error) arrive
+    // through the futures. jobs still pending when the handle is destroyed break their promises.
+    class StateHandle
+    {
+    public:
+        // owns a new state with standard libs opened.
+        StateHandle() : m_state(luaL_newstate()), m_owned(true), m_pending(0), m_current(nullptr), m_count(0), m_limit(0)
+        {
+            luaL_openlibs(m_state);
+        }
+
+        // runs jobs on existing state, which is not closed by the handle.
+        explicit StateHandle(lua_State * L) : m_state(L), m_owned(false), m_pending(0), m_current(nullptr), m_count(0), m_limit(0) {}
+
+        ~StateHandle()
+        {
+            while (LuaJob * job = m_mailbox.pop())
+            {
+                delete job;
+            }
+            if (m_owned)
+            {
+                lua_close(m_state);
+            }
+        }
+
+        // only for owner thread.
+        inline lua_State * state() const { return m_state; }
+
+        // jobs posted and not yet run, approximate while other threads are posting.
+        inline size_t pending() const { return m_pending.load(std::memory_order_acquire); }
+
+        // any thread: f(lua_State*) runs in owner thread, its result sets the future.
+        template<typename F>
+        auto post(F f) -> std::future<decltype(f((lua_State*)nullptr))>
+        {
+            typedef decltype(f((lua_State*)nullptr)) R;
+            LuaTask<F, R> * task = new LuaTask<F, R>(std::move(f));
+            std::future<R> result = task->promise.get_future();
+            enqueue(task);
+            return result;
+        }
+
+        // any thread: calls global function `name`, dots reach into modules (e.g. "AwesomeMod.update").
+        // args are copied at posting, C strings as std::string, and pushed by LuaStack, result is read by LuaStack<R>.
+        template<typename R = void, typename ...ARGS>
+        std::future<R> call(const char * name, ARGS... args)
+        {
+            return callPath<R, typename LuaJobArg<ARGS>::type...>(std::string(name), args...);
+        }
+
+        // fn belongs to the handled state and must stay alive until the future is ready.
+        template<typename R = void, typename ...ARGS>
+        std::future<R> call(const LuaFunctionRef& fn, ARGS... args)
+        {
+            return callRef<R, typename LuaJobArg<ARGS>::type...>(&fn, args...);
+        }
+
+        // any thread: calls like call() without waiting for result, cheaper for events. errors go to onError.
+        template<typename ...ARGS>
+        void notify(const char * name, ARGS... args)
+        {
+            notifyPath<typename LuaJobArg<ARGS>::type...>(std::string(name), args...);
+        }
+
+        template<typename ...ARGS>
+        void notify(const LuaFunctionRef& fn, ARGS... args)
+        {
+            notifyRef<typename LuaJobArg<ARGS>::type...>(&fn, args...);
+        }
+
+        // owner thread: handler of errors raised by notified calls, they are printed to stderr by default.
+        inline void onError(const std::function<void(const char *)>& handler) { m_onError = handler; }
+
+        // owner thread: runs at most max jobs in posting order, returns the number run.
+        // jobs of a batch share one protected call, which is restarted after a job raised an error.
+        size_t drain(size_t max = size_t(-1))
+        {
+            const int top = lua_gettop(m_state);
+            lua_pushcfunction(m_state, LuaMessageHandler);
+            m_count = 0;
+            m_limit = max;
+            for (;;)
+            {
+                lua_pushcfunction(m_state, &StateHandle::runBatch);
+                lua_pushlightuserdata(m_state, this);
+                if (lua_pcall(m_state, 1, 0, top + 1) == 0 || m_current == nullptr)
+                {
+                    break;
+                }
+                if (!m_current->fail(lua_tostring(m_state, -1)))
+                {
+                    report(lua_tostring(m_state, -1));
+                }
+                finish();
+                lua_settop(m_state, top + 1);
+            }
+            lua_settop(m_state, top);
+            return m_count;
+        }
+
+    private:
+        inline void enqueue(LuaJob * job)
+        {
+            m_pending.fetch_add(1, std::memory_order_relaxed);
+            m_mailbox.push(job);
+        }
+
+        template<typename F>
+        inline void notice(F f)
+        {
+            enqueue(new LuaNotice<F>(std::move(f)));
+        }
+
+        // ARGS are the stored types of LuaJobArg, args are captured by value.
+        template<typename R, typename ...ARGS>
+        std::future<R> callPath(const std::string& path, ARGS... args)
+        {
+            return post([path, args...](lua_State * L) -> R {
+                pushPath(L, path.c_str());
+                return invoke<R, ARGS...>(L, args...);
+            });
+        }
+
+        template<typename R, typename ...ARGS>
+        std::future<R> callRef(const LuaFunctionRef * ref, ARGS... args)
+        {
+            return post([ref, args...](lua_State * L) -> R {
+                luaL_argcheck(L, ref->valid(), 1, "invalid function reference");
+                ref->push(L);
+                return invoke<R, ARGS...>(L, args...);
+            });
+        }
+
+        template<typename ...ARGS>
+        void notifyPath(const std::string& path, ARGS... args)
+        {
+            notice([path, args...](lua_State * L) {
+                pushPath(L, path.c_str());
+                invoke<void, ARGS...>(L, args...);
+            });
+        }
+
+        template<typename ...ARGS>
+        void notifyRef(const LuaFunctionRef * ref, ARGS... args)
+        {
+            notice([ref, args...](lua_State * L) {
+                luaL_argcheck(L, ref->valid(), 1, "invalid function reference");
+                ref->push(L);
+                invoke<void, ARGS...>(L, args...);
+            });
+        }
+
+        static int runBatch(lua_State * L)
+        {
+            StateHandle * self = (StateHandle*)lua_touserdata(L, 1);
+            lua_settop(L, 0);
+            while (self->m_count < self->m_limit && (self->m_current = self->m_mailbox.pop()) != nullptr)
+            {
+                if (const char * error = self->m_current->run(L))
+                {
+                    self->report(error);
+                }
+                lua_settop(L, 0);
+                self->finish();
+            }
+            return 0;
+        }
+
+        void report(const char * error)
+        {
+            if (m_onError)
+            {
+                m_onError(error);
+            }
+            else
+            {
+                fprintf(stderr, "StateHandle: %s\n", error ? error : "error");
+            }
+        }
+
+        inline void finish()
+        {
+            delete m_current;
+            m_current = nullptr;
+            m_pending.fetch_sub(1, std::memory_order_release);
+            ++m_count;
+        }
+
+        // calls function on stack top with args, leaves result for LuaStack<R> or nothing for void.
+        template<typename R, typename ...ARGS>
+        static R invoke(lua_State * L, const ARGS&... args)
+        {
+            luaL_checkstack(L, int(sizeof...(ARGS)) + 1, "too many arguments");
+            int initParams[] = { (LuaStack<ARGS>::put(L, args), 0)..., 0 }; (void)initParams;
+            lua_call(L, sizeof...(ARGS), LuaJobReturn<R>::count);
+            return LuaJobReturn<R>::get(L);
+        }
+
+        static void pushPath(lua_State * L, const char * path)
+        {
+            const char * dot = strchr(path, '.');
+            if (dot == nullptr)
+            {
+                lua_getglobal(L, path);
+                return;
+            }
+            lua_pushlstring(L, path, dot - path);
+            lua_getglobal(L, lua_tostring(L, -1));
+            lua_remove(L, -2);
+            while (dot != nullptr && !lua_isnil(L, -1))
+            {
+                const char * key = dot + 1;
+                dot = strchr(key, '.');
+                lua_pushlstring(L, key, dot ? size_t(dot - key) : strlen(key));
+                lua_gettable(L, -2);
+                lua_remove(L, -2);
+            }
+        }
+
+        lua_State * m_state;
+        bool m_owned;
+        std::atomic<size_t> m_pending;
+        LuaMailbox m_mailbox;
+        std::function<void(const char *)> m_onError;
+        // progress of drain.
+        LuaJob * m_current;
+        size_t m_count;
+        size_t m_limit;
+
+        StateHandle(const StateHandle&) = delete;
+        StateHandle& operator=(const StateHandle&) = delete;
+    };
+
+    //========================================================
+    // shared view
+    //========================================================
+    // read-only data shared by any number of states and threads, e.g. game data loaded once per process.
+    // the data is const once shared, so states read it at the same time without locks.
+    template<typename T>
+    class SharedView
+    {
+    public:
+        SharedView() {}
+        explicit SharedView(std::shared_ptr<const T> data) : m_data(std::move(data)) {}
+        explicit SharedView(T&& value) : m_data(std::make_shared<const T>(std::move(value))) {}
+
+        inline const T * get() const { return m_data.get(); }
+        inline const T& operator*() const { return *m_data; }
+        inline const T * operator->() const { return m_data.get(); }
+        inline explicit operator bool() const { return m_data != nullptr; }
+        inline const std::shared_ptr<const T>& data() const { return m_data; }
+
+    private:
+        std::shared_ptr<const T> m_data;
+    };
+
+    // how shared data is viewed: 0 pushed by LuaStack, 1 struct mapped by LUAAA_STRUCT, 2 random access container, 3 map.
+    // containers of char are strings.
+    template<typename E, typename = void> struct LuaSharedIsStruct { enum { value = 0 }; };
+    template<typename E> struct LuaSharedIsStruct<E, typename LuaVoid<decltype(LuaStack<E>::Names(std::declval<int&>()))>::type> { enum { value = 1 }; };
+    template<typename E, typename = void> struct LuaSharedIsMap { enum { value = 0 }; };
+    template<typename E> struct LuaSharedIsMap<E, typename LuaVoid<typename E::mapped_type>::type> { enum { value = 1 }; };
+    template<typename E, typename = void> struct LuaSharedIsRange { enum { value = 0 }; };
+    template<typename E> struct LuaSharedIsRange<E, typename LuaVoid<decltype(std::declval<const E&>()[size_t(0)], std::declval<const E&>().size())>::type>
+    {
+        enum { value = !std::is_same<typename std::remove_cv<typename E::value_type>::type, char>::value };
+    };
+    template<typename E>
+    struct LuaSharedKind
+    {
+        enum { value = LuaSharedIsStruct<E>::value ? 1 : LuaSharedIsMap<E>::value ? 3 : LuaSharedIsRange<E>::value ? 2 : 0 };
+    };
+
+    // userdata of shared views, parts of the data are viewed by reference.
+    struct LuaSharedNode
+    {
+        const void * data;
+    };
+
+    // one reference to the data per SharedView pushed. it is kept in the anchor table shared as user value by
+    // all views of the data in the state, so views of parts are small, have no __gc, and never touch the ref count.
+    struct LuaSharedOwner
+    {
+        std::shared_ptr<const void> data;
+
+        static int Gc(lua_State * L)
+        {
+            LuaSharedOwner * owner = (LuaSharedOwner*)lua_touserdata(L, 1);
+            if (owner)
+            {
+                owner->~LuaSharedOwner();
+            }
+            return 0;
+        }
+
+        static const luaL_Reg * Methods()
+        {
+            static const luaL_Reg methods[] = {
+                { "__gc", Gc },
+                { nullptr, nullptr }
+            };
+            return methods;
+        }
+    };
+
+    template<typename E> struct LuaSharedView;
+    template<typename E, int KIND = LuaSharedKind<E>::value> struct LuaSharedAccess;
+
+    template<typename E, int KIND = LuaSharedKind<E>::value>
+    struct LuaSharedElement
+    {
+        // parent is the view the element is read from.
+        inline static void push(lua_State * L, const E& e, int parent)
+        {
+            LuaSharedView<E>::Push(L, &e, parent);
+        }
+    };
+
+    template<typename E>
+    struct LuaSharedElement<E, 0>
+    {
+        inline static void push(lua_State * L, const E& e, int)
+        {
+            LuaStack<E>::put(L, e);
+        }
+    };
+
+    template<typename E>
+    struct LuaSharedView
+    {
+        // metatable is kept in registry with address of methods as key, methods have it as upvalue 1.
+        static void PushMetatable(lua_State * L)
+        {
+            const luaL_Reg * methods = Methods();
+            lua_pushlightuserdata(L, (void*)methods);
+            lua_rawget(L, LUA_REGISTRYINDEX);
+            if (lua_istable(L, -1))
+            {
+                return;
+            }
+            lua_pop(L, 1);
+            lua_newtable(L);
+            lua_pushvalue(L, -1);
+            luaL_setfuncs(L, methods, 1);
+            lua_pushlightuserdata(L, (void*)methods);
+            lua_pushvalue(L, -2);
+            lua_rawset(L, LUA_REGISTRYINDEX);
+        }
+
+        // mt is index of the metatable of this view type, nullptr if value at idx is not such view.
+        static const E * Test(lua_State * L, int idx, int mt = lua_upvalueindex(1))
+        {
+            LuaSharedNode * node = (LuaSharedNode*)lua_touserdata(L, idx);
+            bool ok = node != nullptr && lua_type(L, idx) == LUA_TUSERDATA && lua_getmetatable(L, idx);
+            if (ok)
+            {
+                ok = lua_rawequal(L, -1, mt) != 0;
+                lua_pop(L, 1);
+            }
+            return ok ? (const E*)node->data : nullptr;
+        }
+
+        static const E * Check(lua_State * L, int idx, int mt = lua_upvalueindex(1))
+        {
+            const E * data = Test(L, idx, mt);
+            luaL_argcheck(L, data != nullptr, idx, "shared view expected");
+            return data;
+        }
+
+        // view of the whole data makes a new anchor, views of parts take the anchor of their parent.
+        static void Push(lua_State * L, const E * data, int parent, const std::shared_ptr<const void>& owner = std::shared_ptr<const void>())
+        {
+            parent = parent ? lua_absindex(L, parent) : 0;
+            luaL_checkstack(L, 4, "too deep to view shared data");
+            LuaSharedNode * node = (LuaSharedNode*)lua_newuserdata(L, sizeof(LuaSharedNode));
+            node->data = data;
+            PushMetatable(L);
+            lua_setmetatable(L, -2);
+            if (parent)
+            {
+                lua_getuservalue(L, parent);
+            }
+            else
+            {
+                lua_createtable(L, 1, 0);
+                LuaSharedOwner * holder = (LuaSharedOwner*)lua_newuserdata(L, sizeof(LuaSharedOwner));
+                new (holder) LuaSharedOwner();
+                holder->data = owner;
+                LuaViewData<LuaSharedOwner>::PushMetatable(L, LuaSharedOwner::Methods());
+                lua_setmetatable(L, -2);
+                lua_rawseti(L, -2, 1);
+            }
+            lua_setuservalue(L, -2);
+        }
+
+        // owner of the data the view at idx is part of.
+        static std::shared_ptr<const void> Owner(lua_State * L, int idx)
+        {
+            lua_getuservalue(L, idx);
+            lua_rawgeti(L, -1, 1);
+            LuaSharedOwner * owner = (LuaSharedOwner*)lua_touserdata(L, -1);
+            lua_pop(L, 2);
+            return owner ? owner->data : std::shared_ptr<const void>();
+        }
+
+        static int NewIndex(lua_State * L)
+        {
+            Check(L, 1);
+            return luaL_error(L, "shared view is read-only");
+        }
+
+        // views of other types, or other userdata sharing this __eq, are not equal.
+        static int Eq(lua_State * L)
+        {
+            const E * a = Test(L, 1);
+            lua_pushboolean(L, a != nullptr && a == Test(L, 2));
+            return 1;
+        }
+
+        static int Pairs(lua_State * L)
+        {
+            Check(L, 1);
+            lua_pushvalue(L, lua_upvalueindex(1));
+            lua_pushcclosure(L, LuaSharedAccess<E>::Next, 1);
+            lua_pushvalue(L, 1);
+            lua_pushnil(L);
+            return 3;
+        }
+
+        static const luaL_Reg * Methods()
+        {
+            static const luaL_Reg methods[] = {
+                { "__index", LuaSharedAccess<E>::Index },
+                { "__newindex", NewIndex },
+                { "__len", LuaSharedAccess<E>::Length },
+                { "__eq", Eq },
+                { "__pairs", Pairs },
+                { "__ipairs", Pairs },
+                { nullptr, nullptr }
+            };
+            return methods;
+        }
+    };
+
+    // pushes field at index target.
+    struct LuaSharedFieldPusher
+    {
+        lua_State * L;
+        int parent;
+        int target;
+        int i;
+
+        template<typename F>
+        inline void operator()(const F& f)
+        {
+            if (i++ == target)
+            {
+                LuaSharedElement<F>::push(L, f, parent);
+            }
+        }
+    };
+
+    template<typename E>
+    struct LuaSharedAccess<E, 1>
+    {
+        // index of field named key, field count if there is none.
+        static int Field(const char * key)
+        {
+            int count = 0;
+            const char * const * names = LuaStack<E>::Names(count);
+            int target = 0;
+            while (target < count && strcmp(names[target], key) != 0)
+            {
+                ++target;
+            }
+            return target;
+        }
+
+        static int Index(lua_State * L)
+        {
+            const E * data = LuaSharedView<E>::Check(L, 1);
+            const int target = lua_type(L, 2) == LUA_TSTRING ? Field(lua_tostring(L, 2)) : -1;
+            LuaSharedFieldPusher pusher = { L, 1, target, 0 };
+            LuaStack<E>::Fields(*data, pusher);
+            if (lua_gettop(L) == 2)
+            {
+                lua_pushnil(L);
+            }
+            return 1;
+        }
+
+        // like a table with only named fields.
+        static int Length(lua_State * L)
+        {
+            LuaSharedView<E>::Check(L, 1);
+            lua_pushinteger(L, 0);
+            return 1;
+        }
+
+        static int Next(lua_State * L)
+        {
+            const E * data = LuaSharedView<E>::Check(L, 1);
+            int count = 0;
+            const char * const * names = LuaStack<E>::Names(count);
+            const int target = lua_isnoneornil(L, 2) ? 0 : Field(luaL_checkstring(L, 2)) + 1;
+            if (target >= count)
+            {
+                return 0;
+            }
+            lua_settop(L, 1);
+            lua_pushstring(L, names[target]);
+            LuaSharedFieldPusher pusher = { L, 1, target, 0 };
+            LuaStack<E>::Fields(*data, pusher);
+            return 2;
+        }
+    };
+
+    template<typename E>
+    struct LuaSharedAccess<E, 2>
+    {
+        static int Index(lua_State * L)
+        {
+            const E * data = LuaSharedView<E>::Check(L, 1);
+            const lua_Integer i = lua_type(L, 2) == LUA_TNUMBER ? lua_tointeger(L, 2) : 0;
+            if (i < 1 || i > lua_Integer(data->size()))
+            {
+                lua_pushnil(L);
+                return 1;
+            }
+            LuaSharedElement<typename E::value_type>::push(L, (*data)[size_t(i - 1)], 1);
+            return 1;
+        }
+
+        static int Length(lua_State * L)
+        {
+            lua_pushinteger(L, lua_Integer(LuaSharedView<E>::Check(L, 1)->size()));
+            return 1;
+        }
+
+        static int Next(lua_State * L)
+        {
+            const E * data = LuaSharedView<E>::Check(L, 1);
+            const lua_Integer i = luaL_optinteger(L, 2, 0) + 1;
+            if (i > lua_Integer(data->size()))
+            {
+                return 0;
+            }
+            lua_pushinteger(L, i);
+            LuaSharedElement<typename E::value_type>::push(L, (*data)[size_t(i - 1)], 1);
+            return 2;
+        }
+    };
+
+    template<typename E>
+    struct LuaSharedAccess<E, 3>
+    {
+        typedef typename E::key_type Key;
+
+        // lua keys of other types can not be in map, they are not converted. same test as the map view.
+        static bool IsKey(lua_State * L, int idx)
+        {
+            return LuaMapKey<Key>::test(L, idx);
+        }
+
+        static int Index(lua_State * L)
+        {
+            const E * data = LuaSharedView<E>::Check(L, 1);
+            if (IsKey(L, 2))
+            {
+                auto it = data->find(LuaStack<Key>::get(L, 2));
+                if (it != data->end())
+                {
+                    LuaSharedElement<typename E::mapped_type>::push(L, it->second, 1);
+                    return 1;
+                }
+            }
+            lua_pushnil(L);
+            return 1;
+        }
+
+        static int Length(lua_State * L)
+        {
+            lua_pushinteger(L, lua_Integer(LuaSharedView<E>::Check(L, 1)->size()));
+            return 1;
+        }
+
+        // next key is found from the previous one, so no iterator is kept between calls.
+        // entries of multimaps sharing the previous key are skipped, lua sees one value per key like Index.
+        static int Next(lua_State * L)
+        {
+            const E * data = LuaSharedView<E>::Check(L, 1);
+            auto it = data->begin();
+            if (!lua_isnoneornil(L, 2))
+            {
+                luaL_argcheck(L, IsKey(L, 2), 2, "invalid key type of shared view");
+                it = data->equal_range(LuaStack<Key>::get(L, 2)).second;
+            }
+            if (it == data->end())
+            {
+                return 0;
+            }
+            LuaStack<Key>::put(L, it->first);
+            LuaSharedElement<typename E::mapped_type>::push(L, it->second, 1);
+            return 2;
+        }
+    };
+
+    // each push adds one reference to the data, views taken from lua share the data with the state.
+    template<typename T>
+    struct LuaStack<SharedView<T>>
+    {
+        inline static SharedView<T> get(lua_State * L, int idx)
+        {
+            idx = lua_absindex(L, idx);
+            LuaSharedView<T>::PushMetatable(L);
+            const T * data = LuaSharedView<T>::Check(L, idx, lua_gettop(L));
+            lua_pop(L, 1);
+            return SharedView<T>(std::shared_ptr<const T>(LuaSharedView<T>::Owner(L, idx), data));
+        }
+
+        inline static void put(lua_State * L, const SharedView<T>& view)
+        {
+            if (!view)
+            {
+                lua_pushnil(L);
+                return;
+            }
+            static_assert(LuaSharedKind<T>::value != 0, "SharedView needs struct mapped by LUAAA_STRUCT, random access container or map");
+            LuaSharedView<T>::Push(L, view.get(), 0, view.data());
+        }
+    };
+}
+
+#endif